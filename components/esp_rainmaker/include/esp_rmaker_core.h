@@ -151,6 +151,9 @@ typedef esp_rmaker_handle_t esp_rmaker_device_t;
 /** ESP RainMaker Parameter Handle */
 typedef esp_rmaker_handle_t esp_rmaker_param_t;
 
+/** ESP RainMaker Parameter Transaction Handle */
+typedef esp_rmaker_handle_t esp_rmaker_param_txn_t;
+
 /** Parameter read/write request source */
 typedef enum {
     /** Request triggered in the init sequence i.e. when a value is found
@@ -211,6 +214,69 @@ typedef struct {
     int8_t reset_reboot_seconds;
 } esp_rmaker_system_serv_config_t;
 
+/** Parameter bounds, as used in \ref esp_rmaker_param_desc_t */
+typedef struct {
+    /** Minimum allowed value */
+    esp_rmaker_param_val_t min;
+    /** Maximum allowed value */
+    esp_rmaker_param_val_t max;
+    /** Minimum stepping */
+    esp_rmaker_param_val_t step;
+} esp_rmaker_param_bounds_desc_t;
+
+/** List of valid strings for a string parameter, as used in \ref esp_rmaker_param_desc_t */
+typedef struct {
+    /** Number of strings in str_list */
+    uint8_t str_list_cnt;
+    /** Array of strings */
+    const char **str_list;
+} esp_rmaker_param_valid_str_list_desc_t;
+
+/** Constant parameter descriptor
+ *
+ * Describes a parameter whose metadata does not change at runtime. Declaring this (and everything it
+ * points to) as const lets the compiler place it in flash. Parameters created from it just refer to
+ * the descriptor instead of keeping their own copies of the name, type, bounds, etc. in RAM.
+ */
+typedef struct {
+    /** Name of the parameter */
+    const char *name;
+    /** Parameter type (Optional) */
+    const char *type;
+    /** Default value of the parameter. This also specifies the type of the parameter */
+    esp_rmaker_param_val_t val;
+    /** Properties of the parameter. Logical OR of flags in \ref esp_param_property_flags_t */
+    uint8_t properties;
+    /** UI Type (Optional) */
+    const char *ui_type;
+    /** Bounds for integer/float parameters (Optional) */
+    const esp_rmaker_param_bounds_desc_t *bounds;
+    /** Valid strings for string parameters (Optional) */
+    const esp_rmaker_param_valid_str_list_desc_t *valid_str_list;
+} esp_rmaker_param_desc_t;
+
+/** Constant device descriptor
+ *
+ * Describes a device with a fixed layout of parameters. Similar to \ref esp_rmaker_param_desc_t,
+ * the descriptor should be declared const and must remain valid for the lifetime of the device.
+ */
+typedef struct {
+    /** Name of the device */
+    const char *name;
+    /** Device type (Optional) */
+    const char *type;
+    /** Device subtype (Optional) */
+    const char *subtype;
+    /** Device model (Optional) */
+    const char *model;
+    /** Array of parameter descriptors */
+    const esp_rmaker_param_desc_t *params;
+    /** Number of elements in params */
+    uint8_t param_count;
+    /** Index of the primary parameter in params. Set to -1 if there is none */
+    int8_t primary_param_index;
+} esp_rmaker_device_desc_t;
+
 /** Callback for parameter value write requests.
  *
  * The callback should call the esp_rmaker_param_update_and_report() API if the new value is to be set
@@ -228,6 +294,38 @@ typedef struct {
 typedef esp_err_t (*esp_rmaker_device_write_cb_t)(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
         const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx);
 
+/** Parameter write request, as passed to the bulk write callback */
+typedef struct {
+    /** Parameter handle */
+    esp_rmaker_param_t *param;
+    /** New value of the parameter */
+    esp_rmaker_param_val_t val;
+} esp_rmaker_param_write_req_t;
+
+/** Callback for bulk parameter value write requests.
+ *
+ * Similar to \ref esp_rmaker_device_write_cb_t, but gets invoked only once per device for a request,
+ * with all the parameters of that device which were present in the request. This can be used to
+ * apply all the changes together, Eg. setting power, hue, saturation and brightness of a light with
+ * a single hardware update.
+ *
+ * The callback should use esp_rmaker_param_update() for the parameters to be set and then report
+ * them together with a single esp_rmaker_param_update_and_report() or a transaction
+ * (esp_rmaker_param_txn_begin()).
+ *
+ * @param[in] device Device handle.
+ * @param[in] write_req Array of \ref esp_rmaker_param_write_req_t. The values are valid only till
+ * the callback returns.
+ * @param[in] count Number of elements in the write_req array.
+ * @param[in] priv_data Pointer to the private data paassed while creating the device.
+ * @param[in] ctx Context associated with the request.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+typedef esp_err_t (*esp_rmaker_device_bulk_write_cb_t)(const esp_rmaker_device_t *device,
+        const esp_rmaker_param_write_req_t write_req[], size_t count, void *priv_data, esp_rmaker_write_ctx_t *ctx);
+
 /** Callback for parameter value changes
  *
  * The callback should call the esp_rmaker_param_update_and_report() API if the new value is to be set
@@ -499,6 +597,39 @@ esp_rmaker_device_t *esp_rmaker_device_create(const char *dev_name, const char *
  */
 esp_rmaker_device_t *esp_rmaker_service_create(const char *serv_name, const char *type, void *priv_data);
 
+/**
+ * Create a Device from a constant descriptor
+ *
+ * Creates a device along with all the parameters described in the descriptor, and assigns
+ * the primary parameter, if any. The names, types, bounds, etc. are not copied, so the descriptor
+ * should be a const (flash resident) table which stays valid for the lifetime of the device.
+ * Only the parameter values are kept in RAM.
+ *
+ * Eg.
+ * static const esp_rmaker_param_bounds_desc_t brightness_bounds = {
+ *     .min = {RMAKER_VAL_TYPE_INTEGER, {.i = 0}}, .max = {RMAKER_VAL_TYPE_INTEGER, {.i = 100}},
+ *     .step = {RMAKER_VAL_TYPE_INTEGER, {.i = 1}},
+ * };
+ * static const esp_rmaker_param_desc_t light_params[] = {
+ *     {"Name", ESP_RMAKER_PARAM_NAME, {RMAKER_VAL_TYPE_STRING, {.s = "Light"}}, PROP_FLAG_READ | PROP_FLAG_WRITE | PROP_FLAG_PERSIST, ESP_RMAKER_UI_TEXT},
+ *     {"Power", ESP_RMAKER_PARAM_POWER, {RMAKER_VAL_TYPE_BOOLEAN, {.b = true}}, PROP_FLAG_READ | PROP_FLAG_WRITE, ESP_RMAKER_UI_TOGGLE},
+ *     {"Brightness", ESP_RMAKER_PARAM_BRIGHTNESS, {RMAKER_VAL_TYPE_INTEGER, {.i = 25}}, PROP_FLAG_READ | PROP_FLAG_WRITE, ESP_RMAKER_UI_SLIDER, &brightness_bounds},
+ * };
+ * static const esp_rmaker_device_desc_t light_desc = {
+ *     .name = "Light", .type = ESP_RMAKER_DEVICE_LIGHTBULB, .params = light_params, .param_count = 3, .primary_param_index = 1,
+ * };
+ * light_device = esp_rmaker_device_create_from_desc(&light_desc, NULL);
+ *
+ * @note The device still needs to be added to the node using esp_rmaker_node_add_device().
+ *
+ * @param[in] desc Pointer to the device descriptor.
+ * @param[in] priv_data (Optional) Private data associated with the device. This will be passed to callbacks.
+ *
+ * @return Device handle on success.
+ * @return NULL in case of any error.
+ */
+esp_rmaker_device_t *esp_rmaker_device_create_from_desc(const esp_rmaker_device_desc_t *desc, void *priv_data);
+
 /**
  * Delete a Device/Service
  *
@@ -528,6 +659,23 @@ esp_err_t esp_rmaker_device_delete(const esp_rmaker_device_t *device);
  */
 esp_err_t esp_rmaker_device_add_cb(const esp_rmaker_device_t *device, esp_rmaker_device_write_cb_t write_cb, esp_rmaker_device_read_cb_t read_cb);
 
+/**
+ * Add bulk callbacks for a device/service
+ *
+ * Add a bulk write callback for a device, which will be invoked once per request with all the parameters
+ * of the device that were present in the request, instead of once per parameter.
+ * If a bulk write callback is registered, it takes precedence over the write callback registered
+ * using esp_rmaker_device_add_cb().
+ *
+ * @param[in] device Device handle.
+ * @param[in] write_cb Bulk write callback.
+ * @param[in] read_cb Read callback.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_device_add_bulk_cb(const esp_rmaker_device_t *device, esp_rmaker_device_bulk_write_cb_t write_cb, esp_rmaker_device_read_cb_t read_cb);
+
 /**
  * Add a device to a node
  *
@@ -698,6 +846,20 @@ esp_err_t esp_rmaker_device_assign_primary_param(const esp_rmaker_device_t *devi
 esp_rmaker_param_t *esp_rmaker_param_create(const char *param_name, const char *type,
         esp_rmaker_param_val_t val, uint8_t properties);
 
+/**
+ * Create a Parameter from a constant descriptor
+ *
+ * Similar to esp_rmaker_param_create(), but the name, type, UI type, bounds and valid strings
+ * are referred from the descriptor instead of being copied, so the descriptor should stay valid
+ * for the lifetime of the parameter. Only the value of the parameter is kept in RAM.
+ *
+ * @param[in] desc Pointer to the parameter descriptor.
+ *
+ * @return Parameter handle on success.
+ * @return NULL in case of failure.
+ */
+esp_rmaker_param_t *esp_rmaker_param_create_from_desc(const esp_rmaker_param_desc_t *desc);
+
 /**
  * Add a UI Type to a parameter
  *
@@ -753,6 +915,37 @@ esp_err_t esp_rmaker_param_add_bounds(const esp_rmaker_param_t *param,
  */
 esp_err_t esp_rmaker_param_add_valid_str_list(const esp_rmaker_param_t *param, const char *strs[], uint8_t count);
 
+/**
+ * Add a list of strings for an enumerated string parameter
+ *
+ * Similar to esp_rmaker_param_add_valid_str_list(), but the parameter value is then stored internally
+ * as an index into this list, instead of as an allocated copy of the string. Updates to the parameter
+ * (including the ones received from the cloud) are validated against the list and do not allocate
+ * any memory. Values not in the list are rejected.
+ *
+ * The value of the parameter, as seen by the callbacks and esp_rmaker_param_get_val(), points to
+ * the corresponding string in the list. esp_rmaker_param_get_enum_index() can be used to get the index.
+ *
+ * @param[in] param Parameter handle.
+ * @param[in] strs Pointer to an array of unique strings, each not longer than 63 characters.
+ * Note that this memory should stay allocated throughout the lifetime of this parameter.
+ * @param[in] count Number of strings in the above array.
+ *
+ * @return ESP_OK on success.
+ * return error in case of failure.
+ */
+esp_err_t esp_rmaker_param_add_enum_str_list(const esp_rmaker_param_t *param, const char *strs[], uint8_t count);
+
+/**
+ * Get the index of the current value of an enumerated string parameter
+ *
+ * @param[in] param Parameter handle, which has a list added using esp_rmaker_param_add_enum_str_list().
+ *
+ * @return Index of the current value in the list, on success.
+ * @return -1 in case of failure or if no value has been set.
+ */
+int esp_rmaker_param_get_enum_index(const esp_rmaker_param_t *param);
+
 /** Add max count for an array parameter
  *
  * This can be used to put a limit on the maximum number of elements in an array.
@@ -767,6 +960,32 @@ esp_err_t esp_rmaker_param_add_valid_str_list(const esp_rmaker_param_t *param, c
  */
 esp_err_t esp_rmaker_param_add_array_max_count(const esp_rmaker_param_t *param, int count);
 
+/** Enable windowed aggregation for a simple time series parameter
+ *
+ * By default, every esp_rmaker_param_update_and_report()/esp_rmaker_param_update_and_notify() call
+ * on a parameter with \ref PROP_FLAG_SIMPLE_TIME_SERIES publishes the instantaneous value.
+ * Once aggregation is enabled, the values are instead accumulated locally and a single summary
+ * record with the min, max, mean and count of the samples is published once every window.
+ * The memory used is constant per parameter, irrespective of the sampling rate.
+ *
+ * The summary record is published on the next update after the window has elapsed, or by a timer
+ * at the end of the window if there is no such update. It has the mean as "v" (so that it stays
+ * compatible with simple time series consumers) along with "min", "max" and "count". The "t" field
+ * is the start of the window.
+ *
+ * Calling this again, to change the window or to disable aggregation, publishes the summary of the
+ * samples collected so far in the current window.
+ *
+ * @note Only integer and float parameters with \ref PROP_FLAG_SIMPLE_TIME_SERIES are supported.
+ *
+ * @param[in] param Parameter handle.
+ * @param[in] window_secs Aggregation window in seconds. Passing 0 disables aggregation.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure, including failure to publish the partial window.
+ */
+esp_err_t esp_rmaker_param_set_simple_ts_aggregation(const esp_rmaker_param_t *param, uint32_t window_secs);
+
 
 /* Update a parameter
  *
@@ -825,6 +1044,225 @@ esp_err_t esp_rmaker_param_update_and_report(const esp_rmaker_param_t *param, es
  */
 esp_err_t esp_rmaker_param_update_and_notify(const esp_rmaker_param_t *param, esp_rmaker_param_val_t val);
 
+/** Begin a parameter update transaction
+ *
+ * A transaction can be used when multiple parameters change together (Eg. hue, saturation and
+ * brightness of a light). The new values are staged using esp_rmaker_param_txn_stage() and applied
+ * together by esp_rmaker_param_txn_commit(), which persists all the \ref PROP_FLAG_PERSIST params
+ * with a single NVS commit per device and reports all of them in a single message.
+ *
+ * Sample:
+ *
+ * esp_rmaker_param_txn_t *txn = esp_rmaker_param_txn_begin();
+ * esp_rmaker_param_txn_stage(txn, hue_param, esp_rmaker_int(120));
+ * esp_rmaker_param_txn_stage(txn, saturation_param, esp_rmaker_int(80));
+ * esp_rmaker_param_txn_stage(txn, brightness_param, esp_rmaker_int(50));
+ * esp_rmaker_param_txn_commit(txn);
+ *
+ * @return Transaction handle on success.
+ * @return NULL in case of failure.
+ */
+esp_rmaker_param_txn_t *esp_rmaker_param_txn_begin(void);
+
+/** Stage a parameter value in a transaction
+ *
+ * The value is copied and will be applied to the parameter only on esp_rmaker_param_txn_commit().
+ * Staging the same parameter again replaces the earlier staged value.
+ *
+ * @param[in] txn Transaction handle returned by esp_rmaker_param_txn_begin().
+ * @param[in] param Parameter handle.
+ * @param[in] val New value of the parameter.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_param_txn_stage(esp_rmaker_param_txn_t *txn, const esp_rmaker_param_t *param, esp_rmaker_param_val_t val);
+
+/** Commit a parameter update transaction
+ *
+ * Applies all the staged values, persists the changed \ref PROP_FLAG_PERSIST params and reports
+ * all of them in a single message (if RainMaker has started). All the staged values are checked
+ * before applying any of them, so if any value is invalid, none of the params are changed.
+ * The transaction handle is freed and should not be used after this call, irrespective of the
+ * return value.
+ *
+ * @param[in] txn Transaction handle returned by esp_rmaker_param_txn_begin().
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_param_txn_commit(esp_rmaker_param_txn_t *txn);
+
+/** Abort a parameter update transaction
+ *
+ * Discards all the staged values and frees the transaction handle.
+ *
+ * @param[in] txn Transaction handle returned by esp_rmaker_param_txn_begin().
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_param_txn_abort(esp_rmaker_param_txn_t *txn);
+
+/** Set params queue statistics */
+typedef struct {
+    /** Number of requests added to the queue */
+    uint32_t enqueued;
+    /** Number of requests processed by the worker */
+    uint32_t processed;
+    /** Number of requests dropped because the queue was full */
+    uint32_t dropped;
+    /** Current number of requests in the queue */
+    uint8_t depth;
+    /** Maximum number of requests seen in the queue */
+    uint8_t max_depth;
+    /** Average time (in msec) that requests waited in the queue */
+    uint32_t avg_wait_ms;
+    /** Maximum time (in msec) that a request waited in the queue */
+    uint32_t max_wait_ms;
+} esp_rmaker_set_params_queue_stats_t;
+
+/** Get set params queue statistics
+ *
+ * If CONFIG_ESP_RMAKER_SET_PARAMS_QUEUE_ENABLE is set, the set params requests received from the cloud,
+ * schedules and scenes are queued and handled by a dedicated task, instead of in the context of the task
+ * which received them. This API gives the statistics of that queue.
+ *
+ * @param[out] stats Pointer to a \ref esp_rmaker_set_params_queue_stats_t structure to fill.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NOT_SUPPORTED if the queue is not enabled.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_set_params_queue_get_stats(esp_rmaker_set_params_queue_stats_t *stats);
+
+/** Stages of handling a set params request, for latency tracing.
+ *
+ * The param update, NVS store, JSON populate and publish stages are recorded only when they happen as
+ * part of handling a set params request, like from the device write callback, and not when the
+ * application updates or reports params on its own.
+ */
+typedef enum {
+    /** Parsing of the received JSON */
+    ESP_RMAKER_LATENCY_STAGE_PARSE = 0,
+    /** Device write callback (including any param updates/reports done from within it) */
+    ESP_RMAKER_LATENCY_STAGE_WRITE_CB,
+    /** Updating the param value in the data model */
+    ESP_RMAKER_LATENCY_STAGE_PARAM_UPDATE,
+    /** Storing persistent param values in NVS */
+    ESP_RMAKER_LATENCY_STAGE_NVS_STORE,
+    /** Populating the JSON for the params report */
+    ESP_RMAKER_LATENCY_STAGE_JSON_POPULATE,
+    /** Publishing the params report over MQTT */
+    ESP_RMAKER_LATENCY_STAGE_PUBLISH,
+    /** Complete handling of the set params request */
+    ESP_RMAKER_LATENCY_STAGE_TOTAL,
+    /** Number of stages. Not to be used as a stage. */
+    ESP_RMAKER_LATENCY_STAGE_MAX,
+} esp_rmaker_latency_stage_t;
+
+/** Number of histogram buckets per latency stage.
+ *
+ * Bucket 0 counts the samples below 128us, bucket n (n > 0) the ones in [2^(n+6), 2^(n+7)) us,
+ * and the last bucket, all the samples from 2^(ESP_RMAKER_LATENCY_HIST_BUCKETS+5) us onwards.
+ */
+#define ESP_RMAKER_LATENCY_HIST_BUCKETS     12
+
+/** Latency statistics of a stage */
+typedef struct {
+    /** Number of samples */
+    uint32_t count;
+    /** Minimum latency (in usec) */
+    uint32_t min_us;
+    /** Maximum latency (in usec) */
+    uint32_t max_us;
+    /** Sum of all the latencies (in usec) */
+    uint64_t total_us;
+    /** Latency histogram */
+    uint32_t hist[ESP_RMAKER_LATENCY_HIST_BUCKETS];
+} esp_rmaker_latency_stats_t;
+
+/** Get the latency statistics of a set params handling stage
+ *
+ * This requires CONFIG_ESP_RMAKER_LATENCY_TRACE to be enabled.
+ *
+ * @param[in] stage The stage for which the statistics are required.
+ * @param[out] stats Pointer to a \ref esp_rmaker_latency_stats_t structure to fill.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NOT_SUPPORTED if latency tracing is not enabled.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_latency_get_stats(esp_rmaker_latency_stage_t stage, esp_rmaker_latency_stats_t *stats);
+
+/** Reset the latency statistics of all stages
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NOT_SUPPORTED if latency tracing is not enabled.
+ */
+esp_err_t esp_rmaker_latency_reset(void);
+
+/** Get the name of a set params handling stage
+ *
+ * @param[in] stage The stage.
+ *
+ * @return Name of the stage. "invalid" for an invalid stage.
+ */
+const char *esp_rmaker_latency_stage_to_str(esp_rmaker_latency_stage_t stage);
+
+/** Subsystem tags for heap accounting */
+typedef enum {
+    /** Params JSON buffers and set params request payloads */
+    ESP_RMAKER_MEM_TAG_PARAMS = 0,
+    /** Node config JSON */
+    ESP_RMAKER_MEM_TAG_NODE_CONFIG,
+    /** Schedules */
+    ESP_RMAKER_MEM_TAG_SCHEDULE,
+    /** Scenes */
+    ESP_RMAKER_MEM_TAG_SCENES,
+    /** OTA */
+    ESP_RMAKER_MEM_TAG_OTA,
+    /** Local control */
+    ESP_RMAKER_MEM_TAG_LOCAL_CTRL,
+    /** Number of tags. Not to be used as a tag. */
+    ESP_RMAKER_MEM_TAG_MAX,
+} esp_rmaker_mem_tag_t;
+
+/** Heap accounting statistics of a subsystem tag */
+typedef struct {
+    /** Bytes currently allocated */
+    uint32_t live_bytes;
+    /** Maximum bytes allocated at any time */
+    uint32_t peak_bytes;
+    /** Total bytes allocated so far, including the ones freed */
+    uint64_t total_bytes;
+    /** Number of allocations */
+    uint32_t alloc_count;
+    /** Number of frees */
+    uint32_t free_count;
+} esp_rmaker_mem_tag_stats_t;
+
+/** Get the heap accounting statistics of a subsystem tag
+ *
+ * This requires CONFIG_ESP_RMAKER_MEM_TAG_ACCOUNTING to be enabled.
+ *
+ * @param[in] tag The subsystem tag.
+ * @param[out] stats Pointer to a \ref esp_rmaker_mem_tag_stats_t structure to fill.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NOT_SUPPORTED if heap accounting is not enabled.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_mem_tag_get_stats(esp_rmaker_mem_tag_t tag, esp_rmaker_mem_tag_stats_t *stats);
+
+/** Get the name of a subsystem tag
+ *
+ * @param[in] tag The subsystem tag.
+ *
+ * @return Name of the tag. "invalid" for an invalid tag.
+ */
+const char *esp_rmaker_mem_tag_to_str(esp_rmaker_mem_tag_t tag);
+
 /** Trigger an alert on the phone app
  *
  * This API will trigger a notification alert on the phone apps (if enabled) using the formatted text
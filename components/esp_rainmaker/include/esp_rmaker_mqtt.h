@@ -70,6 +70,127 @@ esp_err_t esp_rmaker_mqtt_disconnect(void);
  */
 esp_err_t esp_rmaker_mqtt_publish(const char *topic, void *data, size_t data_len, uint8_t qos, int *msg_id);
 
+/** Classes of outbound MQTT messages, in the order of priority */
+typedef enum {
+    /** Alerts and param notifications */
+    ESP_RMAKER_MQTT_MSG_CLASS_ALERT = 0,
+    /** Command responses, OTA status, user mapping and other acknowledgements */
+    ESP_RMAKER_MQTT_MSG_CLASS_CONTROL_ACK,
+    /** Param reports */
+    ESP_RMAKER_MQTT_MSG_CLASS_PARAM_REPORT,
+    /** Time series data and diagnostics */
+    ESP_RMAKER_MQTT_MSG_CLASS_TIME_SERIES,
+    /** Node configuration */
+    ESP_RMAKER_MQTT_MSG_CLASS_CONFIG,
+    /** Number of classes. Not to be used as a class. */
+    ESP_RMAKER_MQTT_MSG_CLASS_MAX,
+} esp_rmaker_mqtt_msg_class_t;
+
+/** Publish MQTT Message of a specific class
+ *
+ * If CONFIG_ESP_RMAKER_MQTT_PUBLISH_QUEUE is enabled and the MQTT budget is exhausted, the message is
+ * queued as per the policy of its class, and sent once the budget revives. Queued messages are sent in the
+ * order of priority of their classes. Alerts and acknowledgements are drained at control priority. Messages
+ * for which a msg_id is requested are never queued, since the message id is not known till the message is
+ * actually sent.
+ *
+ * esp_rmaker_mqtt_publish() uses this internally, with the class derived from the topic.
+ *
+ * @param[in] topic The MQTT topic on which the message should be published.
+ * @param[in] data Data to be published
+ * @param[in] data_len Length of the data
+ * @param[in] qos Quality of Service for the Publish. Can be 0, 1 or 2. Also depends on what the MQTT broker supports.
+ * @param[out] msg_id Optional pointer to hold the message id of the publish.
+ * @param[in] msg_class Class of the message.
+ *
+ * @return ESP_OK on success (including if the message got queued).
+ * @return error in case of any error.
+ */
+esp_err_t esp_rmaker_mqtt_publish_with_class(const char *topic, void *data, size_t data_len, uint8_t qos,
+        int *msg_id, esp_rmaker_mqtt_msg_class_t msg_class);
+
+/** Outbound queue statistics of a message class */
+typedef struct {
+    /** Messages queued because of insufficient budget */
+    uint32_t queued;
+    /** Queued messages which were eventually sent */
+    uint32_t sent;
+    /** Messages dropped, either because the queue was full or because sending failed */
+    uint32_t dropped;
+    /** Messages collapsed into an already queued one */
+    uint32_t coalesced;
+    /** Current queue depth */
+    uint8_t depth;
+    /** Maximum queue depth seen */
+    uint8_t max_depth;
+} esp_rmaker_mqtt_publish_queue_stats_t;
+
+/** Get the outbound queue statistics of a message class
+ *
+ * This requires CONFIG_ESP_RMAKER_MQTT_PUBLISH_QUEUE to be enabled.
+ *
+ * @param[in] msg_class The message class.
+ * @param[out] stats Pointer to a \ref esp_rmaker_mqtt_publish_queue_stats_t structure to fill.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NOT_SUPPORTED if the publish queue is not enabled.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_mqtt_publish_queue_get_stats(esp_rmaker_mqtt_msg_class_t msg_class,
+        esp_rmaker_mqtt_publish_queue_stats_t *stats);
+
+/** Get the name of a message class
+ *
+ * @param[in] msg_class The message class.
+ *
+ * @return Name of the class. "invalid" for an invalid class.
+ */
+const char *esp_rmaker_mqtt_msg_class_to_str(esp_rmaker_mqtt_msg_class_t msg_class);
+
+/** Payload compression statistics */
+typedef struct {
+    /** Messages published compressed */
+    uint32_t compressed;
+    /** Messages which were eligible, but published uncompressed since they did not get any smaller */
+    uint32_t incompressible;
+    /** Total size of the eligible messages, before compression */
+    uint64_t bytes_in;
+    /** Total size of the eligible messages, as published */
+    uint64_t bytes_out;
+    /** Total time spent compressing, in microseconds */
+    uint64_t time_us;
+} esp_rmaker_mqtt_compress_stats_t;
+
+/** Compress data as per the MQTT payload compression settings
+ *
+ * The output is a heatshrink (LZSS) stream, with the window and lookahead sizes as per
+ * CONFIG_ESP_RMAKER_MQTT_COMPRESSION_WINDOW_BITS and CONFIG_ESP_RMAKER_MQTT_COMPRESSION_LOOKAHEAD_BITS.
+ * Compressed messages are published on the original topic suffixed with "/hs-<window bits>-<lookahead bits>",
+ * so that the receiver knows how to decompress them.
+ * This requires CONFIG_ESP_RMAKER_MQTT_COMPRESSION to be enabled.
+ *
+ * @param[in] data Data to be compressed.
+ * @param[in] data_len Length of the data.
+ * @param[out] out Buffer for the compressed data.
+ * @param[in,out] out_len Size of the out buffer. Updated with the length of the compressed data on success.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_INVALID_SIZE if the compressed data did not fit in the out buffer.
+ * @return ESP_ERR_NOT_SUPPORTED if payload compression is not enabled.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_mqtt_compress(const void *data, size_t data_len, void *out, size_t *out_len);
+
+/** Get the payload compression statistics
+ *
+ * @param[out] stats Pointer to a \ref esp_rmaker_mqtt_compress_stats_t structure to fill.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NOT_SUPPORTED if payload compression is not enabled.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_mqtt_compress_get_stats(esp_rmaker_mqtt_compress_stats_t *stats);
+
 /** Subscribe to MQTT topic
  *
  * @param[in] topic The topic to be subscribed to.
@@ -111,6 +232,87 @@ void esp_rmaker_create_mqtt_topic(char *buf, size_t buf_size, const char *topic_
  */
 bool esp_rmaker_mqtt_is_budget_available(void);
 
+/** Budget configuration of a message class
+ *
+ * Each message class has a budget reserved for it, out of the MQTT budget of the node (as configured by
+ * CONFIG_ESP_RMAKER_MQTT_DEFAULT_BUDGET and related options). Only messages of that class can use it. Once it
+ * is exhausted, messages of the class use the unreserved part of the budget, which is shared by all the classes.
+ * This way, a chatty class cannot starve the others of budget. Every message consumes the budget of the node,
+ * so the reserves do not increase the number of messages that the node can send. If the budget of the node
+ * is not enough for all the reserves, the reserves of the lower priority classes are reduced.
+ */
+typedef struct {
+    /** Maximum budget reserved for the class. This is the burst that the class can send
+     * without touching the unreserved budget. 0 to use only the unreserved budget.
+     */
+    uint16_t max_budget;
+    /** Count by which the budget of the class revives every CONFIG_ESP_RMAKER_MQTT_BUDGET_REVIVE_PERIOD seconds,
+     * out of the budget of the node */
+    uint8_t revive_count;
+} esp_rmaker_mqtt_class_budget_config_t;
+
+/** Budget statistics of a message class */
+typedef struct {
+    /** Current budget of the class */
+    int16_t budget;
+    /** Current unreserved budget, shared by all the classes */
+    int16_t shared_budget;
+    /** Messages sent using the budget of the class */
+    uint32_t consumed;
+    /** Messages sent using the unreserved budget */
+    uint32_t borrowed;
+    /** Number of times the class was found to be out of budget (including the unreserved budget) */
+    uint32_t exhausted;
+} esp_rmaker_mqtt_class_budget_stats_t;
+
+/** Check if budget is available to publish an MQTT message of a given class
+ *
+ * @param[in] msg_class The message class.
+ *
+ * @return true if either the budget of the class or the unreserved budget is available
+ * @return false if budget is exhausted
+ */
+bool esp_rmaker_mqtt_is_class_budget_available(esp_rmaker_mqtt_msg_class_t msg_class);
+
+/** Set the budget configuration of a message class
+ *
+ * The defaults are as per the CONFIG_ESP_RMAKER_MQTT_*_BUDGET options. This can be called
+ * any time. If the current budget of the class is more than the new maximum, it gets reduced.
+ *
+ * @param[in] msg_class The message class.
+ * @param[in] config Pointer to the budget configuration.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NOT_SUPPORTED if MQTT budgeting is not enabled.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_mqtt_set_class_budget_config(esp_rmaker_mqtt_msg_class_t msg_class,
+        const esp_rmaker_mqtt_class_budget_config_t *config);
+
+/** Get the budget configuration of a message class
+ *
+ * @param[in] msg_class The message class.
+ * @param[out] config Pointer to a \ref esp_rmaker_mqtt_class_budget_config_t structure to fill.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NOT_SUPPORTED if MQTT budgeting is not enabled.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_mqtt_get_class_budget_config(esp_rmaker_mqtt_msg_class_t msg_class,
+        esp_rmaker_mqtt_class_budget_config_t *config);
+
+/** Get the budget statistics of a message class
+ *
+ * @param[in] msg_class The message class.
+ * @param[out] stats Pointer to a \ref esp_rmaker_mqtt_class_budget_stats_t structure to fill.
+ *
+ * @return ESP_OK on success.
+ * @return ESP_ERR_NOT_SUPPORTED if MQTT budgeting is not enabled.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_mqtt_get_class_budget_stats(esp_rmaker_mqtt_msg_class_t msg_class,
+        esp_rmaker_mqtt_class_budget_stats_t *stats);
+
 /**
  * @brief Check if device is connected to MQTT Server
  *
@@ -119,6 +321,52 @@ bool esp_rmaker_mqtt_is_budget_available(void);
  *
  */
 bool esp_rmaker_is_mqtt_connected();
+
+/** Callback for messages published by the node, when using the MQTT loopback
+ *
+ * @param[in] topic Topic on which the message was published.
+ * @param[in] data Published data.
+ * @param[in] data_len Length of the published data.
+ * @param[in] priv_data Private data registered with esp_rmaker_mqtt_loopback_set_publish_cb().
+ */
+typedef void (*esp_rmaker_mqtt_loopback_publish_cb_t)(const char *topic, const void *data, size_t data_len, void *priv_data);
+
+/** Use the in-process MQTT loopback instead of a real MQTT connection
+ *
+ * Messages published by the node are delivered to the node's own matching subscriptions (and the
+ * callback registered using esp_rmaker_mqtt_loopback_set_publish_cb()) instead of going out to a broker.
+ * Messages from the cloud can be simulated using esp_rmaker_mqtt_loopback_inject().
+ * This is meant for offline testing and benchmarking and requires CONFIG_ESP_RMAKER_MQTT_LOOPBACK.
+ *
+ * @note This should be called before esp_rmaker_node_init().
+ *
+ * @return ESP_OK on success.
+ * @return error in case of any error.
+ */
+esp_err_t esp_rmaker_mqtt_loopback_setup(void);
+
+/** Inject a message, as if it was received from the MQTT broker
+ *
+ * The message is delivered synchronously to all the matching subscriptions.
+ *
+ * @param[in] topic Topic on which the message should appear to have been received.
+ * @param[in] data Message data.
+ * @param[in] data_len Length of the message data.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of any error.
+ */
+esp_err_t esp_rmaker_mqtt_loopback_inject(const char *topic, const void *data, size_t data_len);
+
+/** Register a callback for the messages published by the node, when using the MQTT loopback
+ *
+ * @param[in] cb The callback. NULL to unregister.
+ * @param[in] priv_data Private data to be passed to the callback.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of any error.
+ */
+esp_err_t esp_rmaker_mqtt_loopback_set_publish_cb(esp_rmaker_mqtt_loopback_publish_cb_t cb, void *priv_data);
 #ifdef __cplusplus
 }
 #endif
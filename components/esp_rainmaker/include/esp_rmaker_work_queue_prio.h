@@ -0,0 +1,104 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stdint.h>
+#include <esp_err.h>
+#include <esp_rmaker_work_queue.h>
+
+/** Work classes, in decreasing order of priority */
+typedef enum {
+    /** Time critical work which changes the device state. Eg. Schedule triggers. */
+    ESP_RMAKER_WORK_CLASS_CONTROL = 0,
+    /** Reporting of params, node config, etc. to the cloud. */
+    ESP_RMAKER_WORK_CLASS_REPORT,
+    /** Everything else. Eg. OTA fetch, time sync follow ups. */
+    ESP_RMAKER_WORK_CLASS_BACKGROUND,
+    /** Number of work classes. Not to be used as a class. */
+    ESP_RMAKER_WORK_CLASS_MAX,
+} esp_rmaker_work_class_t;
+
+/** Per work class statistics */
+typedef struct {
+    /** Number of work items added */
+    uint32_t enqueued;
+    /** Number of work items executed */
+    uint32_t processed;
+    /** Number of work items dropped because the class queue was full */
+    uint32_t dropped;
+    /** Number of work items which started executing after their deadline */
+    uint32_t deadline_missed;
+    /** Current number of pending work items */
+    uint8_t depth;
+    /** Maximum number of pending work items seen */
+    uint8_t max_depth;
+    /** Average time (in msec) between adding a work item and it starting execution */
+    uint32_t avg_latency_ms;
+    /** Maximum time (in msec) between adding a work item and it starting execution */
+    uint32_t max_latency_ms;
+} esp_rmaker_work_class_stats_t;
+
+/** Initialise the prioritised work queue
+ *
+ * This is called internally by esp_rmaker_init() and need not be called by applications.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_work_queue_prio_init(void);
+
+/** De-initialise the prioritised work queue
+ *
+ * This is called internally by esp_rmaker_node_deinit() and need not be called by applications.
+ * Any pending work is dropped.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_work_queue_prio_deinit(void);
+
+/** Queue execution of a function in the ESP RainMaker Work Queue, with a priority class
+ *
+ * The work items are executed by the same ESP RainMaker Work Queue task, but whenever that task
+ * picks up work added via this API, it executes the oldest item of the highest priority class
+ * pending at that time. So, a \ref ESP_RMAKER_WORK_CLASS_CONTROL item does not have to wait for all
+ * the report/background work queued before it.
+ *
+ * An item which cannot start executing within its deadline is still executed (since, for example,
+ * a late schedule action is better than a missed one), but is accounted as a deadline miss.
+ *
+ * @note If the prioritised queue has not been initialised, this falls back to esp_rmaker_work_queue_add_task().
+ *
+ * @param[in] work_fn The function to execute.
+ * @param[in] priv_data Private data to be passed to the work function.
+ * @param[in] work_class Priority class of the work.
+ * @param[in] deadline_ms Time (in msec) from now, within which the work should start executing. 0 for no deadline.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_work_queue_add_prio_task(esp_rmaker_work_fn_t work_fn, void *priv_data,
+        esp_rmaker_work_class_t work_class, uint32_t deadline_ms);
+
+/** Get the statistics of a work class
+ *
+ * @param[in] work_class The work class.
+ * @param[out] stats Pointer to a \ref esp_rmaker_work_class_stats_t structure to fill.
+ *
+ * @return ESP_OK on success.
+ * @return error in case of failure.
+ */
+esp_err_t esp_rmaker_work_queue_get_class_stats(esp_rmaker_work_class_t work_class, esp_rmaker_work_class_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -24,8 +24,13 @@
 #include <esp_rmaker_user_mapping.h>
 #include <esp_rmaker_utils.h>
 #include <esp_rmaker_cmd_resp.h>
+#include <esp_rmaker_mqtt.h>
 
 #include <esp_rmaker_console_internal.h>
+#include "esp_rmaker_node_mem.h"
+#include "esp_rmaker_latency.h"
+#include "esp_rmaker_mem_tag.h"
+#include <esp_rmaker_work_queue_prio.h>
 
 static const char *TAG = "esp_rmaker_commands";
 
@@ -149,10 +154,162 @@ static void register_cmd_resp_command()
     esp_console_cmd_register(&cmd_resp_cmd);
 }
 
+static int node_mem_handler(int argc, char** argv)
+{
+    esp_rmaker_node_mem_print_stats();
+    return ESP_OK;
+}
+
+static void register_node_mem()
+{
+    const esp_console_cmd_t cmd = {
+        .command = "node-mem",
+        .help = "Print the memory used by the node data model (devices, params and attributes)",
+        .func = &node_mem_handler,
+    };
+    ESP_LOGI(TAG, "Registering command: %s", cmd.command);
+    esp_console_cmd_register(&cmd);
+}
+
+static int work_queue_stats_handler(int argc, char** argv)
+{
+    static const char *class_str[ESP_RMAKER_WORK_CLASS_MAX] = {"control", "report", "background"};
+    esp_rmaker_work_class_stats_t stats;
+    for (int i = 0; i < ESP_RMAKER_WORK_CLASS_MAX; i++) {
+        if (esp_rmaker_work_queue_get_class_stats(i, &stats) != ESP_OK) {
+            printf("%s: Failed to get work queue stats.\n", TAG);
+            return ESP_FAIL;
+        }
+        printf("%s: %-10s: enqueued %"PRIu32", processed %"PRIu32", dropped %"PRIu32", deadline missed %"PRIu32
+                ", depth %d (max %d), latency avg %"PRIu32" ms (max %"PRIu32" ms)\n", TAG, class_str[i],
+                stats.enqueued, stats.processed, stats.dropped, stats.deadline_missed, stats.depth, stats.max_depth,
+                stats.avg_latency_ms, stats.max_latency_ms);
+    }
+    return ESP_OK;
+}
+
+static void register_work_queue_stats()
+{
+    const esp_console_cmd_t cmd = {
+        .command = "work-queue-stats",
+        .help = "Print the depth and latency statistics of the prioritised work queue classes",
+        .func = &work_queue_stats_handler,
+    };
+    ESP_LOGI(TAG, "Registering command: %s", cmd.command);
+    esp_console_cmd_register(&cmd);
+}
+
+static int mqtt_queue_stats_handler(int argc, char** argv)
+{
+    esp_rmaker_mqtt_publish_queue_stats_t stats;
+    for (int i = 0; i < ESP_RMAKER_MQTT_MSG_CLASS_MAX; i++) {
+        if (esp_rmaker_mqtt_publish_queue_get_stats(i, &stats) != ESP_OK) {
+            printf("%s: Failed to get MQTT publish queue stats.\n", TAG);
+            return ESP_FAIL;
+        }
+        printf("%s: %-12s: queued %"PRIu32", sent %"PRIu32", dropped %"PRIu32", coalesced %"PRIu32
+                ", depth %d (max %d)\n", TAG, esp_rmaker_mqtt_msg_class_to_str(i),
+                stats.queued, stats.sent, stats.dropped, stats.coalesced, stats.depth, stats.max_depth);
+    }
+    return ESP_OK;
+}
+
+static int mqtt_budget_stats_handler(int argc, char** argv)
+{
+    esp_rmaker_mqtt_class_budget_stats_t stats;
+    esp_rmaker_mqtt_class_budget_config_t config;
+    for (int i = 0; i < ESP_RMAKER_MQTT_MSG_CLASS_MAX; i++) {
+        if ((esp_rmaker_mqtt_get_class_budget_stats(i, &stats) != ESP_OK) ||
+                (esp_rmaker_mqtt_get_class_budget_config(i, &config) != ESP_OK)) {
+            printf("%s: Failed to get MQTT budget stats.\n", TAG);
+            return ESP_FAIL;
+        }
+        printf("%s: %-12s: budget %d/%d (+%d), consumed %"PRIu32", borrowed %"PRIu32", exhausted %"PRIu32"\n",
+                TAG, esp_rmaker_mqtt_msg_class_to_str(i), stats.budget, config.max_budget, config.revive_count,
+                stats.consumed, stats.borrowed, stats.exhausted);
+        if (i == ESP_RMAKER_MQTT_MSG_CLASS_MAX - 1) {
+            printf("%s: Shared budget: %d\n", TAG, stats.shared_budget);
+        }
+    }
+    return ESP_OK;
+}
+
+static void register_mqtt_budget_stats()
+{
+    const esp_console_cmd_t cmd = {
+        .command = "mqtt-budget-stats",
+        .help = "Print the MQTT budget and its consumption, per message class",
+        .func = &mqtt_budget_stats_handler,
+    };
+    ESP_LOGI(TAG, "Registering command: %s", cmd.command);
+    esp_console_cmd_register(&cmd);
+}
+
+static void register_mqtt_queue_stats()
+{
+    const esp_console_cmd_t cmd = {
+        .command = "mqtt-queue-stats",
+        .help = "Print the statistics of the outbound MQTT queue, per message class",
+        .func = &mqtt_queue_stats_handler,
+    };
+    ESP_LOGI(TAG, "Registering command: %s", cmd.command);
+    esp_console_cmd_register(&cmd);
+}
+
+static int latency_handler(int argc, char** argv)
+{
+    if ((argc == 2) && (strcmp(argv[1], "reset") == 0)) {
+        if (esp_rmaker_latency_reset() != ESP_OK) {
+            printf("%s: Failed to reset latency stats.\n", TAG);
+            return ESP_FAIL;
+        }
+        return ESP_OK;
+    } else if (argc != 1) {
+        printf("%s: Invalid Usage.\n", TAG);
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_rmaker_latency_print_stats();
+    return ESP_OK;
+}
+
+static void register_latency()
+{
+    const esp_console_cmd_t cmd = {
+        .command = "latency",
+        .help = "Print the per stage latency histograms of set params handling. Usage: latency [reset]",
+        .func = &latency_handler,
+    };
+    ESP_LOGI(TAG, "Registering command: %s", cmd.command);
+    esp_console_cmd_register(&cmd);
+}
+
+static int mem_tags_handler(int argc, char** argv)
+{
+    esp_rmaker_mem_tag_print_stats();
+    return ESP_OK;
+}
+
+static void register_mem_tags()
+{
+    const esp_console_cmd_t cmd = {
+        .command = "mem-tags",
+        .help = "Print the heap memory used by each RainMaker subsystem",
+        .func = &mem_tags_handler,
+    };
+    ESP_LOGI(TAG, "Registering command: %s", cmd.command);
+    esp_console_cmd_register(&cmd);
+}
+
 void register_commands()
 {
     register_user_node_mapping();
     register_get_node_id();
     register_wifi_prov();
     register_cmd_resp_command();
+    register_node_mem();
+    register_work_queue_stats();
+    register_mqtt_queue_stats();
+    register_mqtt_budget_stats();
+    register_latency();
+    register_mem_tags();
 }
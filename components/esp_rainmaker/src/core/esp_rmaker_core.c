@@ -23,6 +23,7 @@
 
 #include <esp_rmaker_factory.h>
 #include <esp_rmaker_work_queue.h>
+#include <esp_rmaker_work_queue_prio.h>
 #include <esp_rmaker_common_events.h>
 #include <esp_rmaker_utils.h>
 
@@ -30,6 +31,7 @@
 #include <esp_rmaker_user_mapping.h>
 #include <esp_rmaker_utils.h>
 #include "esp_rmaker_internal.h"
+#include "esp_rmaker_node_mem.h"
 #include "esp_rmaker_mqtt.h"
 #include "esp_rmaker_claim.h"
 #include "esp_rmaker_client_data.h"
@@ -231,6 +233,7 @@ static esp_err_t esp_rmaker_deinit_priv_data(esp_rmaker_priv_data_t *rmaker_priv
     if (!rmaker_priv_data) {
         return ESP_ERR_INVALID_ARG;
     }
+    esp_rmaker_work_queue_prio_deinit();
     esp_rmaker_work_queue_deinit();
 #ifndef CONFIG_ESP_RMAKER_DISABLE_USER_MAPPING_PROV
     esp_rmaker_user_mapping_prov_deinit();
@@ -299,7 +302,8 @@ static void __esp_rmaker_report_node_config_and_state(void *data)
 
 esp_err_t esp_rmaker_report_node_details()
 {
-    return esp_rmaker_work_queue_add_task(__esp_rmaker_report_node_config_and_state, NULL);
+    return esp_rmaker_work_queue_add_prio_task(__esp_rmaker_report_node_config_and_state, NULL,
+            ESP_RMAKER_WORK_CLASS_REPORT, 0);
 }
 
 
@@ -529,6 +533,18 @@ static esp_err_t esp_rmaker_init(const esp_rmaker_config_t *config, bool use_cla
         ESP_LOGE(TAG, "ESP RainMaker Queue Creation Failed");
         return ESP_ERR_NO_MEM;
     }
+    if (esp_rmaker_work_queue_prio_init() != ESP_OK) {
+        esp_rmaker_deinit_priv_data(esp_rmaker_priv_data);
+        esp_rmaker_priv_data = NULL;
+        ESP_LOGE(TAG, "ESP RainMaker Prioritised Work Queue Creation Failed");
+        return ESP_ERR_NO_MEM;
+    }
+    if (esp_rmaker_set_params_queue_init() != ESP_OK) {
+        esp_rmaker_deinit_priv_data(esp_rmaker_priv_data);
+        esp_rmaker_priv_data = NULL;
+        ESP_LOGE(TAG, "ESP RainMaker Set Params Queue Creation Failed");
+        return ESP_ERR_NO_MEM;
+    }
 #ifndef CONFIG_ESP_RMAKER_DISABLE_USER_MAPPING_PROV
     if (esp_rmaker_user_mapping_prov_init()) {
         esp_rmaker_deinit_priv_data(esp_rmaker_priv_data);
@@ -614,6 +630,8 @@ const esp_rmaker_node_t *esp_rmaker_get_node()
 esp_err_t esp_rmaker_start(void)
 {
     ESP_RMAKER_CHECK_HANDLE(ESP_ERR_INVALID_STATE);
+    /* Devices and params added from now on can also get removed at runtime, so they should not use the arena */
+    esp_rmaker_node_mem_arena_close();
     if (esp_rmaker_priv_data->enable_time_sync) {
         esp_rmaker_time_sync_init(NULL);
     }
@@ -622,6 +640,10 @@ esp_err_t esp_rmaker_start(void)
         ESP_LOGE(TAG, "Couldn't create RainMaker Work Queue task");
         return ESP_FAIL;
     }
+    if (esp_rmaker_set_params_queue_start() != ESP_OK) {
+        ESP_LOGE(TAG, "Couldn't create RainMaker Set Params task");
+        return ESP_FAIL;
+    }
     ESP_ERROR_CHECK(esp_event_handler_register(RMAKER_COMMON_EVENT, ESP_EVENT_ANY_ID, &reset_event_handler, NULL));
     return ESP_OK;
 }
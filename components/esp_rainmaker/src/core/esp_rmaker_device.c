@@ -20,9 +20,20 @@
 #include <esp_rmaker_utils.h>
 
 #include "esp_rmaker_internal.h"
+#include "esp_rmaker_node_mem.h"
 
 static const char *TAG = "esp_rmaker_device";
 
+/* Devices created from a const descriptor refer to its metadata, which should not be freed */
+#define DEVICE_DESC_FIELD(_device, _field)  ((_device)->desc ? (const void *)(_device)->desc->_field : NULL)
+
+static void esp_rmaker_device_free_metadata(void *ptr, const void *desc_ptr)
+{
+    if (ptr && (ptr != desc_ptr)) {
+        esp_rmaker_node_mem_free(ptr);
+    }
+}
+
 esp_err_t esp_rmaker_device_delete(const esp_rmaker_device_t *device)
 {
     _esp_rmaker_device_t *_device = (_esp_rmaker_device_t *)device;
@@ -43,41 +54,44 @@ esp_err_t esp_rmaker_device_delete(const esp_rmaker_device_t *device)
             esp_rmaker_param_delete((esp_rmaker_param_t *)param);
             param = next_param;
         }
-        if (_device->subtype) {
-            free(_device->subtype);
-        }
-        if (_device->model) {
-            free(_device->model);
-        }
-        if (_device->name) {
-            free(_device->name);
-        }
-        if (_device->type) {
-            free(_device->type);
-        }
+        esp_rmaker_device_free_metadata(_device->subtype, DEVICE_DESC_FIELD(_device, subtype));
+        esp_rmaker_device_free_metadata(_device->model, DEVICE_DESC_FIELD(_device, model));
+        esp_rmaker_device_free_metadata(_device->name, DEVICE_DESC_FIELD(_device, name));
+        esp_rmaker_device_free_metadata(_device->type, DEVICE_DESC_FIELD(_device, type));
+        esp_rmaker_node_mem_free(_device);
         return ESP_OK;
     }
     return ESP_ERR_INVALID_ARG;
 }
 
-static esp_rmaker_device_t *__esp_rmaker_device_create(const char *name, const char *type, void *priv, bool is_service)
+static esp_rmaker_device_t *__esp_rmaker_device_create(const char *name, const char *type, void *priv, bool is_service,
+        const esp_rmaker_device_desc_t *desc)
 {
     if (!name) {
         ESP_LOGE(TAG, "%s name is mandatory", is_service ? "Service":"Device");
         return NULL;
     }
-    _esp_rmaker_device_t *_device = MEM_CALLOC_EXTRAM(1, sizeof(_esp_rmaker_device_t));
+    _esp_rmaker_device_t *_device = esp_rmaker_node_mem_calloc(ESP_RMAKER_NODE_MEM_DEVICE, sizeof(_esp_rmaker_device_t));
     if (!_device) {
         ESP_LOGE(TAG, "Failed to allocate memory for %s %s", is_service ? "Service":"Device", name);
         return NULL;
     }
-    _device->name = strdup(name);
+    if (desc) {
+        /* Devices created from a const descriptor just refer to its metadata */
+        _device->desc = desc;
+        _device->name = (char *)desc->name;
+        _device->type = (char *)desc->type;
+        _device->subtype = (char *)desc->subtype;
+        _device->model = (char *)desc->model;
+    } else {
+        _device->name = esp_rmaker_node_mem_strdup(ESP_RMAKER_NODE_MEM_DEVICE, name);
+    }
     if (!_device->name) {
         ESP_LOGE(TAG, "Failed to allocate memory for name for %s %s", is_service ? "Service":"Device", name);
         goto device_create_err;
     }
-    if (type) {
-        _device->type = strdup(type);
+    if (type && !desc) {
+        _device->type = esp_rmaker_node_mem_strdup(ESP_RMAKER_NODE_MEM_DEVICE, type);
         if (!_device->type) {
             ESP_LOGE(TAG, "Failed to allocate memory for type for %s %s", is_service ? "Service":"Device", name);
             goto device_create_err;
@@ -95,11 +109,42 @@ device_create_err:
 
 esp_rmaker_device_t *esp_rmaker_device_create(const char *name, const char *type, void *priv)
 {
-    return __esp_rmaker_device_create(name, type, priv, false);
+    return __esp_rmaker_device_create(name, type, priv, false, NULL);
 }
 esp_rmaker_device_t *esp_rmaker_service_create(const char *name, const char *type, void *priv)
 {
-    return __esp_rmaker_device_create(name, type, priv, true);
+    return __esp_rmaker_device_create(name, type, priv, true, NULL);
+}
+
+esp_rmaker_device_t *esp_rmaker_device_create_from_desc(const esp_rmaker_device_desc_t *desc, void *priv)
+{
+    if (!desc) {
+        ESP_LOGE(TAG, "Device descriptor cannot be NULL.");
+        return NULL;
+    }
+    esp_rmaker_device_t *device = __esp_rmaker_device_create(desc->name, desc->type, priv, false, desc);
+    if (!device) {
+        return NULL;
+    }
+    for (int i = 0; i < desc->param_count; i++) {
+        esp_rmaker_param_t *param = esp_rmaker_param_create_from_desc(&desc->params[i]);
+        if (!param) {
+            goto device_create_from_desc_err;
+        }
+        if (esp_rmaker_device_add_param(device, param) != ESP_OK) {
+            esp_rmaker_param_delete(param);
+            goto device_create_from_desc_err;
+        }
+        if (i == desc->primary_param_index) {
+            esp_rmaker_device_assign_primary_param(device, param);
+        }
+    }
+    return device;
+
+device_create_from_desc_err:
+    ESP_LOGE(TAG, "Failed to create Device %s from descriptor.", desc->name);
+    esp_rmaker_device_delete(device);
+    return NULL;
 }
 
 esp_err_t esp_rmaker_device_add_param(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param)
@@ -137,7 +182,17 @@ esp_err_t esp_rmaker_device_add_param(const esp_rmaker_device_t *device, const e
     stored_val.type = _new_param->val.type;
     if (_new_param->prop_flags & PROP_FLAG_PERSIST) {
         if (esp_rmaker_param_get_stored_value(_new_param, &stored_val) == ESP_OK) {
-            if ((_new_param->val.type == RMAKER_VAL_TYPE_STRING) || (_new_param->val.type == RMAKER_VAL_TYPE_OBJECT)
+            if (_new_param->enum_info) {
+                /* Enumerated params refer to the string in the list instead of an allocated copy */
+                int idx = esp_rmaker_param_enum_lookup(_new_param, stored_val.val.s);
+                free(stored_val.val.s);
+                if (idx >= 0) {
+                    _new_param->enum_info->cur_idx = idx;
+                    stored_val.val.s = (char *)_new_param->valid_str_list->str_list[idx];
+                } else {
+                    stored_val.val.s = _new_param->val.val.s;
+                }
+            } else if ((_new_param->val.type == RMAKER_VAL_TYPE_STRING) || (_new_param->val.type == RMAKER_VAL_TYPE_OBJECT)
                     || (_new_param->val.type == RMAKER_VAL_TYPE_ARRAY)) {
                 if (_new_param->val.val.s) {
                     free(_new_param->val.val.s);
@@ -147,7 +202,7 @@ esp_err_t esp_rmaker_device_add_param(const esp_rmaker_device_t *device, const e
             /* The device callback should be invoked once with the stored value, so
              * that applications can do initialisations as required.
              */
-            if (_device->write_cb) {
+            if (_device->bulk_write_cb || _device->write_cb) {
                 /* However, the callback should be invoked, only if the parameter is not
                  * of type ESP_RMAKER_PARAM_NAME, as it has special handling internally.
                  */
@@ -155,13 +210,22 @@ esp_err_t esp_rmaker_device_add_param(const esp_rmaker_device_t *device, const e
                     esp_rmaker_write_ctx_t ctx = {
                         .src = ESP_RMAKER_REQ_SRC_INIT,
                     };
-                    _device->write_cb(device, param, stored_val, _device->priv_data, &ctx);
+                    if (_device->bulk_write_cb) {
+                        esp_rmaker_param_write_req_t write_req = {
+                            .param = (esp_rmaker_param_t *)param,
+                            .val = stored_val,
+                        };
+                        _device->bulk_write_cb(device, &write_req, 1, _device->priv_data, &ctx);
+                    } else {
+                        _device->write_cb(device, param, stored_val, _device->priv_data, &ctx);
+                    }
                 }
             }
         } else {
             esp_rmaker_param_store_value(_new_param);
         }
     }
+    esp_rmaker_node_devices_changed();
     ESP_LOGD(TAG, "Param %s added in %s", _new_param->name, _device->name);
     return ESP_OK;
 }
@@ -186,13 +250,13 @@ esp_err_t esp_rmaker_device_add_attribute(const esp_rmaker_device_t *device, con
             break;
         }
     }
-    esp_rmaker_attr_t *new_attr = MEM_CALLOC_EXTRAM(1, sizeof(esp_rmaker_attr_t));
+    esp_rmaker_attr_t *new_attr = esp_rmaker_node_mem_calloc(ESP_RMAKER_NODE_MEM_DEVICE, sizeof(esp_rmaker_attr_t));
     if (!new_attr) {
         ESP_LOGE(TAG, "Failed to allocate memory for device attribute");
         return ESP_ERR_NO_MEM;
     }
-    new_attr->name = strdup(attr_name);
-    new_attr->value = strdup(val);
+    new_attr->name = esp_rmaker_node_mem_strdup(ESP_RMAKER_NODE_MEM_DEVICE, attr_name);
+    new_attr->value = esp_rmaker_node_mem_strdup(ESP_RMAKER_NODE_MEM_DEVICE, val);
     if (!new_attr->name || !new_attr->value) {
         ESP_LOGE(TAG, "Failed to allocate memory for device attribute name or value");
         esp_rmaker_attribute_delete(new_attr);
@@ -215,10 +279,8 @@ esp_err_t esp_rmaker_device_add_subtype(const esp_rmaker_device_t *device, const
         return ESP_ERR_INVALID_ARG;
     }
     _esp_rmaker_device_t *_device = (_esp_rmaker_device_t *)device;
-    if (_device->subtype) {
-        free(_device->subtype);
-    }
-    if ((_device->subtype = strdup(subtype)) != NULL ){
+    esp_rmaker_device_free_metadata(_device->subtype, DEVICE_DESC_FIELD(_device, subtype));
+    if ((_device->subtype = esp_rmaker_node_mem_strdup(ESP_RMAKER_NODE_MEM_DEVICE, subtype)) != NULL ){
         return ESP_OK;
     } else {
         ESP_LOGE(TAG, "Failed to allocate memory for device subtype");
@@ -234,10 +296,8 @@ esp_err_t esp_rmaker_device_add_model(const esp_rmaker_device_t *device, const c
         return ESP_ERR_INVALID_ARG;
     }
     _esp_rmaker_device_t *_device = (_esp_rmaker_device_t *)device;
-    if (_device->model) {
-        free(_device->model);
-    }
-    if ((_device->model = strdup(model)) != NULL ){
+    esp_rmaker_device_free_metadata(_device->model, DEVICE_DESC_FIELD(_device, model));
+    if ((_device->model = esp_rmaker_node_mem_strdup(ESP_RMAKER_NODE_MEM_DEVICE, model)) != NULL ){
         return ESP_OK;
     } else {
         ESP_LOGE(TAG, "Failed to allocate memory for device model");
@@ -267,6 +327,18 @@ esp_err_t esp_rmaker_device_add_cb(const esp_rmaker_device_t *device, esp_rmaker
     return ESP_OK;
 }
 
+esp_err_t esp_rmaker_device_add_bulk_cb(const esp_rmaker_device_t *device, esp_rmaker_device_bulk_write_cb_t write_cb, esp_rmaker_device_read_cb_t read_cb)
+{
+    if (!device) {
+        ESP_LOGE(TAG, "Device handle cannot be NULL");
+        return ESP_ERR_INVALID_ARG;
+    }
+    _esp_rmaker_device_t *_device = (_esp_rmaker_device_t *)device;
+    _device->bulk_write_cb = write_cb;
+    _device->read_cb = read_cb;
+    return ESP_OK;
+}
+
 char *esp_rmaker_device_get_name(const esp_rmaker_device_t *device)
 {
     if (!device) {
@@ -13,13 +13,18 @@
 // limitations under the License.
 #pragma once
 #include <stdint.h>
+#include <time.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
 #include <json_generator.h>
+#include <esp_timer.h>
 #include <esp_rmaker_core.h>
+#include "esp_rmaker_ts_aggregate.h"
 
 #define RMAKER_PARAM_FLAG_VALUE_CHANGE   (1 << 0)
 #define RMAKER_PARAM_FLAG_VALUE_NOTIFY   (1 << 1)
+/* Current value not yet confirmed by a publish ack */
+#define RMAKER_PARAM_FLAG_VALUE_UNACKED  (1 << 2)
 #define ESP_RMAKER_NVS_PART_NAME            "nvs"
 
 typedef enum {
@@ -30,26 +35,41 @@ typedef enum {
     ESP_RMAKER_STATE_STOP_REQUESTED,
 } esp_rmaker_state_t;
 
+/* These are kept the same as the public descriptor types so that params created from a
+ * const descriptor can directly refer to the descriptor's bounds and valid strings.
+ */
+typedef esp_rmaker_param_bounds_desc_t esp_rmaker_param_bounds_t;
+typedef esp_rmaker_param_valid_str_list_desc_t esp_rmaker_param_valid_str_list_t;
+
 typedef struct {
-    esp_rmaker_param_val_t min;
-    esp_rmaker_param_val_t max;
-    esp_rmaker_param_val_t step;
-} esp_rmaker_param_bounds_t;
+    /* Indices into the valid strings list, sorted as per the strings, for binary search */
+    uint8_t *sorted_idx;
+    uint8_t cur_idx;
+} esp_rmaker_param_enum_t;
 
 typedef struct {
-    uint8_t str_list_cnt;
-    const char **str_list;
-} esp_rmaker_param_valid_str_list_t;
+    uint32_t window_secs;
+    esp_rmaker_ts_window_t window;
+    /* Flushes the window once it elapses, even if no more samples come in */
+    esp_timer_handle_t flush_timer;
+} esp_rmaker_param_ts_aggregate_t;
 
 struct esp_rmaker_param {
     char *name;
     char *type;
     uint8_t flags;
     uint8_t prop_flags;
+    /* Sequence number of the last report carrying the current value. 0 if not reported yet. */
+    uint16_t report_seq;
+    /* Params version at the time of the last value change */
+    uint32_t change_seq;
     char *ui_type;
     esp_rmaker_param_val_t val;
     esp_rmaker_param_bounds_t *bounds;
     esp_rmaker_param_valid_str_list_t *valid_str_list;
+    esp_rmaker_param_enum_t *enum_info;
+    esp_rmaker_param_ts_aggregate_t *ts_aggregate;
+    const esp_rmaker_param_desc_t *desc;
     struct esp_rmaker_device *parent;
     struct esp_rmaker_param * next;
 };
@@ -69,12 +89,14 @@ struct esp_rmaker_device {
     char *subtype;
     char *model;
     esp_rmaker_device_write_cb_t write_cb;
+    esp_rmaker_device_bulk_write_cb_t bulk_write_cb;
     esp_rmaker_device_read_cb_t read_cb;
     void *priv_data;
     bool is_service;
     esp_rmaker_attr_t *attributes;
     _esp_rmaker_param_t *params;
     _esp_rmaker_param_t *primary;
+    const esp_rmaker_device_desc_t *desc;
     const esp_rmaker_node_t *parent;
     struct esp_rmaker_device *next;
 };
@@ -98,12 +120,58 @@ esp_rmaker_attr_t *esp_rmaker_node_get_first_attribute(const esp_rmaker_node_t *
 esp_err_t esp_rmaker_params_mqtt_init(void);
 esp_err_t esp_rmaker_param_get_stored_value(_esp_rmaker_param_t *param, esp_rmaker_param_val_t *val);
 esp_err_t esp_rmaker_param_store_value(_esp_rmaker_param_t *param);
+int esp_rmaker_param_enum_lookup(const _esp_rmaker_param_t *param, const char *str);
 esp_err_t esp_rmaker_node_delete(const esp_rmaker_node_t *node);
 esp_err_t esp_rmaker_param_delete(const esp_rmaker_param_t *param);
 esp_err_t esp_rmaker_attribute_delete(esp_rmaker_attr_t *attr);
 char *esp_rmaker_get_node_config(void);
 char *esp_rmaker_get_node_params(void);
+/* Version counters for the node config and params JSON, which change whenever their contents may have changed.
+ * They start at a random value on every boot, so that a version held by a client from before a reboot does not
+ * match the current one. A node config change changes the params version as well, with structure_changed set,
+ * since the params JSON follows the node structure. The config version changes only when a node attribute, device
+ * or param gets added or removed, and not on reporting the node config.
+ */
+void esp_rmaker_node_config_changed(void);
+/* Changes the devices version as well as the config version. Called when a device or param gets added or removed,
+ * after which any device or param handles held, like in compiled actions, may not be valid anymore.
+ */
+void esp_rmaker_node_devices_changed(void);
+uint32_t esp_rmaker_get_node_devices_version(void);
+uint32_t esp_rmaker_get_node_config_version(void);
+uint32_t esp_rmaker_node_params_changed(bool structure_changed);
+uint32_t esp_rmaker_get_node_params_version(void);
+/* Gets the values of the params changed since the given params version, along with the current version.
+ * All the params are included if that is not possible, for example after a node config change.
+ */
+char *esp_rmaker_get_node_params_delta(uint32_t since);
 esp_err_t esp_rmaker_handle_set_params(char *data, size_t data_len, esp_rmaker_req_src_t src);
+esp_err_t esp_rmaker_queue_set_params(const char *data, size_t data_len, esp_rmaker_req_src_t src);
+/* Actions which are run repeatedly, like those of schedules and scenes, are compiled once into the param
+ * handles and values to be written, so that running them does not need any parsing or allocation.
+ * A program is tied to the node devices version it was compiled against, and is refcounted, so that a
+ * queued run holds its own reference. It keeps a copy of the action JSON, which is used instead if the
+ * devices change before a queued run.
+ */
+typedef struct esp_rmaker_action_prog esp_rmaker_action_prog_t;
+esp_rmaker_action_prog_t *esp_rmaker_action_prog_compile(const char *data, size_t data_len);
+esp_rmaker_action_prog_t *esp_rmaker_action_prog_retain(esp_rmaker_action_prog_t *prog);
+void esp_rmaker_action_prog_release(esp_rmaker_action_prog_t *prog);
+bool esp_rmaker_action_prog_is_valid(const esp_rmaker_action_prog_t *prog);
+esp_err_t esp_rmaker_action_prog_exec(esp_rmaker_action_prog_t *prog, esp_rmaker_req_src_t src);
+/* Queues the compiled action, recompiling it first if devices or params have been added or removed.
+ * Falls back to queuing the JSON if it cannot be compiled.
+ */
+esp_err_t esp_rmaker_action_prog_run(esp_rmaker_action_prog_t **prog, const char *data, size_t data_len,
+        esp_rmaker_req_src_t src);
+esp_err_t esp_rmaker_queue_action_prog(esp_rmaker_action_prog_t *prog, esp_rmaker_req_src_t src);
+/* Same as esp_rmaker_param_update_and_report(), but reports only the given delta instead of the full new value,
+ * when possible. The delta should be of the same type as the value. The full value is reported if delta is NULL.
+ */
+esp_err_t esp_rmaker_param_update_and_report_delta(const esp_rmaker_param_t *param, esp_rmaker_param_val_t val,
+        const char *delta);
+esp_err_t esp_rmaker_set_params_queue_init(void);
+esp_err_t esp_rmaker_set_params_queue_start(void);
 esp_err_t esp_rmaker_user_mapping_prov_init(void);
 esp_err_t esp_rmaker_user_mapping_prov_deinit(void);
 esp_err_t esp_rmaker_user_node_mapping_init(void);
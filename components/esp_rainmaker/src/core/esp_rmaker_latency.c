@@ -0,0 +1,201 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <sdkconfig.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <esp_err.h>
+#include <esp_rmaker_core.h>
+#include "esp_rmaker_latency.h"
+
+static const char *TAG = "esp_rmaker_latency";
+
+static const char *stage_str[ESP_RMAKER_LATENCY_STAGE_MAX] = {
+    [ESP_RMAKER_LATENCY_STAGE_PARSE] = "parse",
+    [ESP_RMAKER_LATENCY_STAGE_WRITE_CB] = "write_cb",
+    [ESP_RMAKER_LATENCY_STAGE_PARAM_UPDATE] = "param_update",
+    [ESP_RMAKER_LATENCY_STAGE_NVS_STORE] = "nvs_store",
+    [ESP_RMAKER_LATENCY_STAGE_JSON_POPULATE] = "json_populate",
+    [ESP_RMAKER_LATENCY_STAGE_PUBLISH] = "publish",
+    [ESP_RMAKER_LATENCY_STAGE_TOTAL] = "total",
+};
+
+const char *esp_rmaker_latency_stage_to_str(esp_rmaker_latency_stage_t stage)
+{
+    if ((stage < 0) || (stage >= ESP_RMAKER_LATENCY_STAGE_MAX)) {
+        return "invalid";
+    }
+    return stage_str[stage];
+}
+
+#ifdef CONFIG_ESP_RMAKER_LATENCY_TRACE
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define LATENCY_HIST_MIN_SHIFT  7   /* Upper limit of the first bucket is 2^7 = 128us */
+/* Set params requests can be handled by multiple tasks at a time, like the MQTT and local control ones */
+#define LATENCY_MAX_SET_PARAMS_TASKS    4
+
+typedef struct {
+    TaskHandle_t task;
+    /* The handling can nest, like when a write callback handles another request */
+    uint8_t depth;
+} esp_rmaker_latency_set_params_task_t;
+
+static esp_rmaker_latency_stats_t latency_stats[ESP_RMAKER_LATENCY_STAGE_MAX];
+static esp_rmaker_latency_set_params_task_t set_params_tasks[LATENCY_MAX_SET_PARAMS_TASKS];
+static portMUX_TYPE latency_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Should be called with latency_lock held */
+static esp_rmaker_latency_set_params_task_t *esp_rmaker_latency_find_set_params_task(TaskHandle_t task)
+{
+    for (int i = 0; i < LATENCY_MAX_SET_PARAMS_TASKS; i++) {
+        if (set_params_tasks[i].task == task) {
+            return &set_params_tasks[i];
+        }
+    }
+    return NULL;
+}
+
+void esp_rmaker_latency_set_params_enter(void)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&latency_lock);
+    esp_rmaker_latency_set_params_task_t *entry = esp_rmaker_latency_find_set_params_task(task);
+    if (!entry) {
+        entry = esp_rmaker_latency_find_set_params_task(NULL);
+        if (entry) {
+            entry->task = task;
+        }
+    }
+    /* If all the entries are in use, the stages of this request are just not recorded */
+    if (entry) {
+        entry->depth++;
+    }
+    portEXIT_CRITICAL(&latency_lock);
+}
+
+void esp_rmaker_latency_set_params_exit(void)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&latency_lock);
+    esp_rmaker_latency_set_params_task_t *entry = esp_rmaker_latency_find_set_params_task(task);
+    if (entry && (--entry->depth == 0)) {
+        entry->task = NULL;
+    }
+    portEXIT_CRITICAL(&latency_lock);
+}
+
+static inline int esp_rmaker_latency_get_bucket(uint32_t latency_us)
+{
+    if (latency_us < (1 << LATENCY_HIST_MIN_SHIFT)) {
+        return 0;
+    }
+    /* Index of the most significant bit */
+    int msb = 31 - __builtin_clz(latency_us);
+    int bucket = msb - LATENCY_HIST_MIN_SHIFT + 1;
+    return (bucket < ESP_RMAKER_LATENCY_HIST_BUCKETS) ? bucket : (ESP_RMAKER_LATENCY_HIST_BUCKETS - 1);
+}
+
+/* Should be called with latency_lock held */
+static void esp_rmaker_latency_add_sample(esp_rmaker_latency_stage_t stage, uint32_t latency_us)
+{
+    esp_rmaker_latency_stats_t *stats = &latency_stats[stage];
+    if ((stats->count == 0) || (latency_us < stats->min_us)) {
+        stats->min_us = latency_us;
+    }
+    if (latency_us > stats->max_us) {
+        stats->max_us = latency_us;
+    }
+    stats->count++;
+    stats->total_us += latency_us;
+    stats->hist[esp_rmaker_latency_get_bucket(latency_us)]++;
+}
+
+static uint32_t esp_rmaker_latency_since(int64_t start_us)
+{
+    int64_t diff = esp_timer_get_time() - start_us;
+    return (diff > UINT32_MAX) ? UINT32_MAX : (uint32_t)diff;
+}
+
+void esp_rmaker_latency_record(esp_rmaker_latency_stage_t stage, int64_t start_us)
+{
+    uint32_t latency_us = esp_rmaker_latency_since(start_us);
+    portENTER_CRITICAL(&latency_lock);
+    esp_rmaker_latency_add_sample(stage, latency_us);
+    portEXIT_CRITICAL(&latency_lock);
+}
+
+void esp_rmaker_latency_record_in_set_params(esp_rmaker_latency_stage_t stage, int64_t start_us)
+{
+    uint32_t latency_us = esp_rmaker_latency_since(start_us);
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    portENTER_CRITICAL(&latency_lock);
+    if (esp_rmaker_latency_find_set_params_task(task)) {
+        esp_rmaker_latency_add_sample(stage, latency_us);
+    }
+    portEXIT_CRITICAL(&latency_lock);
+}
+
+esp_err_t esp_rmaker_latency_get_stats(esp_rmaker_latency_stage_t stage, esp_rmaker_latency_stats_t *stats)
+{
+    if (!stats || (stage < 0) || (stage >= ESP_RMAKER_LATENCY_STAGE_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&latency_lock);
+    *stats = latency_stats[stage];
+    portEXIT_CRITICAL(&latency_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_latency_reset(void)
+{
+    portENTER_CRITICAL(&latency_lock);
+    memset(latency_stats, 0, sizeof(latency_stats));
+    portEXIT_CRITICAL(&latency_lock);
+    return ESP_OK;
+}
+
+void esp_rmaker_latency_print_stats(void)
+{
+    esp_rmaker_latency_stats_t stats;
+    printf("%s: Latency histogram buckets (us): <%d", TAG, 1 << LATENCY_HIST_MIN_SHIFT);
+    for (int i = 1; i < ESP_RMAKER_LATENCY_HIST_BUCKETS - 1; i++) {
+        printf(" <%d", 1 << (LATENCY_HIST_MIN_SHIFT + i));
+    }
+    printf(" >=%d\n", 1 << (LATENCY_HIST_MIN_SHIFT + ESP_RMAKER_LATENCY_HIST_BUCKETS - 2));
+    for (int stage = 0; stage < ESP_RMAKER_LATENCY_STAGE_MAX; stage++) {
+        esp_rmaker_latency_get_stats(stage, &stats);
+        printf("%s: %-13s: count %"PRIu32", min %"PRIu32", avg %"PRIu32", max %"PRIu32" us, hist:", TAG,
+                stage_str[stage], stats.count, stats.min_us,
+                stats.count ? (uint32_t)(stats.total_us / stats.count) : 0, stats.max_us);
+        for (int i = 0; i < ESP_RMAKER_LATENCY_HIST_BUCKETS; i++) {
+            printf(" %"PRIu32, stats.hist[i]);
+        }
+        printf("\n");
+    }
+}
+
+#else /* !CONFIG_ESP_RMAKER_LATENCY_TRACE */
+
+esp_err_t esp_rmaker_latency_get_stats(esp_rmaker_latency_stage_t stage, esp_rmaker_latency_stats_t *stats)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_rmaker_latency_reset(void)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void esp_rmaker_latency_print_stats(void)
+{
+    printf("%s: Enable CONFIG_ESP_RMAKER_LATENCY_TRACE for latency tracing.\n", TAG);
+}
+
+#endif /* !CONFIG_ESP_RMAKER_LATENCY_TRACE */
@@ -0,0 +1,38 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <sdkconfig.h>
+#include <stdint.h>
+#include <esp_rmaker_core.h>
+
+#ifdef CONFIG_ESP_RMAKER_LATENCY_TRACE
+#include <esp_timer.h>
+
+void esp_rmaker_latency_record(esp_rmaker_latency_stage_t stage, int64_t start_us);
+void esp_rmaker_latency_record_in_set_params(esp_rmaker_latency_stage_t stage, int64_t start_us);
+void esp_rmaker_latency_set_params_enter(void);
+void esp_rmaker_latency_set_params_exit(void);
+
+/* Hot path instrumentation. These compile to nothing if CONFIG_ESP_RMAKER_LATENCY_TRACE is disabled. */
+#define ESP_RMAKER_LATENCY_START(_var)          int64_t _var = esp_timer_get_time()
+#define ESP_RMAKER_LATENCY_END(_stage, _var)    esp_rmaker_latency_record(_stage, _var)
+/* For the stages which are also reached outside of set params handling, like when the application updates
+ * a param on its own. These get recorded only if the calling task is handling a set params request, between
+ * ESP_RMAKER_LATENCY_SET_PARAMS_ENTER() and ESP_RMAKER_LATENCY_SET_PARAMS_EXIT().
+ */
+#define ESP_RMAKER_LATENCY_END_IN_SET_PARAMS(_stage, _var)  esp_rmaker_latency_record_in_set_params(_stage, _var)
+#define ESP_RMAKER_LATENCY_SET_PARAMS_ENTER()   esp_rmaker_latency_set_params_enter()
+#define ESP_RMAKER_LATENCY_SET_PARAMS_EXIT()    esp_rmaker_latency_set_params_exit()
+#else
+#define ESP_RMAKER_LATENCY_START(_var)
+#define ESP_RMAKER_LATENCY_END(_stage, _var)
+#define ESP_RMAKER_LATENCY_END_IN_SET_PARAMS(_stage, _var)
+#define ESP_RMAKER_LATENCY_SET_PARAMS_ENTER()
+#define ESP_RMAKER_LATENCY_SET_PARAMS_EXIT()
+#endif /* CONFIG_ESP_RMAKER_LATENCY_TRACE */
+
+void esp_rmaker_latency_print_stats(void);
@@ -14,17 +14,23 @@
 
 #include <stdlib.h>
 #include <inttypes.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <esp_log.h>
 #include <nvs.h>
 #include <esp_event.h>
 #include <esp_local_ctrl.h>
 #include <wifi_provisioning/manager.h>
 #include <esp_rmaker_internal.h>
+#include <esp_rmaker_mem_tag.h>
 #include <esp_rmaker_standard_services.h>
 #include <esp_https_server.h>
 #include <esp_rmaker_work_queue.h>
 #include <mdns.h>
 #include <esp_rmaker_utils.h>
+#include <json_generator.h>
+#include <json_parser.h>
+#include "esp_rmaker_local_ctrl_notify.h"
 
 #include <esp_idf_version.h>
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 2, 0)
@@ -57,6 +63,10 @@ static const char * TAG = "esp_rmaker_local";
 enum property_types {
     PROP_TYPE_NODE_CONFIG = 1,
     PROP_TYPE_NODE_PARAMS,
+    PROP_TYPE_NODE_VERSIONS,
+    PROP_TYPE_NODE_PARAMS_DELTA,
+    PROP_TYPE_NODE_NOTIFY,
+    PROP_TYPE_MAX,
 };
 
 /* Custom flags that can be set for a property */
@@ -68,6 +78,187 @@ static bool g_local_ctrl_is_started = false;
 
 static char *g_serv_name;
 static bool wait_for_wifi_prov;
+
+#define VERSIONS_JSON_SIZE      48
+
+/* Params version from which the "params_delta" property reports the changes, as last set by a client.
+ * esp_local_ctrl does not tell which client a request came from, so this is shared by all the clients.
+ * It is reset to 0 after every read, so that a read without a preceding set gets all the params instead
+ * of a delta meant for some other client. If two clients interleave their set and read, one of them will
+ * get the delta for the other one's version. So, clients must check that the "since" in the response is
+ * the version they had set, and if not, set it again and read again.
+ */
+static uint32_t g_params_delta_since;
+
+#ifdef CONFIG_ESP_RMAKER_LOCAL_CTRL_CACHE
+/* Generated node config/params JSON, shared by all the reads while the corresponding version stays the same.
+ * A snapshot replaced by a newer one is freed only after all the responses referring to it have been sent.
+ */
+typedef struct local_ctrl_snapshot {
+    char *data;
+    size_t len;
+    uint32_t version;
+    /* Number of responses using this, plus one if this is still the cached snapshot */
+    uint16_t refcount;
+    struct local_ctrl_snapshot *next;
+} local_ctrl_snapshot_t;
+
+static local_ctrl_snapshot_t *g_snapshots;
+static local_ctrl_snapshot_t *g_cached_snapshot[PROP_TYPE_MAX];
+static SemaphoreHandle_t g_snapshot_lock;
+
+/* Drops a reference. Should be called with g_snapshot_lock held. */
+static void esp_rmaker_local_ctrl_snapshot_put(local_ctrl_snapshot_t *snapshot)
+{
+    if (--snapshot->refcount > 0) {
+        return;
+    }
+    local_ctrl_snapshot_t **link = &g_snapshots;
+    while (*link && (*link != snapshot)) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = snapshot->next;
+    }
+    RMAKER_MEM_FREE(snapshot->data);
+    RMAKER_MEM_FREE(snapshot);
+}
+
+/* Used as the free_fn of the property values served from a snapshot */
+static void esp_rmaker_local_ctrl_snapshot_release(void *data)
+{
+    xSemaphoreTake(g_snapshot_lock, portMAX_DELAY);
+    for (local_ctrl_snapshot_t *snapshot = g_snapshots; snapshot; snapshot = snapshot->next) {
+        if (snapshot->data == data) {
+            esp_rmaker_local_ctrl_snapshot_put(snapshot);
+            break;
+        }
+    }
+    xSemaphoreGive(g_snapshot_lock);
+}
+
+static esp_err_t esp_rmaker_local_ctrl_get_snapshot(int prop_type, esp_local_ctrl_prop_val_t *prop_value)
+{
+    if (!g_snapshot_lock) {
+        g_snapshot_lock = xSemaphoreCreateMutex();
+        if (!g_snapshot_lock) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    uint32_t version = (prop_type == PROP_TYPE_NODE_CONFIG) ? esp_rmaker_get_node_config_version() :
+            esp_rmaker_get_node_params_version();
+    xSemaphoreTake(g_snapshot_lock, portMAX_DELAY);
+    local_ctrl_snapshot_t *snapshot = g_cached_snapshot[prop_type];
+    if (snapshot && (snapshot->version == version)) {
+        snapshot->refcount++;
+        xSemaphoreGive(g_snapshot_lock);
+        ESP_LOGD(TAG, "Serving cached snapshot for version %"PRIu32, version);
+        goto done;
+    }
+    xSemaphoreGive(g_snapshot_lock);
+    /* The version was read before generating, so a change during generation just leads to regeneration next time */
+    char *data = (prop_type == PROP_TYPE_NODE_CONFIG) ? esp_rmaker_get_node_config() : esp_rmaker_get_node_params();
+    if (!data) {
+        return ESP_ERR_NO_MEM;
+    }
+    snapshot = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_LOCAL_CTRL, 1, sizeof(local_ctrl_snapshot_t));
+    if (!snapshot) {
+        RMAKER_MEM_FREE(data);
+        return ESP_ERR_NO_MEM;
+    }
+    snapshot->data = data;
+    snapshot->len = strlen(data);
+    snapshot->version = version;
+    /* One reference for the cache and one for this response */
+    snapshot->refcount = 2;
+    xSemaphoreTake(g_snapshot_lock, portMAX_DELAY);
+    snapshot->next = g_snapshots;
+    g_snapshots = snapshot;
+    if (g_cached_snapshot[prop_type]) {
+        esp_rmaker_local_ctrl_snapshot_put(g_cached_snapshot[prop_type]);
+    }
+    g_cached_snapshot[prop_type] = snapshot;
+    xSemaphoreGive(g_snapshot_lock);
+done:
+    prop_value->size = snapshot->len;
+    prop_value->data = snapshot->data;
+    prop_value->free_fn = esp_rmaker_local_ctrl_snapshot_release;
+    return ESP_OK;
+}
+
+static void esp_rmaker_local_ctrl_clear_snapshots(void)
+{
+    if (!g_snapshot_lock) {
+        return;
+    }
+    xSemaphoreTake(g_snapshot_lock, portMAX_DELAY);
+    for (int i = 0; i < PROP_TYPE_MAX; i++) {
+        if (g_cached_snapshot[i]) {
+            esp_rmaker_local_ctrl_snapshot_put(g_cached_snapshot[i]);
+            g_cached_snapshot[i] = NULL;
+        }
+    }
+    xSemaphoreGive(g_snapshot_lock);
+}
+#else
+static esp_err_t esp_rmaker_local_ctrl_get_snapshot(int prop_type, esp_local_ctrl_prop_val_t *prop_value)
+{
+    char *data = (prop_type == PROP_TYPE_NODE_CONFIG) ? esp_rmaker_get_node_config() : esp_rmaker_get_node_params();
+    if (!data) {
+        return ESP_ERR_NO_MEM;
+    }
+    prop_value->size = strlen(data);
+    prop_value->data = data;
+    prop_value->free_fn = RMAKER_MEM_FREE_FN;
+    return ESP_OK;
+}
+
+static void esp_rmaker_local_ctrl_clear_snapshots(void)
+{
+}
+#endif /* CONFIG_ESP_RMAKER_LOCAL_CTRL_CACHE */
+
+/* Versions of the node config and params. Clients can poll this tiny property and read "config" or "params"
+ * only if the corresponding version has changed since their last read.
+ */
+static char *esp_rmaker_local_ctrl_get_versions(void)
+{
+    char *versions = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_LOCAL_CTRL, 1, VERSIONS_JSON_SIZE);
+    if (!versions) {
+        return NULL;
+    }
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, versions, VERSIONS_JSON_SIZE, NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_int(&jstr, "config", esp_rmaker_get_node_config_version());
+    json_gen_obj_set_int(&jstr, "params", esp_rmaker_get_node_params_version());
+    json_gen_end_object(&jstr);
+    json_gen_str_end(&jstr);
+    return versions;
+}
+
+/* Sets the params version to report the changes from, for the next "params_delta" read.
+ * Expects {"since":<version>}, where the version is the "seq" from the last read, or 0 for all params.
+ */
+static esp_err_t esp_rmaker_local_ctrl_set_params_delta_since(const char *data, size_t data_len)
+{
+    jparse_ctx_t jctx;
+    if (json_parse_start(&jctx, data, data_len) != 0) {
+        ESP_LOGE(TAG, "Invalid params_delta request.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    int64_t since = 0;
+    esp_err_t err = ESP_OK;
+    if ((json_obj_get_int64(&jctx, "since", &since) != 0) || (since < 0) || (since > UINT32_MAX)) {
+        ESP_LOGE(TAG, "Invalid or missing \"since\" in params_delta request.");
+        err = ESP_ERR_INVALID_ARG;
+    } else {
+        g_params_delta_since = (uint32_t)since;
+    }
+    json_parse_end(&jctx);
+    return err;
+}
+
 /********* Handler functions for responding to control requests / commands *********/
 
 static esp_err_t get_property_values(size_t props_count,
@@ -80,27 +271,49 @@ static esp_err_t get_property_values(size_t props_count,
     for (i = 0; i < props_count && ret == ESP_OK ; i++) {
         ESP_LOGD(TAG, "(%"PRIu32") Reading property : %s", i, props[i].name);
         switch (props[i].type) {
-            case PROP_TYPE_NODE_CONFIG: {
-                char *node_config = esp_rmaker_get_node_config();
-                if (!node_config) {
+            case PROP_TYPE_NODE_CONFIG:
+            case PROP_TYPE_NODE_PARAMS:
+                ret = esp_rmaker_local_ctrl_get_snapshot(props[i].type, &prop_values[i]);
+                if (ret != ESP_OK) {
                     ESP_LOGE(TAG, "Failed to allocate memory for %s", props[i].name);
-                    ret = ESP_ERR_NO_MEM;
-                } else {
-                    prop_values[i].size = strlen(node_config);
-                    prop_values[i].data = node_config;
-                    prop_values[i].free_fn = free;
                 }
                 break;
-            }
-            case PROP_TYPE_NODE_PARAMS: {
-                char *node_params = esp_rmaker_get_node_params();
+            case PROP_TYPE_NODE_PARAMS_DELTA: {
+                char *node_params = esp_rmaker_get_node_params_delta(g_params_delta_since);
+                g_params_delta_since = 0;
                 if (!node_params) {
                     ESP_LOGE(TAG, "Failed to allocate memory for %s", props[i].name);
                     ret = ESP_ERR_NO_MEM;
                 } else {
                     prop_values[i].size = strlen(node_params);
                     prop_values[i].data = node_params;
-                    prop_values[i].free_fn = free;
+                    prop_values[i].free_fn = RMAKER_MEM_FREE_FN;
+                }
+                break;
+            }
+#ifdef CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY
+            case PROP_TYPE_NODE_NOTIFY: {
+                char *status = esp_rmaker_local_ctrl_notify_get_status();
+                if (!status) {
+                    ESP_LOGE(TAG, "Failed to allocate memory for %s", props[i].name);
+                    ret = ESP_ERR_NO_MEM;
+                } else {
+                    prop_values[i].size = strlen(status);
+                    prop_values[i].data = status;
+                    prop_values[i].free_fn = RMAKER_MEM_FREE_FN;
+                }
+                break;
+            }
+#endif /* CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY */
+            case PROP_TYPE_NODE_VERSIONS: {
+                char *versions = esp_rmaker_local_ctrl_get_versions();
+                if (!versions) {
+                    ESP_LOGE(TAG, "Failed to allocate memory for %s", props[i].name);
+                    ret = ESP_ERR_NO_MEM;
+                } else {
+                    prop_values[i].size = strlen(versions);
+                    prop_values[i].data = versions;
+                    prop_values[i].free_fn = RMAKER_MEM_FREE_FN;
                 }
                 break;
             }
@@ -140,9 +353,20 @@ static esp_err_t set_property_values(size_t props_count,
     for (i = 0; i < props_count && ret == ESP_OK; i++) {
         switch (props[i].type) {
             case PROP_TYPE_NODE_PARAMS:
+                /* Handled inline rather than queued, so that the response to the client has the result */
                 ret = esp_rmaker_handle_set_params((char *)prop_values[i].data,
                         prop_values[i].size, ESP_RMAKER_REQ_SRC_LOCAL);
                 break;
+            case PROP_TYPE_NODE_PARAMS_DELTA:
+                ret = esp_rmaker_local_ctrl_set_params_delta_since((const char *)prop_values[i].data,
+                        prop_values[i].size);
+                break;
+#ifdef CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY
+            case PROP_TYPE_NODE_NOTIFY:
+                ret = esp_rmaker_local_ctrl_notify_subscribe((const char *)prop_values[i].data,
+                        prop_values[i].size);
+                break;
+#endif /* CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY */
             default:
                 break;
         }
@@ -160,7 +384,7 @@ static char *__esp_rmaker_local_ctrl_get_nvs(const char *key)
     }
     size_t len = 0;
     if ((err = nvs_get_blob(handle, key, NULL, &len)) == ESP_OK) {
-        val = MEM_CALLOC_EXTRAM(1, len + 1); /* +1 for NULL termination */
+        val = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_LOCAL_CTRL, 1, len + 1); /* +1 for NULL termination */
         if (val) {
             nvs_get_blob(handle, key, val, &len);
         }
@@ -191,7 +415,7 @@ static char *esp_rmaker_local_ctrl_get_pop()
     }
 
     ESP_LOGI(TAG, "Couldn't find POP in NVS. Generating a new one.");
-    pop = (char *)MEM_CALLOC_EXTRAM(1, ESP_RMAKER_POP_LEN);
+    pop = (char *)RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_LOCAL_CTRL, 1, ESP_RMAKER_POP_LEN);
     if (!pop) {
         ESP_LOGE(TAG, "Couldn't allocate POP");
         return NULL;
@@ -221,10 +445,10 @@ static esp_err_t esp_rmaker_local_ctrl_service_enable(void)
     esp_rmaker_device_t *local_ctrl_service = esp_rmaker_create_local_control_service(ESP_RMAKER_LOCAL_CTRL_DEVICE_NAME, pop_str, sec_ver, NULL);;
     if (!local_ctrl_service) {
         ESP_LOGE(TAG, "Failed to create Local Control Service.");
-        free(pop_str);
+        RMAKER_MEM_FREE(pop_str);
         return ESP_FAIL;
     }
-    free(pop_str);
+    RMAKER_MEM_FREE(pop_str);
 
     esp_err_t err = esp_rmaker_node_add_device(esp_rmaker_get_node(), local_ctrl_service);
     if (err != ESP_OK) {
@@ -312,10 +536,10 @@ static esp_err_t __esp_rmaker_start_local_ctrl_service(const char *serv_name)
         int sec_ver = esp_rmaker_local_ctrl_get_security_type();
 
         if (sec_ver != 0 && pop_str) {
-            pop = (PROTOCOMM_SEC_DATA *)MEM_CALLOC_EXTRAM(1, sizeof(PROTOCOMM_SEC_DATA));
+            pop = (PROTOCOMM_SEC_DATA *)RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_LOCAL_CTRL, 1, sizeof(PROTOCOMM_SEC_DATA));
             if (!pop) {
                 ESP_LOGE(TAG, "Failed to allocate pop");
-                free(pop_str);
+                RMAKER_MEM_FREE(pop_str);
                 return ESP_ERR_NO_MEM;
             }
             pop->data = (uint8_t *)pop_str;
@@ -338,7 +562,7 @@ static esp_err_t __esp_rmaker_start_local_ctrl_service(const char *serv_name)
     mdns_service_txt_item_set("_esp_local_ctrl", "_tcp", "node_id", esp_rmaker_get_node_id());
 
     if (pop) {
-        free(pop);
+        RMAKER_MEM_FREE(pop);
     }
 
     ESP_LOGI(TAG, "esp_local_ctrl service started with name : %s", serv_name);
@@ -363,9 +587,46 @@ static esp_err_t __esp_rmaker_start_local_ctrl_service(const char *serv_name)
         .ctx_free_fn = NULL
     };
 
+    /* Create the Node Versions property */
+    esp_local_ctrl_prop_t node_versions = {
+        .name        = "versions",
+        .type        = PROP_TYPE_NODE_VERSIONS,
+        .size        = 0,
+        .flags       = PROP_FLAG_READONLY,
+        .ctx         = NULL,
+        .ctx_free_fn = NULL
+    };
+
+    /* Create the Node Params Delta property */
+    esp_local_ctrl_prop_t node_params_delta = {
+        .name        = "params_delta",
+        .type        = PROP_TYPE_NODE_PARAMS_DELTA,
+        .size        = 0,
+        .flags       = 0,
+        .ctx         = NULL,
+        .ctx_free_fn = NULL
+    };
+
+#ifdef CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY
+    /* Create the Node Notify property */
+    esp_local_ctrl_prop_t node_notify = {
+        .name        = "notify",
+        .type        = PROP_TYPE_NODE_NOTIFY,
+        .size        = 0,
+        .flags       = 0,
+        .ctx         = NULL,
+        .ctx_free_fn = NULL
+    };
+#endif /* CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY */
+
     /* Now register the properties */
     ESP_ERROR_CHECK(esp_local_ctrl_add_property(&node_config));
     ESP_ERROR_CHECK(esp_local_ctrl_add_property(&node_params));
+    ESP_ERROR_CHECK(esp_local_ctrl_add_property(&node_versions));
+    ESP_ERROR_CHECK(esp_local_ctrl_add_property(&node_params_delta));
+#ifdef CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY
+    ESP_ERROR_CHECK(esp_local_ctrl_add_property(&node_notify));
+#endif /* CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY */
 
     /* update the global status */
     g_local_ctrl_is_started = true;
@@ -470,6 +731,10 @@ esp_err_t esp_rmaker_local_ctrl_disable(void)
     if (err != ESP_OK) {
         return err;
     }
+    esp_rmaker_local_ctrl_clear_snapshots();
+#ifdef CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY
+    esp_rmaker_local_ctrl_notify_deinit();
+#endif /* CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY */
     if (ESP_RMAKER_LOCAL_CTRL_SECURITY_TYPE == 1) {
         err = esp_rmaker_local_ctrl_service_disable();
         if (err != ESP_OK) {
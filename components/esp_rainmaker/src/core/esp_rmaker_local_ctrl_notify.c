@@ -0,0 +1,314 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Change notifications for local control clients. A client subscribes by writing its UDP port
+ * to the "notify" property and, whenever the params change, gets a small datagram with the
+ * node id and the new params version. It can then read the "params_delta" property instead of
+ * polling the node. Changes are coalesced, so a client has at most one notification pending,
+ * for the latest version, irrespective of how many params changed meanwhile.
+ */
+
+#include <sdkconfig.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <esp_log.h>
+#include <esp_err.h>
+#include "esp_rmaker_local_ctrl_notify.h"
+
+#ifdef CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_timer.h>
+#include <esp_netif.h>
+#include <esp_idf_version.h>
+#include <lwip/sockets.h>
+#include <json_generator.h>
+#include <json_parser.h>
+#include <esp_rmaker_core.h>
+#include <esp_rmaker_utils.h>
+#include <esp_rmaker_work_queue.h>
+#include "esp_rmaker_internal.h"
+#include "esp_rmaker_mem_tag.h"
+
+static const char *TAG = "esp_rmaker_local_ctrl_notify";
+
+#define NOTIFY_MAX_SUBSCRIBERS      CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY_MAX_SUBSCRIBERS
+#define NOTIFY_MAX_LEASE_SEC        CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY_LEASE_SEC
+#define NOTIFY_INTERVAL_US          (CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY_INTERVAL_MS * 1000)
+#define NOTIFY_IP_STR_LEN           16
+
+typedef struct {
+    bool in_use;
+    struct sockaddr_in addr;
+    /* Time, in seconds since boot, after which the subscription is dropped unless renewed */
+    int64_t expiry;
+    /* Params version for which the last notification was sent */
+    uint32_t sent_version;
+} notify_subscriber_t;
+
+static notify_subscriber_t notify_subscribers[NOTIFY_MAX_SUBSCRIBERS];
+static SemaphoreHandle_t notify_lock;
+static esp_timer_handle_t notify_timer;
+static int notify_sock = -1;
+/* Read without the lock on the param update path, to skip all the work when no one has subscribed */
+static volatile int notify_subscriber_count;
+
+static int64_t esp_rmaker_local_ctrl_notify_now(void)
+{
+    return esp_timer_get_time() / 1000000;
+}
+
+/* Should be called with the lock held */
+static void esp_rmaker_local_ctrl_notify_prune(int64_t now)
+{
+    int count = 0;
+    for (int i = 0; i < NOTIFY_MAX_SUBSCRIBERS; i++) {
+        if (notify_subscribers[i].in_use && (notify_subscribers[i].expiry <= now)) {
+            ESP_LOGI(TAG, "Subscription from %s:%d expired.", inet_ntoa(notify_subscribers[i].addr.sin_addr),
+                    ntohs(notify_subscribers[i].addr.sin_port));
+            notify_subscribers[i].in_use = false;
+        }
+        if (notify_subscribers[i].in_use) {
+            count++;
+        }
+    }
+    notify_subscriber_count = count;
+    if ((count == 0) && (notify_sock >= 0)) {
+        close(notify_sock);
+        notify_sock = -1;
+    }
+}
+
+static void esp_rmaker_local_ctrl_notify_flush(void *priv_data)
+{
+    if (!notify_lock) {
+        return;
+    }
+    char buf[96];
+    json_gen_str_t jstr;
+    xSemaphoreTake(notify_lock, portMAX_DELAY);
+    esp_rmaker_local_ctrl_notify_prune(esp_rmaker_local_ctrl_notify_now());
+    uint32_t version = esp_rmaker_get_node_params_version();
+    if (notify_subscriber_count == 0) {
+        xSemaphoreGive(notify_lock);
+        return;
+    }
+    if (notify_sock < 0) {
+        notify_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (notify_sock < 0) {
+            ESP_LOGE(TAG, "Failed to create socket. errno=%d", errno);
+            xSemaphoreGive(notify_lock);
+            return;
+        }
+    }
+    json_gen_str_start(&jstr, buf, sizeof(buf), NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_string(&jstr, "node_id", esp_rmaker_get_node_id());
+    json_gen_obj_set_int(&jstr, "seq", version);
+    json_gen_end_object(&jstr);
+    json_gen_str_end(&jstr);
+    size_t len = strlen(buf);
+    for (int i = 0; i < NOTIFY_MAX_SUBSCRIBERS; i++) {
+        notify_subscriber_t *sub = &notify_subscribers[i];
+        if (!sub->in_use || (sub->sent_version == version)) {
+            continue;
+        }
+        /* Delivery is best effort. A client which misses a notification catches up with the next one,
+         * or on its next "params_delta" read.
+         */
+        if (sendto(notify_sock, buf, len, 0, (struct sockaddr *)&sub->addr, sizeof(sub->addr)) < 0) {
+            ESP_LOGW(TAG, "Failed to notify %s:%d. errno=%d", inet_ntoa(sub->addr.sin_addr),
+                    ntohs(sub->addr.sin_port), errno);
+        }
+        sub->sent_version = version;
+    }
+    xSemaphoreGive(notify_lock);
+}
+
+static void esp_rmaker_local_ctrl_notify_timer_cb(void *priv)
+{
+    esp_rmaker_work_queue_add_task(esp_rmaker_local_ctrl_notify_flush, NULL);
+}
+
+/* Notifications are sent only to hosts on the node's own subnet, so that a client cannot make the node
+ * send datagrams to arbitrary hosts elsewhere.
+ */
+static bool esp_rmaker_local_ctrl_notify_is_on_subnet(struct in_addr addr)
+{
+    esp_netif_ip_info_t ip_info;
+    esp_netif_t *netif = esp_netif_get_default_netif();
+    if (!netif || (esp_netif_get_ip_info(netif, &ip_info) != ESP_OK) || (ip_info.ip.addr == 0)) {
+        return false;
+    }
+    uint32_t mask = ip_info.netmask.addr;
+    if (((addr.s_addr ^ ip_info.ip.addr) & mask) != 0) {
+        return false;
+    }
+    /* Exclude the network and broadcast addresses, and the node itself */
+    uint32_t host = addr.s_addr & ~mask;
+    return (host != 0) && (host != ~mask) && (addr.s_addr != ip_info.ip.addr);
+}
+
+static esp_err_t esp_rmaker_local_ctrl_notify_init(void)
+{
+    if (notify_lock) {
+        return ESP_OK;
+    }
+    esp_timer_create_args_t timer_conf = {
+        .callback = esp_rmaker_local_ctrl_notify_timer_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "rmaker_lc_notify"
+    };
+    if (esp_timer_create(&timer_conf, &notify_timer) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create notification timer.");
+        return ESP_FAIL;
+    }
+    notify_lock = xSemaphoreCreateMutex();
+    if (!notify_lock) {
+        ESP_LOGE(TAG, "Failed to create notification lock.");
+        esp_timer_delete(notify_timer);
+        notify_timer = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void esp_rmaker_local_ctrl_notify_params_changed(void)
+{
+    if ((notify_subscriber_count == 0) || !notify_timer) {
+        return;
+    }
+    /* If the timer is already running, this change goes out with the notification already scheduled */
+    esp_timer_start_once(notify_timer, NOTIFY_INTERVAL_US);
+}
+
+/* Expects {"port":<udp port>,"ip":"<client ip>","lease":<seconds>}. The local control handlers do not
+ * get the peer address, so the client provides its own IP. A lease of 0 removes the subscription.
+ */
+esp_err_t esp_rmaker_local_ctrl_notify_subscribe(const char *data, size_t data_len)
+{
+#if (CONFIG_ESP_RMAKER_LOCAL_CTRL_SECURITY == 0) || (ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(4, 2, 0))
+    /* Without security, any peer on the network could add subscriptions */
+    ESP_LOGE(TAG, "Notifications are not supported with local control security 0.");
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+    jparse_ctx_t jctx;
+    if (json_parse_start(&jctx, data, data_len) != 0) {
+        ESP_LOGE(TAG, "Invalid notify request.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    char ip[NOTIFY_IP_STR_LEN] = {0};
+    int port = 0;
+    int lease = NOTIFY_MAX_LEASE_SEC;
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+    };
+    esp_err_t err = ESP_OK;
+    if ((json_obj_get_string(&jctx, "ip", ip, sizeof(ip)) != 0) ||
+            (inet_pton(AF_INET, ip, &addr.sin_addr) != 1)) {
+        ESP_LOGE(TAG, "Invalid or missing \"ip\" in notify request.");
+        err = ESP_ERR_INVALID_ARG;
+    } else if (!esp_rmaker_local_ctrl_notify_is_on_subnet(addr.sin_addr)) {
+        ESP_LOGE(TAG, "Notify \"ip\" %s is not on the node's subnet.", ip);
+        err = ESP_ERR_INVALID_ARG;
+    } else if ((json_obj_get_int(&jctx, "port", &port) != 0) || (port <= 0) || (port > UINT16_MAX)) {
+        ESP_LOGE(TAG, "Invalid or missing \"port\" in notify request.");
+        err = ESP_ERR_INVALID_ARG;
+    } else {
+        json_obj_get_int(&jctx, "lease", &lease);
+        if ((lease < 0) || (lease > NOTIFY_MAX_LEASE_SEC)) {
+            lease = NOTIFY_MAX_LEASE_SEC;
+        }
+    }
+    json_parse_end(&jctx);
+    if (err != ESP_OK) {
+        return err;
+    }
+    addr.sin_port = htons(port);
+    if ((err = esp_rmaker_local_ctrl_notify_init()) != ESP_OK) {
+        return err;
+    }
+    int64_t now = esp_rmaker_local_ctrl_notify_now();
+    xSemaphoreTake(notify_lock, portMAX_DELAY);
+    esp_rmaker_local_ctrl_notify_prune(now);
+    notify_subscriber_t *sub = NULL;
+    notify_subscriber_t *free_slot = NULL;
+    for (int i = 0; i < NOTIFY_MAX_SUBSCRIBERS; i++) {
+        if (!notify_subscribers[i].in_use) {
+            if (!free_slot) {
+                free_slot = &notify_subscribers[i];
+            }
+        } else if ((notify_subscribers[i].addr.sin_addr.s_addr == addr.sin_addr.s_addr) &&
+                (notify_subscribers[i].addr.sin_port == addr.sin_port)) {
+            sub = &notify_subscribers[i];
+        }
+    }
+    if (lease == 0) {
+        if (sub) {
+            sub->in_use = false;
+            /* Updates the count, and closes the socket if this was the last subscriber */
+            esp_rmaker_local_ctrl_notify_prune(now);
+            ESP_LOGI(TAG, "Removed subscription from %s:%d.", ip, port);
+        }
+    } else if (sub) {
+        sub->expiry = now + lease;
+    } else if (free_slot) {
+        free_slot->in_use = true;
+        free_slot->addr = addr;
+        free_slot->expiry = now + lease;
+        /* The client reads the current params after subscribing, so only later changes are notified */
+        free_slot->sent_version = esp_rmaker_get_node_params_version();
+        notify_subscriber_count++;
+        ESP_LOGI(TAG, "Added subscription from %s:%d for %d seconds.", ip, port, lease);
+    } else {
+        ESP_LOGE(TAG, "Max %d subscriptions allowed.", NOTIFY_MAX_SUBSCRIBERS);
+        err = ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(notify_lock);
+    return err;
+}
+
+char *esp_rmaker_local_ctrl_notify_get_status(void)
+{
+    int subscribers = 0;
+    if (notify_lock) {
+        xSemaphoreTake(notify_lock, portMAX_DELAY);
+        esp_rmaker_local_ctrl_notify_prune(esp_rmaker_local_ctrl_notify_now());
+        subscribers = notify_subscriber_count;
+        xSemaphoreGive(notify_lock);
+    }
+    size_t len = 80;
+    char *status = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_LOCAL_CTRL, 1, len);
+    if (!status) {
+        return NULL;
+    }
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, status, len, NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_int(&jstr, "subscribers", subscribers);
+    json_gen_obj_set_int(&jstr, "max", NOTIFY_MAX_SUBSCRIBERS);
+    json_gen_obj_set_int(&jstr, "lease", NOTIFY_MAX_LEASE_SEC);
+    json_gen_end_object(&jstr);
+    json_gen_str_end(&jstr);
+    return status;
+}
+
+void esp_rmaker_local_ctrl_notify_deinit(void)
+{
+    if (!notify_lock) {
+        return;
+    }
+    esp_timer_stop(notify_timer);
+    xSemaphoreTake(notify_lock, portMAX_DELAY);
+    memset(notify_subscribers, 0, sizeof(notify_subscribers));
+    esp_rmaker_local_ctrl_notify_prune(0);
+    xSemaphoreGive(notify_lock);
+}
+
+#endif /* CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY */
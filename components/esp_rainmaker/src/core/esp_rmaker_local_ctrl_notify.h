@@ -0,0 +1,21 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <sdkconfig.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+#ifdef CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY
+/* Handles a write to the "notify" local control property, to add, renew or remove a subscription */
+esp_err_t esp_rmaker_local_ctrl_notify_subscribe(const char *data, size_t data_len);
+/* Gets the JSON for a read of the "notify" local control property */
+char *esp_rmaker_local_ctrl_notify_get_status(void);
+/* Schedules a notification to all the subscribers. Called on every params version change. */
+void esp_rmaker_local_ctrl_notify_params_changed(void);
+void esp_rmaker_local_ctrl_notify_deinit(void);
+#endif /* CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY */
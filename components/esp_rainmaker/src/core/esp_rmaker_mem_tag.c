@@ -0,0 +1,133 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <sdkconfig.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <esp_err.h>
+#include <esp_rmaker_core.h>
+#include "esp_rmaker_mem_tag.h"
+
+static const char *TAG = "esp_rmaker_mem_tag";
+
+static const char *tag_str[ESP_RMAKER_MEM_TAG_MAX] = {
+    [ESP_RMAKER_MEM_TAG_PARAMS] = "params",
+    [ESP_RMAKER_MEM_TAG_NODE_CONFIG] = "node_config",
+    [ESP_RMAKER_MEM_TAG_SCHEDULE] = "schedule",
+    [ESP_RMAKER_MEM_TAG_SCENES] = "scenes",
+    [ESP_RMAKER_MEM_TAG_OTA] = "ota",
+    [ESP_RMAKER_MEM_TAG_LOCAL_CTRL] = "local_ctrl",
+};
+
+const char *esp_rmaker_mem_tag_to_str(esp_rmaker_mem_tag_t tag)
+{
+    if ((tag < 0) || (tag >= ESP_RMAKER_MEM_TAG_MAX)) {
+        return "invalid";
+    }
+    return tag_str[tag];
+}
+
+#ifdef CONFIG_ESP_RMAKER_MEM_TAG_ACCOUNTING
+
+#include <freertos/FreeRTOS.h>
+
+/* Prepended to every tagged allocation, so that the free path knows what to account.
+ * Being 8 bytes, it retains the alignment given by the underlying allocator.
+ */
+typedef struct {
+    uint32_t size;
+    uint32_t tag;
+} mem_tag_hdr_t;
+
+static esp_rmaker_mem_tag_stats_t mem_tag_stats[ESP_RMAKER_MEM_TAG_MAX];
+static portMUX_TYPE mem_tag_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void *esp_rmaker_mem_tag_account(esp_rmaker_mem_tag_t tag, mem_tag_hdr_t *hdr, size_t size)
+{
+    if (!hdr) {
+        return NULL;
+    }
+    hdr->size = size;
+    hdr->tag = tag;
+    esp_rmaker_mem_tag_stats_t *stats = &mem_tag_stats[tag];
+    portENTER_CRITICAL(&mem_tag_lock);
+    stats->alloc_count++;
+    stats->total_bytes += size;
+    stats->live_bytes += size;
+    if (stats->live_bytes > stats->peak_bytes) {
+        stats->peak_bytes = stats->live_bytes;
+    }
+    portEXIT_CRITICAL(&mem_tag_lock);
+    return hdr + 1;
+}
+
+void *esp_rmaker_mem_tag_calloc(esp_rmaker_mem_tag_t tag, size_t num, size_t size)
+{
+    if ((tag < 0) || (tag >= ESP_RMAKER_MEM_TAG_MAX) || (size && (num > (SIZE_MAX - sizeof(mem_tag_hdr_t)) / size))) {
+        return NULL;
+    }
+    size_t total = num * size;
+    return esp_rmaker_mem_tag_account(tag, MEM_CALLOC_EXTRAM(1, sizeof(mem_tag_hdr_t) + total), total);
+}
+
+void *esp_rmaker_mem_tag_alloc(esp_rmaker_mem_tag_t tag, size_t size)
+{
+    if ((tag < 0) || (tag >= ESP_RMAKER_MEM_TAG_MAX) || (size > SIZE_MAX - sizeof(mem_tag_hdr_t))) {
+        return NULL;
+    }
+    return esp_rmaker_mem_tag_account(tag, MEM_ALLOC_EXTRAM(sizeof(mem_tag_hdr_t) + size), size);
+}
+
+void esp_rmaker_mem_tag_free(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    mem_tag_hdr_t *hdr = (mem_tag_hdr_t *)ptr - 1;
+    esp_rmaker_mem_tag_stats_t *stats = &mem_tag_stats[hdr->tag];
+    portENTER_CRITICAL(&mem_tag_lock);
+    stats->free_count++;
+    stats->live_bytes -= hdr->size;
+    portEXIT_CRITICAL(&mem_tag_lock);
+    free(hdr);
+}
+
+esp_err_t esp_rmaker_mem_tag_get_stats(esp_rmaker_mem_tag_t tag, esp_rmaker_mem_tag_stats_t *stats)
+{
+    if (!stats || (tag < 0) || (tag >= ESP_RMAKER_MEM_TAG_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&mem_tag_lock);
+    *stats = mem_tag_stats[tag];
+    portEXIT_CRITICAL(&mem_tag_lock);
+    return ESP_OK;
+}
+
+void esp_rmaker_mem_tag_print_stats(void)
+{
+    esp_rmaker_mem_tag_stats_t stats;
+    for (int tag = 0; tag < ESP_RMAKER_MEM_TAG_MAX; tag++) {
+        esp_rmaker_mem_tag_get_stats(tag, &stats);
+        printf("%s: %-11s: live %"PRIu32" bytes, peak %"PRIu32" bytes, allocs %"PRIu32", frees %"PRIu32"\n",
+                TAG, tag_str[tag], stats.live_bytes, stats.peak_bytes, stats.alloc_count, stats.free_count);
+    }
+}
+
+#else /* !CONFIG_ESP_RMAKER_MEM_TAG_ACCOUNTING */
+
+esp_err_t esp_rmaker_mem_tag_get_stats(esp_rmaker_mem_tag_t tag, esp_rmaker_mem_tag_stats_t *stats)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void esp_rmaker_mem_tag_print_stats(void)
+{
+    printf("%s: Enable CONFIG_ESP_RMAKER_MEM_TAG_ACCOUNTING for heap accounting.\n", TAG);
+}
+
+#endif /* !CONFIG_ESP_RMAKER_MEM_TAG_ACCOUNTING */
@@ -0,0 +1,35 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <sdkconfig.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <esp_rmaker_core.h>
+#include <esp_rmaker_utils.h>
+
+/* Allocators which account the memory against a subsystem tag, if CONFIG_ESP_RMAKER_MEM_TAG_ACCOUNTING
+ * is enabled, else are same as MEM_CALLOC_EXTRAM()/MEM_ALLOC_EXTRAM()/free().
+ * Memory obtained from these should be released only using RMAKER_MEM_FREE() (or RMAKER_MEM_FREE_FN,
+ * wherever a free function pointer is required).
+ */
+#ifdef CONFIG_ESP_RMAKER_MEM_TAG_ACCOUNTING
+void *esp_rmaker_mem_tag_calloc(esp_rmaker_mem_tag_t tag, size_t num, size_t size);
+void *esp_rmaker_mem_tag_alloc(esp_rmaker_mem_tag_t tag, size_t size);
+void esp_rmaker_mem_tag_free(void *ptr);
+
+#define RMAKER_MEM_CALLOC_EXTRAM(tag, num, size)    esp_rmaker_mem_tag_calloc(tag, num, size)
+#define RMAKER_MEM_ALLOC_EXTRAM(tag, size)          esp_rmaker_mem_tag_alloc(tag, size)
+#define RMAKER_MEM_FREE(ptr)                        esp_rmaker_mem_tag_free(ptr)
+#define RMAKER_MEM_FREE_FN                          esp_rmaker_mem_tag_free
+#else
+#define RMAKER_MEM_CALLOC_EXTRAM(tag, num, size)    MEM_CALLOC_EXTRAM(num, size)
+#define RMAKER_MEM_ALLOC_EXTRAM(tag, size)          MEM_ALLOC_EXTRAM(size)
+#define RMAKER_MEM_FREE(ptr)                        free(ptr)
+#define RMAKER_MEM_FREE_FN                          free
+#endif /* CONFIG_ESP_RMAKER_MEM_TAG_ACCOUNTING */
+
+void esp_rmaker_mem_tag_print_stats(void);
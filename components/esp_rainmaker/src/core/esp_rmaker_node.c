@@ -21,6 +21,7 @@
 #include <esp_rmaker_secure_boot_digest.h>
 
 #include "esp_rmaker_internal.h"
+#include "esp_rmaker_node_mem.h"
 
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
 #include <esp_app_desc.h>
@@ -57,13 +58,14 @@ static void esp_rmaker_node_info_free(esp_rmaker_node_info_t *info)
 esp_err_t esp_rmaker_attribute_delete(esp_rmaker_attr_t *attr)
 {
     if (attr) {
+        /* Node and device attributes are allocated from the node model memory */
         if (attr->name) {
-            free(attr->name);
+            esp_rmaker_node_mem_free(attr->name);
         }
         if (attr->value) {
-            free(attr->value);
+            esp_rmaker_node_mem_free(attr->value);
         }
-        free(attr);
+        esp_rmaker_node_mem_free(attr);
         return ESP_OK;
     }
     return ESP_ERR_INVALID_ARG;
@@ -236,13 +238,13 @@ esp_err_t esp_rmaker_node_add_attribute(const esp_rmaker_node_t *node, const cha
         }
         attr = attr->next;
     }
-    esp_rmaker_attr_t *new_attr = MEM_CALLOC_EXTRAM(1, sizeof(esp_rmaker_attr_t));
+    esp_rmaker_attr_t *new_attr = esp_rmaker_node_mem_calloc(ESP_RMAKER_NODE_MEM_NODE, sizeof(esp_rmaker_attr_t));
     if (!new_attr) {
         ESP_LOGE(TAG, "Failed to create node attribute %s.", attr_name);
         return ESP_ERR_NO_MEM;
     }
-    new_attr->name = strdup(attr_name);
-    new_attr->value = strdup(value);
+    new_attr->name = esp_rmaker_node_mem_strdup(ESP_RMAKER_NODE_MEM_NODE, attr_name);
+    new_attr->value = esp_rmaker_node_mem_strdup(ESP_RMAKER_NODE_MEM_NODE, value);
     if (!new_attr->name || !new_attr->value) {
         ESP_LOGE(TAG, "Failed to allocate memory for name/value for attribute %s.", attr_name);
         esp_rmaker_attribute_delete(new_attr);
@@ -254,6 +256,7 @@ esp_err_t esp_rmaker_node_add_attribute(const esp_rmaker_node_t *node, const cha
     } else {
         ((_esp_rmaker_node_t *)node)->attributes = new_attr;
     }
+    esp_rmaker_node_config_changed();
     ESP_LOGI(TAG, "Node attribute %s created", attr_name);
     return ESP_OK;
 }
@@ -284,6 +287,7 @@ esp_err_t esp_rmaker_node_add_device(const esp_rmaker_node_t *node, const esp_rm
         _node->devices = _new_device;
     }
     _new_device->parent = node;
+    esp_rmaker_node_devices_changed();
     return ESP_OK;
 }
 
@@ -315,6 +319,7 @@ esp_err_t esp_rmaker_node_remove_device(const esp_rmaker_node_t *node, const esp
         prev_device->next = tmp_device->next;
     }
     tmp_device->parent = NULL;
+    esp_rmaker_node_devices_changed();
     return ESP_OK;
 }
 
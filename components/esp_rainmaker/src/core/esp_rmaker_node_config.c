@@ -19,12 +19,16 @@
 #include <esp_rmaker_core.h>
 #include <esp_rmaker_utils.h>
 #include "esp_rmaker_internal.h"
+#include "esp_rmaker_mem_tag.h"
 #include "esp_rmaker_mqtt.h"
 #include "esp_rmaker_mqtt_topics.h"
 #include <esp_rmaker_secure_boot_digest.h>
 
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
 #include <esp_app_desc.h>
+#include <esp_random.h>
+#else
+#include <esp_system.h>
 #endif
 
 #define NODE_CONFIG_TOPIC_SUFFIX        "config"
@@ -255,6 +259,36 @@ static esp_err_t esp_rmaker_report_devices_or_services(json_gen_str_t *jptr, cha
     return ESP_OK;
 }
 
+static uint32_t node_config_version;
+
+void esp_rmaker_node_config_changed(void)
+{
+    if (!node_config_version) {
+        /* Kept well within the positive int range, since this is reported in JSON */
+        node_config_version = (esp_random() >> 2) + 1;
+    }
+    node_config_version++;
+    esp_rmaker_node_params_changed(true);
+}
+
+static uint32_t node_devices_version;
+
+void esp_rmaker_node_devices_changed(void)
+{
+    node_devices_version++;
+    esp_rmaker_node_config_changed();
+}
+
+uint32_t esp_rmaker_get_node_devices_version(void)
+{
+    return node_devices_version;
+}
+
+uint32_t esp_rmaker_get_node_config_version(void)
+{
+    return node_config_version;
+}
+
 int __esp_rmaker_get_node_config(char *buf, size_t buf_size)
 {
     json_gen_str_t jstr;
@@ -278,13 +312,13 @@ char *esp_rmaker_get_node_config(void)
         ESP_LOGE(TAG, "Failed to get required size for Node config JSON.");
         return NULL;
     }
-    char *node_config = MEM_CALLOC_EXTRAM(1, req_size);
+    char *node_config = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_NODE_CONFIG, 1, req_size);
     if (!node_config) {
         ESP_LOGE(TAG, "Failed to allocate %d bytes for node config", req_size);
         return NULL;
     }
     if (__esp_rmaker_get_node_config(node_config, req_size) < 0) {
-        free(node_config);
+        RMAKER_MEM_FREE(node_config);
         ESP_LOGE(TAG, "Failed to generate Node config JSON.");
         return NULL;
     }
@@ -305,6 +339,6 @@ esp_err_t esp_rmaker_report_node_config()
     ESP_LOGD(TAG, "%s", publish_payload);
     esp_err_t ret = esp_rmaker_mqtt_publish(publish_topic, publish_payload, strlen(publish_payload),
                         RMAKER_MQTT_QOS1, NULL);
-    free(publish_payload);
+    RMAKER_MEM_FREE(publish_payload);
     return ret;
 }
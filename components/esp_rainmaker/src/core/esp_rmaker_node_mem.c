@@ -0,0 +1,234 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <sdkconfig.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <esp_rmaker_core.h>
+#include <esp_rmaker_utils.h>
+#include "esp_rmaker_internal.h"
+#include "esp_rmaker_node_mem.h"
+
+static const char *TAG = "esp_rmaker_node_mem";
+
+typedef struct {
+    /* Bytes requested by the model, by owner */
+    size_t requested[ESP_RMAKER_NODE_MEM_MAX];
+    /* Number of allocations, by owner */
+    uint32_t allocs[ESP_RMAKER_NODE_MEM_MAX];
+    /* Bytes currently taken from the heap, including arena chunks */
+    size_t heap_used;
+    /* Number of arena allocations freed. This memory cannot be reused */
+    uint32_t arena_frees;
+} esp_rmaker_node_mem_stats_t;
+
+static esp_rmaker_node_mem_stats_t s_stats;
+/* Protects the stats and the arena, since devices and params can be added or removed from any task */
+static portMUX_TYPE node_mem_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Heap allocations are prefixed with their size, so that heap_used can be reduced when they are freed */
+typedef union {
+    size_t size;
+    /* For the alignment of the data that follows */
+    uint64_t align;
+} esp_rmaker_node_mem_heap_hdr_t;
+
+static void *esp_rmaker_node_mem_heap_alloc(size_t size)
+{
+    esp_rmaker_node_mem_heap_hdr_t *hdr = MEM_CALLOC_EXTRAM(1, sizeof(esp_rmaker_node_mem_heap_hdr_t) + size);
+    if (!hdr) {
+        return NULL;
+    }
+    hdr->size = size;
+    portENTER_CRITICAL(&node_mem_lock);
+    s_stats.heap_used += size;
+    portEXIT_CRITICAL(&node_mem_lock);
+    return hdr + 1;
+}
+
+static void esp_rmaker_node_mem_heap_free(void *ptr)
+{
+    esp_rmaker_node_mem_heap_hdr_t *hdr = ((esp_rmaker_node_mem_heap_hdr_t *)ptr) - 1;
+    portENTER_CRITICAL(&node_mem_lock);
+    s_stats.heap_used -= hdr->size;
+    portEXIT_CRITICAL(&node_mem_lock);
+    free(hdr);
+}
+
+#ifdef CONFIG_ESP_RMAKER_NODE_MEM_ARENA
+
+#define ARENA_CHUNK_SIZE        CONFIG_ESP_RMAKER_NODE_MEM_ARENA_CHUNK_SIZE
+#define ARENA_ALIGN             sizeof(void *)
+/* Allocations larger than this go to the heap directly so that a chunk is not left mostly unused */
+#define ARENA_MAX_ALLOC_SIZE    (ARENA_CHUNK_SIZE / 4)
+
+typedef struct esp_rmaker_arena_chunk {
+    struct esp_rmaker_arena_chunk *next;
+    size_t used;
+    uint8_t data[];
+} esp_rmaker_arena_chunk_t;
+
+static esp_rmaker_arena_chunk_t *s_chunks;
+/* Once closed, all the allocations go to the heap, so that the memory of devices and params added and
+ * removed at runtime (Eg. on enabling/disabling services) gets released.
+ */
+static bool s_arena_closed;
+
+/* Chunks are never freed, so the list can be walked without the lock */
+static bool esp_rmaker_arena_owns(void *ptr)
+{
+    esp_rmaker_arena_chunk_t *chunk = s_chunks;
+    while (chunk) {
+        if (((uint8_t *)ptr >= chunk->data) && ((uint8_t *)ptr < (chunk->data + ARENA_CHUNK_SIZE))) {
+            return true;
+        }
+        chunk = chunk->next;
+    }
+    return false;
+}
+
+/* Carves the memory out of the latest chunk, if it fits. Should be called with the lock held. */
+static void *esp_rmaker_arena_carve(size_t size)
+{
+    /* Only the latest chunk is used for new allocations. Older chunks are nearly full anyways */
+    if (!s_chunks || ((s_chunks->used + size) > ARENA_CHUNK_SIZE)) {
+        return NULL;
+    }
+    void *ptr = s_chunks->data + s_chunks->used;
+    s_chunks->used += size;
+    return ptr;
+}
+
+static void *esp_rmaker_arena_alloc(size_t size)
+{
+    size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+    portENTER_CRITICAL(&node_mem_lock);
+    void *ptr = esp_rmaker_arena_carve(size);
+    portEXIT_CRITICAL(&node_mem_lock);
+    if (ptr) {
+        return ptr;
+    }
+    /* The new chunk is allocated without the lock held, since it is a spinlock */
+    esp_rmaker_arena_chunk_t *chunk = MEM_CALLOC_EXTRAM(1, sizeof(esp_rmaker_arena_chunk_t) + ARENA_CHUNK_SIZE);
+    if (!chunk) {
+        return NULL;
+    }
+    portENTER_CRITICAL(&node_mem_lock);
+    /* Some other task may have added a chunk in the meantime */
+    ptr = esp_rmaker_arena_carve(size);
+    if (!ptr) {
+        chunk->next = s_chunks;
+        s_chunks = chunk;
+        s_stats.heap_used += sizeof(esp_rmaker_arena_chunk_t) + ARENA_CHUNK_SIZE;
+        ptr = esp_rmaker_arena_carve(size);
+        chunk = NULL;
+    }
+    portEXIT_CRITICAL(&node_mem_lock);
+    if (chunk) {
+        free(chunk);
+    }
+    return ptr;
+}
+#endif /* CONFIG_ESP_RMAKER_NODE_MEM_ARENA */
+
+void esp_rmaker_node_mem_arena_close(void)
+{
+#ifdef CONFIG_ESP_RMAKER_NODE_MEM_ARENA
+    s_arena_closed = true;
+#endif
+}
+
+void *esp_rmaker_node_mem_calloc(esp_rmaker_node_mem_owner_t owner, size_t size)
+{
+    if (owner >= ESP_RMAKER_NODE_MEM_MAX) {
+        return NULL;
+    }
+    void *ptr = NULL;
+#ifdef CONFIG_ESP_RMAKER_NODE_MEM_ARENA
+    if ((size <= ARENA_MAX_ALLOC_SIZE) && !s_arena_closed) {
+        /* Arena chunks are zero initialised and never reused, so no memset required */
+        ptr = esp_rmaker_arena_alloc(size);
+    } else
+#endif
+    {
+        ptr = esp_rmaker_node_mem_heap_alloc(size);
+    }
+    if (ptr) {
+        portENTER_CRITICAL(&node_mem_lock);
+        s_stats.requested[owner] += size;
+        s_stats.allocs[owner]++;
+        portEXIT_CRITICAL(&node_mem_lock);
+    }
+    return ptr;
+}
+
+char *esp_rmaker_node_mem_strdup(esp_rmaker_node_mem_owner_t owner, const char *str)
+{
+    if (!str) {
+        return NULL;
+    }
+    size_t len = strlen(str) + 1;
+    char *new_str = esp_rmaker_node_mem_calloc(owner, len);
+    if (new_str) {
+        memcpy(new_str, str, len);
+    }
+    return new_str;
+}
+
+void esp_rmaker_node_mem_free(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+#ifdef CONFIG_ESP_RMAKER_NODE_MEM_ARENA
+    if (esp_rmaker_arena_owns(ptr)) {
+        /* Arena memory cannot be released individually. This is rare though (only when a device/param
+         * created before esp_rmaker_start() is deleted or its metadata replaced), so just keep a count.
+         */
+        portENTER_CRITICAL(&node_mem_lock);
+        s_stats.arena_frees++;
+        portEXIT_CRITICAL(&node_mem_lock);
+        return;
+    }
+#endif
+    esp_rmaker_node_mem_heap_free(ptr);
+}
+
+void esp_rmaker_node_mem_print_stats(void)
+{
+    uint32_t num_devices = 0, num_params = 0;
+    _esp_rmaker_device_t *device = esp_rmaker_node_get_first_device(esp_rmaker_get_node());
+    while (device) {
+        num_devices++;
+        _esp_rmaker_param_t *param = device->params;
+        while (param) {
+            num_params++;
+            param = param->next;
+        }
+        device = device->next;
+    }
+    size_t device_bytes = s_stats.requested[ESP_RMAKER_NODE_MEM_DEVICE];
+    size_t param_bytes = s_stats.requested[ESP_RMAKER_NODE_MEM_PARAM];
+    printf("%s: Node model memory (%s)\n", TAG,
+#ifdef CONFIG_ESP_RMAKER_NODE_MEM_ARENA
+            "arena"
+#else
+            "heap"
+#endif
+            );
+    printf("%s: Devices: %"PRIu32", %u bytes in %"PRIu32" allocations (%u bytes per device)\n", TAG,
+            num_devices, (unsigned)device_bytes, s_stats.allocs[ESP_RMAKER_NODE_MEM_DEVICE],
+            num_devices ? (unsigned)(device_bytes / num_devices) : 0);
+    printf("%s: Params: %"PRIu32", %u bytes in %"PRIu32" allocations (%u bytes per param)\n", TAG,
+            num_params, (unsigned)param_bytes, s_stats.allocs[ESP_RMAKER_NODE_MEM_PARAM],
+            num_params ? (unsigned)(param_bytes / num_params) : 0);
+    /* Heap usage excludes the allocator's own per-allocation overhead, which the arena avoids */
+    printf("%s: Heap used: %u bytes, Arena frees: %"PRIu32"\n", TAG,
+            (unsigned)s_stats.heap_used, s_stats.arena_frees);
+}
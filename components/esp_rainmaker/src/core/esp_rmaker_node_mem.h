@@ -0,0 +1,34 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+
+/* Owner of the node model memory, used for accounting */
+typedef enum {
+    ESP_RMAKER_NODE_MEM_DEVICE = 0,
+    ESP_RMAKER_NODE_MEM_PARAM,
+    ESP_RMAKER_NODE_MEM_NODE,
+    ESP_RMAKER_NODE_MEM_MAX,
+} esp_rmaker_node_mem_owner_t;
+
+/* Allocators for the static parts of the node data model (devices, params, attributes
+ * and their names/types/bounds). If CONFIG_ESP_RMAKER_NODE_MEM_ARENA is enabled, the memory
+ * is carved out of large arena chunks, else it comes from the heap as before.
+ * Memory obtained from these should be released only using esp_rmaker_node_mem_free().
+ * These can be called from any task.
+ */
+void *esp_rmaker_node_mem_calloc(esp_rmaker_node_mem_owner_t owner, size_t size);
+char *esp_rmaker_node_mem_strdup(esp_rmaker_node_mem_owner_t owner, const char *str);
+void esp_rmaker_node_mem_free(void *ptr);
+void esp_rmaker_node_mem_print_stats(void);
+
+/* Stops using the arena for new allocations. Called from esp_rmaker_start(), after which the
+ * devices and params are mostly added and removed at runtime, and so should not be in the arena.
+ */
+void esp_rmaker_node_mem_arena_close(void);
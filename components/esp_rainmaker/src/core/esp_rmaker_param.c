@@ -16,7 +16,14 @@
 #include <string.h>
 #include <esp_log.h>
 #include <esp_err.h>
+#include <esp_event.h>
+#include <esp_idf_version.h>
 #include <nvs.h>
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0)
+#include <esp_random.h>
+#else
+#include <esp_system.h>
+#endif
 
 #include <json_parser.h>
 #include <json_generator.h>
@@ -25,8 +32,15 @@
 #include <esp_rmaker_standard_types.h>
 #include <esp_rmaker_mqtt.h>
 #include <esp_rmaker_utils.h>
+#include <esp_rmaker_common_events.h>
+#include <esp_rmaker_work_queue_prio.h>
 #include "esp_rmaker_mqtt_topics.h"
 #include "esp_rmaker_internal.h"
+#include "esp_rmaker_node_mem.h"
+#include "esp_rmaker_latency.h"
+#include "esp_rmaker_local_ctrl_notify.h"
+#include "esp_rmaker_mem_tag.h"
+#include "esp_rmaker_mqtt_publish_queue.h"
 
 #define TS_DATA_VERSION                         "2021-09-13"
 
@@ -35,6 +49,7 @@
 #define RMAKER_PARAMS_SIZE_MARGIN       50 /* To accommodate for changes in param values while creating JSON */
 #define RMAKER_ALERT_STR_MARGIN         25 /* To accommodate rest of the alert payload {"esp.alert.str":""}  */
 #define MAX_TS_DATA_PARAM_NAME          66 /* Time series data param name is of the format <device_name>.<param_name> */
+#define MAX_ENUM_PARAM_STRLEN           63 /* Max length of the strings for enumerated string params */
 
 static size_t max_node_params_size = CONFIG_ESP_RMAKER_MAX_PARAM_DATA_SIZE;
 /* This buffer will be allocated once and will be reused for all param updates.
@@ -42,6 +57,9 @@ static size_t max_node_params_size = CONFIG_ESP_RMAKER_MAX_PARAM_DATA_SIZE;
 
 static char publish_topic[MQTT_TOPIC_BUFFER_SIZE];
 static bool esp_rmaker_params_mqtt_init_done;
+static uint32_t node_params_version;
+/* Params version at the last node config change. Deltas from before this cannot be generated. */
+static uint32_t node_params_structure_version;
 
 static const char *TAG = "esp_rmaker_param";
 
@@ -117,7 +135,17 @@ esp_rmaker_param_val_t esp_rmaker_array(const char *val)
     return param_val;
 }
 
-static esp_err_t esp_rmaker_populate_params(char *buf, size_t *buf_len, uint8_t flags, bool reset_flags)
+/* Protects the read-modify-write of the flags and report_seq of the params, which are updated by the
+ * application tasks and the RainMaker tasks, as well as by the MQTT event handler when a report is acknowledged.
+ * Also protects the node params version and the change_seq of the params stamped with it.
+ */
+static portMUX_TYPE param_flags_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* If report_seq is non zero, it gets recorded in all the params included in the report, so that they can be
+ * marked as delivered once the report gets acknowledged.
+ */
+static esp_err_t esp_rmaker_populate_params(char *buf, size_t *buf_len, uint8_t flags, bool reset_flags,
+        uint16_t report_seq)
 {
     esp_err_t err = ESP_OK;
     json_gen_str_t jstr;
@@ -154,9 +182,14 @@ static esp_err_t esp_rmaker_populate_params(char *buf, size_t *buf_len, uint8_t
         while (device) {
             _esp_rmaker_param_t *param = device->params;
             while (param) {
+                portENTER_CRITICAL(&param_flags_lock);
+                if (report_seq && (!flags || (param->flags & flags))) {
+                    param->report_seq = report_seq;
+                }
                 if (reset_flags) {
                     param->flags &= ~flags;
                 }
+                portEXIT_CRITICAL(&param_flags_lock);
                 param = param->next;
             }
             device = device->next;
@@ -174,27 +207,129 @@ char *esp_rmaker_get_node_params(void)
 {
     size_t req_size = 0;
     /* Passing NULL pointer to find the required buffer size */
-    esp_err_t err = esp_rmaker_populate_params(NULL, &req_size, 0, false);
+    esp_err_t err = esp_rmaker_populate_params(NULL, &req_size, 0, false, 0);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to get required size for Node params JSON.");
         return NULL;
     }
     /* Keeping some margin just in case some param value changes in between */
     req_size += RMAKER_PARAMS_SIZE_MARGIN;
-    char *node_params = MEM_CALLOC_EXTRAM(1, req_size);
+    char *node_params = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_PARAMS, 1, req_size);
     if (!node_params) {
         ESP_LOGE(TAG, "Failed to allocate %d bytes for Node params.", req_size);
         return NULL;
     }
-    err = esp_rmaker_populate_params(node_params, &req_size, 0, false);
+    err = esp_rmaker_populate_params(node_params, &req_size, 0, false, 0);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to generate Node params JSON.");
-        free(node_params);
+        RMAKER_MEM_FREE(node_params);
+        return NULL;
+    }
+    return node_params;
+}
+
+/* Should be called with param_flags_lock held, so that concurrent changes get distinct versions, and the
+ * change_seq of a param gets stamped along with the version bump, before a delta report can read it.
+ */
+static uint32_t esp_rmaker_node_params_version_bump(bool structure_changed)
+{
+    if (!node_params_version) {
+        /* Kept well within the positive int range, since this is reported in JSON */
+        node_params_version = (esp_random() >> 2) + 1;
+    }
+    node_params_version++;
+    if (structure_changed) {
+        node_params_structure_version = node_params_version;
+    }
+    return node_params_version;
+}
+
+static void esp_rmaker_node_params_notify_changed(void)
+{
+#ifdef CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY
+    esp_rmaker_local_ctrl_notify_params_changed();
+#endif /* CONFIG_ESP_RMAKER_LOCAL_CTRL_NOTIFY */
+}
+
+uint32_t esp_rmaker_node_params_changed(bool structure_changed)
+{
+    portENTER_CRITICAL(&param_flags_lock);
+    uint32_t version = esp_rmaker_node_params_version_bump(structure_changed);
+    portEXIT_CRITICAL(&param_flags_lock);
+    esp_rmaker_node_params_notify_changed();
+    return version;
+}
+
+static esp_err_t esp_rmaker_populate_params_delta(char *buf, size_t *buf_len, uint32_t since)
+{
+    uint32_t version = node_params_version;
+    /* A since value greater than the current version is from before a reboot */
+    bool full = (since < node_params_structure_version) || (since > version);
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, buf, *buf_len, NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_int(&jstr, "seq", version);
+    json_gen_obj_set_int(&jstr, "since", since);
+    json_gen_obj_set_bool(&jstr, "full", full);
+    json_gen_push_object(&jstr, "params");
+    _esp_rmaker_device_t *device = esp_rmaker_node_get_first_device(esp_rmaker_get_node());
+    while (device) {
+        bool device_added = false;
+        _esp_rmaker_param_t *param = device->params;
+        while (param) {
+            if (full || (param->change_seq > since)) {
+                if (!device_added) {
+                    json_gen_push_object(&jstr, device->name);
+                    device_added = true;
+                }
+                esp_rmaker_report_value(&param->val, param->name, &jstr);
+            }
+            param = param->next;
+        }
+        if (device_added) {
+            json_gen_pop_object(&jstr);
+        }
+        device = device->next;
+    }
+    json_gen_pop_object(&jstr);
+    esp_err_t err = ESP_OK;
+    if (json_gen_end_object(&jstr) < 0) {
+        err = ESP_ERR_NO_MEM;
+    }
+    *buf_len = json_gen_str_end(&jstr);
+    return err;
+}
+
+char *esp_rmaker_get_node_params_delta(uint32_t since)
+{
+    size_t req_size = 0;
+    /* Passing NULL pointer to find the required buffer size */
+    esp_err_t err = esp_rmaker_populate_params_delta(NULL, &req_size, since);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to get required size for Node params delta JSON.");
+        return NULL;
+    }
+    /* Keeping some margin just in case some param value changes in between */
+    req_size += RMAKER_PARAMS_SIZE_MARGIN;
+    char *node_params = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_PARAMS, 1, req_size);
+    if (!node_params) {
+        ESP_LOGE(TAG, "Failed to allocate %d bytes for Node params delta.", req_size);
+        return NULL;
+    }
+    err = esp_rmaker_populate_params_delta(node_params, &req_size, since);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to generate Node params delta JSON.");
+        RMAKER_MEM_FREE(node_params);
         return NULL;
     }
     return node_params;
 }
 
+uint32_t esp_rmaker_get_node_params_version(void)
+{
+    return node_params_version;
+}
+
 static char * esp_rmaker_param_get_buf(size_t size)
 {
     static char *s_node_params_buf;
@@ -209,12 +344,12 @@ static char * esp_rmaker_param_get_buf(size_t size)
      */
     if ((s_param_buf_size != 0) && (s_param_buf_size != size)) {
         ESP_LOGD(TAG, "Freeing s_node_params_buf of size %d", s_param_buf_size);
-        free(s_node_params_buf);
+        RMAKER_MEM_FREE(s_node_params_buf);
         s_node_params_buf = NULL;
     }
     if (!s_node_params_buf) {
         ESP_LOGD(TAG, "Allocating s_node_params_buf for size %d.", size);
-        s_node_params_buf = MEM_CALLOC_EXTRAM(1, size);
+        s_node_params_buf = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_PARAMS, 1, size);
         if (!s_node_params_buf) {
             ESP_LOGE(TAG, "Failed to allocate %d bytes for Node params.", size);
             s_param_buf_size = 0;
@@ -225,7 +360,7 @@ static char * esp_rmaker_param_get_buf(size_t size)
     return s_node_params_buf;
 }
 
-static esp_err_t esp_rmaker_allocate_and_populate_params(uint8_t flags, bool reset_flags)
+static esp_err_t esp_rmaker_allocate_and_populate_params(uint8_t flags, bool reset_flags, uint16_t report_seq)
 {
     char *node_params_buf = esp_rmaker_param_get_buf(max_node_params_size);
     if (!node_params_buf) {
@@ -233,7 +368,7 @@ static esp_err_t esp_rmaker_allocate_and_populate_params(uint8_t flags, bool res
     }
     /* Typically, max_node_params_size should be sufficient for the parameters */
     size_t req_size = max_node_params_size;
-    esp_err_t err = esp_rmaker_populate_params(node_params_buf, &req_size, flags, reset_flags);
+    esp_err_t err = esp_rmaker_populate_params(node_params_buf, &req_size, flags, reset_flags, report_seq);
     /* If the max_node_params_size was insufficient, we will re-allocate new buffer */
     if (err == ESP_ERR_NO_MEM) {
         ESP_LOGW(TAG, "%d bytes not sufficient for Node params. Reallocating %d bytes.",
@@ -244,7 +379,7 @@ static esp_err_t esp_rmaker_allocate_and_populate_params(uint8_t flags, bool res
             return ESP_ERR_NO_MEM;
         }
         req_size = max_node_params_size;
-        err = esp_rmaker_populate_params(node_params_buf, &req_size, flags, reset_flags);
+        err = esp_rmaker_populate_params(node_params_buf, &req_size, flags, reset_flags, report_seq);
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "Failed to populate node parameters.");
         }
@@ -252,9 +387,160 @@ static esp_err_t esp_rmaker_allocate_and_populate_params(uint8_t flags, bool res
     return err;
 }
 
+#ifdef CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC
+/* Reports which are published, but not yet acknowledged. If this overflows, the oldest entry is
+ * overwritten and its params just stay unacknowledged, to be reported again on reconnect.
+ */
+#define PARAM_REPORTS_IN_FLIGHT     8
+
+typedef struct {
+    int msg_id;
+    uint16_t report_seq;
+} esp_rmaker_param_report_in_flight_t;
+
+static esp_rmaker_param_report_in_flight_t s_reports_in_flight[PARAM_REPORTS_IN_FLIGHT];
+static uint8_t s_reports_in_flight_idx;
+static uint16_t s_report_seq;
+
+static uint16_t esp_rmaker_param_get_next_report_seq(void)
+{
+    /* 0 is reserved for "not reported" */
+    if (++s_report_seq == 0) {
+        s_report_seq = 1;
+    }
+    return s_report_seq;
+}
+
+static void esp_rmaker_param_report_acked(int msg_id)
+{
+    uint16_t report_seq = 0;
+    portENTER_CRITICAL(&param_flags_lock);
+    for (int i = 0; i < PARAM_REPORTS_IN_FLIGHT; i++) {
+        if (s_reports_in_flight[i].report_seq && (s_reports_in_flight[i].msg_id == msg_id)) {
+            report_seq = s_reports_in_flight[i].report_seq;
+            s_reports_in_flight[i].report_seq = 0;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&param_flags_lock);
+    if (!report_seq) {
+        return;
+    }
+    /* Params whose value changed after this report was created have their report_seq reset, and so
+     * remain unacknowledged.
+     */
+    _esp_rmaker_device_t *device = esp_rmaker_node_get_first_device(esp_rmaker_get_node());
+    while (device) {
+        _esp_rmaker_param_t *param = device->params;
+        while (param) {
+            portENTER_CRITICAL(&param_flags_lock);
+            if (param->report_seq == report_seq) {
+                param->flags &= ~RMAKER_PARAM_FLAG_VALUE_UNACKED;
+            }
+            portEXIT_CRITICAL(&param_flags_lock);
+            param = param->next;
+        }
+        device = device->next;
+    }
+    ESP_LOGD(TAG, "Params report %d acknowledged.", report_seq);
+}
+
+/* priv_data is the report_seq of the report */
+static void esp_rmaker_param_report_published(int msg_id, void *priv_data)
+{
+    if (msg_id < 0) {
+        return;
+    }
+    portENTER_CRITICAL(&param_flags_lock);
+    s_reports_in_flight[s_reports_in_flight_idx].msg_id = msg_id;
+    s_reports_in_flight[s_reports_in_flight_idx].report_seq = (uint16_t)(uintptr_t)priv_data;
+    s_reports_in_flight_idx = (s_reports_in_flight_idx + 1) % PARAM_REPORTS_IN_FLIGHT;
+    portEXIT_CRITICAL(&param_flags_lock);
+}
+
+static esp_err_t esp_rmaker_report_unacked_params(void);
+
+static void esp_rmaker_report_unacked_params_cb(void *priv_data)
+{
+    esp_rmaker_report_unacked_params();
+}
+
+static void esp_rmaker_param_mqtt_event_handler(void* arg, esp_event_base_t event_base,
+                          int32_t event_id, void* event_data)
+{
+    if (event_base != RMAKER_COMMON_EVENT) {
+        return;
+    }
+    if (event_id == RMAKER_MQTT_EVENT_PUBLISHED) {
+        esp_rmaker_param_report_acked(*((int *)event_data));
+    } else if (event_id == RMAKER_MQTT_EVENT_CONNECTED) {
+        /* This is registered only after the first connection, so this is a reconnect */
+        esp_rmaker_work_queue_add_prio_task(esp_rmaker_report_unacked_params_cb, NULL,
+                ESP_RMAKER_WORK_CLASS_REPORT, 0);
+    }
+}
+
+static esp_err_t esp_rmaker_param_register_for_acks(void)
+{
+    esp_err_t err = esp_event_handler_register(RMAKER_COMMON_EVENT, RMAKER_MQTT_EVENT_PUBLISHED,
+            &esp_rmaker_param_mqtt_event_handler, NULL);
+    if (err == ESP_OK) {
+        err = esp_event_handler_register(RMAKER_COMMON_EVENT, RMAKER_MQTT_EVENT_CONNECTED,
+                &esp_rmaker_param_mqtt_event_handler, NULL);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register for MQTT events. Params will be reported in full on reconnect.");
+    }
+    return err;
+}
+#endif /* CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC */
+
+/* Publishes the given params report. If report_seq is non zero, the publish ack is tracked so that the params
+ * included in the report can be marked as delivered.
+ */
+static esp_err_t esp_rmaker_param_publish_report(const char *topic, char *buf, uint16_t report_seq)
+{
+#ifdef CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC
+    if (report_seq) {
+        /* The report may get queued, in which case the message id is known only once it is sent */
+        return esp_rmaker_mqtt_publish_with_cb(topic, buf, strlen(buf), RMAKER_MQTT_QOS1,
+                esp_rmaker_param_report_published, (void *)(uintptr_t)report_seq);
+    }
+#endif /* CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC */
+    return esp_rmaker_mqtt_publish(topic, buf, strlen(buf), RMAKER_MQTT_QOS1, NULL);
+}
+
+#ifdef CONFIG_ESP_RMAKER_MQTT_PUBLISH_QUEUE
+static esp_err_t esp_rmaker_report_param_internal(uint8_t flags);
+
+static void esp_rmaker_report_pending_params(void *priv_data)
+{
+    esp_rmaker_report_param_internal(RMAKER_PARAM_FLAG_VALUE_CHANGE);
+}
+#endif /* CONFIG_ESP_RMAKER_MQTT_PUBLISH_QUEUE */
+
 static esp_err_t esp_rmaker_report_param_internal(uint8_t flags)
 {
-    esp_err_t err = esp_rmaker_allocate_and_populate_params(flags, true);
+#ifdef CONFIG_ESP_RMAKER_MQTT_PUBLISH_QUEUE
+    /* If out of budget, just leave the value change flags set and defer the report. All the changes
+     * till the budget revives then get reported together, with the latest value of each param.
+     */
+    if ((flags == RMAKER_PARAM_FLAG_VALUE_CHANGE) && esp_rmaker_params_mqtt_init_done &&
+            !esp_rmaker_mqtt_is_class_budget_available(ESP_RMAKER_MQTT_MSG_CLASS_PARAM_REPORT)) {
+        return esp_rmaker_mqtt_publish_queue_defer(ESP_RMAKER_MQTT_MSG_CLASS_PARAM_REPORT,
+                esp_rmaker_report_pending_params, NULL);
+    }
+#endif /* CONFIG_ESP_RMAKER_MQTT_PUBLISH_QUEUE */
+    uint16_t report_seq = 0;
+#ifdef CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC
+    /* Alerts are always followed by a regular report of the same params, so only the latter is tracked */
+    if (flags == RMAKER_PARAM_FLAG_VALUE_CHANGE) {
+        report_seq = esp_rmaker_param_get_next_report_seq();
+    }
+#endif /* CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC */
+    ESP_RMAKER_LATENCY_START(populate_start);
+    esp_err_t err = esp_rmaker_allocate_and_populate_params(flags, true, report_seq);
+    ESP_RMAKER_LATENCY_END_IN_SET_PARAMS(ESP_RMAKER_LATENCY_STAGE_JSON_POPULATE, populate_start);
     if (err == ESP_OK) {
         /* Just checking if there are indeed any params to report by comparing with a decent enough
          * length as even the smallest possible data, Eg. '{"d":{"p":0}}' will be > 10 bytes.
@@ -271,7 +557,9 @@ static esp_err_t esp_rmaker_report_param_internal(uint8_t flags)
                 return ESP_FAIL;
             }
             if (esp_rmaker_params_mqtt_init_done) {
-                esp_rmaker_mqtt_publish(publish_topic, node_params_buf, strlen(node_params_buf), RMAKER_MQTT_QOS1, NULL);
+                ESP_RMAKER_LATENCY_START(publish_start);
+                esp_rmaker_param_publish_report(publish_topic, node_params_buf, report_seq);
+                ESP_RMAKER_LATENCY_END_IN_SET_PARAMS(ESP_RMAKER_LATENCY_STAGE_PUBLISH, publish_start);
             } else {
                 ESP_LOGW(TAG, "Not reporting params since params mqtt not initialized yet.");
             }
@@ -282,81 +570,188 @@ static esp_err_t esp_rmaker_report_param_internal(uint8_t flags)
 }
 
 
-static esp_err_t esp_rmaker_device_set_params(_esp_rmaker_device_t *device, jparse_ctx_t *jptr, esp_rmaker_req_src_t src)
+static void esp_rmaker_param_free_val(esp_rmaker_param_val_t *val)
 {
-    _esp_rmaker_param_t *param = device->params;
-    while (param) {
-        esp_rmaker_param_val_t new_val = {0};
-        bool param_found = false;
-        switch(param->val.type) {
-            case RMAKER_VAL_TYPE_BOOLEAN:
-                if (json_obj_get_bool(jptr, param->name, &new_val.val.b) == 0) {
-                    new_val.type = RMAKER_VAL_TYPE_BOOLEAN;
-                    param_found = true;
-                }
-                break;
-            case RMAKER_VAL_TYPE_INTEGER:
-                if (json_obj_get_int(jptr, param->name, &new_val.val.i) == 0) {
-                    new_val.type = RMAKER_VAL_TYPE_INTEGER;
-                    param_found = true;
+    if ((val->type == RMAKER_VAL_TYPE_STRING) || (val->type == RMAKER_VAL_TYPE_OBJECT) ||
+            (val->type == RMAKER_VAL_TYPE_ARRAY)) {
+        if (val->val.s) {
+            free(val->val.s);
+            val->val.s = NULL;
+        }
+    }
+}
+
+/* Reads the value for the given param from the JSON object that jptr is in. If the param
+ * is not present, new_val->type is left as RMAKER_VAL_TYPE_INVALID.
+ */
+static esp_err_t esp_rmaker_param_get_val_from_json(_esp_rmaker_param_t *param, jparse_ctx_t *jptr, esp_rmaker_param_val_t *new_val)
+{
+    memset(new_val, 0, sizeof(esp_rmaker_param_val_t));
+    switch(param->val.type) {
+        case RMAKER_VAL_TYPE_BOOLEAN:
+            if (json_obj_get_bool(jptr, param->name, &new_val->val.b) == 0) {
+                new_val->type = RMAKER_VAL_TYPE_BOOLEAN;
+            }
+            break;
+        case RMAKER_VAL_TYPE_INTEGER:
+            if (json_obj_get_int(jptr, param->name, &new_val->val.i) == 0) {
+                new_val->type = RMAKER_VAL_TYPE_INTEGER;
+            }
+            break;
+        case RMAKER_VAL_TYPE_FLOAT:
+            if (json_obj_get_float(jptr, param->name, &new_val->val.f) == 0) {
+                new_val->type = RMAKER_VAL_TYPE_FLOAT;
+            }
+            break;
+        case RMAKER_VAL_TYPE_STRING: {
+            int val_size = 0;
+            if (param->enum_info && (json_obj_get_strlen(jptr, param->name, &val_size) == 0)) {
+                /* Enumerated params just refer to the string in the list, so no allocation is required */
+                char str[MAX_ENUM_PARAM_STRLEN + 1];
+                int idx = -1;
+                if (val_size <= MAX_ENUM_PARAM_STRLEN) {
+                    json_obj_get_string(jptr, param->name, str, sizeof(str));
+                    idx = esp_rmaker_param_enum_lookup(param, str);
                 }
-                break;
-            case RMAKER_VAL_TYPE_FLOAT:
-                if (json_obj_get_float(jptr, param->name, &new_val.val.f) == 0) {
-                    new_val.type = RMAKER_VAL_TYPE_FLOAT;
-                    param_found = true;
+                if (idx < 0) {
+                    ESP_LOGE(TAG, "Invalid value received for param %s.", param->name);
+                } else {
+                    new_val->val.s = (char *)param->valid_str_list->str_list[idx];
+                    new_val->type = RMAKER_VAL_TYPE_STRING;
                 }
-                break;
-            case RMAKER_VAL_TYPE_STRING: {
-                int val_size = 0;
-                if (json_obj_get_strlen(jptr, param->name, &val_size) == 0) {
-                    val_size++; /* For NULL termination */
-                    new_val.val.s = MEM_CALLOC_EXTRAM(1, val_size);
-                    if (!new_val.val.s) {
-                        return ESP_ERR_NO_MEM;
-                    }
-                    json_obj_get_string(jptr, param->name, new_val.val.s, val_size);
-                    new_val.type = RMAKER_VAL_TYPE_STRING;
-                    param_found = true;
+            } else if (json_obj_get_strlen(jptr, param->name, &val_size) == 0) {
+                val_size++; /* For NULL termination */
+                new_val->val.s = MEM_CALLOC_EXTRAM(1, val_size);
+                if (!new_val->val.s) {
+                    return ESP_ERR_NO_MEM;
                 }
-                break;
+                json_obj_get_string(jptr, param->name, new_val->val.s, val_size);
+                new_val->type = RMAKER_VAL_TYPE_STRING;
             }
-            case RMAKER_VAL_TYPE_OBJECT: {
-                int val_size = 0;
-                if (json_obj_get_object_strlen(jptr, param->name, &val_size) == 0) {
-                    val_size++; /* For NULL termination */
-                    new_val.val.s = MEM_CALLOC_EXTRAM(1, val_size);
-                    if (!new_val.val.s) {
-                        return ESP_ERR_NO_MEM;
-                    }
-                    json_obj_get_object_str(jptr, param->name, new_val.val.s, val_size);
-                    new_val.type = RMAKER_VAL_TYPE_OBJECT;
-                    param_found = true;
+            break;
+        }
+        case RMAKER_VAL_TYPE_OBJECT: {
+            int val_size = 0;
+            if (json_obj_get_object_strlen(jptr, param->name, &val_size) == 0) {
+                val_size++; /* For NULL termination */
+                new_val->val.s = MEM_CALLOC_EXTRAM(1, val_size);
+                if (!new_val->val.s) {
+                    return ESP_ERR_NO_MEM;
                 }
-                break;
+                json_obj_get_object_str(jptr, param->name, new_val->val.s, val_size);
+                new_val->type = RMAKER_VAL_TYPE_OBJECT;
             }
-            case RMAKER_VAL_TYPE_ARRAY: {
-                int val_size = 0;
-                if (json_obj_get_array_strlen(jptr, param->name, &val_size) == 0) {
-                    val_size++; /* For NULL termination */
-                    new_val.val.s = MEM_CALLOC_EXTRAM(1, val_size);
-                    if (!new_val.val.s) {
-                        return ESP_ERR_NO_MEM;
-                    }
-                    json_obj_get_array_str(jptr, param->name, new_val.val.s, val_size);
-                    new_val.type = RMAKER_VAL_TYPE_ARRAY;
-                    param_found = true;
+            break;
+        }
+        case RMAKER_VAL_TYPE_ARRAY: {
+            int val_size = 0;
+            if (json_obj_get_array_strlen(jptr, param->name, &val_size) == 0) {
+                val_size++; /* For NULL termination */
+                new_val->val.s = MEM_CALLOC_EXTRAM(1, val_size);
+                if (!new_val->val.s) {
+                    return ESP_ERR_NO_MEM;
                 }
-                break;
+                json_obj_get_array_str(jptr, param->name, new_val->val.s, val_size);
+                new_val->type = RMAKER_VAL_TYPE_ARRAY;
             }
-            default:
-                break;
+            break;
+        }
+        default:
+            break;
+    }
+    return ESP_OK;
+}
+
+/* Values of enumerated params point to the valid strings list, and are not allocated */
+static void esp_rmaker_param_free_new_val(_esp_rmaker_param_t *param, esp_rmaker_param_val_t *val)
+{
+    if (!param->enum_info) {
+        esp_rmaker_param_free_val(val);
+    }
+}
+
+static bool esp_rmaker_param_is_name_param(_esp_rmaker_param_t *param)
+{
+    return (param->type && (strcmp(param->type, ESP_RMAKER_PARAM_NAME) == 0));
+}
+
+/* Invokes the bulk write callback once, with all the params of the device found in the request */
+static esp_err_t esp_rmaker_device_bulk_set_params(_esp_rmaker_device_t *device, jparse_ctx_t *jptr, esp_rmaker_req_src_t src)
+{
+    size_t param_count = 0;
+    _esp_rmaker_param_t *param = device->params;
+    while (param) {
+        param_count++;
+        param = param->next;
+    }
+    if (param_count == 0) {
+        return ESP_OK;
+    }
+    esp_rmaker_param_write_req_t *write_req = MEM_CALLOC_EXTRAM(param_count, sizeof(esp_rmaker_param_write_req_t));
+    if (!write_req) {
+        ESP_LOGE(TAG, "Failed to allocate memory for write requests of %s.", device->name);
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = ESP_OK;
+    size_t req_count = 0;
+    for (param = device->params; param; param = param->next) {
+        esp_rmaker_param_val_t new_val;
+        if ((err = esp_rmaker_param_get_val_from_json(param, jptr, &new_val)) != ESP_OK) {
+            goto bulk_set_params_done;
+        }
+        if (new_val.type == RMAKER_VAL_TYPE_INVALID) {
+            continue;
+        }
+#ifndef CONFIG_RMAKER_NAME_PARAM_CB
+        /* Special handling for ESP_RMAKER_PARAM_NAME. Just update the name instead
+         * of passing it to the registered callback.
+         */
+        if (esp_rmaker_param_is_name_param(param)) {
+            esp_rmaker_param_update_and_report((esp_rmaker_param_t *)param, new_val);
+            esp_rmaker_param_free_new_val(param, &new_val);
+            continue;
+        }
+#endif
+        write_req[req_count].param = (esp_rmaker_param_t *)param;
+        write_req[req_count].val = new_val;
+        req_count++;
+    }
+    if (req_count) {
+        esp_rmaker_write_ctx_t ctx = {
+            .src = src,
+        };
+        ESP_RMAKER_LATENCY_START(write_cb_start);
+        if (device->bulk_write_cb((esp_rmaker_device_t *)device, write_req, req_count,
+                    device->priv_data, &ctx) != ESP_OK) {
+            ESP_LOGE(TAG, "Remote update to params of %s failed", device->name);
+        }
+        ESP_RMAKER_LATENCY_END(ESP_RMAKER_LATENCY_STAGE_WRITE_CB, write_cb_start);
+    }
+bulk_set_params_done:
+    for (size_t i = 0; i < req_count; i++) {
+        esp_rmaker_param_free_new_val((_esp_rmaker_param_t *)write_req[i].param, &write_req[i].val);
+    }
+    free(write_req);
+    return err;
+}
+
+static esp_err_t esp_rmaker_device_set_params(_esp_rmaker_device_t *device, jparse_ctx_t *jptr, esp_rmaker_req_src_t src)
+{
+    if (device->bulk_write_cb) {
+        return esp_rmaker_device_bulk_set_params(device, jptr, src);
+    }
+    _esp_rmaker_param_t *param = device->params;
+    while (param) {
+        esp_rmaker_param_val_t new_val;
+        esp_err_t err = esp_rmaker_param_get_val_from_json(param, jptr, &new_val);
+        if (err != ESP_OK) {
+            return err;
         }
-        if (param_found) {
+        if (new_val.type != RMAKER_VAL_TYPE_INVALID) {
             /* Special handling for ESP_RMAKER_PARAM_NAME. Just update the name instead
              * of calling the registered callback.
              */
-            if (param->type && (strcmp(param->type, ESP_RMAKER_PARAM_NAME) == 0)) {
+            if (esp_rmaker_param_is_name_param(param)) {
 #ifdef CONFIG_RMAKER_NAME_PARAM_CB
                 if (device->write_cb) {
                     esp_rmaker_write_ctx_t ctx = {
@@ -374,17 +769,14 @@ static esp_err_t esp_rmaker_device_set_params(_esp_rmaker_device_t *device, jpar
                 esp_rmaker_write_ctx_t ctx = {
                     .src = src,
                 };
+                ESP_RMAKER_LATENCY_START(write_cb_start);
                 if (device->write_cb((esp_rmaker_device_t *)device, (esp_rmaker_param_t *)param,
                             new_val, device->priv_data, &ctx) != ESP_OK) {
                     ESP_LOGE(TAG, "Remote update to param %s - %s failed", device->name, param->name);
                 }
+                ESP_RMAKER_LATENCY_END(ESP_RMAKER_LATENCY_STAGE_WRITE_CB, write_cb_start);
             }
-            if ((new_val.type == RMAKER_VAL_TYPE_STRING) || (new_val.type == RMAKER_VAL_TYPE_OBJECT ||
-                        (new_val.type == RMAKER_VAL_TYPE_ARRAY))) {
-                if (new_val.val.s) {
-                    free(new_val.val.s);
-                }
-            }
+            esp_rmaker_param_free_new_val(param, &new_val);
         }
         param = param->next;
     }
@@ -394,10 +786,15 @@ static esp_err_t esp_rmaker_device_set_params(_esp_rmaker_device_t *device, jpar
 esp_err_t esp_rmaker_handle_set_params(char *data, size_t data_len, esp_rmaker_req_src_t src)
 {
     ESP_LOGI(TAG, "Received params: %.*s", data_len, data);
+    ESP_RMAKER_LATENCY_START(total_start);
+    ESP_RMAKER_LATENCY_SET_PARAMS_ENTER();
     jparse_ctx_t jctx;
+    ESP_RMAKER_LATENCY_START(parse_start);
     if (json_parse_start(&jctx, data, data_len) != 0) {
+        ESP_RMAKER_LATENCY_SET_PARAMS_EXIT();
         return ESP_FAIL;
     }
+    ESP_RMAKER_LATENCY_END(ESP_RMAKER_LATENCY_STAGE_PARSE, parse_start);
     _esp_rmaker_device_t *device = esp_rmaker_node_get_first_device(esp_rmaker_get_node());
     while (device) {
         if (json_obj_get_object(&jctx, device->name) == 0) {
@@ -407,58 +804,302 @@ esp_err_t esp_rmaker_handle_set_params(char *data, size_t data_len, esp_rmaker_r
         device = device->next;
     }
     json_parse_end(&jctx);
+    ESP_RMAKER_LATENCY_SET_PARAMS_EXIT();
+    ESP_RMAKER_LATENCY_END(ESP_RMAKER_LATENCY_STAGE_TOTAL, total_start);
     return ESP_OK;
 }
 
-static void esp_rmaker_set_params_callback(const char *topic, void *payload, size_t payload_len, void *priv_data)
-{
-    esp_rmaker_handle_set_params((char *)payload, payload_len, ESP_RMAKER_REQ_SRC_CLOUD);
-}
+/* Params of one device in a compiled action. The name params, if any, are at the start of reqs,
+ * since they are just updated instead of being passed to the write callbacks.
+ */
+typedef struct {
+    _esp_rmaker_device_t *device;
+    esp_rmaker_param_write_req_t *reqs;
+    size_t count;
+    size_t name_count;
+} esp_rmaker_action_prog_group_t;
 
-static esp_err_t esp_rmaker_register_for_set_params(void)
+struct esp_rmaker_action_prog {
+    /* Node devices version the program was compiled against. The device and param handles are
+     * valid only as long as this matches the current version.
+     */
+    uint32_t devices_version;
+    uint32_t refcount;
+    uint16_t group_count;
+    esp_rmaker_action_prog_group_t *groups;
+    /* The action JSON, to be used if the handles are not valid anymore when a queued run executes */
+    char *data;
+    size_t data_len;
+};
+
+static portMUX_TYPE action_prog_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Adds the values of the matching params of the device to the group. Each value is owned by the program,
+ * including those of enumerated params, so that freeing it does not need the param.
+ */
+static esp_err_t esp_rmaker_action_prog_add_params(esp_rmaker_action_prog_group_t *group, jparse_ctx_t *jptr, bool name_params)
 {
-    char subscribe_topic[MQTT_TOPIC_BUFFER_SIZE];
-    snprintf(subscribe_topic, sizeof(subscribe_topic), "node/%s/%s",
-                esp_rmaker_get_node_id(), NODE_PARAMS_REMOTE_TOPIC_SUFFIX);
-    esp_err_t err = esp_rmaker_mqtt_subscribe(subscribe_topic, esp_rmaker_set_params_callback, RMAKER_MQTT_QOS1, NULL);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to subscribe to %s. Error %d", subscribe_topic, err);
-        return ESP_FAIL;
+    for (_esp_rmaker_param_t *param = group->device->params; param; param = param->next) {
+#ifndef CONFIG_RMAKER_NAME_PARAM_CB
+        if (esp_rmaker_param_is_name_param(param) != name_params) {
+            continue;
+        }
+#endif
+        esp_rmaker_param_val_t new_val;
+        esp_err_t err = esp_rmaker_param_get_val_from_json(param, jptr, &new_val);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (new_val.type == RMAKER_VAL_TYPE_INVALID) {
+            continue;
+        }
+        if (param->enum_info && ((new_val.val.s = strdup(new_val.val.s)) == NULL)) {
+            return ESP_ERR_NO_MEM;
+        }
+        group->reqs[group->count].param = (esp_rmaker_param_t *)param;
+        group->reqs[group->count].val = new_val;
+        group->count++;
+        if (name_params) {
+            group->name_count++;
+        }
     }
     return ESP_OK;
 }
 
-esp_err_t esp_rmaker_param_get_stored_value(_esp_rmaker_param_t *param, esp_rmaker_param_val_t *val)
+esp_rmaker_action_prog_t *esp_rmaker_action_prog_compile(const char *data, size_t data_len)
 {
-    if (!param || !param->parent || !val) {
-        return ESP_FAIL;
+    if (!data) {
+        return NULL;
     }
-    nvs_handle handle;
-    esp_err_t err = nvs_open_from_partition(ESP_RMAKER_NVS_PART_NAME, param->parent->name, NVS_READONLY, &handle);
-    if (err != ESP_OK) {
-        return err;
+    jparse_ctx_t jctx;
+    if (json_parse_start(&jctx, data, data_len) != 0) {
+        ESP_LOGE(TAG, "Failed to parse action: %.*s", data_len, data);
+        return NULL;
     }
-    if ((param->val.type == RMAKER_VAL_TYPE_STRING) || (param->val.type == RMAKER_VAL_TYPE_OBJECT) ||
-                (param->val.type == RMAKER_VAL_TYPE_ARRAY)) {
-        size_t len = 0;
-        if ((err = nvs_get_blob(handle, param->name, NULL, &len)) == ESP_OK) {
-            char *s_val = MEM_CALLOC_EXTRAM(1, len + 1);
-            if (!s_val) {
-                err = ESP_ERR_NO_MEM;
-            } else {
-                nvs_get_blob(handle, param->name, s_val, &len);
-                s_val[len] = '\0';
-                val->type = param->val.type;
-                val->val.s = s_val;
+    /* Sizes the program for all the params of the devices in the action, so that a single allocation
+     * is enough. Params not in the action just leave some unused space.
+     */
+    uint16_t group_count = 0;
+    size_t param_count = 0;
+    const esp_rmaker_node_t *node = esp_rmaker_get_node();
+    for (_esp_rmaker_device_t *device = esp_rmaker_node_get_first_device(node); device; device = device->next) {
+        if (json_obj_get_object(&jctx, device->name) == 0) {
+            group_count++;
+            for (_esp_rmaker_param_t *param = device->params; param; param = param->next) {
+                param_count++;
             }
-        } else if ((err = nvs_get_str(handle, param->name, NULL, &len)) == ESP_OK) {
-            /* In order to be compatible with the previous nvs_set_str() */
-            char *s_val = MEM_CALLOC_EXTRAM(1, len);
-            if (!s_val) {
-                err = ESP_ERR_NO_MEM;
-            } else {
-                nvs_get_str(handle, param->name, s_val, &len);
-                val->type = param->val.type;
+            json_obj_leave_object(&jctx);
+        }
+    }
+    size_t reqs_size = param_count * sizeof(esp_rmaker_param_write_req_t);
+    esp_rmaker_action_prog_t *prog = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_PARAMS, 1, sizeof(esp_rmaker_action_prog_t) +
+            (group_count * sizeof(esp_rmaker_action_prog_group_t)) + reqs_size + data_len + 1);
+    if (!prog) {
+        ESP_LOGE(TAG, "Failed to allocate memory for action.");
+        json_parse_end(&jctx);
+        return NULL;
+    }
+    prog->devices_version = esp_rmaker_get_node_devices_version();
+    prog->refcount = 1;
+    prog->groups = (esp_rmaker_action_prog_group_t *)(prog + 1);
+    esp_rmaker_param_write_req_t *reqs = (esp_rmaker_param_write_req_t *)(prog->groups + group_count);
+    prog->data = (char *)reqs + reqs_size;
+    prog->data_len = data_len;
+    memcpy(prog->data, data, data_len);
+    esp_err_t err = ESP_OK;
+    for (_esp_rmaker_device_t *device = esp_rmaker_node_get_first_device(node); device && (err == ESP_OK);
+            device = device->next) {
+        if (json_obj_get_object(&jctx, device->name) != 0) {
+            continue;
+        }
+        esp_rmaker_action_prog_group_t *group = &prog->groups[prog->group_count];
+        group->device = device;
+        group->reqs = reqs;
+        /* Counted before adding the params, so that a failure midway still frees the values added */
+        prog->group_count++;
+#ifndef CONFIG_RMAKER_NAME_PARAM_CB
+        err = esp_rmaker_action_prog_add_params(group, &jctx, true);
+        if (err == ESP_OK) {
+            err = esp_rmaker_action_prog_add_params(group, &jctx, false);
+        }
+#else
+        err = esp_rmaker_action_prog_add_params(group, &jctx, false);
+#endif
+        reqs += group->count;
+        json_obj_leave_object(&jctx);
+    }
+    json_parse_end(&jctx);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to compile action.");
+        esp_rmaker_action_prog_release(prog);
+        return NULL;
+    }
+    return prog;
+}
+
+esp_rmaker_action_prog_t *esp_rmaker_action_prog_retain(esp_rmaker_action_prog_t *prog)
+{
+    portENTER_CRITICAL(&action_prog_lock);
+    prog->refcount++;
+    portEXIT_CRITICAL(&action_prog_lock);
+    return prog;
+}
+
+void esp_rmaker_action_prog_release(esp_rmaker_action_prog_t *prog)
+{
+    if (!prog) {
+        return;
+    }
+    portENTER_CRITICAL(&action_prog_lock);
+    uint32_t refcount = --prog->refcount;
+    portEXIT_CRITICAL(&action_prog_lock);
+    if (refcount) {
+        return;
+    }
+    for (uint16_t i = 0; i < prog->group_count; i++) {
+        for (size_t j = 0; j < prog->groups[i].count; j++) {
+            esp_rmaker_param_free_val(&prog->groups[i].reqs[j].val);
+        }
+    }
+    RMAKER_MEM_FREE(prog);
+}
+
+bool esp_rmaker_action_prog_is_valid(const esp_rmaker_action_prog_t *prog)
+{
+    return prog && (prog->devices_version == esp_rmaker_get_node_devices_version());
+}
+
+/* Same as esp_rmaker_device_set_params(), but with the values already available */
+static void esp_rmaker_action_prog_group_exec(esp_rmaker_action_prog_group_t *group, esp_rmaker_write_ctx_t *ctx)
+{
+    _esp_rmaker_device_t *device = group->device;
+    for (size_t i = 0; i < group->name_count; i++) {
+        esp_rmaker_param_update_and_report(group->reqs[i].param, group->reqs[i].val);
+    }
+    esp_rmaker_param_write_req_t *reqs = group->reqs + group->name_count;
+    size_t count = group->count - group->name_count;
+    if (count == 0) {
+        return;
+    }
+    if (device->bulk_write_cb) {
+        ESP_RMAKER_LATENCY_START(write_cb_start);
+        if (device->bulk_write_cb((esp_rmaker_device_t *)device, reqs, count, device->priv_data, ctx) != ESP_OK) {
+            ESP_LOGE(TAG, "Remote update to params of %s failed", device->name);
+        }
+        ESP_RMAKER_LATENCY_END(ESP_RMAKER_LATENCY_STAGE_WRITE_CB, write_cb_start);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (device->write_cb) {
+            ESP_RMAKER_LATENCY_START(write_cb_start);
+            if (device->write_cb((esp_rmaker_device_t *)device, reqs[i].param, reqs[i].val,
+                        device->priv_data, ctx) != ESP_OK) {
+                ESP_LOGE(TAG, "Remote update to param %s - %s failed", device->name,
+                        ((_esp_rmaker_param_t *)reqs[i].param)->name);
+            }
+            ESP_RMAKER_LATENCY_END(ESP_RMAKER_LATENCY_STAGE_WRITE_CB, write_cb_start);
+        }
+#ifdef CONFIG_RMAKER_NAME_PARAM_CB
+        else if (esp_rmaker_param_is_name_param((_esp_rmaker_param_t *)reqs[i].param)) {
+            esp_rmaker_param_update_and_report(reqs[i].param, reqs[i].val);
+        }
+#endif
+    }
+}
+
+esp_err_t esp_rmaker_action_prog_exec(esp_rmaker_action_prog_t *prog, esp_rmaker_req_src_t src)
+{
+    if (!prog) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!esp_rmaker_action_prog_is_valid(prog)) {
+        /* Devices or params changed after the program was queued, so its handles cannot be used anymore */
+        ESP_LOGI(TAG, "Devices changed. Running %s action from JSON.", esp_rmaker_device_cb_src_to_str(src));
+        return esp_rmaker_handle_set_params(prog->data, prog->data_len, src);
+    }
+    ESP_LOGD(TAG, "Running %s action.", esp_rmaker_device_cb_src_to_str(src));
+    ESP_RMAKER_LATENCY_START(total_start);
+    ESP_RMAKER_LATENCY_SET_PARAMS_ENTER();
+    esp_rmaker_write_ctx_t ctx = {
+        .src = src,
+    };
+    for (uint16_t i = 0; i < prog->group_count; i++) {
+        esp_rmaker_action_prog_group_exec(&prog->groups[i], &ctx);
+    }
+    ESP_RMAKER_LATENCY_SET_PARAMS_EXIT();
+    ESP_RMAKER_LATENCY_END(ESP_RMAKER_LATENCY_STAGE_TOTAL, total_start);
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_action_prog_run(esp_rmaker_action_prog_t **prog, const char *data, size_t data_len,
+        esp_rmaker_req_src_t src)
+{
+    if (!prog || !data) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (*prog && !esp_rmaker_action_prog_is_valid(*prog)) {
+        /* Devices or params were added or removed since the action was compiled */
+        esp_rmaker_action_prog_release(*prog);
+        *prog = NULL;
+    }
+    if (!*prog) {
+        *prog = esp_rmaker_action_prog_compile(data, data_len);
+        if (!*prog) {
+            return esp_rmaker_queue_set_params(data, data_len, src);
+        }
+    }
+    return esp_rmaker_queue_action_prog(*prog, src);
+}
+
+static void esp_rmaker_set_params_callback(const char *topic, void *payload, size_t payload_len, void *priv_data)
+{
+    esp_rmaker_queue_set_params((const char *)payload, payload_len, ESP_RMAKER_REQ_SRC_CLOUD);
+}
+
+static esp_err_t esp_rmaker_register_for_set_params(void)
+{
+    char subscribe_topic[MQTT_TOPIC_BUFFER_SIZE];
+    snprintf(subscribe_topic, sizeof(subscribe_topic), "node/%s/%s",
+                esp_rmaker_get_node_id(), NODE_PARAMS_REMOTE_TOPIC_SUFFIX);
+    esp_err_t err = esp_rmaker_mqtt_subscribe(subscribe_topic, esp_rmaker_set_params_callback, RMAKER_MQTT_QOS1, NULL);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to subscribe to %s. Error %d", subscribe_topic, err);
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_param_get_stored_value(_esp_rmaker_param_t *param, esp_rmaker_param_val_t *val)
+{
+    if (!param || !param->parent || !val) {
+        return ESP_FAIL;
+    }
+    nvs_handle handle;
+    esp_err_t err = nvs_open_from_partition(ESP_RMAKER_NVS_PART_NAME, param->parent->name, NVS_READONLY, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if ((param->val.type == RMAKER_VAL_TYPE_STRING) || (param->val.type == RMAKER_VAL_TYPE_OBJECT) ||
+                (param->val.type == RMAKER_VAL_TYPE_ARRAY)) {
+        size_t len = 0;
+        if ((err = nvs_get_blob(handle, param->name, NULL, &len)) == ESP_OK) {
+            char *s_val = MEM_CALLOC_EXTRAM(1, len + 1);
+            if (!s_val) {
+                err = ESP_ERR_NO_MEM;
+            } else {
+                nvs_get_blob(handle, param->name, s_val, &len);
+                s_val[len] = '\0';
+                val->type = param->val.type;
+                val->val.s = s_val;
+            }
+        } else if ((err = nvs_get_str(handle, param->name, NULL, &len)) == ESP_OK) {
+            /* In order to be compatible with the previous nvs_set_str() */
+            char *s_val = MEM_CALLOC_EXTRAM(1, len);
+            if (!s_val) {
+                err = ESP_ERR_NO_MEM;
+            } else {
+                nvs_get_str(handle, param->name, s_val, &len);
+                val->type = param->val.type;
                 val->val.s = s_val;
             }
         }
@@ -470,30 +1111,36 @@ esp_err_t esp_rmaker_param_get_stored_value(_esp_rmaker_param_t *param, esp_rmak
     return err;
 }
 
+static esp_err_t __esp_rmaker_param_store_value(nvs_handle handle, _esp_rmaker_param_t *param)
+{
+    if ((param->val.type == RMAKER_VAL_TYPE_STRING) || (param->val.type == RMAKER_VAL_TYPE_OBJECT) ||
+                (param->val.type == RMAKER_VAL_TYPE_ARRAY)) {
+        /* Store only if value is not NULL */
+        if (param->val.val.s) {
+            return nvs_set_blob(handle, param->name, param->val.val.s, strlen(param->val.val.s));
+        }
+        return ESP_OK;
+    }
+    return nvs_set_blob(handle, param->name, &param->val, sizeof(esp_rmaker_param_val_t));
+}
+
 esp_err_t esp_rmaker_param_store_value(_esp_rmaker_param_t *param)
 {
     if (!param || !param->parent) {
         return ESP_FAIL;
     }
+    ESP_RMAKER_LATENCY_START(store_start);
     nvs_handle handle;
     esp_err_t err = nvs_open_from_partition(ESP_RMAKER_NVS_PART_NAME, param->parent->name, NVS_READWRITE, &handle);
     if (err != ESP_OK) {
         return err;
     }
-    if ((param->val.type == RMAKER_VAL_TYPE_STRING) || (param->val.type == RMAKER_VAL_TYPE_OBJECT) ||
-                (param->val.type == RMAKER_VAL_TYPE_ARRAY)) {
-        /* Store only if value is not NULL */
-        if (param->val.val.s) {
-            err = nvs_set_blob(handle, param->name, param->val.val.s, strlen(param->val.val.s));
-            nvs_commit(handle);
-        } else {
-            err = ESP_OK;
-        }
-    } else {
-        err = nvs_set_blob(handle, param->name, &param->val, sizeof(esp_rmaker_param_val_t));
+    err = __esp_rmaker_param_store_value(handle, param);
+    if (err == ESP_OK) {
         nvs_commit(handle);
     }
     nvs_close(handle);
+    ESP_RMAKER_LATENCY_END_IN_SET_PARAMS(ESP_RMAKER_LATENCY_STAGE_NVS_STORE, store_start);
     return err;
 }
 
@@ -506,27 +1153,50 @@ esp_rmaker_param_val_t *esp_rmaker_param_get_val(esp_rmaker_param_t *param)
     return &((_esp_rmaker_param_t *)param)->val;
 }
 
+/* Params created from a const descriptor refer to its metadata, which should not be freed */
+#define PARAM_DESC_FIELD(_param, _field)    ((_param)->desc ? (const void *)(_param)->desc->_field : NULL)
+
+static void esp_rmaker_param_free_metadata(void *ptr, const void *desc_ptr)
+{
+    if (ptr && (ptr != desc_ptr)) {
+        esp_rmaker_node_mem_free(ptr);
+    }
+}
+
+static void esp_rmaker_param_ts_aggregate_free(_esp_rmaker_param_t *_param)
+{
+    /* Detached under the lock, so that a flush running in the meantime does not see a freed aggregate */
+    portENTER_CRITICAL(&param_flags_lock);
+    esp_rmaker_param_ts_aggregate_t *agg = _param->ts_aggregate;
+    _param->ts_aggregate = NULL;
+    portEXIT_CRITICAL(&param_flags_lock);
+    if (agg) {
+        esp_timer_stop(agg->flush_timer);
+        esp_timer_delete(agg->flush_timer);
+        free(agg);
+    }
+}
+
 esp_err_t esp_rmaker_param_delete(const esp_rmaker_param_t *param)
 {
     _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
     if (_param) {
-        if (_param->name) {
-            free(_param->name);
-        }
-        if (_param->type) {
-            free(_param->type);
+        esp_rmaker_param_free_metadata(_param->name, PARAM_DESC_FIELD(_param, name));
+        esp_rmaker_param_free_metadata(_param->type, PARAM_DESC_FIELD(_param, type));
+        esp_rmaker_param_free_metadata(_param->ui_type, PARAM_DESC_FIELD(_param, ui_type));
+        esp_rmaker_param_ts_aggregate_free(_param);
+        if (_param->enum_info) {
+            esp_rmaker_node_mem_free(_param->enum_info->sorted_idx);
+            esp_rmaker_node_mem_free(_param->enum_info);
         }
-        if (_param->ui_type) {
-            free(_param->ui_type);
-        }
-        free(_param);
+        esp_rmaker_node_mem_free(_param);
         return ESP_OK;
     }
     return ESP_ERR_INVALID_ARG;
 }
 
-esp_rmaker_param_t *esp_rmaker_param_create(const char *param_name, const char *type,
-        esp_rmaker_param_val_t val, uint8_t properties)
+static esp_rmaker_param_t *__esp_rmaker_param_create(const char *param_name, const char *type,
+        esp_rmaker_param_val_t val, uint8_t properties, const esp_rmaker_param_desc_t *desc)
 {
     if (!param_name) {
         ESP_LOGE(TAG, "Param name is mandatory");
@@ -542,18 +1212,27 @@ esp_rmaker_param_t *esp_rmaker_param_create(const char *param_name, const char *
             return NULL;
         }
     }
-    _esp_rmaker_param_t *param = MEM_CALLOC_EXTRAM(1, sizeof(_esp_rmaker_param_t));
+    _esp_rmaker_param_t *param = esp_rmaker_node_mem_calloc(ESP_RMAKER_NODE_MEM_PARAM, sizeof(_esp_rmaker_param_t));
     if (!param) {
         ESP_LOGE(TAG, "Failed to allocate memory for param %s", param_name);
         return NULL;
     }
-    param->name = strdup(param_name);
+    if (desc) {
+        param->desc = desc;
+        param->name = (char *)desc->name;
+        param->type = (char *)desc->type;
+        param->ui_type = (char *)desc->ui_type;
+        param->bounds = (esp_rmaker_param_bounds_t *)desc->bounds;
+        param->valid_str_list = (esp_rmaker_param_valid_str_list_t *)desc->valid_str_list;
+    } else {
+        param->name = esp_rmaker_node_mem_strdup(ESP_RMAKER_NODE_MEM_PARAM, param_name);
+    }
     if (!param->name) {
         ESP_LOGE(TAG, "Failed to allocate memory for name for param %s.", param_name);
         goto param_create_err;
     }
-    if (type) {
-        param->type = strdup(type);
+    if (type && !desc) {
+        param->type = esp_rmaker_node_mem_strdup(ESP_RMAKER_NODE_MEM_PARAM, type);
         if (!param->type) {
             ESP_LOGE(TAG, "Failed to allocate memory for type for param %s.", param_name);
             goto param_create_err;
@@ -583,6 +1262,33 @@ param_create_err:
     return NULL;
 }
 
+esp_rmaker_param_t *esp_rmaker_param_create(const char *param_name, const char *type,
+        esp_rmaker_param_val_t val, uint8_t properties)
+{
+    return __esp_rmaker_param_create(param_name, type, val, properties, NULL);
+}
+
+esp_rmaker_param_t *esp_rmaker_param_create_from_desc(const esp_rmaker_param_desc_t *desc)
+{
+    if (!desc) {
+        ESP_LOGE(TAG, "Param descriptor cannot be NULL.");
+        return NULL;
+    }
+    if (desc->bounds) {
+        if (((desc->val.type != RMAKER_VAL_TYPE_INTEGER) && (desc->val.type != RMAKER_VAL_TYPE_FLOAT)) ||
+                (desc->bounds->min.type != desc->val.type) || (desc->bounds->max.type != desc->val.type) ||
+                (desc->bounds->step.type != desc->val.type)) {
+            ESP_LOGE(TAG, "Invalid bounds in descriptor for param %s.", desc->name ? desc->name : "");
+            return NULL;
+        }
+    }
+    if (desc->valid_str_list && (desc->val.type != RMAKER_VAL_TYPE_STRING)) {
+        ESP_LOGE(TAG, "Only string params can have valid strings array.");
+        return NULL;
+    }
+    return __esp_rmaker_param_create(desc->name, desc->type, desc->val, desc->properties, desc);
+}
+
 esp_err_t esp_rmaker_param_add_bounds(const esp_rmaker_param_t *param,
     esp_rmaker_param_val_t min, esp_rmaker_param_val_t max, esp_rmaker_param_val_t step)
 {
@@ -599,7 +1305,7 @@ esp_err_t esp_rmaker_param_add_bounds(const esp_rmaker_param_t *param,
         ESP_LOGE(TAG, "Cannot set bounds for %s because of value type mismatch.", _param->name);
         return ESP_ERR_INVALID_ARG;
     }
-    esp_rmaker_param_bounds_t *bounds = MEM_CALLOC_EXTRAM(1, sizeof(esp_rmaker_param_bounds_t));
+    esp_rmaker_param_bounds_t *bounds = esp_rmaker_node_mem_calloc(ESP_RMAKER_NODE_MEM_PARAM, sizeof(esp_rmaker_param_bounds_t));
     if (!bounds) {
         ESP_LOGE(TAG, "Failed to allocate memory for parameter bounds.");
         return ESP_ERR_NO_MEM;
@@ -607,9 +1313,7 @@ esp_err_t esp_rmaker_param_add_bounds(const esp_rmaker_param_t *param,
     bounds->min = min;
     bounds->max = max;
     bounds->step = step;
-    if (_param->bounds) {
-        free(_param->bounds);
-    }
+    esp_rmaker_param_free_metadata(_param->bounds, PARAM_DESC_FIELD(_param, bounds));
     _param->bounds = bounds;
     return ESP_OK;
 }
@@ -625,20 +1329,124 @@ esp_err_t esp_rmaker_param_add_valid_str_list(const esp_rmaker_param_t *param, c
         ESP_LOGE(TAG, "Only string params can have valid strings array.");
         return ESP_ERR_INVALID_ARG;
     }
-    esp_rmaker_param_valid_str_list_t *valid_str_list = MEM_CALLOC_EXTRAM(1, sizeof(esp_rmaker_param_valid_str_list_t));
+    esp_rmaker_param_valid_str_list_t *valid_str_list = esp_rmaker_node_mem_calloc(ESP_RMAKER_NODE_MEM_PARAM, sizeof(esp_rmaker_param_valid_str_list_t));
     if (!valid_str_list) {
         ESP_LOGE(TAG, "Failed to allocate memory for valid strings array.");
         return ESP_ERR_NO_MEM;
     }
     valid_str_list->str_list = strs;
     valid_str_list->str_list_cnt = count;
-    if (_param->valid_str_list) {
-        free(_param->valid_str_list);
-    }
+    esp_rmaker_param_free_metadata(_param->valid_str_list, PARAM_DESC_FIELD(_param, valid_str_list));
     _param->valid_str_list = valid_str_list;
   return ESP_OK;
 }
 
+int esp_rmaker_param_enum_lookup(const _esp_rmaker_param_t *param, const char *str)
+{
+    if (!param->enum_info || !str) {
+        return -1;
+    }
+    const uint8_t *sorted_idx = param->enum_info->sorted_idx;
+    const char **str_list = param->valid_str_list->str_list;
+    int low = 0, high = param->valid_str_list->str_list_cnt - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        int cmp = strcmp(str, str_list[sorted_idx[mid]]);
+        if (cmp == 0) {
+            return sorted_idx[mid];
+        } else if (cmp < 0) {
+            high = mid - 1;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return -1;
+}
+
+esp_err_t esp_rmaker_param_add_enum_str_list(const esp_rmaker_param_t *param, const char *strs[], uint8_t count)
+{
+    if (!param || !strs || !count) {
+        ESP_LOGE(TAG, "Param handle or strings cannot be NULL.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
+    if (_param->val.type != RMAKER_VAL_TYPE_STRING) {
+        ESP_LOGE(TAG, "Only string params can be enumerated.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < count; i++) {
+        if (!strs[i] || (strlen(strs[i]) > MAX_ENUM_PARAM_STRLEN)) {
+            ESP_LOGE(TAG, "Enum strings for param %s should be non NULL and max %d characters.",
+                    _param->name, MAX_ENUM_PARAM_STRLEN);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    esp_rmaker_param_enum_t *enum_info = esp_rmaker_node_mem_calloc(ESP_RMAKER_NODE_MEM_PARAM, sizeof(esp_rmaker_param_enum_t));
+    uint8_t *sorted_idx = esp_rmaker_node_mem_calloc(ESP_RMAKER_NODE_MEM_PARAM, count);
+    if (!enum_info || !sorted_idx) {
+        ESP_LOGE(TAG, "Failed to allocate memory for enum of param %s.", _param->name);
+        esp_rmaker_node_mem_free(enum_info);
+        esp_rmaker_node_mem_free(sorted_idx);
+        return ESP_ERR_NO_MEM;
+    }
+    /* Insertion sort is good enough, since this is done just once, for a small list */
+    for (int i = 0; i < count; i++) {
+        int j = i;
+        while ((j > 0) && (strcmp(strs[sorted_idx[j - 1]], strs[i]) > 0)) {
+            sorted_idx[j] = sorted_idx[j - 1];
+            j--;
+        }
+        if ((j > 0) && (strcmp(strs[sorted_idx[j - 1]], strs[i]) == 0)) {
+            ESP_LOGE(TAG, "Duplicate enum string %s for param %s.", strs[i], _param->name);
+            esp_rmaker_node_mem_free(enum_info);
+            esp_rmaker_node_mem_free(sorted_idx);
+            return ESP_ERR_INVALID_ARG;
+        }
+        sorted_idx[j] = i;
+    }
+    esp_err_t err = esp_rmaker_param_add_valid_str_list(param, strs, count);
+    if (err != ESP_OK) {
+        esp_rmaker_node_mem_free(enum_info);
+        esp_rmaker_node_mem_free(sorted_idx);
+        return err;
+    }
+    enum_info->sorted_idx = sorted_idx;
+    esp_rmaker_param_enum_t *old_enum_info = _param->enum_info;
+    _param->enum_info = enum_info;
+    /* Map the current value into the list. Default to the first string if it is not valid */
+    char *cur_val = _param->val.val.s;
+    if (cur_val) {
+        int idx = esp_rmaker_param_enum_lookup(_param, cur_val);
+        if (idx < 0) {
+            ESP_LOGW(TAG, "Current value %s of param %s not in enum list. Using %s.", cur_val, _param->name, strs[0]);
+            idx = 0;
+        }
+        enum_info->cur_idx = idx;
+        _param->val.val.s = (char *)strs[idx];
+    }
+    if (old_enum_info) {
+        esp_rmaker_node_mem_free(old_enum_info->sorted_idx);
+        esp_rmaker_node_mem_free(old_enum_info);
+    } else if (cur_val) {
+        /* Earlier value was an allocated copy */
+        free(cur_val);
+    }
+    return ESP_OK;
+}
+
+int esp_rmaker_param_get_enum_index(const esp_rmaker_param_t *param)
+{
+    if (!param) {
+        ESP_LOGE(TAG, "Param handle cannot be NULL.");
+        return -1;
+    }
+    _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
+    if (!_param->enum_info || !_param->val.val.s) {
+        return -1;
+    }
+    return _param->enum_info->cur_idx;
+}
+
 esp_err_t esp_rmaker_param_add_array_max_count(const esp_rmaker_param_t *param, int count)
 {
     if (!param) {
@@ -650,15 +1458,13 @@ esp_err_t esp_rmaker_param_add_array_max_count(const esp_rmaker_param_t *param,
         ESP_LOGE(TAG, "Only array params can have max count.");
         return ESP_ERR_INVALID_ARG;
     }
-    esp_rmaker_param_bounds_t *bounds = MEM_CALLOC_EXTRAM(1, sizeof(esp_rmaker_param_bounds_t));
+    esp_rmaker_param_bounds_t *bounds = esp_rmaker_node_mem_calloc(ESP_RMAKER_NODE_MEM_PARAM, sizeof(esp_rmaker_param_bounds_t));
     if (!bounds) {
         ESP_LOGE(TAG, "Failed to allocate memory for parameter bounds.");
         return ESP_ERR_NO_MEM;
     }
     bounds->max = esp_rmaker_int(count);
-    if (_param->bounds) {
-        free(_param->bounds);
-    }
+    esp_rmaker_param_free_metadata(_param->bounds, PARAM_DESC_FIELD(_param, bounds));
     _param->bounds = bounds;
     return ESP_OK;
 }
@@ -670,53 +1476,198 @@ esp_err_t esp_rmaker_param_add_ui_type(const esp_rmaker_param_t *param, const ch
         return ESP_ERR_INVALID_ARG;
     }
     _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
-    if (_param->ui_type) {
-        free(_param->ui_type);
-    }
-    if ((_param->ui_type = strdup(ui_type)) != NULL ) {
+    esp_rmaker_param_free_metadata(_param->ui_type, PARAM_DESC_FIELD(_param, ui_type));
+    if ((_param->ui_type = esp_rmaker_node_mem_strdup(ESP_RMAKER_NODE_MEM_PARAM, ui_type)) != NULL ) {
         return ESP_OK;
     } else {
         return ESP_ERR_NO_MEM;
     }
 }
 
-esp_err_t esp_rmaker_param_update(const esp_rmaker_param_t *param, esp_rmaker_param_val_t val)
+static esp_err_t esp_rmaker_param_report_simple_ts_aggregate(_esp_rmaker_param_t *_param,
+        const esp_rmaker_ts_window_t *window);
+
+/* Publishes the summary of the current window if it has elapsed, or right away if force is set */
+static esp_err_t esp_rmaker_param_flush_simple_ts_aggregate(_esp_rmaker_param_t *_param, bool force)
+{
+    esp_rmaker_ts_window_t done;
+    bool window_done = false;
+    time_t current_timestamp = 0;
+    time(&current_timestamp);
+    portENTER_CRITICAL(&param_flags_lock);
+    esp_rmaker_param_ts_aggregate_t *agg = _param->ts_aggregate;
+    if (agg) {
+        window_done = esp_rmaker_ts_window_take(&agg->window, agg->window_secs, current_timestamp, force, &done);
+    }
+    portEXIT_CRITICAL(&param_flags_lock);
+    if (!window_done || !_param->parent) {
+        return ESP_OK;
+    }
+    return esp_rmaker_param_report_simple_ts_aggregate(_param, &done);
+}
+
+static void esp_rmaker_param_ts_flush_work(void *priv_data)
+{
+    esp_rmaker_param_flush_simple_ts_aggregate((_esp_rmaker_param_t *)priv_data, false);
+}
+
+static void esp_rmaker_param_ts_flush_timer_cb(void *priv_data)
+{
+    /* Publishing is done from the work queue, rather than the esp_timer task */
+    if (esp_rmaker_work_queue_add_prio_task(esp_rmaker_param_ts_flush_work, priv_data,
+                ESP_RMAKER_WORK_CLASS_BACKGROUND, 0) != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to queue flush of aggregated time series data.");
+    }
+}
+
+esp_err_t esp_rmaker_param_set_simple_ts_aggregation(const esp_rmaker_param_t *param, uint32_t window_secs)
 {
     if (!param) {
         ESP_LOGE(TAG, "Param handle cannot be NULL.");
         return ESP_ERR_INVALID_ARG;
     }
     _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
-    if (_param->val.type != val.type) {
+    if (!(_param->prop_flags & PROP_FLAG_SIMPLE_TIME_SERIES)) {
+        ESP_LOGE(TAG, "Aggregation is supported only for params with PROP_FLAG_SIMPLE_TIME_SERIES.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((_param->val.type != RMAKER_VAL_TYPE_INTEGER) && (_param->val.type != RMAKER_VAL_TYPE_FLOAT)) {
+        ESP_LOGE(TAG, "Only integer and float params can be aggregated.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* Publish the samples of the current, partial window, so that they are not lost */
+    esp_err_t err = esp_rmaker_param_flush_simple_ts_aggregate(_param, true);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to report partial aggregation window of %s.", _param->name);
+    }
+    if (window_secs == 0) {
+        esp_rmaker_param_ts_aggregate_free(_param);
+        return err;
+    }
+    if (!_param->ts_aggregate) {
+        esp_rmaker_param_ts_aggregate_t *agg = MEM_CALLOC_EXTRAM(1, sizeof(esp_rmaker_param_ts_aggregate_t));
+        if (!agg) {
+            ESP_LOGE(TAG, "Failed to allocate memory for time series aggregation.");
+            return ESP_ERR_NO_MEM;
+        }
+        esp_timer_create_args_t timer_args = {
+            .callback = esp_rmaker_param_ts_flush_timer_cb,
+            .arg = _param,
+            .name = "ts_aggregate",
+        };
+        if (esp_timer_create(&timer_args, &agg->flush_timer) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create time series aggregation timer.");
+            free(agg);
+            return ESP_ERR_NO_MEM;
+        }
+        agg->window_secs = window_secs;
+        portENTER_CRITICAL(&param_flags_lock);
+        _param->ts_aggregate = agg;
+        portEXIT_CRITICAL(&param_flags_lock);
+    } else {
+        _param->ts_aggregate->window_secs = window_secs;
+    }
+    return err;
+}
+
+/* Checks if the value can be applied to the param, without changing anything. For params with
+ * valid strings, the index of the value in the list is returned in enum_idx.
+ */
+static esp_err_t esp_rmaker_param_check_val(_esp_rmaker_param_t *_param, const esp_rmaker_param_val_t *val, int *enum_idx)
+{
+    if (_param->val.type != val->type) {
         ESP_LOGE(TAG, "New param value type not same as the existing one.");
         return ESP_ERR_INVALID_ARG;
     }
+    *enum_idx = -1;
     switch (_param->val.type) {
         case RMAKER_VAL_TYPE_STRING:
         case RMAKER_VAL_TYPE_OBJECT:
-        case RMAKER_VAL_TYPE_ARRAY: {
-            char *new_val = NULL;
-            if (val.val.s) {
-                new_val = strdup(val.val.s);
-                if (!new_val) {
-                    return ESP_FAIL;
+        case RMAKER_VAL_TYPE_ARRAY:
+            if (_param->enum_info) {
+                *enum_idx = val->val.s ? esp_rmaker_param_enum_lookup(_param, val->val.s) : -1;
+                if (*enum_idx < 0) {
+                    ESP_LOGE(TAG, "Invalid value for param %s.", _param->name);
+                    return ESP_ERR_INVALID_ARG;
                 }
             }
-            if (_param->val.val.s) {
-                free(_param->val.val.s);
-            }
-            _param->val.val.s = new_val;
-            break;
-        }
+            return ESP_OK;
         case RMAKER_VAL_TYPE_BOOLEAN:
         case RMAKER_VAL_TYPE_INTEGER:
         case RMAKER_VAL_TYPE_FLOAT:
-            _param->val.val = val.val;
-            break;
+            return ESP_OK;
         default:
             return ESP_ERR_INVALID_ARG;
     }
+}
+
+/* Applies a value already checked by esp_rmaker_param_check_val(). This cannot fail. For strings,
+ * objects and arrays, the param takes over val->val.s, which should be an allocated copy, and it
+ * is set to NULL.
+ */
+static void esp_rmaker_param_apply_val(_esp_rmaker_param_t *_param, esp_rmaker_param_val_t *val, int enum_idx)
+{
+    switch (_param->val.type) {
+        case RMAKER_VAL_TYPE_STRING:
+        case RMAKER_VAL_TYPE_OBJECT:
+        case RMAKER_VAL_TYPE_ARRAY:
+            if (_param->enum_info) {
+                _param->enum_info->cur_idx = enum_idx;
+                _param->val.val.s = (char *)_param->valid_str_list->str_list[enum_idx];
+                break;
+            }
+            if (_param->val.val.s) {
+                free(_param->val.val.s);
+            }
+            _param->val.val.s = val->val.s;
+            val->val.s = NULL;
+            break;
+        default:
+            _param->val.val = val->val;
+            break;
+    }
+    portENTER_CRITICAL(&param_flags_lock);
+    _param->change_seq = esp_rmaker_node_params_version_bump(false);
     _param->flags |= RMAKER_PARAM_FLAG_VALUE_CHANGE;
+#ifdef CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC
+    _param->flags |= RMAKER_PARAM_FLAG_VALUE_UNACKED;
+    _param->report_seq = 0;
+#endif /* CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC */
+    portEXIT_CRITICAL(&param_flags_lock);
+    esp_rmaker_node_params_notify_changed();
+}
+
+static esp_err_t __esp_rmaker_param_update(_esp_rmaker_param_t *_param, esp_rmaker_param_val_t val)
+{
+    int enum_idx;
+    esp_err_t err = esp_rmaker_param_check_val(_param, &val, &enum_idx);
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (((val.type == RMAKER_VAL_TYPE_STRING) || (val.type == RMAKER_VAL_TYPE_OBJECT) ||
+            (val.type == RMAKER_VAL_TYPE_ARRAY)) && !_param->enum_info && val.val.s) {
+        val.val.s = strdup(val.val.s);
+        if (!val.val.s) {
+            return ESP_FAIL;
+        }
+    }
+    esp_rmaker_param_apply_val(_param, &val, enum_idx);
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_param_update(const esp_rmaker_param_t *param, esp_rmaker_param_val_t val)
+{
+    if (!param) {
+        ESP_LOGE(TAG, "Param handle cannot be NULL.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
+    ESP_RMAKER_LATENCY_START(update_start);
+    esp_err_t err = __esp_rmaker_param_update(_param, val);
+    ESP_RMAKER_LATENCY_END_IN_SET_PARAMS(ESP_RMAKER_LATENCY_STAGE_PARAM_UPDATE, update_start);
+    if (err != ESP_OK) {
+        return err;
+    }
     if (_param->prop_flags & PROP_FLAG_PERSIST) {
         esp_rmaker_param_store_value(_param);
     }
@@ -808,6 +1759,76 @@ static esp_err_t esp_rmaker_param_report_time_series(const esp_rmaker_param_t *p
     return ESP_OK;
 }
 
+static esp_err_t esp_rmaker_param_report_simple_ts_aggregate(_esp_rmaker_param_t *_param,
+        const esp_rmaker_ts_window_t *window)
+{
+    _esp_rmaker_device_t *_device = _param->parent;
+    /* node_params_buf will be NULL during the first publish */
+    char * node_params_buf = esp_rmaker_param_get_buf(max_node_params_size);
+    if (!node_params_buf) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    json_gen_str_t jstr;
+    int buf_len = max_node_params_size;
+    json_gen_str_start(&jstr, node_params_buf, buf_len, NULL, NULL);
+    json_gen_start_object(&jstr);
+    char param_name[MAX_TS_DATA_PARAM_NAME];
+    snprintf(param_name, sizeof(param_name), "%s.%s", _device->name, _param->name);
+    json_gen_obj_set_string(&jstr, "name", param_name);
+    /* The mean of integer samples need not be an integer, so report all aggregates as float */
+    esp_rmaker_report_data_type(RMAKER_VAL_TYPE_FLOAT, "dt", &jstr);
+    json_gen_obj_set_int(&jstr, "t", (int)window->start);
+    json_gen_obj_set_float(&jstr, "v", (float)(window->sum / window->count));
+    json_gen_obj_set_float(&jstr, "min", window->min);
+    json_gen_obj_set_float(&jstr, "max", window->max);
+    json_gen_obj_set_int(&jstr, "count", window->count);
+    json_gen_end_object(&jstr);
+    json_gen_str_end(&jstr);
+
+    esp_rmaker_create_mqtt_topic(publish_topic, sizeof(publish_topic), SIMPLE_TS_DATA_TOPIC_SUFFIX, SIMPLE_TS_DATA_TOPIC_RULE);
+    if (esp_rmaker_params_mqtt_init_done) {
+        ESP_LOGI(TAG, "Reporting Aggregated Simple Time Series Data for %s.%s", _device->name, _param->name);
+        return esp_rmaker_mqtt_publish(publish_topic, node_params_buf, strlen(node_params_buf), RMAKER_MQTT_QOS1, NULL);
+    }
+    return ESP_OK;
+}
+
+/* Adds the current value of the param to its aggregation window and publishes the summary
+ * once the window has elapsed. This is O(1) and does not allocate any memory. The flush timer
+ * publishes the summary if no sample comes in after the window has elapsed.
+ */
+static esp_err_t esp_rmaker_param_aggregate_simple_time_series(_esp_rmaker_param_t *_param)
+{
+    time_t current_timestamp = 0;
+    time(&current_timestamp);
+    float val = (_param->val.type == RMAKER_VAL_TYPE_INTEGER) ? (float)_param->val.val.i : _param->val.val.f;
+    esp_rmaker_ts_window_t done;
+    bool window_done = false, window_started = false;
+    esp_timer_handle_t flush_timer = NULL;
+    uint32_t window_secs = 0;
+    portENTER_CRITICAL(&param_flags_lock);
+    esp_rmaker_param_ts_aggregate_t *agg = _param->ts_aggregate;
+    if (agg) {
+        window_done = esp_rmaker_ts_window_add(&agg->window, agg->window_secs, val, current_timestamp, &done);
+        window_started = (agg->window.count == 1);
+        flush_timer = agg->flush_timer;
+        window_secs = agg->window_secs;
+    }
+    portEXIT_CRITICAL(&param_flags_lock);
+    if (window_started) {
+        /* Stopped first, in case it is still running for the previous window. The extra second covers
+         * the timestamps having a resolution of a second.
+         */
+        esp_timer_stop(flush_timer);
+        esp_timer_start_once(flush_timer, ((uint64_t)window_secs + 1) * 1000000);
+    }
+    if (window_done) {
+        return esp_rmaker_param_report_simple_ts_aggregate(_param, &done);
+    }
+    return ESP_OK;
+}
+
 static esp_err_t esp_rmaker_param_report_simple_time_series(const esp_rmaker_param_t *param)
 {
     if (!param) {
@@ -824,6 +1845,9 @@ static esp_err_t esp_rmaker_param_report_simple_time_series(const esp_rmaker_par
         ESP_LOGE(TAG, "Current time not yet available. Cannot report time series data.");
         return ESP_ERR_INVALID_STATE;
     }
+    if (_param->ts_aggregate) {
+        return esp_rmaker_param_aggregate_simple_time_series(_param);
+    }
     /* node_params_buf will be NULL during the first publish */
     char * node_params_buf = esp_rmaker_param_get_buf(max_node_params_size);
     if (!node_params_buf) {
@@ -861,7 +1885,9 @@ esp_err_t esp_rmaker_param_notify(const esp_rmaker_param_t *param)
         ESP_LOGE(TAG, "Param handle cannot be NULL.");
         return ESP_ERR_INVALID_ARG;
     }
+    portENTER_CRITICAL(&param_flags_lock);
     ((_esp_rmaker_param_t *)param)->flags |= (RMAKER_PARAM_FLAG_VALUE_CHANGE | RMAKER_PARAM_FLAG_VALUE_NOTIFY);
+    portEXIT_CRITICAL(&param_flags_lock);
     esp_err_t err = esp_rmaker_report_param_internal(RMAKER_PARAM_FLAG_VALUE_NOTIFY);
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "Failed to report parameter");
@@ -884,6 +1910,88 @@ esp_err_t esp_rmaker_param_update_and_report(const esp_rmaker_param_t *param, es
     return err;
 }
 
+static size_t __esp_rmaker_param_populate_delta(_esp_rmaker_param_t *param, esp_rmaker_param_val_t *delta,
+        char *buf, size_t buf_size)
+{
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, buf, buf_size, NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_push_object(&jstr, param->parent->name);
+    esp_rmaker_report_value(delta, param->name, &jstr);
+    json_gen_pop_object(&jstr);
+    json_gen_end_object(&jstr);
+    return json_gen_str_end(&jstr);
+}
+
+/* Reports only the given delta for the param, in place of its full value. Used for large params which
+ * are made up of entries, like schedules and scenes, when just a few of the entries change.
+ */
+static esp_err_t esp_rmaker_param_report_delta(_esp_rmaker_param_t *param, esp_rmaker_param_val_t *delta)
+{
+    size_t buf_size = __esp_rmaker_param_populate_delta(param, delta, NULL, 0);
+    char *buf = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_PARAMS, 1, buf_size);
+    if (!buf) {
+        ESP_LOGE(TAG, "Failed to allocate %d bytes for delta report of %s.", buf_size, param->name);
+        return ESP_ERR_NO_MEM;
+    }
+    __esp_rmaker_param_populate_delta(param, delta, buf, buf_size);
+    uint16_t report_seq = 0;
+#ifdef CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC
+    report_seq = esp_rmaker_param_get_next_report_seq();
+#endif /* CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC */
+    portENTER_CRITICAL(&param_flags_lock);
+    if (report_seq) {
+        param->report_seq = report_seq;
+    }
+    /* The delta covers the value change, so the param need not be included in the next regular report */
+    param->flags &= ~RMAKER_PARAM_FLAG_VALUE_CHANGE;
+    portEXIT_CRITICAL(&param_flags_lock);
+    esp_rmaker_create_mqtt_topic(publish_topic, sizeof(publish_topic), NODE_PARAMS_LOCAL_TOPIC_SUFFIX, NODE_PARAMS_LOCAL_TOPIC_RULE);
+    ESP_LOGI(TAG, "Reporting params: %s", buf);
+    esp_err_t err = esp_rmaker_param_publish_report(publish_topic, buf, report_seq);
+    RMAKER_MEM_FREE(buf);
+    if (err != ESP_OK) {
+        /* The value change is still to be reported, by the full report which the caller falls back to.
+         * The flag is cleared before publishing, rather than after a successful one, so that a change
+         * made while publishing is not lost.
+         */
+        portENTER_CRITICAL(&param_flags_lock);
+        param->flags |= RMAKER_PARAM_FLAG_VALUE_CHANGE;
+        portEXIT_CRITICAL(&param_flags_lock);
+    }
+    return err;
+}
+
+esp_err_t esp_rmaker_param_update_and_report_delta(const esp_rmaker_param_t *param, esp_rmaker_param_val_t val,
+        const char *delta)
+{
+    esp_err_t err = esp_rmaker_param_update(param, val);
+    if ((err != ESP_OK) || (esp_rmaker_get_state() != ESP_RMAKER_STATE_STARTED)) {
+        return err;
+    }
+    _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
+    /* The full value is reported if the delta cannot be published right away, since any deferred report
+     * would have the latest full value anyways.
+     */
+    if (!delta || !esp_rmaker_params_mqtt_init_done ||
+            (_param->prop_flags & (PROP_FLAG_TIME_SERIES | PROP_FLAG_SIMPLE_TIME_SERIES))) {
+        return esp_rmaker_param_report(param);
+    }
+#ifdef CONFIG_ESP_RMAKER_MQTT_PUBLISH_QUEUE
+    if (!esp_rmaker_mqtt_is_class_budget_available(ESP_RMAKER_MQTT_MSG_CLASS_PARAM_REPORT)) {
+        return esp_rmaker_param_report(param);
+    }
+#endif /* CONFIG_ESP_RMAKER_MQTT_PUBLISH_QUEUE */
+    esp_rmaker_param_val_t delta_val = {
+        .type = val.type,
+        .val.s = (char *)delta,
+    };
+    if (esp_rmaker_param_report_delta(_param, &delta_val) != ESP_OK) {
+        return esp_rmaker_param_report(param);
+    }
+    return ESP_OK;
+}
+
 esp_err_t esp_rmaker_param_update_and_notify(const esp_rmaker_param_t *param, esp_rmaker_param_val_t val)
 {
     esp_err_t err = esp_rmaker_param_update(param, val);
@@ -899,6 +2007,174 @@ esp_err_t esp_rmaker_param_update_and_notify(const esp_rmaker_param_t *param, es
     return err;
 }
 
+typedef struct esp_rmaker_param_txn_entry {
+    _esp_rmaker_param_t *param;
+    /* Allocated copy of the value, so that applying it on commit cannot fail */
+    esp_rmaker_param_val_t val;
+    /* Index of the value, for params with valid strings. Set on commit. */
+    int enum_idx;
+    bool stored;
+    struct esp_rmaker_param_txn_entry *next;
+} esp_rmaker_param_txn_entry_t;
+
+typedef struct {
+    esp_rmaker_param_txn_entry_t *entries;
+} _esp_rmaker_param_txn_t;
+
+static void esp_rmaker_param_txn_free(_esp_rmaker_param_txn_t *txn)
+{
+    esp_rmaker_param_txn_entry_t *entry = txn->entries;
+    while (entry) {
+        esp_rmaker_param_txn_entry_t *next = entry->next;
+        esp_rmaker_param_free_val(&entry->val);
+        free(entry);
+        entry = next;
+    }
+    free(txn);
+}
+
+esp_rmaker_param_txn_t *esp_rmaker_param_txn_begin(void)
+{
+    _esp_rmaker_param_txn_t *txn = MEM_CALLOC_EXTRAM(1, sizeof(_esp_rmaker_param_txn_t));
+    if (!txn) {
+        ESP_LOGE(TAG, "Failed to allocate memory for param transaction.");
+        return NULL;
+    }
+    return (esp_rmaker_param_txn_t *)txn;
+}
+
+esp_err_t esp_rmaker_param_txn_stage(esp_rmaker_param_txn_t *txn, const esp_rmaker_param_t *param, esp_rmaker_param_val_t val)
+{
+    if (!txn || !param) {
+        ESP_LOGE(TAG, "Transaction or Param handle cannot be NULL.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    _esp_rmaker_param_txn_t *_txn = (_esp_rmaker_param_txn_t *)txn;
+    _esp_rmaker_param_t *_param = (_esp_rmaker_param_t *)param;
+    if (_param->val.type != val.type) {
+        ESP_LOGE(TAG, "New param value type not same as the existing one.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_rmaker_param_val_t new_val = val;
+    if ((val.type == RMAKER_VAL_TYPE_STRING) || (val.type == RMAKER_VAL_TYPE_OBJECT) ||
+            (val.type == RMAKER_VAL_TYPE_ARRAY)) {
+        if (val.val.s) {
+            new_val.val.s = strdup(val.val.s);
+            if (!new_val.val.s) {
+                return ESP_ERR_NO_MEM;
+            }
+        }
+    }
+    esp_rmaker_param_txn_entry_t *entry = _txn->entries;
+    esp_rmaker_param_txn_entry_t *prev = NULL;
+    while (entry) {
+        if (entry->param == _param) {
+            esp_rmaker_param_free_val(&entry->val);
+            entry->val = new_val;
+            return ESP_OK;
+        }
+        prev = entry;
+        entry = entry->next;
+    }
+    entry = MEM_CALLOC_EXTRAM(1, sizeof(esp_rmaker_param_txn_entry_t));
+    if (!entry) {
+        ESP_LOGE(TAG, "Failed to allocate memory for staging param %s.", _param->name);
+        esp_rmaker_param_free_val(&new_val);
+        return ESP_ERR_NO_MEM;
+    }
+    entry->param = _param;
+    entry->val = new_val;
+    /* Append, so that the params get applied in the same order as they were staged */
+    if (prev) {
+        prev->next = entry;
+    } else {
+        _txn->entries = entry;
+    }
+    return ESP_OK;
+}
+
+/* Store all the persistent params of a transaction, using a single NVS session per device */
+static esp_err_t esp_rmaker_param_txn_store(_esp_rmaker_param_txn_t *txn)
+{
+    esp_err_t ret = ESP_OK;
+    esp_rmaker_param_txn_entry_t *entry = txn->entries;
+    for (; entry; entry = entry->next) {
+        if (entry->stored || !(entry->param->prop_flags & PROP_FLAG_PERSIST) || !entry->param->parent) {
+            continue;
+        }
+        _esp_rmaker_device_t *device = entry->param->parent;
+        nvs_handle handle;
+        esp_err_t err = nvs_open_from_partition(ESP_RMAKER_NVS_PART_NAME, device->name, NVS_READWRITE, &handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to open NVS namespace %s.", device->name);
+            ret = err;
+            continue;
+        }
+        esp_rmaker_param_txn_entry_t *cur = entry;
+        for (; cur; cur = cur->next) {
+            if (!cur->stored && (cur->param->parent == device) && (cur->param->prop_flags & PROP_FLAG_PERSIST)) {
+                if ((err = __esp_rmaker_param_store_value(handle, cur->param)) != ESP_OK) {
+                    ESP_LOGE(TAG, "Failed to store param %s.%s", device->name, cur->param->name);
+                    ret = err;
+                }
+                cur->stored = true;
+            }
+        }
+        nvs_commit(handle);
+        nvs_close(handle);
+    }
+    return ret;
+}
+
+esp_err_t esp_rmaker_param_txn_commit(esp_rmaker_param_txn_t *txn)
+{
+    if (!txn) {
+        ESP_LOGE(TAG, "Transaction handle cannot be NULL.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    _esp_rmaker_param_txn_t *_txn = (_esp_rmaker_param_txn_t *)txn;
+    esp_err_t err = ESP_OK;
+    esp_rmaker_param_txn_entry_t *entry = _txn->entries;
+    /* Check all the values first, so that either all of them get applied, or none */
+    for (; entry; entry = entry->next) {
+        if ((err = esp_rmaker_param_check_val(entry->param, &entry->val, &entry->enum_idx)) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to update param %s.", entry->param->name);
+            goto txn_commit_done;
+        }
+    }
+    for (entry = _txn->entries; entry; entry = entry->next) {
+        esp_rmaker_param_apply_val(entry->param, &entry->val, entry->enum_idx);
+    }
+    err = esp_rmaker_param_txn_store(_txn);
+    /** Report parameters only if the RainMaker has started */
+    if (_txn->entries && (esp_rmaker_get_state() == ESP_RMAKER_STATE_STARTED)) {
+        for (entry = _txn->entries; entry; entry = entry->next) {
+            if (entry->param->prop_flags & PROP_FLAG_TIME_SERIES) {
+                esp_rmaker_param_report_time_series((esp_rmaker_param_t *)entry->param);
+            } else if (entry->param->prop_flags & PROP_FLAG_SIMPLE_TIME_SERIES) {
+                esp_rmaker_param_report_simple_time_series((esp_rmaker_param_t *)entry->param);
+            }
+        }
+        esp_err_t report_err = esp_rmaker_report_param_internal(RMAKER_PARAM_FLAG_VALUE_CHANGE);
+        if (err == ESP_OK) {
+            err = report_err;
+        }
+    }
+txn_commit_done:
+    esp_rmaker_param_txn_free(_txn);
+    return err;
+}
+
+esp_err_t esp_rmaker_param_txn_abort(esp_rmaker_param_txn_t *txn)
+{
+    if (!txn) {
+        ESP_LOGE(TAG, "Transaction handle cannot be NULL.");
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_rmaker_param_txn_free((_esp_rmaker_param_txn_t *)txn);
+    return ESP_OK;
+}
+
 static esp_err_t esp_rmaker_report_all_ts_params(void)
 {
     _esp_rmaker_device_t *device = esp_rmaker_node_get_first_device(esp_rmaker_get_node());
@@ -920,7 +2196,11 @@ static esp_err_t esp_rmaker_report_all_ts_params(void)
 
 esp_err_t esp_rmaker_report_node_state(void)
 {
-    esp_err_t err = esp_rmaker_allocate_and_populate_params(0, false);
+    uint16_t report_seq = 0;
+#ifdef CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC
+    report_seq = esp_rmaker_param_get_next_report_seq();
+#endif /* CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC */
+    esp_err_t err = esp_rmaker_allocate_and_populate_params(0, false, report_seq);
     if (err == ESP_OK) {
         /* Just checking if there are indeed any params to report by comparing with a decent enough
          * length as even the smallest possible data, Eg. '{"d":{"p":0}}' will be > 10 bytes.
@@ -930,7 +2210,7 @@ esp_err_t esp_rmaker_report_node_state(void)
             esp_rmaker_create_mqtt_topic(publish_topic, sizeof(publish_topic), NODE_PARAMS_LOCAL_INIT_TOPIC_SUFFIX, NODE_PARAMS_LOCAL_INIT_RULE);
             ESP_LOGI(TAG, "Reporting params (init): %s", node_params_buf);
             if (esp_rmaker_params_mqtt_init_done) {
-                esp_rmaker_mqtt_publish(publish_topic, node_params_buf, strlen(node_params_buf), RMAKER_MQTT_QOS1, NULL);
+                esp_rmaker_param_publish_report(publish_topic, node_params_buf, report_seq);
             } else {
                 ESP_LOGW(TAG, "Not reporting params since params mqtt not initialized yet.");
             }
@@ -941,6 +2221,31 @@ esp_err_t esp_rmaker_report_node_state(void)
     return err;
 }
 
+#ifdef CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC
+/* Reports only the params whose current value has not been acknowledged yet. The unacknowledged flags are
+ * not reset here, but only when the ack for this report is received.
+ */
+static esp_err_t esp_rmaker_report_unacked_params(void)
+{
+    if (!esp_rmaker_params_mqtt_init_done) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    uint16_t report_seq = esp_rmaker_param_get_next_report_seq();
+    esp_err_t err = esp_rmaker_allocate_and_populate_params(RMAKER_PARAM_FLAG_VALUE_UNACKED, false, report_seq);
+    if (err != ESP_OK) {
+        return err;
+    }
+    char *node_params_buf = esp_rmaker_param_get_buf(0);
+    if (strlen(node_params_buf) > 10) {
+        esp_rmaker_create_mqtt_topic(publish_topic, sizeof(publish_topic), NODE_PARAMS_LOCAL_TOPIC_SUFFIX, NODE_PARAMS_LOCAL_TOPIC_RULE);
+        ESP_LOGI(TAG, "Reporting params (resync): %s", node_params_buf);
+        return esp_rmaker_param_publish_report(publish_topic, node_params_buf, report_seq);
+    }
+    ESP_LOGI(TAG, "No params changed since the last acknowledged report.");
+    return ESP_OK;
+}
+#endif /* CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC */
+
 esp_err_t esp_rmaker_params_mqtt_init(void)
 {
     /* Subscribe for parameter update requests */
@@ -948,6 +2253,9 @@ esp_err_t esp_rmaker_params_mqtt_init(void)
     if (err == ESP_OK) {
         ESP_LOGI(TAG, "Params MQTT Init done.");
         esp_rmaker_params_mqtt_init_done = true;
+#ifdef CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC
+        esp_rmaker_param_register_for_acks();
+#endif /* CONFIG_ESP_RMAKER_PARAM_DELTA_RESYNC */
         /* Report the current node state i.e. values of all the node parameters */
         esp_rmaker_report_node_state();
     }
@@ -19,6 +19,7 @@
 #include <json_generator.h>
 
 #include <esp_rmaker_internal.h>
+#include <esp_rmaker_mem_tag.h>
 #include <esp_rmaker_standard_services.h>
 #include <esp_rmaker_standard_types.h>
 #include <esp_rmaker_scenes.h>
@@ -35,6 +36,8 @@ static const char *TAG = "esp_rmaker_scenes";
 typedef struct esp_rmaker_scene_action {
     void *data;
     size_t data_len;
+    /* Compiled from data, so that running the action does not need parsing it again */
+    esp_rmaker_action_prog_t *prog;
 } esp_rmaker_scene_action_t;
 
 typedef struct esp_rmaker_scene {
@@ -45,9 +48,28 @@ typedef struct esp_rmaker_scene {
     /* Flags can be used to identify the scene. */
     uint32_t flags;
     esp_rmaker_scene_action_t action;
+    /* JSON of this scene in the scenes param. Generated again only if the scene changes. */
+    char *json;
+    size_t json_len;
+    /* Incremented on every change to the scene. Compared with the counts below, as for schedules */
+    uint32_t change_count;
+    /* change_count when the JSON was last generated */
+    uint32_t json_count;
+    /* change_count when the scenes param was last reported */
+    uint32_t reported_count;
     struct esp_rmaker_scene *next;
 } esp_rmaker_scene_t;
 
+#define ESP_RMAKER_SCENE_IS_CHANGED(scene) ((scene)->change_count != (scene)->reported_count)
+
+#ifdef CONFIG_ESP_RMAKER_SCENES_DELTA_REPORT
+/* Id of a scene removed since the scenes param was last reported */
+typedef struct esp_rmaker_scene_removed {
+    char id[MAX_ID_LEN + 1];            /* +1 for NULL termination */
+    struct esp_rmaker_scene_removed *next;
+} esp_rmaker_scene_removed_t;
+#endif /* CONFIG_ESP_RMAKER_SCENES_DELTA_REPORT */
+
 typedef enum scenes_operation {
     OPERATION_INVALID,
     OPERATION_ADD,
@@ -62,6 +84,9 @@ typedef struct {
     int total_scenes;
     bool deactivate_support;
     esp_rmaker_device_t *scenes_service;
+#ifdef CONFIG_ESP_RMAKER_SCENES_DELTA_REPORT
+    esp_rmaker_scene_removed_t *removed_list;
+#endif /* CONFIG_ESP_RMAKER_SCENES_DELTA_REPORT */
 } esp_rmaker_scenes_priv_data_t;
 
 static esp_rmaker_scenes_priv_data_t *scenes_priv_data;
@@ -72,12 +97,16 @@ static void esp_rmaker_scenes_free(esp_rmaker_scene_t *scene)
         return;
     }
     if (scene->action.data) {
-        free(scene->action.data);
+        RMAKER_MEM_FREE(scene->action.data);
     }
+    esp_rmaker_action_prog_release(scene->action.prog);
     if (scene->info) {
-        free(scene->info);
+        RMAKER_MEM_FREE(scene->info);
     }
-    free(scene);
+    if (scene->json) {
+        RMAKER_MEM_FREE(scene->json);
+    }
+    RMAKER_MEM_FREE(scene);
 }
 
 static esp_rmaker_scene_t *esp_rmaker_scenes_get_scene_from_id(const char *id)
@@ -159,6 +188,22 @@ static esp_err_t esp_rmaker_scenes_remove_from_list(esp_rmaker_scene_t *scene)
     }
     scenes_priv_data->total_scenes--;
     ESP_LOGD(TAG, "Scene with id %s removed from list.", scene->id);
+#ifdef CONFIG_ESP_RMAKER_SCENES_DELTA_REPORT
+    esp_rmaker_scene_removed_t *removed = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_SCENES, 1,
+            sizeof(esp_rmaker_scene_removed_t));
+    if (removed) {
+        strlcpy(removed->id, scene->id, sizeof(removed->id));
+        removed->next = scenes_priv_data->removed_list;
+        scenes_priv_data->removed_list = removed;
+    } else {
+        /* Without the id, the removal cannot be reported as a delta. Mark all the others as changed so
+         * that the full list gets reported instead.
+         */
+        for (curr_scene = scenes_priv_data->scenes_list; curr_scene; curr_scene = curr_scene->next) {
+            curr_scene->change_count++;
+        }
+    }
+#endif /* CONFIG_ESP_RMAKER_SCENES_DELTA_REPORT */
     return ESP_OK;
 }
 
@@ -212,13 +257,13 @@ static esp_err_t esp_rmaker_scenes_parse_info_and_flags(jparse_ctx_t *jctx, char
     int err_code = json_obj_get_string(jctx, "info", _info, sizeof(_info));
     if (err_code == OS_SUCCESS) {
         if (*info) {
-            free(*info);
+            RMAKER_MEM_FREE(*info);
             *info = NULL;
         }
 
         if (strlen(_info) > 0) {
             /* +1 for NULL termination */
-            *info = (char *)MEM_CALLOC_EXTRAM(1, strlen(_info) + 1);
+            *info = (char *)RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_SCENES, 1, strlen(_info) + 1);
             if (*info) {
                 strncpy(*info, _info, strlen(_info));
             }
@@ -246,14 +291,16 @@ static esp_err_t esp_rmaker_scenes_parse_action(jparse_ctx_t *jctx, esp_rmaker_s
     action->data_len = data_len + 1;
 
     if (action->data) {
-        free(action->data);
+        RMAKER_MEM_FREE(action->data);
     }
-    action->data = (void *)MEM_CALLOC_EXTRAM(1, action->data_len);
+    action->data = (void *)RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_SCENES, 1, action->data_len);
     if (!action->data) {
         ESP_LOGE(TAG, "Could not allocate action");
         return ESP_ERR_NO_MEM;
     }
     json_obj_get_object_str(jctx, "action", action->data, action->data_len);
+    esp_rmaker_action_prog_release(action->prog);
+    action->prog = esp_rmaker_action_prog_compile(action->data, action->data_len);
     return ESP_OK;
 }
 
@@ -277,7 +324,7 @@ static esp_rmaker_scene_t *esp_rmaker_scenes_find_or_create(jparse_ctx_t *jctx,
         }
 
         /* This is a new scene. Fill it. */
-        scene = (esp_rmaker_scene_t *)MEM_CALLOC_EXTRAM(1, sizeof(esp_rmaker_scene_t));
+        scene = (esp_rmaker_scene_t *)RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_SCENES, 1, sizeof(esp_rmaker_scene_t));
         if (!scene) {
             ESP_LOGE(TAG, "Couldn't allocate scene with id: %s", id);
             return NULL;
@@ -331,12 +378,14 @@ static esp_err_t esp_rmaker_scenes_perform_operation(esp_rmaker_scene_t *scene,
             break;
 
         case OPERATION_ACTIVATE:
-            err = esp_rmaker_handle_set_params(scene->action.data, scene->action.data_len, ESP_RMAKER_REQ_SRC_SCENE_ACTIVATE);
+            err = esp_rmaker_action_prog_run(&scene->action.prog, scene->action.data, scene->action.data_len,
+                    ESP_RMAKER_REQ_SRC_SCENE_ACTIVATE);
             break;
 
         case OPERATION_DEACTIVATE:
             if (scenes_priv_data->deactivate_support) {
-                err = esp_rmaker_handle_set_params(scene->action.data, scene->action.data_len, ESP_RMAKER_REQ_SRC_SCENE_DEACTIVATE);
+                err = esp_rmaker_action_prog_run(&scene->action.prog, scene->action.data, scene->action.data_len,
+                        ESP_RMAKER_REQ_SRC_SCENE_DEACTIVATE);
             } else {
                 ESP_LOGW(TAG, "Deactivate operation not supported.");
                 err = ESP_ERR_NOT_SUPPORTED;
@@ -400,6 +449,7 @@ static esp_err_t esp_rmaker_scenes_parse_json(void *data, size_t data_len, esp_r
 
             /* Get action */
             esp_rmaker_scenes_parse_action(&jctx, &scene->action);
+            scene->change_count++;
         }
 
         /* Set report_params */
@@ -420,78 +470,180 @@ cleanup:
     return ESP_OK;
 }
 
-static esp_err_t __esp_rmaker_scenes_get_params(char *buf, size_t *buf_size)
+static void esp_rmaker_scenes_gen_json(json_gen_str_t *jstr, esp_rmaker_scene_t *scene, char *operation)
 {
-    esp_err_t err = ESP_OK;
-    esp_rmaker_scene_t *scene = scenes_priv_data->scenes_list;
-    json_gen_str_t jstr;
-    json_gen_str_start(&jstr, buf, *buf_size, NULL, NULL);
-    json_gen_start_array(&jstr);
+    json_gen_start_object(jstr);
 
-    while (scene) {
-        json_gen_start_object(&jstr);
-
-        /* Add details */
-        json_gen_obj_set_string(&jstr, "name", scene->name);
-        json_gen_obj_set_string(&jstr, "id", scene->id);
-       /* If info and flags is not zero, add it. */
-        if (scene->info != NULL) {
-            json_gen_obj_set_string(&jstr, "info", scene->info);
-        }
-        if (scene->flags != 0) {
-            json_gen_obj_set_int(&jstr, "flags", scene->flags);
-        }
+    /* Add details */
+    json_gen_obj_set_string(jstr, "name", scene->name);
+    json_gen_obj_set_string(jstr, "id", scene->id);
+    if (operation) {
+        json_gen_obj_set_string(jstr, "operation", operation);
+    }
+    /* If info and flags is not zero, add it. */
+    if (scene->info != NULL) {
+        json_gen_obj_set_string(jstr, "info", scene->info);
+    }
+    if (scene->flags != 0) {
+        json_gen_obj_set_int(jstr, "flags", scene->flags);
+    }
 
-        /* Add action */
-        json_gen_push_object_str(&jstr, "action", scene->action.data);
+    /* Add action */
+    json_gen_push_object_str(jstr, "action", scene->action.data);
 
-        json_gen_end_object(&jstr);
+    json_gen_end_object(jstr);
+}
 
-        /* Go to next scene */
-        scene = scene->next;
+/* Regenerates the cached JSON of the scene, if it has changed since it was last generated */
+static esp_err_t esp_rmaker_scenes_update_json(esp_rmaker_scene_t *scene)
+{
+    uint32_t change_count = scene->change_count;
+    if (scene->json && (scene->json_count == change_count)) {
+        return ESP_OK;
     }
-
-    if (json_gen_end_array(&jstr) < 0) {
-        ESP_LOGE(TAG, "Buffer size %d not sufficient for reporting Scenes Params.", *buf_size);
-        err = ESP_ERR_NO_MEM;
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, NULL, 0, NULL, NULL);
+    esp_rmaker_scenes_gen_json(&jstr, scene, NULL);
+    size_t buf_size = json_gen_str_end(&jstr);
+    char *json = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_SCENES, 1, buf_size);
+    if (!json) {
+        ESP_LOGE(TAG, "Failed to allocate %d bytes for scene.", buf_size);
+        return ESP_ERR_NO_MEM;
     }
-    *buf_size = json_gen_str_end(&jstr);
-    return err;
+    json_gen_str_start(&jstr, json, buf_size, NULL, NULL);
+    esp_rmaker_scenes_gen_json(&jstr, scene, NULL);
+    json_gen_str_end(&jstr);
+    if (scene->json) {
+        RMAKER_MEM_FREE(scene->json);
+    }
+    scene->json = json;
+    scene->json_len = buf_size - 1;
+    scene->json_count = change_count;
+    return ESP_OK;
 }
 
+/* Builds the scenes array from the JSON of the individual scenes, so that only the changed ones
+ * need to be generated again.
+ */
 static char *esp_rmaker_scenes_get_params(void)
 {
-    size_t req_size = 0;
-    esp_err_t err = __esp_rmaker_scenes_get_params(NULL, &req_size);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to get required size for scenes JSON.");
-        return NULL;
+    size_t req_size = 3; /* For [, ] and NULL termination */
+    esp_rmaker_scene_t *scene = scenes_priv_data->scenes_list;
+    for (; scene; scene = scene->next) {
+        if (esp_rmaker_scenes_update_json(scene) != ESP_OK) {
+            return NULL;
+        }
+        req_size += scene->json_len + 1; /* +1 for the comma */
     }
-    char *data = MEM_CALLOC_EXTRAM(1, req_size);
+    char *data = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_SCENES, 1, req_size);
     if (!data) {
         ESP_LOGE(TAG, "Failed to allocate %d bytes for scenes.", req_size);
         return NULL;
     }
-    err = __esp_rmaker_scenes_get_params(data, &req_size);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error occured while trying to populate sceness JSON.");
-        free(data);
+    char *ptr = data;
+    *ptr++ = '[';
+    for (scene = scenes_priv_data->scenes_list; scene; scene = scene->next) {
+        if (ptr != data + 1) {
+            *ptr++ = ',';
+        }
+        memcpy(ptr, scene->json, scene->json_len);
+        ptr += scene->json_len;
+    }
+    *ptr++ = ']';
+    *ptr = '\0';
+    return data;
+}
+
+#ifdef CONFIG_ESP_RMAKER_SCENES_DELTA_REPORT
+static bool esp_rmaker_scenes_has_unchanged(void)
+{
+    for (esp_rmaker_scene_t *scene = scenes_priv_data->scenes_list; scene; scene = scene->next) {
+        if (!ESP_RMAKER_SCENE_IS_CHANGED(scene)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static size_t __esp_rmaker_scenes_get_delta(char *buf, size_t buf_size)
+{
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, buf, buf_size, NULL, NULL);
+    json_gen_start_array(&jstr);
+    /* Removals first, so that a scene removed and added again with the same id ends up added */
+    for (esp_rmaker_scene_removed_t *removed = scenes_priv_data->removed_list; removed; removed = removed->next) {
+        json_gen_start_object(&jstr);
+        json_gen_obj_set_string(&jstr, "id", removed->id);
+        json_gen_obj_set_string(&jstr, "operation", "remove");
+        json_gen_end_object(&jstr);
+    }
+    for (esp_rmaker_scene_t *scene = scenes_priv_data->scenes_list; scene; scene = scene->next) {
+        if (ESP_RMAKER_SCENE_IS_CHANGED(scene)) {
+            esp_rmaker_scenes_gen_json(&jstr, scene, "update");
+        }
+    }
+    json_gen_end_array(&jstr);
+    return json_gen_str_end(&jstr);
+}
+
+/* Gets the array of the scenes changed or removed since the last report, in the same format as for
+ * schedules. Returns NULL if a delta is not useful, Eg. if all the scenes have changed.
+ */
+static char *esp_rmaker_scenes_get_delta(void)
+{
+    if (!esp_rmaker_scenes_has_unchanged()) {
         return NULL;
     }
+    size_t req_size = __esp_rmaker_scenes_get_delta(NULL, 0);
+    char *data = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_SCENES, 1, req_size);
+    if (!data) {
+        ESP_LOGE(TAG, "Failed to allocate %d bytes for scenes delta.", req_size);
+        return NULL;
+    }
+    __esp_rmaker_scenes_get_delta(data, req_size);
     return data;
 }
+#endif /* CONFIG_ESP_RMAKER_SCENES_DELTA_REPORT */
+
+/* Clears the changes tracked since the last report, once they have been reported. If all is false, only
+ * the changes which were there when the JSON was generated are cleared.
+ */
+static void esp_rmaker_scenes_clear_changes(bool all)
+{
+    for (esp_rmaker_scene_t *scene = scenes_priv_data->scenes_list; scene; scene = scene->next) {
+        scene->reported_count = all ? scene->change_count : scene->json_count;
+    }
+#ifdef CONFIG_ESP_RMAKER_SCENES_DELTA_REPORT
+    while (scenes_priv_data->removed_list) {
+        esp_rmaker_scene_removed_t *removed = scenes_priv_data->removed_list;
+        scenes_priv_data->removed_list = removed->next;
+        RMAKER_MEM_FREE(removed);
+    }
+#endif /* CONFIG_ESP_RMAKER_SCENES_DELTA_REPORT */
+}
 
 static esp_err_t esp_rmaker_scenes_report_params(void)
 {
     char *data = esp_rmaker_scenes_get_params();
+    if (!data) {
+        return ESP_ERR_NO_MEM;
+    }
+    char *delta = NULL;
+#ifdef CONFIG_ESP_RMAKER_SCENES_DELTA_REPORT
+    delta = esp_rmaker_scenes_get_delta();
+#endif /* CONFIG_ESP_RMAKER_SCENES_DELTA_REPORT */
     esp_rmaker_param_val_t val = {
         .type = RMAKER_VAL_TYPE_ARRAY,
         .val.s = data,
     };
     esp_rmaker_param_t *param = esp_rmaker_device_get_param_by_type(scenes_priv_data->scenes_service, ESP_RMAKER_PARAM_SCENES);
-    esp_rmaker_param_update_and_report(param, val);
+    esp_rmaker_param_update_and_report_delta(param, val, delta);
+    esp_rmaker_scenes_clear_changes(false);
 
-    free(data);
+    if (delta) {
+        RMAKER_MEM_FREE(delta);
+    }
+    RMAKER_MEM_FREE(data);
     return ESP_OK;
 }
 
@@ -515,6 +667,9 @@ static esp_err_t write_cb(const esp_rmaker_device_t *device, const esp_rmaker_pa
             activate, deactivate operations. So need to report the params in that case. */
             esp_rmaker_scenes_report_params();
         }
+    } else {
+        /* The scenes loaded from NVS are reported with all the other params, so are not changes */
+        esp_rmaker_scenes_clear_changes(true);
     }
     return ESP_OK;
 }
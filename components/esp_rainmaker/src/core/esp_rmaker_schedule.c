@@ -13,9 +13,11 @@
 #include <freertos/timers.h>
 #include <json_parser.h>
 #include <esp_rmaker_work_queue.h>
+#include <esp_rmaker_work_queue_prio.h>
 #include <esp_rmaker_core.h>
 #include <esp_rmaker_utils.h>
 #include <esp_rmaker_internal.h>
+#include <esp_rmaker_mem_tag.h>
 #include <esp_rmaker_utils.h>
 #include <esp_rmaker_standard_services.h>
 #include <esp_rmaker_standard_types.h>
@@ -27,6 +29,7 @@
 #define MAX_INFO_LEN 128
 #define MAX_OPERATION_LEN 10
 #define TIME_SYNC_DELAY 10          /* 10 seconds */
+#define TRIGGER_DEADLINE_MS 1000    /* 1 second */
 #define MAX_SCHEDULES CONFIG_ESP_RMAKER_SCHEDULING_MAX_SCHEDULES
 
 static const char *TAG = "esp_rmaker_schedule";
@@ -64,6 +67,8 @@ typedef struct esp_rmaker_schedule_trigger {
 typedef struct esp_rmaker_schedule_action {
     void *data;
     size_t data_len;
+    /* Compiled from data, so that running the action does not need parsing it again */
+    esp_rmaker_action_prog_t *prog;
 } esp_rmaker_schedule_action_t;
 
 typedef struct esp_rmaker_schedule {
@@ -80,9 +85,31 @@ typedef struct esp_rmaker_schedule {
     esp_rmaker_schedule_action_t action;
     esp_rmaker_schedule_trigger_t trigger;
     esp_schedule_validity_t validity;
+    /* JSON of this schedule in the schedules param. Generated again only if the schedule changes. */
+    char *json;
+    size_t json_len;
+    /* Incremented on every change to the schedule. It is compared with the counts below, rather than
+     * using a flag, since the next timestamp can get updated by the esp_schedule timer task while the
+     * schedules param is being reported. A change made after the JSON was generated is thus not lost.
+     */
+    uint32_t change_count;
+    /* change_count when the JSON was last generated */
+    uint32_t json_count;
+    /* change_count when the schedules param was last reported */
+    uint32_t reported_count;
     struct esp_rmaker_schedule *next;
 } esp_rmaker_schedule_t;
 
+#define ESP_RMAKER_SCHEDULE_IS_CHANGED(schedule) ((schedule)->change_count != (schedule)->reported_count)
+
+#ifdef CONFIG_ESP_RMAKER_SCHEDULING_DELTA_REPORT
+/* Id of a schedule removed since the schedules param was last reported */
+typedef struct esp_rmaker_schedule_removed {
+    char id[MAX_ID_LEN + 1];            /* +1 for NULL termination */
+    struct esp_rmaker_schedule_removed *next;
+} esp_rmaker_schedule_removed_t;
+#endif /* CONFIG_ESP_RMAKER_SCHEDULING_DELTA_REPORT */
+
 enum time_sync_state {
     TIME_SYNC_NOT_STARTED,
     TIME_SYNC_STARTED,
@@ -106,6 +133,9 @@ typedef struct {
     esp_rmaker_device_t *schedule_service;
     TimerHandle_t time_sync_timer;
     enum time_sync_state time_sync_state;;
+#ifdef CONFIG_ESP_RMAKER_SCHEDULING_DELTA_REPORT
+    esp_rmaker_schedule_removed_t *removed_list;
+#endif /* CONFIG_ESP_RMAKER_SCHEDULING_DELTA_REPORT */
 } esp_rmaker_schedule_priv_data_t;
 
 static esp_rmaker_schedule_priv_data_t *schedule_priv_data;
@@ -122,12 +152,16 @@ static void esp_rmaker_schedule_free(esp_rmaker_schedule_t *schedule)
         return;
     }
     if (schedule->action.data) {
-        free(schedule->action.data);
+        RMAKER_MEM_FREE(schedule->action.data);
     }
+    esp_rmaker_action_prog_release(schedule->action.prog);
     if (schedule->info) {
-        free(schedule->info);
+        RMAKER_MEM_FREE(schedule->info);
     }
-    free(schedule);
+    if (schedule->json) {
+        RMAKER_MEM_FREE(schedule->json);
+    }
+    RMAKER_MEM_FREE(schedule);
 }
 
 static esp_rmaker_schedule_t *esp_rmaker_schedule_get_schedule_from_id(const char *id)
@@ -223,6 +257,22 @@ static esp_err_t esp_rmaker_schedule_remove_from_list(esp_rmaker_schedule_t *sch
     }
     schedule_priv_data->total_schedules--;
     ESP_LOGD(TAG, "Schedule with id %s removed from list.", schedule->id);
+#ifdef CONFIG_ESP_RMAKER_SCHEDULING_DELTA_REPORT
+    esp_rmaker_schedule_removed_t *removed = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_SCHEDULE, 1,
+            sizeof(esp_rmaker_schedule_removed_t));
+    if (removed) {
+        strlcpy(removed->id, schedule->id, sizeof(removed->id));
+        removed->next = schedule_priv_data->removed_list;
+        schedule_priv_data->removed_list = removed;
+    } else {
+        /* Without the id, the removal cannot be reported as a delta. Mark all the others as changed so
+         * that the full list gets reported instead.
+         */
+        for (curr_schedule = schedule_priv_data->schedule_list; curr_schedule; curr_schedule = curr_schedule->next) {
+            curr_schedule->change_count++;
+        }
+    }
+#endif /* CONFIG_ESP_RMAKER_SCHEDULING_DELTA_REPORT */
     return ESP_OK;
 }
 
@@ -280,7 +330,7 @@ static bool esp_rmaker_schedule_is_expired(esp_rmaker_schedule_t *schedule)
 
 static esp_err_t esp_rmaker_schedule_process_action(esp_rmaker_schedule_action_t *action)
 {
-    return esp_rmaker_handle_set_params(action->data, action->data_len, ESP_RMAKER_REQ_SRC_SCHEDULE);
+    return esp_rmaker_action_prog_run(&action->prog, action->data, action->data_len, ESP_RMAKER_REQ_SRC_SCHEDULE);
 }
 
 static void esp_rmaker_schedule_trigger_work_cb(void *priv_data)
@@ -302,7 +352,8 @@ static void esp_rmaker_schedule_trigger_work_cb(void *priv_data)
 static void esp_rmaker_schedule_trigger_common_cb(esp_schedule_handle_t handle, void *priv_data)
 {
     /* Adding to work queue to change the context from timer's task. */
-    esp_rmaker_work_queue_add_task(esp_rmaker_schedule_trigger_work_cb, priv_data);
+    esp_rmaker_work_queue_add_prio_task(esp_rmaker_schedule_trigger_work_cb, priv_data,
+            ESP_RMAKER_WORK_CLASS_CONTROL, TRIGGER_DEADLINE_MS);
 }
 
 static void esp_rmaker_schedule_timestamp_common_cb(esp_schedule_handle_t handle, uint32_t next_timestamp, void *priv_data)
@@ -314,6 +365,7 @@ static void esp_rmaker_schedule_timestamp_common_cb(esp_schedule_handle_t handle
         return;
     }
     schedule->trigger.next_timestamp = next_timestamp;
+    schedule->change_count++;
 }
 
 static esp_err_t esp_rmaker_schedule_prepare_config(esp_rmaker_schedule_t *schedule, esp_schedule_config_t *schedule_config)
@@ -436,7 +488,8 @@ static void esp_rmaker_schedule_timesync_timer_work_cb(void *priv_data)
 
 static void esp_rmaker_schedule_timesync_timer_cb(TimerHandle_t timer)
 {
-    esp_rmaker_work_queue_add_task(esp_rmaker_schedule_timesync_timer_work_cb, NULL);
+    esp_rmaker_work_queue_add_prio_task(esp_rmaker_schedule_timesync_timer_work_cb, NULL,
+            ESP_RMAKER_WORK_CLASS_BACKGROUND, 0);
 }
 
 static esp_err_t esp_rmaker_schedule_timesync_timer_init(void)
@@ -466,6 +519,7 @@ static esp_err_t esp_rmaker_schedule_operation_enable(esp_rmaker_schedule_t *sch
 {
     /* Setting enabled to true even if time is not synced yet. This reports the correct enabled state when reporting the schedules.*/
     schedule->enabled = true;
+    schedule->change_count++;
 
     /* Check for time sync */
     if (schedule_priv_data->time_sync_state == TIME_SYNC_NOT_STARTED) {
@@ -500,6 +554,7 @@ static esp_err_t esp_rmaker_schedule_operation_disable(esp_rmaker_schedule_t *sc
     esp_err_t ret = esp_schedule_disable(schedule->handle);
     schedule->trigger.next_timestamp = 0;
     schedule->enabled = false;
+    schedule->change_count++;
     return ret;
 }
 
@@ -556,14 +611,16 @@ static esp_err_t esp_rmaker_schedule_parse_action(jparse_ctx_t *jctx, esp_rmaker
     action->data_len = data_len + 1;
 
     if (action->data) {
-        free(action->data);
+        RMAKER_MEM_FREE(action->data);
     }
-    action->data = (void *)MEM_CALLOC_EXTRAM(1, action->data_len);
+    action->data = (void *)RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_SCHEDULE, 1, action->data_len);
     if (!action->data) {
         ESP_LOGE(TAG, "Could not allocate action");
         return ESP_ERR_NO_MEM;
     }
     json_obj_get_object_str(jctx, "action", action->data, action->data_len);
+    esp_rmaker_action_prog_release(action->prog);
+    action->prog = esp_rmaker_action_prog_compile(action->data, action->data_len);
     return ESP_OK;
 }
 
@@ -624,13 +681,13 @@ static esp_err_t esp_rmaker_schedule_parse_info_and_flags(jparse_ctx_t *jctx, ch
     int err_code = json_obj_get_string(jctx, "info", _info, sizeof(_info));
     if (err_code == OS_SUCCESS) {
         if (*info) {
-            free(*info);
+            RMAKER_MEM_FREE(*info);
             *info = NULL;
         }
 
         if (strlen(_info) > 0) {
             /* +1 for NULL termination */
-            *info = (char *)MEM_CALLOC_EXTRAM(1, strlen(_info) + 1);
+            *info = (char *)RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_SCHEDULE, 1, strlen(_info) + 1);
             if (*info) {
                 strncpy(*info, _info, strlen(_info));
             }
@@ -677,7 +734,7 @@ static esp_rmaker_schedule_t *esp_rmaker_schedule_find_or_create(jparse_ctx_t *j
         }
 
         /* This is a new schedule. Fill it. */
-        schedule = (esp_rmaker_schedule_t *)MEM_CALLOC_EXTRAM(1, sizeof(esp_rmaker_schedule_t));
+        schedule = (esp_rmaker_schedule_t *)RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_SCHEDULE, 1, sizeof(esp_rmaker_schedule_t));
         if (!schedule) {
             ESP_LOGE(TAG, "Couldn't allocate schedule with id: %s", id);
             return NULL;
@@ -712,6 +769,7 @@ static esp_err_t esp_rmaker_schedule_perform_operation(esp_rmaker_schedule_t *sc
     switch (operation) {
         case OPERATION_ADD:
             if (schedule_priv_data->total_schedules < MAX_SCHEDULES) {
+                schedule->change_count++;
                 esp_rmaker_schedule_operation_add(schedule);
                 if (enabled == true) {
                     esp_rmaker_schedule_operation_enable(schedule);
@@ -724,6 +782,7 @@ static esp_err_t esp_rmaker_schedule_perform_operation(esp_rmaker_schedule_t *sc
             break;
 
         case OPERATION_EDIT:
+            schedule->change_count++;
             esp_rmaker_schedule_operation_edit(schedule);
             break;
 
@@ -827,113 +886,219 @@ cleanup:
     return ESP_OK;
 }
 
-static esp_err_t __esp_rmaker_schedule_get_params(char *buf, size_t *buf_size)
+static void esp_rmaker_schedule_gen_json(json_gen_str_t *jstr, esp_rmaker_schedule_t *schedule, char *operation)
 {
-    esp_err_t err = ESP_OK;
-    esp_rmaker_schedule_t *schedule = schedule_priv_data->schedule_list;
-    json_gen_str_t jstr;
-    json_gen_str_start(&jstr, buf, *buf_size, NULL, NULL);
-    json_gen_start_array(&jstr);
-    while (schedule) {
-        json_gen_start_object(&jstr);
+    json_gen_start_object(jstr);
 
-        /* Add details */
-        json_gen_obj_set_string(&jstr, "name", schedule->name);
-        json_gen_obj_set_string(&jstr, "id", schedule->id);
-        json_gen_obj_set_bool(&jstr, "enabled", schedule->enabled);
-        /* If info and flags is not zero, add it. */
-        if (schedule->info != NULL) {
-            json_gen_obj_set_string(&jstr, "info", schedule->info);
-        }
-        if (schedule->flags != 0) {
-            json_gen_obj_set_int(&jstr, "flags", schedule->flags);
-        }
-        /* Add validity */
-        if (schedule->validity.start_time != 0 || schedule->validity.end_time != 0) {
-            json_gen_push_object(&jstr, "validity");
-            if (schedule->validity.start_time != 0) {
-                json_gen_obj_set_int(&jstr, "start", schedule->validity.start_time);
-            }
-            if (schedule->validity.end_time != 0) {
-                json_gen_obj_set_int(&jstr, "end", schedule->validity.end_time);
-            }
-            json_gen_pop_object(&jstr);
+    /* Add details */
+    json_gen_obj_set_string(jstr, "name", schedule->name);
+    json_gen_obj_set_string(jstr, "id", schedule->id);
+    if (operation) {
+        json_gen_obj_set_string(jstr, "operation", operation);
+    }
+    json_gen_obj_set_bool(jstr, "enabled", schedule->enabled);
+    /* If info and flags is not zero, add it. */
+    if (schedule->info != NULL) {
+        json_gen_obj_set_string(jstr, "info", schedule->info);
+    }
+    if (schedule->flags != 0) {
+        json_gen_obj_set_int(jstr, "flags", schedule->flags);
+    }
+    /* Add validity */
+    if (schedule->validity.start_time != 0 || schedule->validity.end_time != 0) {
+        json_gen_push_object(jstr, "validity");
+        if (schedule->validity.start_time != 0) {
+            json_gen_obj_set_int(jstr, "start", schedule->validity.start_time);
+        }
+        if (schedule->validity.end_time != 0) {
+            json_gen_obj_set_int(jstr, "end", schedule->validity.end_time);
         }
-        /* Add action */
-        json_gen_push_object_str(&jstr, "action", schedule->action.data);
+        json_gen_pop_object(jstr);
+    }
+    /* Add action */
+    json_gen_push_object_str(jstr, "action", schedule->action.data);
 
-        /* Add trigger */
-        json_gen_push_array(&jstr, "triggers");
-        json_gen_start_object(&jstr);
-        if (schedule->trigger.type == TRIGGER_TYPE_RELATIVE) {
-            json_gen_obj_set_int(&jstr, "rsec", schedule->trigger.relative_seconds);
-            json_gen_obj_set_int(&jstr, "ts", schedule->trigger.next_timestamp);
-        } else {
-            json_gen_obj_set_int(&jstr, "m", schedule->trigger.minutes);
-            if (schedule->trigger.type == TRIGGER_TYPE_DAYS_OF_WEEK) {
-                json_gen_obj_set_int(&jstr, "d", schedule->trigger.day.repeat_days);
-                if (schedule->trigger.day.repeat_days == 0) {
-                    json_gen_obj_set_int(&jstr, "ts", schedule->trigger.next_timestamp);
-                }
-            } else if (schedule->trigger.type == TRIGGER_TYPE_DATE) {
-                json_gen_obj_set_int(&jstr, "dd", schedule->trigger.date.day);
-                json_gen_obj_set_int(&jstr, "mm", schedule->trigger.date.repeat_months);
-                json_gen_obj_set_int(&jstr, "yy", schedule->trigger.date.year);
-                json_gen_obj_set_int(&jstr, "r", schedule->trigger.date.repeat_every_year);
-                if (schedule->trigger.date.repeat_months == 0) {
-                    json_gen_obj_set_int(&jstr, "ts", schedule->trigger.next_timestamp);
-                }
+    /* Add trigger */
+    json_gen_push_array(jstr, "triggers");
+    json_gen_start_object(jstr);
+    if (schedule->trigger.type == TRIGGER_TYPE_RELATIVE) {
+        json_gen_obj_set_int(jstr, "rsec", schedule->trigger.relative_seconds);
+        json_gen_obj_set_int(jstr, "ts", schedule->trigger.next_timestamp);
+    } else {
+        json_gen_obj_set_int(jstr, "m", schedule->trigger.minutes);
+        if (schedule->trigger.type == TRIGGER_TYPE_DAYS_OF_WEEK) {
+            json_gen_obj_set_int(jstr, "d", schedule->trigger.day.repeat_days);
+            if (schedule->trigger.day.repeat_days == 0) {
+                json_gen_obj_set_int(jstr, "ts", schedule->trigger.next_timestamp);
+            }
+        } else if (schedule->trigger.type == TRIGGER_TYPE_DATE) {
+            json_gen_obj_set_int(jstr, "dd", schedule->trigger.date.day);
+            json_gen_obj_set_int(jstr, "mm", schedule->trigger.date.repeat_months);
+            json_gen_obj_set_int(jstr, "yy", schedule->trigger.date.year);
+            json_gen_obj_set_int(jstr, "r", schedule->trigger.date.repeat_every_year);
+            if (schedule->trigger.date.repeat_months == 0) {
+                json_gen_obj_set_int(jstr, "ts", schedule->trigger.next_timestamp);
             }
         }
-        json_gen_end_object(&jstr);
-        json_gen_pop_array(&jstr);
+    }
+    json_gen_end_object(jstr);
+    json_gen_pop_array(jstr);
 
-        json_gen_end_object(&jstr);
+    json_gen_end_object(jstr);
+}
 
-        /* Go to next schedule */
-        schedule = schedule->next;
+/* Regenerates the cached JSON of the schedule, if it has changed since it was last generated */
+static esp_err_t esp_rmaker_schedule_update_json(esp_rmaker_schedule_t *schedule)
+{
+    uint32_t change_count = schedule->change_count;
+    if (schedule->json && (schedule->json_count == change_count)) {
+        return ESP_OK;
     }
-    if (json_gen_end_array(&jstr) < 0) {
-        ESP_LOGE(TAG, "Buffer size %d not sufficient for reporting Schedule Params.", *buf_size);
-        err = ESP_ERR_NO_MEM;
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, NULL, 0, NULL, NULL);
+    esp_rmaker_schedule_gen_json(&jstr, schedule, NULL);
+    size_t buf_size = json_gen_str_end(&jstr);
+    char *json = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_SCHEDULE, 1, buf_size);
+    if (!json) {
+        ESP_LOGE(TAG, "Failed to allocate %d bytes for schedule.", buf_size);
+        return ESP_ERR_NO_MEM;
     }
-    *buf_size = json_gen_str_end(&jstr);
-    return err;
+    json_gen_str_start(&jstr, json, buf_size, NULL, NULL);
+    esp_rmaker_schedule_gen_json(&jstr, schedule, NULL);
+    json_gen_str_end(&jstr);
+    if (schedule->json) {
+        RMAKER_MEM_FREE(schedule->json);
+    }
+    schedule->json = json;
+    schedule->json_len = buf_size - 1;
+    schedule->json_count = change_count;
+    return ESP_OK;
 }
 
+/* Builds the schedules array from the JSON of the individual schedules, so that only the changed ones
+ * need to be generated again.
+ */
 static char *esp_rmaker_schedule_get_params(void)
 {
-    size_t req_size = 0;
-    esp_err_t err = __esp_rmaker_schedule_get_params(NULL, &req_size);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to get required size for schedules JSON.");
-        return NULL;
+    size_t req_size = 3; /* For [, ] and NULL termination */
+    esp_rmaker_schedule_t *schedule = schedule_priv_data->schedule_list;
+    for (; schedule; schedule = schedule->next) {
+        if (esp_rmaker_schedule_update_json(schedule) != ESP_OK) {
+            return NULL;
+        }
+        req_size += schedule->json_len + 1; /* +1 for the comma */
     }
-    char *data = MEM_CALLOC_EXTRAM(1, req_size);
+    char *data = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_SCHEDULE, 1, req_size);
     if (!data) {
         ESP_LOGE(TAG, "Failed to allocate %d bytes for schedule.", req_size);
         return NULL;
     }
-    err = __esp_rmaker_schedule_get_params(data, &req_size);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error occured while trying to populate schedules JSON.");
-        free(data);
+    char *ptr = data;
+    *ptr++ = '[';
+    for (schedule = schedule_priv_data->schedule_list; schedule; schedule = schedule->next) {
+        if (ptr != data + 1) {
+            *ptr++ = ',';
+        }
+        memcpy(ptr, schedule->json, schedule->json_len);
+        ptr += schedule->json_len;
+    }
+    *ptr++ = ']';
+    *ptr = '\0';
+    return data;
+}
+
+#ifdef CONFIG_ESP_RMAKER_SCHEDULING_DELTA_REPORT
+static bool esp_rmaker_schedule_has_unchanged(void)
+{
+    for (esp_rmaker_schedule_t *schedule = schedule_priv_data->schedule_list; schedule; schedule = schedule->next) {
+        if (!ESP_RMAKER_SCHEDULE_IS_CHANGED(schedule)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static size_t __esp_rmaker_schedule_get_delta(char *buf, size_t buf_size)
+{
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, buf, buf_size, NULL, NULL);
+    json_gen_start_array(&jstr);
+    /* Removals first, so that a schedule removed and added again with the same id ends up added */
+    for (esp_rmaker_schedule_removed_t *removed = schedule_priv_data->removed_list; removed; removed = removed->next) {
+        json_gen_start_object(&jstr);
+        json_gen_obj_set_string(&jstr, "id", removed->id);
+        json_gen_obj_set_string(&jstr, "operation", "remove");
+        json_gen_end_object(&jstr);
+    }
+    for (esp_rmaker_schedule_t *schedule = schedule_priv_data->schedule_list; schedule; schedule = schedule->next) {
+        if (ESP_RMAKER_SCHEDULE_IS_CHANGED(schedule)) {
+            esp_rmaker_schedule_gen_json(&jstr, schedule, "update");
+        }
+    }
+    json_gen_end_array(&jstr);
+    return json_gen_str_end(&jstr);
+}
+
+/* Gets the array of the schedules changed or removed since the last report. The changed schedules have
+ * "operation":"update" and all their details, while the removed ones just have "operation":"remove" and
+ * their id. Returns NULL if a delta is not useful, Eg. if all the schedules have changed.
+ */
+static char *esp_rmaker_schedule_get_delta(void)
+{
+    if (!esp_rmaker_schedule_has_unchanged()) {
+        return NULL;
+    }
+    size_t req_size = __esp_rmaker_schedule_get_delta(NULL, 0);
+    char *data = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_SCHEDULE, 1, req_size);
+    if (!data) {
+        ESP_LOGE(TAG, "Failed to allocate %d bytes for schedules delta.", req_size);
         return NULL;
     }
+    __esp_rmaker_schedule_get_delta(data, req_size);
     return data;
 }
+#endif /* CONFIG_ESP_RMAKER_SCHEDULING_DELTA_REPORT */
+
+/* Clears the changes tracked since the last report, once they have been reported. If all is false, only
+ * the changes which were there when the JSON was generated are cleared, so that the ones made after that
+ * get reported next time.
+ */
+static void esp_rmaker_schedule_clear_changes(bool all)
+{
+    for (esp_rmaker_schedule_t *schedule = schedule_priv_data->schedule_list; schedule; schedule = schedule->next) {
+        schedule->reported_count = all ? schedule->change_count : schedule->json_count;
+    }
+#ifdef CONFIG_ESP_RMAKER_SCHEDULING_DELTA_REPORT
+    while (schedule_priv_data->removed_list) {
+        esp_rmaker_schedule_removed_t *removed = schedule_priv_data->removed_list;
+        schedule_priv_data->removed_list = removed->next;
+        RMAKER_MEM_FREE(removed);
+    }
+#endif /* CONFIG_ESP_RMAKER_SCHEDULING_DELTA_REPORT */
+}
 
 static esp_err_t esp_rmaker_schedule_report_params(void)
 {
     char *data = esp_rmaker_schedule_get_params();
+    if (!data) {
+        return ESP_ERR_NO_MEM;
+    }
+    char *delta = NULL;
+#ifdef CONFIG_ESP_RMAKER_SCHEDULING_DELTA_REPORT
+    delta = esp_rmaker_schedule_get_delta();
+#endif /* CONFIG_ESP_RMAKER_SCHEDULING_DELTA_REPORT */
     esp_rmaker_param_val_t val = {
         .type = RMAKER_VAL_TYPE_ARRAY,
         .val.s = data,
     };
     esp_rmaker_param_t *param = esp_rmaker_device_get_param_by_type(schedule_priv_data->schedule_service, ESP_RMAKER_PARAM_SCHEDULES);
-    esp_rmaker_param_update_and_report(param, val);
+    esp_rmaker_param_update_and_report_delta(param, val, delta);
+    esp_rmaker_schedule_clear_changes(false);
 
-    free(data);
+    if (delta) {
+        RMAKER_MEM_FREE(delta);
+    }
+    RMAKER_MEM_FREE(data);
     return ESP_OK;
 }
 
@@ -952,6 +1117,9 @@ static esp_err_t write_cb(const esp_rmaker_device_t *device, const esp_rmaker_pa
     if (ctx->src != ESP_RMAKER_REQ_SRC_INIT) {
         /* Since this is a persisting param, we get a write_cb while booting up. We need not report the param when the source is 'init' as this will get reported when the device first reports all the params. */
         esp_rmaker_schedule_report_params();
+    } else {
+        /* The schedules loaded from NVS are reported with all the other params, so are not changes */
+        esp_rmaker_schedule_clear_changes(true);
     }
     return ESP_OK;
 }
@@ -0,0 +1,304 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <sdkconfig.h>
+#include <string.h>
+#include <esp_log.h>
+#include <esp_err.h>
+#include <esp_rmaker_core.h>
+#include "esp_rmaker_internal.h"
+#include "esp_rmaker_mem_tag.h"
+
+static const char *TAG = "esp_rmaker_set_params_queue";
+
+#ifdef CONFIG_ESP_RMAKER_SET_PARAMS_QUEUE_ENABLE
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <esp_timer.h>
+#include <esp_rmaker_utils.h>
+
+#define SET_PARAMS_QUEUE_SIZE           CONFIG_ESP_RMAKER_SET_PARAMS_QUEUE_SIZE
+#define SET_PARAMS_TASK_STACK_SIZE      CONFIG_ESP_RMAKER_SET_PARAMS_TASK_STACK_SIZE
+#define SET_PARAMS_TASK_PRIORITY        CONFIG_ESP_RMAKER_SET_PARAMS_TASK_PRIORITY
+#define SET_PARAMS_ENQUEUE_TIMEOUT_MS   CONFIG_ESP_RMAKER_SET_PARAMS_QUEUE_WAIT_TIME_MS
+#define SEMAPHORE_DELAY_MSEC            500
+
+typedef enum {
+    SET_PARAMS_PRIO_HIGH = 0,
+    SET_PARAMS_PRIO_NORMAL,
+    SET_PARAMS_PRIO_MAX,
+} set_params_prio_t;
+
+/* Requests generated locally on the node (or by a user present near it) get precedence over the
+ * ones from the cloud, so that a burst of cloud requests does not delay them.
+ */
+static const set_params_prio_t src_prio[ESP_RMAKER_REQ_SRC_MAX] = {
+    [ESP_RMAKER_REQ_SRC_INIT] = SET_PARAMS_PRIO_HIGH,
+    [ESP_RMAKER_REQ_SRC_CLOUD] = SET_PARAMS_PRIO_NORMAL,
+    [ESP_RMAKER_REQ_SRC_SCHEDULE] = SET_PARAMS_PRIO_HIGH,
+    [ESP_RMAKER_REQ_SRC_SCENE_ACTIVATE] = SET_PARAMS_PRIO_HIGH,
+    [ESP_RMAKER_REQ_SRC_SCENE_DEACTIVATE] = SET_PARAMS_PRIO_HIGH,
+    [ESP_RMAKER_REQ_SRC_LOCAL] = SET_PARAMS_PRIO_HIGH,
+};
+
+/* A request has either the JSON payload, or a compiled action */
+typedef struct {
+    char *data;
+    size_t data_len;
+    esp_rmaker_action_prog_t *prog;
+    esp_rmaker_req_src_t src;
+    int64_t enqueue_time;
+} set_params_req_t;
+
+static QueueHandle_t set_params_queue[SET_PARAMS_PRIO_MAX];
+/* Counts the requests across all the queues, so that the worker can block on a single object */
+static SemaphoreHandle_t set_params_count;
+static SemaphoreHandle_t set_params_stats_lock;
+static TaskHandle_t set_params_task;
+static esp_rmaker_set_params_queue_stats_t set_params_stats;
+static uint64_t total_wait_ms;
+
+static void esp_rmaker_set_params_req_free(set_params_req_t *req)
+{
+    if (req->prog) {
+        esp_rmaker_action_prog_release(req->prog);
+    } else {
+        RMAKER_MEM_FREE(req->data);
+    }
+}
+
+static void esp_rmaker_set_params_update_wait_stats(int64_t enqueue_time)
+{
+    uint32_t wait_ms = (uint32_t)((esp_timer_get_time() - enqueue_time) / 1000);
+    if (xSemaphoreTake(set_params_stats_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS) != pdTRUE) {
+        return;
+    }
+    set_params_stats.processed++;
+    total_wait_ms += wait_ms;
+    set_params_stats.avg_wait_ms = (uint32_t)(total_wait_ms / set_params_stats.processed);
+    if (wait_ms > set_params_stats.max_wait_ms) {
+        set_params_stats.max_wait_ms = wait_ms;
+    }
+    xSemaphoreGive(set_params_stats_lock);
+}
+
+static void esp_rmaker_set_params_task(void *arg)
+{
+    set_params_req_t req;
+    while (1) {
+        if (xSemaphoreTake(set_params_count, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        for (int prio = 0; prio < SET_PARAMS_PRIO_MAX; prio++) {
+            if (xQueueReceive(set_params_queue[prio], &req, 0) == pdTRUE) {
+                esp_rmaker_set_params_update_wait_stats(req.enqueue_time);
+                if (req.prog) {
+                    esp_rmaker_action_prog_exec(req.prog, req.src);
+                } else {
+                    esp_rmaker_handle_set_params(req.data, req.data_len, req.src);
+                }
+                esp_rmaker_set_params_req_free(&req);
+                break;
+            }
+        }
+    }
+}
+
+static esp_err_t esp_rmaker_set_params_enqueue(set_params_req_t *req)
+{
+    QueueHandle_t queue = set_params_queue[src_prio[req->src]];
+    /* Back-pressure: wait for a while for the worker to make space, before applying the overflow policy */
+    BaseType_t ret = xQueueSend(queue, req, SET_PARAMS_ENQUEUE_TIMEOUT_MS/portTICK_PERIOD_MS);
+#ifdef CONFIG_ESP_RMAKER_SET_PARAMS_QUEUE_DROP_OLDEST
+    if (ret != pdTRUE) {
+        set_params_req_t old_req;
+        if (xQueueReceive(queue, &old_req, 0) == pdTRUE) {
+            ESP_LOGW(TAG, "Set params queue full. Dropping oldest %s request.", esp_rmaker_device_cb_src_to_str(old_req.src));
+            esp_rmaker_set_params_req_free(&old_req);
+            /* The count semaphore stays as is, since one request is being replaced by another */
+            if (xQueueSend(queue, req, 0) == pdTRUE) {
+                xSemaphoreTake(set_params_stats_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS);
+                set_params_stats.dropped++;
+                set_params_stats.enqueued++;
+                xSemaphoreGive(set_params_stats_lock);
+                return ESP_OK;
+            }
+        }
+    }
+#endif /* CONFIG_ESP_RMAKER_SET_PARAMS_QUEUE_DROP_OLDEST */
+    xSemaphoreTake(set_params_stats_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS);
+    if (ret != pdTRUE) {
+        set_params_stats.dropped++;
+    } else {
+        set_params_stats.enqueued++;
+        uint8_t depth = uxQueueMessagesWaiting(set_params_queue[SET_PARAMS_PRIO_HIGH]) +
+                uxQueueMessagesWaiting(set_params_queue[SET_PARAMS_PRIO_NORMAL]);
+        if (depth > set_params_stats.max_depth) {
+            set_params_stats.max_depth = depth;
+        }
+    }
+    xSemaphoreGive(set_params_stats_lock);
+    if (ret != pdTRUE) {
+        ESP_LOGE(TAG, "Set params queue full. Dropping %s request.", esp_rmaker_device_cb_src_to_str(req->src));
+        esp_rmaker_set_params_req_free(req);
+        return ESP_FAIL;
+    }
+    xSemaphoreGive(set_params_count);
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_queue_set_params(const char *data, size_t data_len, esp_rmaker_req_src_t src)
+{
+    if (!data || (src < 0) || (src >= ESP_RMAKER_REQ_SRC_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* If the queue is not started, handle the request in the caller's context, like earlier.
+     * Requests generated from within the set params task (say, a write callback activating a scene)
+     * are handled inline too, since waiting on the queue from the only task draining it could block
+     * till the timeout, and then drop the request.
+     */
+    if (!set_params_task || (xTaskGetCurrentTaskHandle() == set_params_task)) {
+        return esp_rmaker_handle_set_params((char *)data, data_len, src);
+    }
+    /* The queue owns a copy of the payload, as the caller's buffer may not stay valid */
+    set_params_req_t req = {
+        .data = RMAKER_MEM_ALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_PARAMS, data_len + 1),
+        .data_len = data_len,
+        .src = src,
+        .enqueue_time = esp_timer_get_time(),
+    };
+    if (!req.data) {
+        ESP_LOGE(TAG, "Failed to allocate %d bytes for set params request.", data_len);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(req.data, data, data_len);
+    req.data[data_len] = '\0';
+    return esp_rmaker_set_params_enqueue(&req);
+}
+
+esp_err_t esp_rmaker_queue_action_prog(esp_rmaker_action_prog_t *prog, esp_rmaker_req_src_t src)
+{
+    if (!prog || (src < 0) || (src >= ESP_RMAKER_REQ_SRC_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* Same as esp_rmaker_queue_set_params() */
+    if (!set_params_task || (xTaskGetCurrentTaskHandle() == set_params_task)) {
+        return esp_rmaker_action_prog_exec(prog, src);
+    }
+    /* The request holds a reference, so that the action can be edited or removed while this is queued */
+    set_params_req_t req = {
+        .prog = esp_rmaker_action_prog_retain(prog),
+        .src = src,
+        .enqueue_time = esp_timer_get_time(),
+    };
+    return esp_rmaker_set_params_enqueue(&req);
+}
+
+esp_err_t esp_rmaker_set_params_queue_get_stats(esp_rmaker_set_params_queue_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!set_params_stats_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xSemaphoreTake(set_params_stats_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS) != pdTRUE) {
+        return ESP_FAIL;
+    }
+    *stats = set_params_stats;
+    xSemaphoreGive(set_params_stats_lock);
+    stats->depth = uxQueueMessagesWaiting(set_params_queue[SET_PARAMS_PRIO_HIGH]) +
+            uxQueueMessagesWaiting(set_params_queue[SET_PARAMS_PRIO_NORMAL]);
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_set_params_queue_init(void)
+{
+    if (set_params_stats_lock) {
+        return ESP_OK;
+    }
+    for (int prio = 0; prio < SET_PARAMS_PRIO_MAX; prio++) {
+        set_params_queue[prio] = xQueueCreate(SET_PARAMS_QUEUE_SIZE, sizeof(set_params_req_t));
+        if (!set_params_queue[prio]) {
+            goto init_err;
+        }
+    }
+    set_params_count = xSemaphoreCreateCounting(SET_PARAMS_QUEUE_SIZE * SET_PARAMS_PRIO_MAX, 0);
+    set_params_stats_lock = xSemaphoreCreateMutex();
+    if (!set_params_count || !set_params_stats_lock) {
+        goto init_err;
+    }
+    ESP_LOGI(TAG, "Set params queue initialised. Size: %d", SET_PARAMS_QUEUE_SIZE);
+    return ESP_OK;
+
+init_err:
+    ESP_LOGE(TAG, "Failed to create set params queue.");
+    for (int prio = 0; prio < SET_PARAMS_PRIO_MAX; prio++) {
+        if (set_params_queue[prio]) {
+            vQueueDelete(set_params_queue[prio]);
+            set_params_queue[prio] = NULL;
+        }
+    }
+    if (set_params_count) {
+        vSemaphoreDelete(set_params_count);
+        set_params_count = NULL;
+    }
+    if (set_params_stats_lock) {
+        vSemaphoreDelete(set_params_stats_lock);
+        set_params_stats_lock = NULL;
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_rmaker_set_params_queue_start(void)
+{
+    if (!set_params_stats_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (set_params_task) {
+        return ESP_OK;
+    }
+    if (xTaskCreate(esp_rmaker_set_params_task, "rmaker_set_params", SET_PARAMS_TASK_STACK_SIZE,
+                NULL, SET_PARAMS_TASK_PRIORITY, &set_params_task) != pdPASS) {
+        ESP_LOGE(TAG, "Couldn't create set params task");
+        set_params_task = NULL;
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+#else /* ! CONFIG_ESP_RMAKER_SET_PARAMS_QUEUE_ENABLE */
+
+esp_err_t esp_rmaker_queue_set_params(const char *data, size_t data_len, esp_rmaker_req_src_t src)
+{
+    return esp_rmaker_handle_set_params((char *)data, data_len, src);
+}
+
+esp_err_t esp_rmaker_queue_action_prog(esp_rmaker_action_prog_t *prog, esp_rmaker_req_src_t src)
+{
+    return esp_rmaker_action_prog_exec(prog, src);
+}
+
+esp_err_t esp_rmaker_set_params_queue_get_stats(esp_rmaker_set_params_queue_stats_t *stats)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_rmaker_set_params_queue_init(void)
+{
+    ESP_LOGD(TAG, "Set params queue is not enabled.");
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_set_params_queue_start(void)
+{
+    return ESP_OK;
+}
+
+#endif /* ! CONFIG_ESP_RMAKER_SET_PARAMS_QUEUE_ENABLE */
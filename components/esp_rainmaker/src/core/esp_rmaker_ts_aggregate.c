@@ -0,0 +1,40 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "esp_rmaker_ts_aggregate.h"
+
+bool esp_rmaker_ts_window_take(esp_rmaker_ts_window_t *window, uint32_t window_secs, time_t now, bool force,
+        esp_rmaker_ts_window_t *done)
+{
+    if ((window->count == 0) || (!force && ((now - window->start) < (time_t)window_secs))) {
+        return false;
+    }
+    *done = *window;
+    window->count = 0;
+    return true;
+}
+
+bool esp_rmaker_ts_window_add(esp_rmaker_ts_window_t *window, uint32_t window_secs, float val, time_t now,
+        esp_rmaker_ts_window_t *done)
+{
+    bool window_done = esp_rmaker_ts_window_take(window, window_secs, now, false, done);
+    if (window->count == 0) {
+        window->start = now;
+        window->min = val;
+        window->max = val;
+        window->sum = 0;
+    } else {
+        if (val < window->min) {
+            window->min = val;
+        }
+        if (val > window->max) {
+            window->max = val;
+        }
+    }
+    window->sum += val;
+    window->count++;
+    return window_done;
+}
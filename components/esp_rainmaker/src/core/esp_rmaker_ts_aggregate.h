@@ -0,0 +1,34 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/* Summary of the samples of a simple time series param in one aggregation window. It is updated in O(1),
+ * without any allocation, irrespective of the sampling rate. This has no other dependencies, so that it
+ * can be built on a host as well.
+ */
+typedef struct {
+    /* Time of the first sample of the window */
+    time_t start;
+    uint32_t count;
+    float min;
+    float max;
+    double sum;
+} esp_rmaker_ts_window_t;
+
+/* Adds a sample taken at now. If the window had elapsed, its summary is first moved to done and true is
+ * returned, and the sample starts a new window.
+ */
+bool esp_rmaker_ts_window_add(esp_rmaker_ts_window_t *window, uint32_t window_secs, float val, time_t now,
+        esp_rmaker_ts_window_t *done);
+/* Moves the summary to done and empties the window, if the window has samples and has elapsed at now,
+ * or if force is set. Returns true if the summary was moved.
+ */
+bool esp_rmaker_ts_window_take(esp_rmaker_ts_window_t *window, uint32_t window_secs, time_t now, bool force,
+        esp_rmaker_ts_window_t *done);
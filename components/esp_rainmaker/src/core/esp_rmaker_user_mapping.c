@@ -21,6 +21,7 @@
 #include <wifi_provisioning/manager.h>
 #include <json_generator.h>
 #include <esp_rmaker_work_queue.h>
+#include <esp_rmaker_work_queue_prio.h>
 #include <esp_rmaker_core.h>
 #include <esp_rmaker_user_mapping.h>
 #include <esp_rmaker_mqtt.h>
@@ -29,6 +30,7 @@
 #include "esp_rmaker_user_mapping.pb-c.h"
 #include "esp_rmaker_internal.h"
 #include "esp_rmaker_mqtt_topics.h"
+#include "esp_rmaker_mqtt_publish_queue.h"
 
 static const char *TAG = "esp_rmaker_user_mapping";
 
@@ -123,6 +125,18 @@ static void esp_rmaker_user_mapping_event_handler(void* arg, esp_event_base_t ev
     }
 }
 
+static void esp_rmaker_user_mapping_published_cb(int msg_id, void *priv_data)
+{
+    if (xSemaphoreTake(esp_rmaker_user_mapping_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to take semaphore.");
+        return;
+    }
+    if (rmaker_user_mapping_data) {
+        rmaker_user_mapping_data->mqtt_msg_id = msg_id;
+    }
+    xSemaphoreGive(esp_rmaker_user_mapping_lock);
+}
+
 static void esp_rmaker_user_mapping_cb(void *priv_data)
 {
     if (xSemaphoreTake(esp_rmaker_user_mapping_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS) != pdTRUE) {
@@ -151,13 +165,26 @@ static void esp_rmaker_user_mapping_cb(void *priv_data)
     json_gen_str_end(&jstr);
     char publish_topic[MQTT_TOPIC_BUFFER_SIZE];
     esp_rmaker_create_mqtt_topic(publish_topic, sizeof(publish_topic), USER_MAPPING_TOPIC_SUFFIX, USER_MAPPING_TOPIC_RULE);
-    esp_err_t err = esp_rmaker_mqtt_publish(publish_topic, publish_payload, strlen(publish_payload), RMAKER_MQTT_QOS1, &rmaker_user_mapping_data->mqtt_msg_id);
+    /* The message may get queued, and the message id gets set by esp_rmaker_user_mapping_published_cb()
+     * only once it is sent. The lock is released while publishing since that callback needs it.
+     */
+    rmaker_user_mapping_data->mqtt_msg_id = -1;
+    rmaker_user_mapping_data->sent = true;
+    xSemaphoreGive(esp_rmaker_user_mapping_lock);
+    esp_err_t err = esp_rmaker_mqtt_publish_with_cb(publish_topic, publish_payload, strlen(publish_payload),
+            RMAKER_MQTT_QOS1, esp_rmaker_user_mapping_published_cb, NULL);
     ESP_LOGI(TAG, "MQTT Publish: %s", publish_payload);
+    if (xSemaphoreTake(esp_rmaker_user_mapping_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to take semaphore.");
+        return;
+    }
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "MQTT Publish Error %d", err);
+        if (rmaker_user_mapping_data) {
+            rmaker_user_mapping_data->sent = false;
+        }
     } else {
         rmaker_user_mapping_state = ESP_RMAKER_USER_MAPPING_REQ_SENT;
-        rmaker_user_mapping_data->sent = true;
     }
     xSemaphoreGive(esp_rmaker_user_mapping_lock);
     return;
@@ -233,7 +260,8 @@ esp_err_t esp_rmaker_start_user_node_mapping(char *user_id, char *secret_key)
     } else {
         rmaker_user_mapping_state = ESP_RMAKER_USER_MAPPING_DONE;
     }
-    if (esp_rmaker_work_queue_add_task(esp_rmaker_user_mapping_cb, NULL) != ESP_OK) {
+    if (esp_rmaker_work_queue_add_prio_task(esp_rmaker_user_mapping_cb, NULL,
+            ESP_RMAKER_WORK_CLASS_REPORT, 0) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to queue user mapping task.");
         goto user_mapping_error;
     }
@@ -0,0 +1,213 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <sdkconfig.h>
+#include <string.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <esp_rmaker_work_queue.h>
+#include <esp_rmaker_work_queue_prio.h>
+
+static const char *TAG = "esp_rmaker_work_queue_prio";
+
+#define WORK_CLASS_QUEUE_SIZE   CONFIG_ESP_RMAKER_WORK_QUEUE_PRIO_CLASS_SIZE
+#define SEMAPHORE_DELAY_MSEC    500
+
+typedef struct {
+    esp_rmaker_work_fn_t work_fn;
+    void *priv_data;
+    int64_t enqueue_time;
+    /* Absolute time (in usec) by which the work should start. 0 for no deadline. */
+    int64_t deadline;
+} work_prio_item_t;
+
+static QueueHandle_t work_class_queue[ESP_RMAKER_WORK_CLASS_MAX];
+static SemaphoreHandle_t work_prio_lock;
+static esp_rmaker_work_class_stats_t work_class_stats[ESP_RMAKER_WORK_CLASS_MAX];
+static uint64_t total_latency_ms[ESP_RMAKER_WORK_CLASS_MAX];
+/* At most one dispatch work is kept in the underlying FIFO work queue at a time. Each dispatch
+ * executes the highest priority pending item and re-queues itself if more items are pending.
+ * So, the wait for a newly added high priority item is bounded by the execution of the work
+ * already in the FIFO, irrespective of the number of lower priority items pending.
+ */
+static bool dispatch_pending;
+
+static uint8_t esp_rmaker_work_prio_pending_count(void)
+{
+    uint8_t count = 0;
+    for (int i = 0; i < ESP_RMAKER_WORK_CLASS_MAX; i++) {
+        count += uxQueueMessagesWaiting(work_class_queue[i]);
+    }
+    return count;
+}
+
+static void esp_rmaker_work_prio_update_stats(esp_rmaker_work_class_t work_class, work_prio_item_t *item)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t latency_ms = (uint32_t)((now - item->enqueue_time) / 1000);
+    esp_rmaker_work_class_stats_t *stats = &work_class_stats[work_class];
+    stats->processed++;
+    total_latency_ms[work_class] += latency_ms;
+    stats->avg_latency_ms = (uint32_t)(total_latency_ms[work_class] / stats->processed);
+    if (latency_ms > stats->max_latency_ms) {
+        stats->max_latency_ms = latency_ms;
+    }
+    if (item->deadline && (now > item->deadline)) {
+        stats->deadline_missed++;
+        ESP_LOGW(TAG, "Work of class %d missed its deadline by %lld ms.", work_class,
+                (long long)((now - item->deadline) / 1000));
+    }
+}
+
+static void esp_rmaker_work_prio_dispatch(void *priv_data)
+{
+    if (!work_prio_lock) {
+        /* Deinitialised after this was queued */
+        return;
+    }
+    work_prio_item_t item = {0};
+    esp_rmaker_work_class_t work_class;
+    bool found = false;
+    for (work_class = 0; work_class < ESP_RMAKER_WORK_CLASS_MAX; work_class++) {
+        if (xQueueReceive(work_class_queue[work_class], &item, 0) == pdTRUE) {
+            found = true;
+            break;
+        }
+    }
+    xSemaphoreTake(work_prio_lock, portMAX_DELAY);
+    if (found) {
+        esp_rmaker_work_prio_update_stats(work_class, &item);
+    }
+    dispatch_pending = false;
+    if (esp_rmaker_work_prio_pending_count() > 0) {
+        /* Re-queue at the end, so that work added directly to the FIFO queue does not starve */
+        if (esp_rmaker_work_queue_add_task(esp_rmaker_work_prio_dispatch, NULL) == ESP_OK) {
+            dispatch_pending = true;
+        } else {
+            ESP_LOGE(TAG, "Failed to queue dispatch. Pending work will be picked up on next addition.");
+        }
+    }
+    xSemaphoreGive(work_prio_lock);
+    if (found) {
+        item.work_fn(item.priv_data);
+    }
+}
+
+esp_err_t esp_rmaker_work_queue_add_prio_task(esp_rmaker_work_fn_t work_fn, void *priv_data,
+        esp_rmaker_work_class_t work_class, uint32_t deadline_ms)
+{
+    if (!work_fn || (work_class < 0) || (work_class >= ESP_RMAKER_WORK_CLASS_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!work_prio_lock) {
+        return esp_rmaker_work_queue_add_task(work_fn, priv_data);
+    }
+    int64_t now = esp_timer_get_time();
+    work_prio_item_t item = {
+        .work_fn = work_fn,
+        .priv_data = priv_data,
+        .enqueue_time = now,
+        .deadline = deadline_ms ? (now + (int64_t)deadline_ms * 1000) : 0,
+    };
+    xSemaphoreTake(work_prio_lock, portMAX_DELAY);
+    esp_rmaker_work_class_stats_t *stats = &work_class_stats[work_class];
+    if (xQueueSend(work_class_queue[work_class], &item, 0) != pdTRUE) {
+        stats->dropped++;
+        xSemaphoreGive(work_prio_lock);
+        ESP_LOGE(TAG, "Queue for work class %d full. Dropping work.", work_class);
+        return ESP_FAIL;
+    }
+    stats->enqueued++;
+    uint8_t depth = uxQueueMessagesWaiting(work_class_queue[work_class]);
+    if (depth > stats->max_depth) {
+        stats->max_depth = depth;
+    }
+    if (!dispatch_pending) {
+        if (esp_rmaker_work_queue_add_task(esp_rmaker_work_prio_dispatch, NULL) == ESP_OK) {
+            dispatch_pending = true;
+        } else {
+            /* The item is queued and will be dispatched after the next successful addition, so this is not
+             * reported as a failure. The caller must not free what the work uses.
+             */
+            ESP_LOGE(TAG, "Failed to queue dispatch for work class %d.", work_class);
+        }
+    }
+    xSemaphoreGive(work_prio_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_work_queue_get_class_stats(esp_rmaker_work_class_t work_class, esp_rmaker_work_class_stats_t *stats)
+{
+    if (!stats || (work_class < 0) || (work_class >= ESP_RMAKER_WORK_CLASS_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!work_prio_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xSemaphoreTake(work_prio_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS) != pdTRUE) {
+        return ESP_FAIL;
+    }
+    *stats = work_class_stats[work_class];
+    stats->depth = uxQueueMessagesWaiting(work_class_queue[work_class]);
+    xSemaphoreGive(work_prio_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_work_queue_prio_init(void)
+{
+    if (work_prio_lock) {
+        return ESP_OK;
+    }
+    for (int i = 0; i < ESP_RMAKER_WORK_CLASS_MAX; i++) {
+        work_class_queue[i] = xQueueCreate(WORK_CLASS_QUEUE_SIZE, sizeof(work_prio_item_t));
+        if (!work_class_queue[i]) {
+            goto init_err;
+        }
+    }
+    work_prio_lock = xSemaphoreCreateMutex();
+    if (!work_prio_lock) {
+        goto init_err;
+    }
+    memset(work_class_stats, 0, sizeof(work_class_stats));
+    memset(total_latency_ms, 0, sizeof(total_latency_ms));
+    dispatch_pending = false;
+    ESP_LOGI(TAG, "Prioritised work queue initialised. Size per class: %d", WORK_CLASS_QUEUE_SIZE);
+    return ESP_OK;
+
+init_err:
+    ESP_LOGE(TAG, "Failed to create prioritised work queue.");
+    for (int i = 0; i < ESP_RMAKER_WORK_CLASS_MAX; i++) {
+        if (work_class_queue[i]) {
+            vQueueDelete(work_class_queue[i]);
+            work_class_queue[i] = NULL;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t esp_rmaker_work_queue_prio_deinit(void)
+{
+    if (!work_prio_lock) {
+        return ESP_OK;
+    }
+    /* Any pending work is dropped, like for the underlying work queue */
+    xSemaphoreTake(work_prio_lock, portMAX_DELAY);
+    for (int i = 0; i < ESP_RMAKER_WORK_CLASS_MAX; i++) {
+        vQueueDelete(work_class_queue[i]);
+        work_class_queue[i] = NULL;
+    }
+    dispatch_pending = false;
+    SemaphoreHandle_t lock = work_prio_lock;
+    work_prio_lock = NULL;
+    xSemaphoreGive(lock);
+    vSemaphoreDelete(lock);
+    return ESP_OK;
+}
@@ -12,13 +12,18 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <stdlib.h>
 #include <esp_log.h>
 #include <esp_rmaker_mqtt_glue.h>
 #include <esp_rmaker_client_data.h>
 #include <esp_rmaker_core.h>
 
 #include "esp_rmaker_mqtt.h"
+#include "esp_rmaker_mqtt_topics.h"
 #include "esp_rmaker_mqtt_budget.h"
+#include "esp_rmaker_mqtt_compress.h"
+#include "esp_rmaker_mqtt_publish_queue.h"
+#include "esp_rmaker_mqtt_router.h"
 
 static const char *TAG = "esp_rmaker_mqtt";
 static esp_rmaker_mqtt_config_t g_mqtt_config;
@@ -50,6 +55,9 @@ esp_err_t esp_rmaker_mqtt_init(esp_rmaker_mqtt_conn_params_t *conn_params)
             if (esp_rmaker_mqtt_budgeting_init() != ESP_OK) {
                 ESP_LOGE(TAG, "Failied to initialise MQTT Budgeting.");
             }
+            if (esp_rmaker_mqtt_publish_queue_init() != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to initialise MQTT publish queue.");
+            }
         }
         return err;
     }
@@ -59,6 +67,8 @@ esp_err_t esp_rmaker_mqtt_init(esp_rmaker_mqtt_conn_params_t *conn_params)
 
 void esp_rmaker_mqtt_deinit(void)
 {
+    esp_rmaker_mqtt_publish_queue_deinit();
+    esp_rmaker_mqtt_router_deinit();
     esp_rmaker_mqtt_budgeting_deinit();
     if (g_mqtt_config.deinit) {
         return g_mqtt_config.deinit();
@@ -90,7 +100,7 @@ esp_err_t esp_rmaker_mqtt_disconnect(void)
     return ESP_OK;
 }
 
-esp_err_t esp_rmaker_mqtt_subscribe(const char *topic, esp_rmaker_mqtt_subscribe_cb_t cb, uint8_t qos, void *priv_data)
+esp_err_t esp_rmaker_mqtt_subscribe_direct(const char *topic, esp_rmaker_mqtt_subscribe_cb_t cb, uint8_t qos, void *priv_data)
 {
     if (g_mqtt_config.subscribe) {
         return g_mqtt_config.subscribe(topic, cb, qos, priv_data);
@@ -99,8 +109,19 @@ esp_err_t esp_rmaker_mqtt_subscribe(const char *topic, esp_rmaker_mqtt_subscribe
     return ESP_OK;
 }
 
+esp_err_t esp_rmaker_mqtt_subscribe(const char *topic, esp_rmaker_mqtt_subscribe_cb_t cb, uint8_t qos, void *priv_data)
+{
+    if (esp_rmaker_mqtt_router_handles(topic)) {
+        return esp_rmaker_mqtt_router_subscribe(topic, cb, qos, priv_data);
+    }
+    return esp_rmaker_mqtt_subscribe_direct(topic, cb, qos, priv_data);
+}
+
 esp_err_t esp_rmaker_mqtt_unsubscribe(const char *topic)
 {
+    if (esp_rmaker_mqtt_router_handles(topic)) {
+        return esp_rmaker_mqtt_router_unsubscribe(topic);
+    }
     if (g_mqtt_config.unsubscribe) {
         return g_mqtt_config.unsubscribe(topic);
     }
@@ -108,16 +129,29 @@ esp_err_t esp_rmaker_mqtt_unsubscribe(const char *topic)
     return ESP_OK;
 }
 
-esp_err_t esp_rmaker_mqtt_publish(const char *topic, void *data, size_t data_len, uint8_t qos, int *msg_id)
+esp_err_t esp_rmaker_mqtt_publish_direct(const char *topic, void *data, size_t data_len, uint8_t qos, int *msg_id,
+        esp_rmaker_mqtt_msg_class_t msg_class)
 {
-    if (esp_rmaker_mqtt_is_budget_available() != true) {
+    if (esp_rmaker_mqtt_is_class_budget_available(msg_class) != true) {
         ESP_LOGE(TAG, "Out of MQTT Budget. Dropping publish message.");
         return ESP_FAIL;
     }
     if (g_mqtt_config.publish) {
+        char compressed_topic[MQTT_TOPIC_BUFFER_SIZE];
+        void *compressed = NULL;
+        size_t compressed_len = 0;
+        if (esp_rmaker_mqtt_compress_payload(msg_class, topic, data, data_len, compressed_topic,
+                    sizeof(compressed_topic), &compressed, &compressed_len) == ESP_OK) {
+            topic = compressed_topic;
+            data = compressed;
+            data_len = compressed_len;
+        }
         esp_err_t err = g_mqtt_config.publish(topic, data, data_len, qos, msg_id);
+        if (compressed) {
+            free(compressed);
+        }
         if (err == ESP_OK) {
-            esp_rmaker_mqtt_decrease_budget(1);
+            esp_rmaker_mqtt_consume_class_budget(msg_class);
         }
         return err;
     }
@@ -125,6 +159,12 @@ esp_err_t esp_rmaker_mqtt_publish(const char *topic, void *data, size_t data_len
     return ESP_OK;
 }
 
+esp_err_t esp_rmaker_mqtt_publish(const char *topic, void *data, size_t data_len, uint8_t qos, int *msg_id)
+{
+    return esp_rmaker_mqtt_publish_with_class(topic, data, data_len, qos, msg_id,
+            esp_rmaker_mqtt_get_topic_class(topic));
+}
+
 void esp_rmaker_create_mqtt_topic(char *buf, size_t buf_size, const char *topic_suffix, const char *rule)
 {
 #ifdef CONFIG_ESP_RMAKER_MQTT_USE_BASIC_INGEST_TOPICS
@@ -9,6 +9,9 @@
 #include <esp_log.h>
 #include <esp_err.h>
 #include <stdbool.h>
+#include <string.h>
+#include <esp_rmaker_mqtt.h>
+#include "esp_rmaker_mqtt_budget.h"
 static const char *TAG = "esp_rmaker_mqtt_budget";
 
 #ifdef CONFIG_ESP_RMAKER_MQTT_ENABLE_BUDGETING
@@ -16,6 +19,7 @@ static const char *TAG = "esp_rmaker_mqtt_budget";
 #include <freertos/FreeRTOS.h>
 #include <freertos/timers.h>
 #include <freertos/semphr.h>
+#include "esp_rmaker_mqtt_publish_queue.h"
 
 #define DEFAULT_BUDGET              CONFIG_ESP_RMAKER_MQTT_DEFAULT_BUDGET
 #define MAX_BUDGET                  CONFIG_ESP_RMAKER_MQTT_MAX_BUDGET
@@ -27,6 +31,63 @@ static TimerHandle_t mqtt_budget_timer;
 static SemaphoreHandle_t mqtt_budget_lock;
 #define SEMAPHORE_DELAY_MSEC         500
 
+/* mqtt_budget is the budget of the node, and every message consumes it. Part of it is reserved for each
+ * message class, which only that class can use. The rest of it is shared, and available to all the classes.
+ * A class uses the shared part only after exhausting its own reserve. The reserves are always kept within
+ * mqtt_budget, so the classes do not add to the number of messages the node can send.
+ */
+typedef struct {
+    int16_t budget;
+    esp_rmaker_mqtt_class_budget_config_t config;
+    esp_rmaker_mqtt_class_budget_stats_t stats;
+} mqtt_class_budget_t;
+
+static mqtt_class_budget_t mqtt_class_budget[ESP_RMAKER_MQTT_MSG_CLASS_MAX] = {
+    [ESP_RMAKER_MQTT_MSG_CLASS_ALERT] = {
+        .config = {CONFIG_ESP_RMAKER_MQTT_ALERT_BUDGET, CONFIG_ESP_RMAKER_MQTT_ALERT_BUDGET_REVIVE_COUNT},
+    },
+    [ESP_RMAKER_MQTT_MSG_CLASS_CONTROL_ACK] = {
+        .config = {CONFIG_ESP_RMAKER_MQTT_CONTROL_ACK_BUDGET, CONFIG_ESP_RMAKER_MQTT_CONTROL_ACK_BUDGET_REVIVE_COUNT},
+    },
+    [ESP_RMAKER_MQTT_MSG_CLASS_PARAM_REPORT] = {
+        .config = {CONFIG_ESP_RMAKER_MQTT_PARAM_REPORT_BUDGET, CONFIG_ESP_RMAKER_MQTT_PARAM_REPORT_BUDGET_REVIVE_COUNT},
+    },
+    [ESP_RMAKER_MQTT_MSG_CLASS_TIME_SERIES] = {
+        .config = {CONFIG_ESP_RMAKER_MQTT_TIME_SERIES_BUDGET, CONFIG_ESP_RMAKER_MQTT_TIME_SERIES_BUDGET_REVIVE_COUNT},
+    },
+    [ESP_RMAKER_MQTT_MSG_CLASS_CONFIG] = {
+        .config = {CONFIG_ESP_RMAKER_MQTT_CONFIG_BUDGET, CONFIG_ESP_RMAKER_MQTT_CONFIG_BUDGET_REVIVE_COUNT},
+    },
+};
+
+static bool esp_rmaker_mqtt_is_valid_class(esp_rmaker_mqtt_msg_class_t msg_class)
+{
+    return (msg_class >= 0) && (msg_class < ESP_RMAKER_MQTT_MSG_CLASS_MAX);
+}
+
+/* Should be called with the lock held */
+static int16_t esp_rmaker_mqtt_get_shared_budget(void)
+{
+    int16_t shared_budget = mqtt_budget;
+    for (int i = 0; i < ESP_RMAKER_MQTT_MSG_CLASS_MAX; i++) {
+        shared_budget -= mqtt_class_budget[i].budget;
+    }
+    return shared_budget;
+}
+
+/* Reduces the class reserves, starting from the lowest priority class, so that they fit in the
+ * budget of the node. Should be called with the lock held.
+ */
+static void esp_rmaker_mqtt_fit_class_budgets(void)
+{
+    int16_t excess = -esp_rmaker_mqtt_get_shared_budget();
+    for (int i = ESP_RMAKER_MQTT_MSG_CLASS_MAX - 1; (i >= 0) && (excess > 0); i--) {
+        int16_t reduce = (mqtt_class_budget[i].budget < excess) ? mqtt_class_budget[i].budget : excess;
+        mqtt_class_budget[i].budget -= reduce;
+        excess -= reduce;
+    }
+}
+
 bool esp_rmaker_mqtt_is_budget_available(void)
 {
     if (mqtt_budget_lock == NULL) {
@@ -42,6 +103,108 @@ bool esp_rmaker_mqtt_is_budget_available(void)
     return budget ? true : false;
 }
 
+bool esp_rmaker_mqtt_is_class_budget_available(esp_rmaker_mqtt_msg_class_t msg_class)
+{
+    if (!esp_rmaker_mqtt_is_valid_class(msg_class)) {
+        return false;
+    }
+    if (mqtt_budget_lock == NULL) {
+        ESP_LOGW(TAG, "MQTT budgeting not started yet. Allowing publish.");
+        return true;
+    }
+    if (xSemaphoreTake(mqtt_budget_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS) != pdTRUE) {
+        ESP_LOGW(TAG, "Could not acquire MQTT budget lock. Allowing publish.");
+        return true;
+    }
+    bool available = (mqtt_class_budget[msg_class].budget > 0) || (esp_rmaker_mqtt_get_shared_budget() > 0);
+    if (!available) {
+        mqtt_class_budget[msg_class].stats.exhausted++;
+    }
+    xSemaphoreGive(mqtt_budget_lock);
+    return available;
+}
+
+esp_err_t esp_rmaker_mqtt_consume_class_budget(esp_rmaker_mqtt_msg_class_t msg_class)
+{
+    if (!esp_rmaker_mqtt_is_valid_class(msg_class)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (mqtt_budget_lock == NULL) {
+        ESP_LOGW(TAG, "MQTT budgeting not started. Not decreasing the budget.");
+        return ESP_FAIL;
+    }
+    if (xSemaphoreTake(mqtt_budget_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to decrease MQTT budget.");
+        return ESP_FAIL;
+    }
+    mqtt_class_budget_t *class_budget = &mqtt_class_budget[msg_class];
+    if (class_budget->budget > 0) {
+        class_budget->budget--;
+        mqtt_budget--;
+        class_budget->stats.consumed++;
+    } else if (esp_rmaker_mqtt_get_shared_budget() > 0) {
+        mqtt_budget--;
+        class_budget->stats.borrowed++;
+    }
+    ESP_LOGD(TAG, "MQTT budget for class %d: %d, shared: %d, total: %d.", msg_class, class_budget->budget,
+            esp_rmaker_mqtt_get_shared_budget(), mqtt_budget);
+    xSemaphoreGive(mqtt_budget_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_mqtt_set_class_budget_config(esp_rmaker_mqtt_msg_class_t msg_class,
+        const esp_rmaker_mqtt_class_budget_config_t *config)
+{
+    if (!esp_rmaker_mqtt_is_valid_class(msg_class) || !config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (mqtt_budget_lock && (xSemaphoreTake(mqtt_budget_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS) != pdTRUE)) {
+        ESP_LOGE(TAG, "Failed to set MQTT budget config.");
+        return ESP_FAIL;
+    }
+    mqtt_class_budget_t *class_budget = &mqtt_class_budget[msg_class];
+    class_budget->config = *config;
+    if (class_budget->budget > config->max_budget) {
+        class_budget->budget = config->max_budget;
+    }
+    esp_rmaker_mqtt_fit_class_budgets();
+    if (mqtt_budget_lock) {
+        xSemaphoreGive(mqtt_budget_lock);
+    }
+    ESP_LOGI(TAG, "MQTT budget for class %d set to max: %d, revive count: %d.",
+            msg_class, config->max_budget, config->revive_count);
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_mqtt_get_class_budget_config(esp_rmaker_mqtt_msg_class_t msg_class,
+        esp_rmaker_mqtt_class_budget_config_t *config)
+{
+    if (!esp_rmaker_mqtt_is_valid_class(msg_class) || !config) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *config = mqtt_class_budget[msg_class].config;
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_mqtt_get_class_budget_stats(esp_rmaker_mqtt_msg_class_t msg_class,
+        esp_rmaker_mqtt_class_budget_stats_t *stats)
+{
+    if (!esp_rmaker_mqtt_is_valid_class(msg_class) || !stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (mqtt_budget_lock == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xSemaphoreTake(mqtt_budget_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS) != pdTRUE) {
+        return ESP_FAIL;
+    }
+    *stats = mqtt_class_budget[msg_class].stats;
+    stats->budget = mqtt_class_budget[msg_class].budget;
+    stats->shared_budget = esp_rmaker_mqtt_get_shared_budget();
+    xSemaphoreGive(mqtt_budget_lock);
+    return ESP_OK;
+}
+
 esp_err_t esp_rmaker_mqtt_increase_budget(uint8_t budget)
 {
     if (mqtt_budget_lock == NULL) {
@@ -75,14 +238,36 @@ esp_err_t esp_rmaker_mqtt_decrease_budget(uint8_t budget)
     if (mqtt_budget < 0) {
         mqtt_budget = 0;
     }
+    esp_rmaker_mqtt_fit_class_budgets();
     xSemaphoreGive(mqtt_budget_lock);
     ESP_LOGD(TAG, "MQTT budget decreased to %d.", mqtt_budget);
     return ESP_OK;
 }
 
+static void esp_rmaker_mqtt_revive_class_budgets(void)
+{
+    if (xSemaphoreTake(mqtt_budget_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS) != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to revive MQTT class budgets.");
+        return;
+    }
+    for (int i = 0; i < ESP_RMAKER_MQTT_MSG_CLASS_MAX; i++) {
+        mqtt_class_budget_t *class_budget = &mqtt_class_budget[i];
+        class_budget->budget += class_budget->config.revive_count;
+        if (class_budget->budget > class_budget->config.max_budget) {
+            class_budget->budget = class_budget->config.max_budget;
+        }
+    }
+    /* The reserves are revived out of the budget of the node, and not in addition to it */
+    esp_rmaker_mqtt_fit_class_budgets();
+    xSemaphoreGive(mqtt_budget_lock);
+}
+
 static void esp_rmaker_mqtt_revive_budget(TimerHandle_t handle)
 {
     esp_rmaker_mqtt_increase_budget(BUDGET_REVIVE_COUNT);
+    esp_rmaker_mqtt_revive_class_budgets();
+    /* Send out the messages which were queued for want of budget */
+    esp_rmaker_mqtt_publish_queue_kick();
 }
 
 esp_err_t esp_rmaker_mqtt_budgeting_start(void)
@@ -128,6 +313,11 @@ esp_err_t esp_rmaker_mqtt_budgeting_init(void)
     if (!mqtt_budget_lock) {
         return ESP_FAIL;
     }
+    for (int i = 0; i < ESP_RMAKER_MQTT_MSG_CLASS_MAX; i++) {
+        mqtt_class_budget[i].budget = mqtt_class_budget[i].config.max_budget;
+        memset(&mqtt_class_budget[i].stats, 0, sizeof(mqtt_class_budget[i].stats));
+    }
+    esp_rmaker_mqtt_fit_class_budgets();
 
     mqtt_budget_timer = xTimerCreate("mqtt_budget_tm", (BUDGET_REVIVE_PERIOD * 1000) / portTICK_PERIOD_MS,
                             pdTRUE, NULL, esp_rmaker_mqtt_revive_budget);
@@ -180,4 +370,32 @@ bool esp_rmaker_mqtt_is_budget_available(void)
     return true;
 }
 
+bool esp_rmaker_mqtt_is_class_budget_available(esp_rmaker_mqtt_msg_class_t msg_class)
+{
+    return true;
+}
+
+esp_err_t esp_rmaker_mqtt_consume_class_budget(esp_rmaker_mqtt_msg_class_t msg_class)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_mqtt_set_class_budget_config(esp_rmaker_mqtt_msg_class_t msg_class,
+        const esp_rmaker_mqtt_class_budget_config_t *config)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_rmaker_mqtt_get_class_budget_config(esp_rmaker_mqtt_msg_class_t msg_class,
+        esp_rmaker_mqtt_class_budget_config_t *config)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_rmaker_mqtt_get_class_budget_stats(esp_rmaker_mqtt_msg_class_t msg_class,
+        esp_rmaker_mqtt_class_budget_stats_t *stats)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
 #endif /* ! CONFIG_ESP_RMAKER_MQTT_ENABLE_BUDGETING */
@@ -8,6 +8,7 @@
 
 #include <stdint.h>
 #include <esp_err.h>
+#include <esp_rmaker_mqtt.h>
 
 esp_err_t esp_rmaker_mqtt_budgeting_init(void);
 esp_err_t esp_rmaker_mqtt_budgeting_deinit(void);
@@ -15,3 +16,7 @@ esp_err_t esp_rmaker_mqtt_budgeting_stop(void);
 esp_err_t esp_rmaker_mqtt_budgeting_start(void);
 esp_err_t esp_rmaker_mqtt_increase_budget(uint8_t budget);
 esp_err_t esp_rmaker_mqtt_decrease_budget(uint8_t budget);
+/* Consumes one unit of budget for a message of the given class, from the class budget if available,
+ * else from the shared budget.
+ */
+esp_err_t esp_rmaker_mqtt_consume_class_budget(esp_rmaker_mqtt_msg_class_t msg_class);
@@ -0,0 +1,248 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* MQTT payload compression. Large payloads, like the node config or a params report carrying the
+ * schedules, are compressed into a heatshrink (LZSS) stream before publishing. Since the complete
+ * payload is already in RAM, it serves as the sliding window itself and the only memory needed is
+ * the output buffer.
+ */
+
+#include <sdkconfig.h>
+#include <string.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <esp_log.h>
+#include <esp_err.h>
+#include <esp_rmaker_mqtt.h>
+#include "esp_rmaker_mqtt_compress.h"
+
+#ifdef CONFIG_ESP_RMAKER_MQTT_COMPRESSION
+
+#include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+#include <esp_rmaker_utils.h>
+
+static const char *TAG = "esp_rmaker_mqtt_compress";
+
+#define WINDOW_BITS         CONFIG_ESP_RMAKER_MQTT_COMPRESSION_WINDOW_BITS
+#define LOOKAHEAD_BITS      CONFIG_ESP_RMAKER_MQTT_COMPRESSION_LOOKAHEAD_BITS
+#define WINDOW_SIZE         (1 << WINDOW_BITS)
+#define LOOKAHEAD_SIZE      (1 << LOOKAHEAD_BITS)
+/* A literal takes 9 bits per byte and a back-reference takes 1 + WINDOW_BITS + LOOKAHEAD_BITS bits */
+#define BACKREF_BITS        (1 + WINDOW_BITS + LOOKAHEAD_BITS)
+#define STR(x)              #x
+#define XSTR(x)             STR(x)
+#define TOPIC_SUFFIX        "/hs-" XSTR(WINDOW_BITS) "-" XSTR(LOOKAHEAD_BITS)
+
+#if LOOKAHEAD_BITS >= WINDOW_BITS
+#error "CONFIG_ESP_RMAKER_MQTT_COMPRESSION_LOOKAHEAD_BITS should be less than the window bits"
+#endif
+
+typedef struct {
+    uint8_t *buf;
+    size_t buf_size;
+    size_t len;
+    uint8_t cur;
+    uint8_t bits;
+} bit_writer_t;
+
+static esp_rmaker_mqtt_compress_stats_t compress_stats;
+static portMUX_TYPE compress_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Writes the count least significant bits of val, most significant bit first, as heatshrink expects */
+static bool esp_rmaker_mqtt_compress_put_bits(bit_writer_t *w, uint16_t val, uint8_t count)
+{
+    for (int i = count - 1; i >= 0; i--) {
+        w->cur = (w->cur << 1) | ((val >> i) & 1);
+        if (++w->bits == 8) {
+            if (w->len >= w->buf_size) {
+                return false;
+            }
+            w->buf[w->len++] = w->cur;
+            w->cur = 0;
+            w->bits = 0;
+        }
+    }
+    return true;
+}
+
+static bool esp_rmaker_mqtt_compress_flush_bits(bit_writer_t *w)
+{
+    if (w->bits == 0) {
+        return true;
+    }
+    if (w->len >= w->buf_size) {
+        return false;
+    }
+    /* Pad with 0s. The decoder treats the trailing bits as an incomplete back-reference and ignores them. */
+    w->buf[w->len++] = w->cur << (8 - w->bits);
+    w->cur = 0;
+    w->bits = 0;
+    return true;
+}
+
+/* Finds the longest match for the data at pos, within the preceding window. Closer matches are preferred
+ * for equal lengths. Matches may overlap pos, which the decoder handles since it copies byte by byte.
+ */
+static size_t esp_rmaker_mqtt_compress_find_match(const uint8_t *data, size_t data_len, size_t pos, size_t *offset)
+{
+    size_t start = (pos > WINDOW_SIZE) ? pos - WINDOW_SIZE : 0;
+    size_t max_len = data_len - pos;
+    if (max_len > LOOKAHEAD_SIZE) {
+        max_len = LOOKAHEAD_SIZE;
+    }
+    size_t best_len = 0;
+    for (size_t cand = pos; cand-- > start; ) {
+        if (data[cand] != data[pos]) {
+            continue;
+        }
+        size_t len = 1;
+        while ((len < max_len) && (data[cand + len] == data[pos + len])) {
+            len++;
+        }
+        if (len > best_len) {
+            best_len = len;
+            *offset = pos - cand;
+            if (len == max_len) {
+                break;
+            }
+        }
+    }
+    return best_len;
+}
+
+esp_err_t esp_rmaker_mqtt_compress(const void *data, size_t data_len, void *out, size_t *out_len)
+{
+    if (!data || !out || !out_len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    const uint8_t *in = (const uint8_t *)data;
+    bit_writer_t w = {
+        .buf = (uint8_t *)out,
+        .buf_size = *out_len,
+    };
+    size_t pos = 0;
+    while (pos < data_len) {
+        size_t offset = 0;
+        size_t match_len = esp_rmaker_mqtt_compress_find_match(in, data_len, pos, &offset);
+        bool ok;
+        if (BACKREF_BITS < (9 * match_len)) {
+            ok = esp_rmaker_mqtt_compress_put_bits(&w, 0, 1) &&
+                esp_rmaker_mqtt_compress_put_bits(&w, offset - 1, WINDOW_BITS) &&
+                esp_rmaker_mqtt_compress_put_bits(&w, match_len - 1, LOOKAHEAD_BITS);
+            pos += match_len;
+        } else {
+            ok = esp_rmaker_mqtt_compress_put_bits(&w, 1, 1) &&
+                esp_rmaker_mqtt_compress_put_bits(&w, in[pos], 8);
+            pos++;
+        }
+        if (!ok) {
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+    if (!esp_rmaker_mqtt_compress_flush_bits(&w)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *out_len = w.len;
+    return ESP_OK;
+}
+
+static bool esp_rmaker_mqtt_compress_class_enabled(esp_rmaker_mqtt_msg_class_t msg_class)
+{
+    switch (msg_class) {
+#ifdef CONFIG_ESP_RMAKER_MQTT_COMPRESS_CONFIG
+        case ESP_RMAKER_MQTT_MSG_CLASS_CONFIG:
+            return true;
+#endif
+#ifdef CONFIG_ESP_RMAKER_MQTT_COMPRESS_PARAM_REPORT
+        case ESP_RMAKER_MQTT_MSG_CLASS_PARAM_REPORT:
+            return true;
+#endif
+#ifdef CONFIG_ESP_RMAKER_MQTT_COMPRESS_TIME_SERIES
+        case ESP_RMAKER_MQTT_MSG_CLASS_TIME_SERIES:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+esp_err_t esp_rmaker_mqtt_compress_payload(esp_rmaker_mqtt_msg_class_t msg_class, const char *topic,
+        const void *data, size_t data_len, char *out_topic, size_t out_topic_size,
+        void **out_data, size_t *out_data_len)
+{
+    if (!topic || !data || !out_topic || !out_data || !out_data_len) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if ((data_len < CONFIG_ESP_RMAKER_MQTT_COMPRESSION_MIN_SIZE) || !esp_rmaker_mqtt_compress_class_enabled(msg_class)) {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (snprintf(out_topic, out_topic_size, "%s" TOPIC_SUFFIX, topic) >= out_topic_size) {
+        ESP_LOGW(TAG, "No room for compression suffix in %s.", topic);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    /* Only worth it if the payload gets smaller, so the output buffer need not be any larger */
+    size_t out_len = data_len - 1;
+    void *out = MEM_ALLOC_EXTRAM(out_len);
+    if (!out) {
+        ESP_LOGW(TAG, "Failed to allocate %d bytes for compression.", (int)out_len);
+        return ESP_ERR_NO_MEM;
+    }
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = esp_rmaker_mqtt_compress(data, data_len, out, &out_len);
+    uint32_t time_us = (uint32_t)(esp_timer_get_time() - start);
+    portENTER_CRITICAL(&compress_lock);
+    compress_stats.bytes_in += data_len;
+    compress_stats.time_us += time_us;
+    if (err == ESP_OK) {
+        compress_stats.compressed++;
+        compress_stats.bytes_out += out_len;
+    } else {
+        compress_stats.incompressible++;
+        compress_stats.bytes_out += data_len;
+    }
+    portEXIT_CRITICAL(&compress_lock);
+    if (err != ESP_OK) {
+        free(out);
+        return err;
+    }
+    ESP_LOGD(TAG, "Compressed %d bytes to %d for %s in %"PRIu32" us.", (int)data_len, (int)out_len, topic, time_us);
+    *out_data = out;
+    *out_data_len = out_len;
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_mqtt_compress_get_stats(esp_rmaker_mqtt_compress_stats_t *stats)
+{
+    if (!stats) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&compress_lock);
+    *stats = compress_stats;
+    portEXIT_CRITICAL(&compress_lock);
+    return ESP_OK;
+}
+
+#else /* ! CONFIG_ESP_RMAKER_MQTT_COMPRESSION */
+
+esp_err_t esp_rmaker_mqtt_compress(const void *data, size_t data_len, void *out, size_t *out_len)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_rmaker_mqtt_compress_payload(esp_rmaker_mqtt_msg_class_t msg_class, const char *topic,
+        const void *data, size_t data_len, char *out_topic, size_t out_topic_size,
+        void **out_data, size_t *out_data_len)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_rmaker_mqtt_compress_get_stats(esp_rmaker_mqtt_compress_stats_t *stats)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif /* ! CONFIG_ESP_RMAKER_MQTT_COMPRESSION */
@@ -0,0 +1,19 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <esp_err.h>
+#include <esp_rmaker_mqtt.h>
+
+/* Compresses the payload if compression is enabled for the message class and the payload is large enough.
+ * On success, *out_data points to the compressed payload, which should be freed by the caller, and out_topic
+ * holds the topic to publish it on. Returns an error if the message should just be published as is.
+ */
+esp_err_t esp_rmaker_mqtt_compress_payload(esp_rmaker_mqtt_msg_class_t msg_class, const char *topic,
+        const void *data, size_t data_len, char *out_topic, size_t out_topic_size,
+        void **out_data, size_t *out_data_len);
@@ -0,0 +1,227 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* In-process MQTT stand-in. Instead of connecting to a broker, this delivers the messages published
+ * by the node to the node's own matching subscriptions, and lets the messages which would have come
+ * from the cloud be injected directly. This allows the parse, report and schedule paths to be exercised
+ * and benchmarked without any network.
+ */
+
+#include <sdkconfig.h>
+#include <string.h>
+#include <stdbool.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_log.h>
+#include <esp_err.h>
+#include <esp_event.h>
+#include <esp_rmaker_utils.h>
+#include <esp_rmaker_common_events.h>
+#include <esp_rmaker_mqtt_glue.h>
+#include <esp_rmaker_mqtt.h>
+
+static const char *TAG = "esp_rmaker_mqtt_loopback";
+
+#define MAX_SUBSCRIPTIONS       CONFIG_ESP_RMAKER_MQTT_LOOPBACK_MAX_SUBSCRIPTIONS
+
+typedef struct {
+    char *topic;
+    esp_rmaker_mqtt_subscribe_cb_t cb;
+    void *priv_data;
+} loopback_subscription_t;
+
+static loopback_subscription_t subscriptions[MAX_SUBSCRIPTIONS];
+static SemaphoreHandle_t loopback_lock;
+static bool loopback_connected;
+static int loopback_msg_id;
+static esp_rmaker_mqtt_loopback_publish_cb_t loopback_publish_cb;
+static void *loopback_publish_cb_priv;
+
+/* MQTT topic filter matching, with support for the '+' and '#' wildcards */
+static bool esp_rmaker_mqtt_loopback_topic_matches(const char *filter, const char *topic)
+{
+    while (*filter && *topic) {
+        if (*filter == '#') {
+            return true;
+        }
+        if (*filter == '+') {
+            while (*topic && *topic != '/') {
+                topic++;
+            }
+            filter++;
+            continue;
+        }
+        if (*filter != *topic) {
+            return false;
+        }
+        filter++;
+        topic++;
+    }
+    /* "a/#" also matches "a" */
+    if ((strcmp(filter, "/#") == 0) || (strcmp(filter, "#") == 0)) {
+        return true;
+    }
+    return (*filter == '\0') && (*topic == '\0');
+}
+
+static esp_err_t esp_rmaker_mqtt_loopback_deliver(const char *topic, const void *data, size_t data_len)
+{
+    loopback_subscription_t matched[MAX_SUBSCRIPTIONS];
+    int matched_count = 0;
+    xSemaphoreTake(loopback_lock, portMAX_DELAY);
+    for (int i = 0; i < MAX_SUBSCRIPTIONS; i++) {
+        if (subscriptions[i].topic && esp_rmaker_mqtt_loopback_topic_matches(subscriptions[i].topic, topic)) {
+            matched[matched_count++] = subscriptions[i];
+        }
+    }
+    xSemaphoreGive(loopback_lock);
+    /* Callbacks are invoked outside the lock, since they may subscribe or publish */
+    for (int i = 0; i < matched_count; i++) {
+        /* Each subscriber gets its own copy, like it would from a real MQTT client */
+        char *payload = MEM_ALLOC_EXTRAM(data_len + 1);
+        if (!payload) {
+            ESP_LOGE(TAG, "Failed to allocate %d bytes for payload on %s.", data_len, topic);
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(payload, data, data_len);
+        payload[data_len] = '\0';
+        matched[i].cb(topic, payload, data_len, matched[i].priv_data);
+        free(payload);
+    }
+    return ESP_OK;
+}
+
+static esp_err_t esp_rmaker_mqtt_loopback_init(esp_rmaker_mqtt_conn_params_t *conn_params)
+{
+    if (!loopback_lock) {
+        loopback_lock = xSemaphoreCreateMutex();
+        if (!loopback_lock) {
+            ESP_LOGE(TAG, "Failed to create loopback lock.");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    ESP_LOGI(TAG, "Initialised MQTT loopback. Messages will not leave the node.");
+    return ESP_OK;
+}
+
+static void esp_rmaker_mqtt_loopback_deinit(void)
+{
+    if (!loopback_lock) {
+        return;
+    }
+    for (int i = 0; i < MAX_SUBSCRIPTIONS; i++) {
+        if (subscriptions[i].topic) {
+            free(subscriptions[i].topic);
+        }
+    }
+    memset(subscriptions, 0, sizeof(subscriptions));
+    vSemaphoreDelete(loopback_lock);
+    loopback_lock = NULL;
+}
+
+static esp_err_t esp_rmaker_mqtt_loopback_connect(void)
+{
+    loopback_connected = true;
+    return esp_event_post(RMAKER_COMMON_EVENT, RMAKER_MQTT_EVENT_CONNECTED, NULL, 0, portMAX_DELAY);
+}
+
+static esp_err_t esp_rmaker_mqtt_loopback_disconnect(void)
+{
+    loopback_connected = false;
+    return esp_event_post(RMAKER_COMMON_EVENT, RMAKER_MQTT_EVENT_DISCONNECTED, NULL, 0, portMAX_DELAY);
+}
+
+static esp_err_t esp_rmaker_mqtt_loopback_subscribe(const char *topic, esp_rmaker_mqtt_subscribe_cb_t cb, uint8_t qos, void *priv_data)
+{
+    if (!loopback_lock || !topic || !cb) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = ESP_ERR_NO_MEM;
+    xSemaphoreTake(loopback_lock, portMAX_DELAY);
+    for (int i = 0; i < MAX_SUBSCRIPTIONS; i++) {
+        if (!subscriptions[i].topic) {
+            subscriptions[i].topic = strdup(topic);
+            if (subscriptions[i].topic) {
+                subscriptions[i].cb = cb;
+                subscriptions[i].priv_data = priv_data;
+                err = ESP_OK;
+            }
+            break;
+        }
+    }
+    xSemaphoreGive(loopback_lock);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to subscribe to %s.", topic);
+    }
+    return err;
+}
+
+static esp_err_t esp_rmaker_mqtt_loopback_unsubscribe(const char *topic)
+{
+    if (!loopback_lock || !topic) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(loopback_lock, portMAX_DELAY);
+    for (int i = 0; i < MAX_SUBSCRIPTIONS; i++) {
+        if (subscriptions[i].topic && (strcmp(subscriptions[i].topic, topic) == 0)) {
+            free(subscriptions[i].topic);
+            memset(&subscriptions[i], 0, sizeof(loopback_subscription_t));
+        }
+    }
+    xSemaphoreGive(loopback_lock);
+    return ESP_OK;
+}
+
+static esp_err_t esp_rmaker_mqtt_loopback_publish(const char *topic, void *data, size_t data_len, uint8_t qos, int *msg_id)
+{
+    if (!loopback_connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int id = ++loopback_msg_id;
+    if (msg_id) {
+        *msg_id = id;
+    }
+    if (loopback_publish_cb) {
+        loopback_publish_cb(topic, data, data_len, loopback_publish_cb_priv);
+    }
+    esp_rmaker_mqtt_loopback_deliver(topic, data, data_len);
+    if (qos > 0) {
+        esp_event_post(RMAKER_COMMON_EVENT, RMAKER_MQTT_EVENT_PUBLISHED, &id, sizeof(id), portMAX_DELAY);
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_mqtt_loopback_setup(void)
+{
+    esp_rmaker_mqtt_config_t mqtt_config = {
+        .init = esp_rmaker_mqtt_loopback_init,
+        .deinit = esp_rmaker_mqtt_loopback_deinit,
+        .connect = esp_rmaker_mqtt_loopback_connect,
+        .disconnect = esp_rmaker_mqtt_loopback_disconnect,
+        .publish = esp_rmaker_mqtt_loopback_publish,
+        .subscribe = esp_rmaker_mqtt_loopback_subscribe,
+        .unsubscribe = esp_rmaker_mqtt_loopback_unsubscribe,
+    };
+    return esp_rmaker_mqtt_setup(mqtt_config);
+}
+
+esp_err_t esp_rmaker_mqtt_loopback_inject(const char *topic, const void *data, size_t data_len)
+{
+    if (!topic || !data) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!loopback_connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_rmaker_mqtt_loopback_deliver(topic, data, data_len);
+}
+
+esp_err_t esp_rmaker_mqtt_loopback_set_publish_cb(esp_rmaker_mqtt_loopback_publish_cb_t cb, void *priv_data)
+{
+    loopback_publish_cb = cb;
+    loopback_publish_cb_priv = priv_data;
+    return ESP_OK;
+}
@@ -0,0 +1,488 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <sdkconfig.h>
+#include <string.h>
+#include <stdbool.h>
+#include <esp_log.h>
+#include <esp_err.h>
+#include <esp_rmaker_mqtt.h>
+#include "esp_rmaker_mqtt_topics.h"
+#include "esp_rmaker_mqtt_publish_queue.h"
+
+static const char *TAG = "esp_rmaker_mqtt_pubq";
+
+static const char *msg_class_str[ESP_RMAKER_MQTT_MSG_CLASS_MAX] = {
+    [ESP_RMAKER_MQTT_MSG_CLASS_ALERT] = "alert",
+    [ESP_RMAKER_MQTT_MSG_CLASS_CONTROL_ACK] = "control_ack",
+    [ESP_RMAKER_MQTT_MSG_CLASS_PARAM_REPORT] = "param_report",
+    [ESP_RMAKER_MQTT_MSG_CLASS_TIME_SERIES] = "time_series",
+    [ESP_RMAKER_MQTT_MSG_CLASS_CONFIG] = "config",
+};
+
+const char *esp_rmaker_mqtt_msg_class_to_str(esp_rmaker_mqtt_msg_class_t msg_class)
+{
+    if ((msg_class < 0) || (msg_class >= ESP_RMAKER_MQTT_MSG_CLASS_MAX)) {
+        return "invalid";
+    }
+    return msg_class_str[msg_class];
+}
+
+static bool esp_rmaker_mqtt_topic_ends_with(const char *topic, const char *suffix)
+{
+    size_t topic_len = strlen(topic);
+    size_t suffix_len = strlen(suffix);
+    return (topic_len >= suffix_len) && (strcmp(topic + topic_len - suffix_len, suffix) == 0);
+}
+
+esp_rmaker_mqtt_msg_class_t esp_rmaker_mqtt_get_topic_class(const char *topic)
+{
+    if (!topic) {
+        return ESP_RMAKER_MQTT_MSG_CLASS_CONTROL_ACK;
+    }
+    if (esp_rmaker_mqtt_topic_ends_with(topic, "/" NODE_PARAMS_ALERT_TOPIC_SUFFIX)) {
+        return ESP_RMAKER_MQTT_MSG_CLASS_ALERT;
+    } else if (esp_rmaker_mqtt_topic_ends_with(topic, "/" NODE_PARAMS_LOCAL_TOPIC_SUFFIX) ||
+            esp_rmaker_mqtt_topic_ends_with(topic, "/" NODE_PARAMS_LOCAL_INIT_TOPIC_SUFFIX)) {
+        return ESP_RMAKER_MQTT_MSG_CLASS_PARAM_REPORT;
+    } else if (esp_rmaker_mqtt_topic_ends_with(topic, "/" TIME_SERIES_DATA_TOPIC_SUFFIX) ||
+            esp_rmaker_mqtt_topic_ends_with(topic, "/" SIMPLE_TS_DATA_TOPIC_SUFFIX) ||
+            esp_rmaker_mqtt_topic_ends_with(topic, "/" INSIGHTS_TOPIC_SUFFIX)) {
+        return ESP_RMAKER_MQTT_MSG_CLASS_TIME_SERIES;
+    } else if (esp_rmaker_mqtt_topic_ends_with(topic, "/" NODE_CONFIG_TOPIC_SUFFIX)) {
+        return ESP_RMAKER_MQTT_MSG_CLASS_CONFIG;
+    }
+    /* Command responses, OTA status/fetch, user mapping and anything else */
+    return ESP_RMAKER_MQTT_MSG_CLASS_CONTROL_ACK;
+}
+
+#ifdef CONFIG_ESP_RMAKER_MQTT_PUBLISH_QUEUE
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_rmaker_utils.h>
+#include <esp_rmaker_work_queue_prio.h>
+
+#define CLASS_QUEUE_SIZE        CONFIG_ESP_RMAKER_MQTT_PUBLISH_QUEUE_CLASS_SIZE
+#define SEMAPHORE_DELAY_MSEC    500
+/* Classes up to this one are drained at control priority, so that they do not wait behind reports */
+#define PUBQ_URGENT_CLASS_LAST  ESP_RMAKER_MQTT_MSG_CLASS_CONTROL_ACK
+
+typedef enum {
+    PUBQ_DRAIN_URGENT = 0,
+    PUBQ_DRAIN_REGULAR,
+    PUBQ_DRAIN_MAX,
+} pubq_drain_type_t;
+
+typedef enum {
+    /* Reject the new message. Used where older messages are as important as newer ones. */
+    PUBQ_POLICY_DROP_NEWEST,
+    /* Evict the oldest message. Used where newer data is more useful than older. */
+    PUBQ_POLICY_DROP_OLDEST,
+    /* Replace a queued message for the same topic, since only the latest one matters.
+     * Falls back to evicting the oldest message if there is no such message.
+     */
+    PUBQ_POLICY_REPLACE_SAME_TOPIC,
+} pubq_policy_t;
+
+static const pubq_policy_t class_policy[ESP_RMAKER_MQTT_MSG_CLASS_MAX] = {
+    [ESP_RMAKER_MQTT_MSG_CLASS_ALERT] = PUBQ_POLICY_DROP_NEWEST,
+    [ESP_RMAKER_MQTT_MSG_CLASS_CONTROL_ACK] = PUBQ_POLICY_DROP_NEWEST,
+    /* Regular param reports are deferred rather than queued. See esp_rmaker_mqtt_publish_queue_defer() */
+    [ESP_RMAKER_MQTT_MSG_CLASS_PARAM_REPORT] = PUBQ_POLICY_REPLACE_SAME_TOPIC,
+    [ESP_RMAKER_MQTT_MSG_CLASS_TIME_SERIES] = PUBQ_POLICY_DROP_OLDEST,
+    [ESP_RMAKER_MQTT_MSG_CLASS_CONFIG] = PUBQ_POLICY_REPLACE_SAME_TOPIC,
+};
+
+typedef struct {
+    /* Copies of the topic and data. topic is NULL for deferred entries. */
+    char *topic;
+    void *data;
+    size_t data_len;
+    uint8_t qos;
+    /* Called with the message id once a queued message is sent. Optional. */
+    esp_rmaker_mqtt_published_cb_t published_cb;
+    /* Generates and publishes the message, for deferred entries */
+    esp_rmaker_mqtt_deferred_publish_cb_t cb;
+    void *priv_data;
+} pubq_entry_t;
+
+typedef struct {
+    pubq_entry_t entries[CLASS_QUEUE_SIZE];
+    uint8_t count;
+    esp_rmaker_mqtt_publish_queue_stats_t stats;
+} pubq_class_t;
+
+static pubq_class_t pubq[ESP_RMAKER_MQTT_MSG_CLASS_MAX];
+static SemaphoreHandle_t pubq_lock;
+static bool drain_scheduled[PUBQ_DRAIN_MAX];
+
+static void pubq_entry_free(pubq_entry_t *entry)
+{
+    if (entry->topic) {
+        free(entry->topic);
+    }
+    if (entry->data) {
+        free(entry->data);
+    }
+    memset(entry, 0, sizeof(pubq_entry_t));
+}
+
+static void pubq_remove(pubq_class_t *q, int index)
+{
+    memmove(&q->entries[index], &q->entries[index + 1], (q->count - index - 1) * sizeof(pubq_entry_t));
+    q->count--;
+    memset(&q->entries[q->count], 0, sizeof(pubq_entry_t));
+}
+
+static void pubq_append(pubq_class_t *q, pubq_entry_t *entry)
+{
+    q->entries[q->count++] = *entry;
+    q->stats.queued++;
+    if (q->count > q->stats.max_depth) {
+        q->stats.max_depth = q->count;
+    }
+}
+
+/* Should be called with pubq_lock held. Takes ownership of the entry only on success. */
+static esp_err_t pubq_add(esp_rmaker_mqtt_msg_class_t msg_class, pubq_entry_t *entry)
+{
+    pubq_class_t *q = &pubq[msg_class];
+    pubq_policy_t policy = class_policy[msg_class];
+    if (policy == PUBQ_POLICY_REPLACE_SAME_TOPIC) {
+        for (int i = 0; i < q->count; i++) {
+            if (q->entries[i].topic && (strcmp(q->entries[i].topic, entry->topic) == 0)) {
+                free(q->entries[i].topic);
+                free(q->entries[i].data);
+                q->entries[i] = *entry;
+                q->stats.coalesced++;
+                return ESP_OK;
+            }
+        }
+    }
+    if (q->count < CLASS_QUEUE_SIZE) {
+        pubq_append(q, entry);
+        return ESP_OK;
+    }
+    if (policy != PUBQ_POLICY_DROP_NEWEST) {
+        /* Deferred entries are not evicted, since they stand for all the pending updates */
+        for (int i = 0; i < q->count; i++) {
+            if (q->entries[i].topic) {
+                ESP_LOGW(TAG, "Queue for %s full. Dropping oldest message on %s.",
+                        msg_class_str[msg_class], q->entries[i].topic);
+                pubq_entry_free(&q->entries[i]);
+                pubq_remove(q, i);
+                q->stats.dropped++;
+                pubq_append(q, entry);
+                return ESP_OK;
+            }
+        }
+    }
+    q->stats.dropped++;
+    return ESP_ERR_NO_MEM;
+}
+
+/* priv_data is the pubq_drain_type_t. An urgent drain only sends the urgent classes, whereas a regular
+ * one sends all the classes, in the order of priority.
+ */
+static void pubq_drain(void *priv_data)
+{
+    pubq_drain_type_t drain_type = (pubq_drain_type_t)(intptr_t)priv_data;
+    int class_max = (drain_type == PUBQ_DRAIN_URGENT) ? (PUBQ_URGENT_CLASS_LAST + 1) : ESP_RMAKER_MQTT_MSG_CLASS_MAX;
+    xSemaphoreTake(pubq_lock, portMAX_DELAY);
+    drain_scheduled[drain_type] = false;
+    xSemaphoreGive(pubq_lock);
+    while (1) {
+        pubq_entry_t entry;
+        int msg_class;
+        bool pending[ESP_RMAKER_MQTT_MSG_CLASS_MAX];
+        xSemaphoreTake(pubq_lock, portMAX_DELAY);
+        for (msg_class = 0; msg_class < class_max; msg_class++) {
+            pending[msg_class] = pubq[msg_class].count ? true : false;
+        }
+        xSemaphoreGive(pubq_lock);
+        /* Highest priority class which has messages pending, as well as budget to send them */
+        for (msg_class = 0; msg_class < class_max; msg_class++) {
+            if (pending[msg_class] && esp_rmaker_mqtt_is_class_budget_available(msg_class)) {
+                break;
+            }
+        }
+        if (msg_class == class_max) {
+            break;
+        }
+        pubq_class_t *q = &pubq[msg_class];
+        xSemaphoreTake(pubq_lock, portMAX_DELAY);
+        if (q->count == 0) {
+            xSemaphoreGive(pubq_lock);
+            continue;
+        }
+        entry = q->entries[0];
+        pubq_remove(q, 0);
+        xSemaphoreGive(pubq_lock);
+        esp_err_t err = ESP_OK;
+        if (entry.topic) {
+            int msg_id = -1;
+            err = esp_rmaker_mqtt_publish_direct(entry.topic, entry.data, entry.data_len, entry.qos,
+                    entry.published_cb ? &msg_id : NULL, msg_class);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to publish queued message on %s.", entry.topic);
+            } else if (entry.published_cb) {
+                entry.published_cb(msg_id, entry.priv_data);
+            }
+            pubq_entry_free(&entry);
+        } else {
+            entry.cb(entry.priv_data);
+        }
+        xSemaphoreTake(pubq_lock, portMAX_DELAY);
+        if (err == ESP_OK) {
+            q->stats.sent++;
+        } else {
+            q->stats.dropped++;
+        }
+        xSemaphoreGive(pubq_lock);
+    }
+}
+
+void esp_rmaker_mqtt_publish_queue_kick(void)
+{
+    if (!pubq_lock) {
+        return;
+    }
+    if (xSemaphoreTake(pubq_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS) != pdTRUE) {
+        return;
+    }
+    bool pending[PUBQ_DRAIN_MAX] = {false};
+    for (int i = 0; i < ESP_RMAKER_MQTT_MSG_CLASS_MAX; i++) {
+        if (pubq[i].count) {
+            pending[(i <= PUBQ_URGENT_CLASS_LAST) ? PUBQ_DRAIN_URGENT : PUBQ_DRAIN_REGULAR] = true;
+        }
+    }
+    /* Alerts and acknowledgements should not wait for the reports scheduled before them */
+    if (pending[PUBQ_DRAIN_URGENT] && !drain_scheduled[PUBQ_DRAIN_URGENT]) {
+        if (esp_rmaker_work_queue_add_prio_task(pubq_drain, (void *)(intptr_t)PUBQ_DRAIN_URGENT,
+                    ESP_RMAKER_WORK_CLASS_CONTROL, 0) == ESP_OK) {
+            drain_scheduled[PUBQ_DRAIN_URGENT] = true;
+        }
+    }
+    if (pending[PUBQ_DRAIN_REGULAR] && !drain_scheduled[PUBQ_DRAIN_REGULAR]) {
+        if (esp_rmaker_work_queue_add_prio_task(pubq_drain, (void *)(intptr_t)PUBQ_DRAIN_REGULAR,
+                    ESP_RMAKER_WORK_CLASS_REPORT, 0) == ESP_OK) {
+            drain_scheduled[PUBQ_DRAIN_REGULAR] = true;
+        }
+    }
+    xSemaphoreGive(pubq_lock);
+}
+
+static esp_err_t pubq_publish(const char *topic, void *data, size_t data_len, uint8_t qos,
+        esp_rmaker_mqtt_msg_class_t msg_class, esp_rmaker_mqtt_published_cb_t published_cb, void *priv_data)
+{
+    xSemaphoreTake(pubq_lock, portMAX_DELAY);
+    bool pending = pubq[msg_class].count ? true : false;
+    xSemaphoreGive(pubq_lock);
+    bool budget_available = esp_rmaker_mqtt_is_class_budget_available(msg_class);
+    /* Messages of a class are not allowed to overtake the ones already queued */
+    if (!pending && budget_available) {
+        int msg_id = -1;
+        esp_err_t err = esp_rmaker_mqtt_publish_direct(topic, data, data_len, qos,
+                published_cb ? &msg_id : NULL, msg_class);
+        if ((err == ESP_OK) && published_cb) {
+            published_cb(msg_id, priv_data);
+        }
+        return err;
+    }
+    pubq_entry_t entry = {
+        .topic = strdup(topic),
+        .data = MEM_ALLOC_EXTRAM(data_len),
+        .data_len = data_len,
+        .qos = qos,
+        .published_cb = published_cb,
+        .priv_data = priv_data,
+    };
+    if (!entry.topic || !entry.data) {
+        ESP_LOGE(TAG, "Failed to allocate memory to queue message on %s.", topic);
+        pubq_entry_free(&entry);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(entry.data, data, data_len);
+    xSemaphoreTake(pubq_lock, portMAX_DELAY);
+    esp_err_t err = pubq_add(msg_class, &entry);
+    xSemaphoreGive(pubq_lock);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Out of MQTT Budget and queue for %s full. Dropping publish message.", msg_class_str[msg_class]);
+        pubq_entry_free(&entry);
+        return err;
+    }
+    ESP_LOGD(TAG, "Queued %s message on %s.", msg_class_str[msg_class], topic);
+    if (budget_available) {
+        esp_rmaker_mqtt_publish_queue_kick();
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_mqtt_publish_with_class(const char *topic, void *data, size_t data_len, uint8_t qos,
+        int *msg_id, esp_rmaker_mqtt_msg_class_t msg_class)
+{
+    if (!topic || !data || (msg_class < 0) || (msg_class >= ESP_RMAKER_MQTT_MSG_CLASS_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    /* The message id has to be returned right away, so such messages cannot be queued */
+    if (!pubq_lock || msg_id) {
+        return esp_rmaker_mqtt_publish_direct(topic, data, data_len, qos, msg_id, msg_class);
+    }
+    return pubq_publish(topic, data, data_len, qos, msg_class, NULL, NULL);
+}
+
+esp_err_t esp_rmaker_mqtt_publish_with_cb(const char *topic, void *data, size_t data_len, uint8_t qos,
+        esp_rmaker_mqtt_published_cb_t published_cb, void *priv_data)
+{
+    if (!topic || !data || !published_cb) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    esp_rmaker_mqtt_msg_class_t msg_class = esp_rmaker_mqtt_get_topic_class(topic);
+    if (!pubq_lock) {
+        int msg_id = -1;
+        esp_err_t err = esp_rmaker_mqtt_publish_direct(topic, data, data_len, qos, &msg_id, msg_class);
+        if (err == ESP_OK) {
+            published_cb(msg_id, priv_data);
+        }
+        return err;
+    }
+    return pubq_publish(topic, data, data_len, qos, msg_class, published_cb, priv_data);
+}
+
+esp_err_t esp_rmaker_mqtt_publish_queue_defer(esp_rmaker_mqtt_msg_class_t msg_class,
+        esp_rmaker_mqtt_deferred_publish_cb_t cb, void *priv_data)
+{
+    if (!cb || (msg_class < 0) || (msg_class >= ESP_RMAKER_MQTT_MSG_CLASS_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!pubq_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(pubq_lock, portMAX_DELAY);
+    pubq_class_t *q = &pubq[msg_class];
+    int i;
+    for (i = 0; i < q->count; i++) {
+        if (!q->entries[i].topic && (q->entries[i].cb == cb) && (q->entries[i].priv_data == priv_data)) {
+            q->stats.coalesced++;
+            break;
+        }
+    }
+    if (i == q->count) {
+        pubq_entry_t entry = {
+            .cb = cb,
+            .priv_data = priv_data,
+        };
+        err = pubq_add(msg_class, &entry);
+    }
+    xSemaphoreGive(pubq_lock);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Queue for %s full. Could not defer publish.", msg_class_str[msg_class]);
+    }
+    return err;
+}
+
+esp_err_t esp_rmaker_mqtt_publish_queue_get_stats(esp_rmaker_mqtt_msg_class_t msg_class,
+        esp_rmaker_mqtt_publish_queue_stats_t *stats)
+{
+    if (!stats || (msg_class < 0) || (msg_class >= ESP_RMAKER_MQTT_MSG_CLASS_MAX)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!pubq_lock) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (xSemaphoreTake(pubq_lock, SEMAPHORE_DELAY_MSEC/portTICK_PERIOD_MS) != pdTRUE) {
+        return ESP_FAIL;
+    }
+    *stats = pubq[msg_class].stats;
+    stats->depth = pubq[msg_class].count;
+    xSemaphoreGive(pubq_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_rmaker_mqtt_publish_queue_init(void)
+{
+    if (pubq_lock) {
+        return ESP_OK;
+    }
+    pubq_lock = xSemaphoreCreateMutex();
+    if (!pubq_lock) {
+        ESP_LOGE(TAG, "Failed to create MQTT publish queue lock.");
+        return ESP_ERR_NO_MEM;
+    }
+    memset(pubq, 0, sizeof(pubq));
+    memset(drain_scheduled, 0, sizeof(drain_scheduled));
+    ESP_LOGI(TAG, "MQTT publish queue initialised. Size per class: %d", CLASS_QUEUE_SIZE);
+    return ESP_OK;
+}
+
+void esp_rmaker_mqtt_publish_queue_deinit(void)
+{
+    if (!pubq_lock) {
+        return;
+    }
+    xSemaphoreTake(pubq_lock, portMAX_DELAY);
+    for (int i = 0; i < ESP_RMAKER_MQTT_MSG_CLASS_MAX; i++) {
+        for (int j = 0; j < pubq[i].count; j++) {
+            pubq_entry_free(&pubq[i].entries[j]);
+        }
+        pubq[i].count = 0;
+    }
+    xSemaphoreGive(pubq_lock);
+    vSemaphoreDelete(pubq_lock);
+    pubq_lock = NULL;
+}
+
+#else /* ! CONFIG_ESP_RMAKER_MQTT_PUBLISH_QUEUE */
+
+esp_err_t esp_rmaker_mqtt_publish_with_class(const char *topic, void *data, size_t data_len, uint8_t qos,
+        int *msg_id, esp_rmaker_mqtt_msg_class_t msg_class)
+{
+    return esp_rmaker_mqtt_publish_direct(topic, data, data_len, qos, msg_id, msg_class);
+}
+
+esp_err_t esp_rmaker_mqtt_publish_with_cb(const char *topic, void *data, size_t data_len, uint8_t qos,
+        esp_rmaker_mqtt_published_cb_t published_cb, void *priv_data)
+{
+    if (!topic || !data || !published_cb) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int msg_id = -1;
+    esp_err_t err = esp_rmaker_mqtt_publish_direct(topic, data, data_len, qos, &msg_id,
+            esp_rmaker_mqtt_get_topic_class(topic));
+    if (err == ESP_OK) {
+        published_cb(msg_id, priv_data);
+    }
+    return err;
+}
+
+esp_err_t esp_rmaker_mqtt_publish_queue_defer(esp_rmaker_mqtt_msg_class_t msg_class,
+        esp_rmaker_mqtt_deferred_publish_cb_t cb, void *priv_data)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_rmaker_mqtt_publish_queue_get_stats(esp_rmaker_mqtt_msg_class_t msg_class,
+        esp_rmaker_mqtt_publish_queue_stats_t *stats)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void esp_rmaker_mqtt_publish_queue_kick(void)
+{
+}
+
+esp_err_t esp_rmaker_mqtt_publish_queue_init(void)
+{
+    return ESP_OK;
+}
+
+void esp_rmaker_mqtt_publish_queue_deinit(void)
+{
+}
+
+#endif /* ! CONFIG_ESP_RMAKER_MQTT_PUBLISH_QUEUE */
@@ -0,0 +1,36 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <esp_err.h>
+#include <esp_rmaker_mqtt.h>
+
+/* Callback for a deferred publish. It should generate and publish the message when invoked. */
+typedef void (*esp_rmaker_mqtt_deferred_publish_cb_t)(void *priv_data);
+/* Callback for esp_rmaker_mqtt_publish_with_cb(), invoked with the message id once the message is sent */
+typedef void (*esp_rmaker_mqtt_published_cb_t)(int msg_id, void *priv_data);
+
+esp_err_t esp_rmaker_mqtt_publish_queue_init(void);
+void esp_rmaker_mqtt_publish_queue_deinit(void);
+/* Schedules draining of the queue, if there are any pending messages */
+void esp_rmaker_mqtt_publish_queue_kick(void);
+/* Queues a callback which generates the message at the time of sending, rather than a copy of the
+ * message. At most one instance of a given cb + priv_data is kept in the queue, so that all the updates
+ * in the meantime get collapsed into a single message.
+ */
+esp_err_t esp_rmaker_mqtt_publish_queue_defer(esp_rmaker_mqtt_msg_class_t msg_class,
+        esp_rmaker_mqtt_deferred_publish_cb_t cb, void *priv_data);
+/* Like esp_rmaker_mqtt_publish(), but the message id is handed to published_cb rather than returned, so that
+ * the message can be queued if the budget is exhausted. published_cb is called right away if the message is
+ * sent directly, and from the queue drain otherwise. It is not called if the message gets dropped.
+ */
+esp_err_t esp_rmaker_mqtt_publish_with_cb(const char *topic, void *data, size_t data_len, uint8_t qos,
+        esp_rmaker_mqtt_published_cb_t published_cb, void *priv_data);
+esp_rmaker_mqtt_msg_class_t esp_rmaker_mqtt_get_topic_class(const char *topic);
+/* Publishes right away, subject to the budget of the class, bypassing the queue */
+esp_err_t esp_rmaker_mqtt_publish_direct(const char *topic, void *data, size_t data_len, uint8_t qos, int *msg_id,
+        esp_rmaker_mqtt_msg_class_t msg_class);
@@ -0,0 +1,297 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* In-node topic router. Instead of a broker subscription per topic, a single "node/<node_id>/#"
+ * subscription is made and the messages received on it are dispatched to the registered handlers
+ * using a trie of the topic levels. This keeps the broker state and the subscriptions to be
+ * restored on every reconnect down to one.
+ */
+
+#include <sdkconfig.h>
+#include <string.h>
+#include <stdbool.h>
+#include <esp_log.h>
+#include <esp_err.h>
+#include <esp_rmaker_core.h>
+#include <esp_rmaker_mqtt.h>
+#include "esp_rmaker_mqtt_router.h"
+
+#ifdef CONFIG_ESP_RMAKER_MQTT_TOPIC_ROUTER
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_rmaker_utils.h>
+#include "esp_rmaker_mqtt_topics.h"
+
+static const char *TAG = "esp_rmaker_mqtt_router";
+
+#define ROUTER_MAX_MATCHES      8
+#define ROUTER_PREFIX_FMT       "node/%s/"
+
+typedef struct router_node {
+    /* Topic level. "+" and "#" are the MQTT wildcards. */
+    char *level;
+    esp_rmaker_mqtt_subscribe_cb_t cb;
+    void *priv_data;
+    struct router_node *children;
+    struct router_node *next;
+} router_node_t;
+
+typedef struct {
+    esp_rmaker_mqtt_subscribe_cb_t cb;
+    void *priv_data;
+} router_handler_t;
+
+static router_node_t router_root;
+static SemaphoreHandle_t router_lock;
+static char *router_prefix;
+static size_t router_prefix_len;
+static bool router_subscribed;
+
+static const char *esp_rmaker_mqtt_router_get_prefix(void)
+{
+    if (router_prefix) {
+        return router_prefix;
+    }
+    char *node_id = esp_rmaker_get_node_id();
+    if (!node_id) {
+        return NULL;
+    }
+    size_t len = strlen(node_id) + strlen(ROUTER_PREFIX_FMT);
+    router_prefix = MEM_CALLOC_EXTRAM(1, len);
+    if (!router_prefix) {
+        return NULL;
+    }
+    snprintf(router_prefix, len, ROUTER_PREFIX_FMT, node_id);
+    router_prefix_len = strlen(router_prefix);
+    return router_prefix;
+}
+
+bool esp_rmaker_mqtt_router_handles(const char *topic)
+{
+    const char *prefix = esp_rmaker_mqtt_router_get_prefix();
+    return prefix && topic && (strncmp(topic, prefix, router_prefix_len) == 0) &&
+            (topic[router_prefix_len] != '\0');
+}
+
+static router_node_t *esp_rmaker_mqtt_router_get_child(router_node_t *node, const char *level,
+        size_t level_len, bool create)
+{
+    router_node_t *child = node->children;
+    while (child) {
+        if ((strlen(child->level) == level_len) && (strncmp(child->level, level, level_len) == 0)) {
+            return child;
+        }
+        child = child->next;
+    }
+    if (!create) {
+        return NULL;
+    }
+    child = MEM_CALLOC_EXTRAM(1, sizeof(router_node_t));
+    if (!child) {
+        return NULL;
+    }
+    child->level = strndup(level, level_len);
+    if (!child->level) {
+        free(child);
+        return NULL;
+    }
+    child->next = node->children;
+    node->children = child;
+    return child;
+}
+
+/* Frees the nodes below the given one which have neither a handler nor any children.
+ * Returns true if the node itself can be freed.
+ */
+static bool esp_rmaker_mqtt_router_prune(router_node_t *node)
+{
+    router_node_t **link = &node->children;
+    while (*link) {
+        router_node_t *child = *link;
+        if (esp_rmaker_mqtt_router_prune(child)) {
+            *link = child->next;
+            free(child->level);
+            free(child);
+        } else {
+            link = &child->next;
+        }
+    }
+    return !node->cb && !node->children;
+}
+
+static void esp_rmaker_mqtt_router_add_match(router_node_t *node, router_handler_t *matched, int *count)
+{
+    if (node->cb && (*count < ROUTER_MAX_MATCHES)) {
+        matched[*count].cb = node->cb;
+        matched[*count].priv_data = node->priv_data;
+        (*count)++;
+    }
+}
+
+/* topic points to the remaining topic levels, or is NULL if all the levels have been consumed */
+static void esp_rmaker_mqtt_router_match(router_node_t *node, const char *topic, router_handler_t *matched, int *count)
+{
+    if (!topic) {
+        esp_rmaker_mqtt_router_add_match(node, matched, count);
+        /* "a/#" also matches "a" */
+        router_node_t *multi = esp_rmaker_mqtt_router_get_child(node, "#", 1, false);
+        if (multi) {
+            esp_rmaker_mqtt_router_add_match(multi, matched, count);
+        }
+        return;
+    }
+    const char *end = strchr(topic, '/');
+    size_t level_len = end ? (size_t)(end - topic) : strlen(topic);
+    const char *next = end ? end + 1 : NULL;
+    for (router_node_t *child = node->children; child; child = child->next) {
+        if (strcmp(child->level, "#") == 0) {
+            esp_rmaker_mqtt_router_add_match(child, matched, count);
+        } else if ((strcmp(child->level, "+") == 0) ||
+                ((strlen(child->level) == level_len) && (strncmp(child->level, topic, level_len) == 0))) {
+            esp_rmaker_mqtt_router_match(child, next, matched, count);
+        }
+    }
+}
+
+static void esp_rmaker_mqtt_router_dispatch(const char *topic, void *payload, size_t payload_len, void *priv_data)
+{
+    router_handler_t matched[ROUTER_MAX_MATCHES];
+    int count = 0;
+    if (!esp_rmaker_mqtt_router_handles(topic)) {
+        return;
+    }
+    xSemaphoreTake(router_lock, portMAX_DELAY);
+    esp_rmaker_mqtt_router_match(&router_root, topic + router_prefix_len, matched, &count);
+    xSemaphoreGive(router_lock);
+    if (count == 0) {
+        ESP_LOGD(TAG, "No handler for %s.", topic);
+        return;
+    }
+    /* Handlers are invoked outside the lock, since they may subscribe or unsubscribe */
+    for (int i = 0; i < count; i++) {
+        matched[i].cb(topic, payload, payload_len, matched[i].priv_data);
+    }
+}
+
+esp_err_t esp_rmaker_mqtt_router_subscribe(const char *topic, esp_rmaker_mqtt_subscribe_cb_t cb,
+        uint8_t qos, void *priv_data)
+{
+    if (!topic || !cb) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!router_lock) {
+        router_lock = xSemaphoreCreateMutex();
+        if (!router_lock) {
+            ESP_LOGE(TAG, "Failed to create router lock.");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    const char *level = topic + router_prefix_len;
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(router_lock, portMAX_DELAY);
+    router_node_t *node = &router_root;
+    while (node) {
+        const char *end = strchr(level, '/');
+        size_t level_len = end ? (size_t)(end - level) : strlen(level);
+        node = esp_rmaker_mqtt_router_get_child(node, level, level_len, true);
+        if (!end) {
+            break;
+        }
+        level = end + 1;
+    }
+    if (node) {
+        node->cb = cb;
+        node->priv_data = priv_data;
+    } else {
+        esp_rmaker_mqtt_router_prune(&router_root);
+        err = ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(router_lock);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add route for %s.", topic);
+        return err;
+    }
+    ESP_LOGD(TAG, "Added route for %s.", topic);
+    if (!router_subscribed) {
+        char wildcard_topic[MQTT_TOPIC_BUFFER_SIZE];
+        snprintf(wildcard_topic, sizeof(wildcard_topic), "%s#", router_prefix);
+        /* The QoS of the first subscription is used for all the routed topics */
+        err = esp_rmaker_mqtt_subscribe_direct(wildcard_topic, esp_rmaker_mqtt_router_dispatch, qos, NULL);
+        if (err == ESP_OK) {
+            router_subscribed = true;
+            ESP_LOGI(TAG, "Subscribed to %s.", wildcard_topic);
+        } else {
+            ESP_LOGE(TAG, "Failed to subscribe to %s.", wildcard_topic);
+        }
+    }
+    return err;
+}
+
+esp_err_t esp_rmaker_mqtt_router_unsubscribe(const char *topic)
+{
+    if (!topic) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!router_lock) {
+        return ESP_OK;
+    }
+    const char *level = topic + router_prefix_len;
+    xSemaphoreTake(router_lock, portMAX_DELAY);
+    router_node_t *node = &router_root;
+    while (node) {
+        const char *end = strchr(level, '/');
+        size_t level_len = end ? (size_t)(end - level) : strlen(level);
+        node = esp_rmaker_mqtt_router_get_child(node, level, level_len, false);
+        if (!end) {
+            break;
+        }
+        level = end + 1;
+    }
+    if (node) {
+        node->cb = NULL;
+        node->priv_data = NULL;
+        esp_rmaker_mqtt_router_prune(&router_root);
+    }
+    xSemaphoreGive(router_lock);
+    /* The wildcard subscription itself is retained, since routes are typically added back soon after */
+    return ESP_OK;
+}
+
+void esp_rmaker_mqtt_router_deinit(void)
+{
+    if (router_lock) {
+        xSemaphoreTake(router_lock, portMAX_DELAY);
+        router_root.cb = NULL;
+        esp_rmaker_mqtt_router_prune(&router_root);
+        xSemaphoreGive(router_lock);
+    }
+    router_subscribed = false;
+}
+
+#else /* ! CONFIG_ESP_RMAKER_MQTT_TOPIC_ROUTER */
+
+bool esp_rmaker_mqtt_router_handles(const char *topic)
+{
+    return false;
+}
+
+esp_err_t esp_rmaker_mqtt_router_subscribe(const char *topic, esp_rmaker_mqtt_subscribe_cb_t cb,
+        uint8_t qos, void *priv_data)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_rmaker_mqtt_router_unsubscribe(const char *topic)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void esp_rmaker_mqtt_router_deinit(void)
+{
+}
+
+#endif /* ! CONFIG_ESP_RMAKER_MQTT_TOPIC_ROUTER */
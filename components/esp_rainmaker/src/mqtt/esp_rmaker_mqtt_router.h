@@ -0,0 +1,21 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+#include <esp_rmaker_mqtt_glue.h>
+
+/* Checks if the topic is one which should be routed, rather than subscribed to individually */
+bool esp_rmaker_mqtt_router_handles(const char *topic);
+esp_err_t esp_rmaker_mqtt_router_subscribe(const char *topic, esp_rmaker_mqtt_subscribe_cb_t cb,
+        uint8_t qos, void *priv_data);
+esp_err_t esp_rmaker_mqtt_router_unsubscribe(const char *topic);
+void esp_rmaker_mqtt_router_deinit(void);
+/* Subscribes with the MQTT broker, bypassing the router */
+esp_err_t esp_rmaker_mqtt_subscribe_direct(const char *topic, esp_rmaker_mqtt_subscribe_cb_t cb,
+        uint8_t qos, void *priv_data);
@@ -34,6 +34,7 @@
 #include <esp_rmaker_common_events.h>
 #include <esp_rmaker_utils.h>
 #include "esp_rmaker_internal.h"
+#include "esp_rmaker_mem_tag.h"
 #include "esp_rmaker_ota_internal.h"
 
 #if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 4, 0)
@@ -681,7 +682,7 @@ esp_err_t esp_rmaker_ota_enable(esp_rmaker_ota_config_t *ota_config, esp_rmaker_
         ESP_LOGE(TAG, "OTA already initialised");
         return ESP_FAIL;
     }
-    esp_rmaker_ota_t *ota = MEM_CALLOC_EXTRAM(1, sizeof(esp_rmaker_ota_t));
+    esp_rmaker_ota_t *ota = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_OTA, 1, sizeof(esp_rmaker_ota_t));
     if (!ota) {
         ESP_LOGE(TAG, "Failed to allocate memory for esp_rmaker_ota_t");
         return ESP_ERR_NO_MEM;
@@ -706,7 +707,7 @@ esp_err_t esp_rmaker_ota_enable(esp_rmaker_ota_config_t *ota_config, esp_rmaker_
         ota_init_done = true;
         g_ota_priv = ota;
     } else {
-        free(ota);
+        RMAKER_MEM_FREE(ota);
         ESP_LOGE(TAG, "Failed to enable OTA");
     }
 #ifdef CONFIG_ESP_RMAKER_OTA_TIME_SUPPORT
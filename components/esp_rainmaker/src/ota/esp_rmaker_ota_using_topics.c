@@ -21,11 +21,13 @@
 #include <esp_system.h>
 #include <nvs.h>
 #include <esp_rmaker_work_queue.h>
+#include <esp_rmaker_work_queue_prio.h>
 #include <esp_rmaker_core.h>
 #include <esp_rmaker_ota.h>
 #include <esp_rmaker_utils.h>
 
 #include "esp_rmaker_internal.h"
+#include "esp_rmaker_mem_tag.h"
 #include "esp_rmaker_ota_internal.h"
 #include "esp_rmaker_mqtt.h"
 #include "esp_rmaker_mqtt_topics.h"
@@ -94,20 +96,20 @@ esp_err_t esp_rmaker_ota_report_status_using_topics(esp_rmaker_ota_handle_t ota_
 void esp_rmaker_ota_finish_using_topics(esp_rmaker_ota_t *ota)
 {
     if (ota->url) {
-        free(ota->url);
+        RMAKER_MEM_FREE(ota->url);
         ota->url = NULL;
     }
     ota->filesize = 0;
     if (ota->transient_priv) {
-        free(ota->transient_priv);
+        RMAKER_MEM_FREE(ota->transient_priv);
         ota->transient_priv = NULL;
     }
     if (ota->metadata) {
-        free(ota->metadata);
+        RMAKER_MEM_FREE(ota->metadata);
         ota->metadata = NULL;
     }
     if (ota->fw_version) {
-        free(ota->fw_version);
+        RMAKER_MEM_FREE(ota->fw_version);
         ota->fw_version = NULL;
     }
     ota->ota_in_progress = false;
@@ -151,7 +153,7 @@ static void ota_url_handler(const char *topic, void *payload, size_t payload_len
         goto end;
     }
     len++; /* Increment for NULL character */
-    ota_job_id = MEM_CALLOC_EXTRAM(1, len);
+    ota_job_id = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_OTA, 1, len);
     if (!ota_job_id) {
         ESP_LOGE(TAG, "Aborted. OTA Job ID memory allocation failed");
         esp_rmaker_ota_report_status(ota_handle, OTA_STATUS_FAILED, "Aborted. OTA Updated ID memory allocation failed");
@@ -174,7 +176,7 @@ static void ota_url_handler(const char *topic, void *payload, size_t payload_len
         goto end;
     }
     len++; /* Increment for NULL character */
-    url = MEM_CALLOC_EXTRAM(1, len);
+    url = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_OTA, 1, len);
     if (!url) {
         ESP_LOGE(TAG, "Aborted. URL memory allocation failed");
         esp_rmaker_ota_report_status(ota_handle, OTA_STATUS_FAILED, "Aborted. URL memory allocation failed");
@@ -191,7 +193,7 @@ static void ota_url_handler(const char *topic, void *payload, size_t payload_len
     ret = json_obj_get_strlen(&jctx, "fw_version", &len);
     if (ret == ESP_OK && len > 0) {
         len++; /* Increment for NULL character */
-        fw_version = MEM_CALLOC_EXTRAM(1, len);
+        fw_version = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_OTA, 1, len);
         if (!fw_version) {
             ESP_LOGE(TAG, "Aborted. Firmware version memory allocation failed");
             esp_rmaker_ota_report_status(ota_handle, OTA_STATUS_FAILED, "Aborted. Firmware version memory allocation failed");
@@ -206,7 +208,7 @@ static void ota_url_handler(const char *topic, void *payload, size_t payload_len
     ret = json_obj_get_object_strlen(&jctx, "metadata", &metadata_size);
     if (ret == ESP_OK && metadata_size > 0) {
         metadata_size++; /* Increment for NULL character */
-        metadata = MEM_CALLOC_EXTRAM(1, metadata_size);
+        metadata = RMAKER_MEM_CALLOC_EXTRAM(ESP_RMAKER_MEM_TAG_OTA, 1, metadata_size);
         if (!metadata) {
             ESP_LOGE(TAG, "Aborted. OTA metadata memory allocation failed");
             esp_rmaker_ota_report_status(ota_handle, OTA_STATUS_FAILED, "Aborted. OTA metadata memory allocation failed");
@@ -218,22 +220,23 @@ static void ota_url_handler(const char *topic, void *payload, size_t payload_len
 
     json_parse_end(&jctx);
     if (ota->url) {
-        free(ota->url);
+        RMAKER_MEM_FREE(ota->url);
     }
     ota->url = url;
     ota->fw_version = fw_version;
     ota->filesize = filesize;
     ota->ota_in_progress = true;
-    if (esp_rmaker_work_queue_add_task(esp_rmaker_ota_common_cb, ota) != ESP_OK) {
+    if (esp_rmaker_work_queue_add_prio_task(esp_rmaker_ota_common_cb, ota,
+                ESP_RMAKER_WORK_CLASS_BACKGROUND, 0) != ESP_OK) {
         esp_rmaker_ota_finish_using_topics(ota);
     }
     return;
 end:
     if (url) {
-        free(url);
+        RMAKER_MEM_FREE(url);
     }
     if (fw_version) {
-        free(fw_version);
+        RMAKER_MEM_FREE(fw_version);
     }
     esp_rmaker_ota_finish_using_topics(ota);
     json_parse_end(&jctx);
@@ -321,7 +324,8 @@ static void esp_rmaker_ota_work_fn(void *priv_data)
 /* Enable the ESP RainMaker specific OTA */
 esp_err_t esp_rmaker_ota_enable_using_topics(esp_rmaker_ota_t *ota)
 {
-    esp_err_t err = esp_rmaker_work_queue_add_task(esp_rmaker_ota_work_fn, ota);
+    esp_err_t err = esp_rmaker_work_queue_add_prio_task(esp_rmaker_ota_work_fn, ota,
+            ESP_RMAKER_WORK_CLASS_BACKGROUND, 0);
     if (err == ESP_OK) {
         ESP_LOGI(TAG, "OTA enabled with Topics");
     }
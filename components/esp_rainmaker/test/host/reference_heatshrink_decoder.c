@@ -0,0 +1,78 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Reference decoder of the heatshrink stream that the MQTT payload compression generates, written from
+ * the heatshrink format rather than from the encoder, so that the encoder is checked against it.
+ * Each item starts with a tag bit, most significant bit first. A 1 is followed by an 8 bit literal. A 0
+ * is followed by the back-reference offset - 1 in window_bits and the length - 1 in lookahead_bits.
+ * Like the heatshrink decoder, the trailing bits which do not make up a complete item are ignored.
+ * Unlike it, a back-reference before the start of the output is reported as an error, since heatshrink
+ * would silently output 0s for it.
+ */
+
+typedef struct {
+    const uint8_t *buf;
+    size_t len;
+    size_t bit_pos;
+} ref_bit_reader_t;
+
+static bool ref_get_bits(ref_bit_reader_t *r, uint8_t count, uint16_t *val)
+{
+    if ((r->bit_pos + count) > (r->len * 8)) {
+        return false;
+    }
+    *val = 0;
+    for (int i = 0; i < count; i++) {
+        uint8_t byte = r->buf[r->bit_pos / 8];
+        *val = (*val << 1) | ((byte >> (7 - (r->bit_pos % 8))) & 1);
+        r->bit_pos++;
+    }
+    return true;
+}
+
+/* Returns the decoded length, or -1 if the stream is invalid or does not fit in out */
+static long ref_heatshrink_decode(const uint8_t *in, size_t in_len, uint8_t window_bits, uint8_t lookahead_bits,
+        uint8_t *out, size_t out_size)
+{
+    ref_bit_reader_t r = {
+        .buf = in,
+        .len = in_len,
+    };
+    size_t out_len = 0;
+    uint16_t tag;
+    while (ref_get_bits(&r, 1, &tag)) {
+        uint16_t val;
+        if (tag) {
+            if (!ref_get_bits(&r, 8, &val)) {
+                break;
+            }
+            if (out_len >= out_size) {
+                return -1;
+            }
+            out[out_len++] = (uint8_t)val;
+            continue;
+        }
+        uint16_t offset, count;
+        if (!ref_get_bits(&r, window_bits, &offset) || !ref_get_bits(&r, lookahead_bits, &count)) {
+            break;
+        }
+        offset++;
+        count++;
+        if ((offset > out_len) || ((out_len + count) > out_size)) {
+            return -1;
+        }
+        /* Byte by byte, since the source may overlap what is being written */
+        for (uint16_t i = 0; i < count; i++) {
+            out[out_len] = out[out_len - offset];
+            out_len++;
+        }
+    }
+    /* Only the padding of the last byte may be left */
+    if (((in_len * 8) - r.bit_pos) >= 8) {
+        return -1;
+    }
+    return (long)out_len;
+}
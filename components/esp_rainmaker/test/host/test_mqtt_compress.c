@@ -0,0 +1,183 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host test for the MQTT payload compression. Payloads are compressed with esp_rmaker_mqtt_compress() and
+ * decoded again with a reference heatshrink decoder, which must give back the original payload. The
+ * window and lookahead sizes are build time options, so the Makefile builds this once for every supported
+ * combination.
+ *
+ * Usage: test_mqtt_compress
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <esp_err.h>
+#include <esp_rmaker_mqtt.h>
+
+#include "reference_heatshrink_decoder.c"
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __func__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+#define WINDOW_BITS         CONFIG_ESP_RMAKER_MQTT_COMPRESSION_WINDOW_BITS
+#define LOOKAHEAD_BITS      CONFIG_ESP_RMAKER_MQTT_COMPRESSION_LOOKAHEAD_BITS
+#define WINDOW_SIZE         (1 << WINDOW_BITS)
+#define LOOKAHEAD_SIZE      (1 << LOOKAHEAD_BITS)
+#define MAX_DATA_SIZE       16384
+/* A literal takes 9 bits, so this fits any payload */
+#define MAX_OUT_SIZE        (((MAX_DATA_SIZE * 9) / 8) + 1)
+
+static uint8_t s_data[MAX_DATA_SIZE];
+static uint8_t s_out[MAX_OUT_SIZE];
+static uint8_t s_decoded[MAX_DATA_SIZE];
+
+/* Compresses data_len bytes of s_data, checks the round trip and returns the compressed length, or -1 */
+static long round_trip(size_t data_len, const char *what)
+{
+    size_t out_len = sizeof(s_out);
+    esp_err_t err = esp_rmaker_mqtt_compress(s_data, data_len, s_out, &out_len);
+    if (err != ESP_OK) {
+        printf("FAIL %s: %zu bytes: compression failed with 0x%x\n", what, data_len, err);
+        return -1;
+    }
+    long decoded_len = ref_heatshrink_decode(s_out, out_len, WINDOW_BITS, LOOKAHEAD_BITS, s_decoded,
+            sizeof(s_decoded));
+    if ((decoded_len != (long)data_len) || (memcmp(s_data, s_decoded, data_len) != 0)) {
+        printf("FAIL %s: %zu bytes: compressed to %zu, decoded to %ld, which does not match\n", what,
+                data_len, out_len, decoded_len);
+        return -1;
+    }
+    return (long)out_len;
+}
+
+/* Repeats the pattern, of which only the first pattern_len bytes are used, to fill data_len bytes */
+static void fill_pattern(const char *pattern, size_t pattern_len, size_t data_len)
+{
+    for (size_t i = 0; i < data_len; i++) {
+        s_data[i] = (uint8_t)pattern[i % pattern_len];
+    }
+}
+
+/* A node config like payload, with the same params repeated for every device */
+static size_t fill_config(int num_devices)
+{
+    size_t len = snprintf((char *)s_data, sizeof(s_data), "{\"node_id\":\"1234567890ABCDEF\",\"config_version\":"
+            "\"2020-03-20\",\"info\":{\"name\":\"Benchmark\",\"fw_version\":\"1.0\",\"type\":\"Benchmark\"},"
+            "\"devices\":[");
+    for (int d = 0; (d < num_devices) && (len < sizeof(s_data)); d++) {
+        len += snprintf((char *)s_data + len, sizeof(s_data) - len, "%s{\"name\":\"Dev%d\",\"type\":"
+                "\"esp.device.other\",\"primary\":\"P0\",\"params\":[{\"name\":\"Name\",\"type\":\"esp.param.name\","
+                "\"data_type\":\"string\",\"properties\":[\"read\",\"write\"]},{\"name\":\"P0\",\"data_type\":\"int\","
+                "\"properties\":[\"read\",\"write\"],\"bounds\":{\"min\":0,\"max\":%d}}]}", d ? "," : "", d, d * 100);
+    }
+    if (len < sizeof(s_data)) {
+        len += snprintf((char *)s_data + len, sizeof(s_data) - len, "]}");
+    }
+    return (len < sizeof(s_data)) ? len : 0;
+}
+
+static int test_edge_cases(void)
+{
+    int failures = 0;
+    size_t out_len = sizeof(s_out);
+    CHECK(esp_rmaker_mqtt_compress(NULL, 1, s_out, &out_len) == ESP_ERR_INVALID_ARG);
+    CHECK(esp_rmaker_mqtt_compress(s_data, 1, NULL, &out_len) == ESP_ERR_INVALID_ARG);
+    CHECK(esp_rmaker_mqtt_compress(s_data, 1, s_out, NULL) == ESP_ERR_INVALID_ARG);
+    CHECK(round_trip(0, "empty") == 0);
+    s_data[0] = 'x';
+    /* A literal, padded to a byte */
+    CHECK(round_trip(1, "single byte") == 2);
+    for (size_t len = 2; len <= (2 * LOOKAHEAD_SIZE) + 2; len++) {
+        fill_pattern("a", 1, len);
+        CHECK(round_trip(len, "run") > 0);
+    }
+    printf("Edge cases: %d failures\n", failures);
+    return failures;
+}
+
+static int test_patterns(void)
+{
+    int failures = 0;
+    /* Matches that overlap what they copy, and matches at the edges of the window */
+    fill_pattern("a", 1, MAX_DATA_SIZE);
+    long out_len = round_trip(MAX_DATA_SIZE, "single byte run");
+    CHECK(out_len > 0);
+    /* The literal and then full length back-references */
+    CHECK(out_len <= (((((MAX_DATA_SIZE / LOOKAHEAD_SIZE) + 1) * (1 + WINDOW_BITS + LOOKAHEAD_BITS)) + 9) / 8) + 1);
+    const char *pattern = "{\"Dev0\":{\"P0\":123,\"P1\":true,\"P2\":\"text\"}}";
+    size_t periods[] = {1, 2, 3, 7, WINDOW_SIZE - 1, WINDOW_SIZE, WINDOW_SIZE + 1};
+    static char period_data[WINDOW_SIZE + 1];
+    for (int i = 0; i < sizeof(periods) / sizeof(periods[0]); i++) {
+        for (size_t j = 0; j < periods[i]; j++) {
+            period_data[j] = pattern[(j * 7) % strlen(pattern)] + (j / strlen(pattern));
+        }
+        fill_pattern(period_data, periods[i], 4 * WINDOW_SIZE);
+        CHECK(round_trip(4 * WINDOW_SIZE, "periodic") > 0);
+    }
+    size_t config_len = fill_config(40);
+    CHECK(config_len > 0);
+    out_len = round_trip(config_len, "node config");
+    CHECK((out_len > 0) && (out_len < config_len));
+    printf("Patterns: %d failures\n", failures);
+    return failures;
+}
+
+static int test_random(void)
+{
+    int failures = 0;
+    srand(1);
+    for (int i = 0; i < 200; i++) {
+        size_t len = rand() % MAX_DATA_SIZE;
+        /* From no repetition to long runs, with the alphabet size */
+        int alphabet = 1 + (rand() % 256);
+        for (size_t j = 0; j < len; j++) {
+            s_data[j] = (uint8_t)(rand() % alphabet);
+        }
+        CHECK(round_trip(len, "random") >= 0);
+    }
+    printf("Random: %d failures\n", failures);
+    return failures;
+}
+
+static int test_out_buffer_size(void)
+{
+    int failures = 0;
+    size_t config_len = fill_config(10);
+    long compressed_len = round_trip(config_len, "node config");
+    CHECK(compressed_len > 0);
+    /* Exactly the compressed size is enough and one byte less is not */
+    size_t out_len = compressed_len;
+    CHECK(esp_rmaker_mqtt_compress(s_data, config_len, s_out, &out_len) == ESP_OK);
+    CHECK(out_len == compressed_len);
+    out_len = compressed_len - 1;
+    CHECK(esp_rmaker_mqtt_compress(s_data, config_len, s_out, &out_len) == ESP_ERR_INVALID_SIZE);
+    /* Incompressible data does not fit in a buffer smaller than the data, as the publish path uses */
+    srand(2);
+    for (size_t i = 0; i < 1024; i++) {
+        s_data[i] = (uint8_t)rand();
+    }
+    out_len = 1023;
+    CHECK(esp_rmaker_mqtt_compress(s_data, 1024, s_out, &out_len) == ESP_ERR_INVALID_SIZE);
+    printf("Output buffer size: %d failures\n", failures);
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    printf("Window bits %d, lookahead bits %d\n", WINDOW_BITS, LOOKAHEAD_BITS);
+    int failures = test_edge_cases();
+    failures += test_patterns();
+    failures += test_random();
+    failures += test_out_buffer_size();
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+/*
+ * SPDX-FileCopyrightText: 2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host test for the prioritised work queue. A control class work added while background work is pending
+ * must start after at most the background work already executing, irrespective of how many background
+ * items are pending. The same load on the plain FIFO work queue is run as a baseline, for which the
+ * latency grows with the load.
+ *
+ * Usage: test_work_queue_prio
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <esp_timer.h>
+#include <esp_rmaker_work_queue_prio.h>
+#include "host_shims.h"
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __func__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+/* Simulated execution time of each background work */
+#define BACKGROUND_WORK_MS      10
+#define CONTROL_DEADLINE_MS     (2 * BACKGROUND_WORK_MS)
+#define MAX_LOAD                CONFIG_ESP_RMAKER_WORK_QUEUE_PRIO_CLASS_SIZE
+
+static int64_t s_control_enqueue_time;
+static int64_t s_control_start_time;
+/* Number of background works executed before the control work started */
+static int s_background_before_control;
+static int s_background_done;
+static bool s_control_done;
+
+static void control_work(void *priv_data)
+{
+    s_control_start_time = esp_timer_get_time();
+    s_background_before_control = s_background_done;
+    s_control_done = true;
+}
+
+static void background_work(void *priv_data)
+{
+    bool use_prio = (bool)(intptr_t)priv_data;
+    if (s_background_done == 0) {
+        /* The control request arrives while the first background work is executing */
+        s_control_enqueue_time = esp_timer_get_time();
+        if (use_prio) {
+            esp_rmaker_work_queue_add_prio_task(control_work, NULL, ESP_RMAKER_WORK_CLASS_CONTROL,
+                    CONTROL_DEADLINE_MS);
+        } else {
+            esp_rmaker_work_queue_add_task(control_work, NULL);
+        }
+    }
+    host_time_advance_us(BACKGROUND_WORK_MS * 1000);
+    s_background_done++;
+}
+
+/* Returns the latency (in msec) of the control work with the given background load, or -1 on failure */
+static int run_load(int load, bool use_prio)
+{
+    s_background_done = 0;
+    s_control_done = false;
+    for (int i = 0; i < load; i++) {
+        esp_err_t err = use_prio ?
+                esp_rmaker_work_queue_add_prio_task(background_work, (void *)(intptr_t)use_prio,
+                        ESP_RMAKER_WORK_CLASS_BACKGROUND, 0) :
+                esp_rmaker_work_queue_add_task(background_work, (void *)(intptr_t)use_prio);
+        if (err != ESP_OK) {
+            return -1;
+        }
+    }
+    host_work_queue_run();
+    if (!s_control_done || (s_background_done != load)) {
+        return -1;
+    }
+    return (int)((s_control_start_time - s_control_enqueue_time) / 1000);
+}
+
+static int test_control_latency_bounded(void)
+{
+    int failures = 0;
+    if (esp_rmaker_work_queue_prio_init() != ESP_OK) {
+        printf("FAIL: Could not initialise the prioritised work queue\n");
+        return 1;
+    }
+    for (int load = 1; load <= MAX_LOAD; load++) {
+        int latency_ms = run_load(load, true);
+        CHECK(latency_ms >= 0);
+        CHECK(latency_ms <= BACKGROUND_WORK_MS);
+        /* Only the background work which added it ran before the control work */
+        CHECK(s_background_before_control == 1);
+    }
+    esp_rmaker_work_class_stats_t stats;
+    CHECK(esp_rmaker_work_queue_get_class_stats(ESP_RMAKER_WORK_CLASS_CONTROL, &stats) == ESP_OK);
+    CHECK(stats.processed == MAX_LOAD);
+    CHECK(stats.max_latency_ms <= BACKGROUND_WORK_MS);
+    CHECK(stats.deadline_missed == 0);
+    CHECK(stats.depth == 0);
+    CHECK(esp_rmaker_work_queue_get_class_stats(ESP_RMAKER_WORK_CLASS_BACKGROUND, &stats) == ESP_OK);
+    CHECK(stats.processed == (MAX_LOAD * (MAX_LOAD + 1)) / 2);
+    CHECK(stats.max_depth == MAX_LOAD);
+    CHECK(stats.dropped == 0);
+    esp_rmaker_work_queue_prio_deinit();
+    printf("Control latency bounded under background load: %d failures\n", failures);
+    return failures;
+}
+
+static int test_fifo_baseline(void)
+{
+    int failures = 0;
+    /* Without the prioritised queue, the control work waits for all the pending background work */
+    for (int load = 1; load <= MAX_LOAD; load++) {
+        int latency_ms = run_load(load, false);
+        CHECK(latency_ms == load * BACKGROUND_WORK_MS);
+        CHECK(s_background_before_control == load);
+        if (load > 2) {
+            CHECK(latency_ms > CONTROL_DEADLINE_MS);
+        }
+    }
+    printf("FIFO baseline: %d failures\n", failures);
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    int failures = test_control_latency_bounded();
+    failures += test_fifo_baseline();
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -3,11 +3,16 @@
  *
  * SPDX-License-Identifier: Apache-2.0
  */
+#include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
 #include <esp_log.h>
 #include <esp_sntp.h>
+#include <esp_timer.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
 #include <esp_rmaker_utils.h>
+#include <esp_rmaker_work_queue.h>
 #include "esp_schedule_internal.h"
 
 static const char *TAG = "esp_schedule";
@@ -15,8 +20,33 @@ static const char *TAG = "esp_schedule";
 #define SECONDS_TILL_2020 ((2020 - 1970) * 365 * 24 * 3600)
 #define SECONDS_IN_DAY (60 * 60 * 24)
 
+/* Initial number of entries in the heap of armed schedules. It grows as required. */
+#define ESP_SCHEDULE_HEAP_INITIAL_SIZE 8
+/* Size of the TZ string kept along with the cached local time. POSIX TZ strings are usually much shorter. */
+#define ESP_SCHEDULE_TZ_CACHE_LEN 64
+/* Longest period for which the timer is armed in one go, so that it fits in the tick count */
+#define ESP_SCHEDULE_MAX_TIMER_PERIOD_US ((int64_t)SECONDS_IN_DAY * 1000000)
+
+typedef struct {
+    /* Time, as per esp_timer_get_time(), at which the schedule is due */
+    int64_t deadline_us;
+    esp_schedule_t *schedule;
+} esp_schedule_heap_entry_t;
+
 static bool init_done = false;
 
+/* All the enabled schedules are kept in a min-heap ordered by the time they are due. A single timer
+ * is armed for the earliest of them, instead of a timer per schedule.
+ */
+static esp_schedule_heap_entry_t *schedule_heap;
+static size_t schedule_heap_count;
+static size_t schedule_heap_size;
+static TimerHandle_t schedule_timer;
+static SemaphoreHandle_t schedule_lock;
+/* Deadline for which the timer is currently armed, or INT64_MAX if it is not armed */
+static int64_t schedule_armed_deadline_us = INT64_MAX;
+static bool schedule_dispatching;
+
 static int esp_schedule_get_no_of_days(esp_schedule_trigger_t *trigger, struct tm *current_time, struct tm *schedule_time)
 {
     /* for day, monday = 0, sunday = 6. */
@@ -155,10 +185,47 @@ static uint16_t esp_schedule_get_next_year(esp_schedule_trigger_t *trigger, stru
     return current_year;
 }
 
+/* Gets the local time for now. Re-arming all the schedules, like after a time sync, happens within the same
+ * second, so the last conversion is reused. The timezone can change at any time, so the conversion is reused
+ * only if the TZ is also the same.
+ */
+static void esp_schedule_get_local_time(time_t now, struct tm *local_time)
+{
+    static time_t cached_now;
+    static struct tm cached_local_time;
+    static char cached_tz[ESP_SCHEDULE_TZ_CACHE_LEN];
+    static portMUX_TYPE cache_lock = portMUX_INITIALIZER_UNLOCKED;
+    const char *tz = getenv("TZ");
+    if (!tz) {
+        tz = "";
+    }
+    /* Conversions for longer TZ strings are not cached */
+    bool cacheable = (strlen(tz) < sizeof(cached_tz));
+    bool found = false;
+    portENTER_CRITICAL(&cache_lock);
+    if (cacheable && (cached_now == now) && (strcmp(cached_tz, tz) == 0)) {
+        *local_time = cached_local_time;
+        found = true;
+    }
+    portEXIT_CRITICAL(&cache_lock);
+    if (found) {
+        return;
+    }
+    localtime_r(&now, local_time);
+    if (!cacheable) {
+        return;
+    }
+    portENTER_CRITICAL(&cache_lock);
+    cached_now = now;
+    cached_local_time = *local_time;
+    strcpy(cached_tz, tz);
+    portEXIT_CRITICAL(&cache_lock);
+}
+
 static uint32_t esp_schedule_get_next_schedule_time_diff(const char *schedule_name, esp_schedule_trigger_t *trigger)
 {
     struct tm current_time, schedule_time;
-    time_t now;
+    time_t now, target;
     char time_str[64];
     int32_t time_diff;
 
@@ -171,7 +238,6 @@ static uint32_t esp_schedule_get_next_schedule_time_diff(const char *schedule_na
         /* If next scheduled time is already set, just compute the difference
          * between current time and next scheduled time and return that diff.
          */
-        time_t target;
         if (trigger->next_scheduled_time_utc > 0) {
             target = (time_t)trigger->next_scheduled_time_utc;
             time_diff = difftime(target, now);
@@ -179,66 +245,54 @@ static uint32_t esp_schedule_get_next_schedule_time_diff(const char *schedule_na
             target = now + (time_t)trigger->relative_seconds;
             time_diff = trigger->relative_seconds;
         }
+        trigger->next_scheduled_time_utc = target;
         localtime_r(&target, &schedule_time);
-        trigger->next_scheduled_time_utc = mktime(&schedule_time);
-        /* Print schedule time */
-        memset(time_str, 0, sizeof(time_str));
-        strftime(time_str, sizeof(time_str), "%c %z[%Z]", &schedule_time);
-        ESP_LOGI(TAG, "Schedule %s will be active on: %s. DST: %s", schedule_name, time_str, schedule_time.tm_isdst ? "Yes" : "No");
-        return time_diff;
-    }
-    localtime_r(&now, &current_time);
-
-    /* Get schedule time */
-    localtime_r(&now, &schedule_time);
-    schedule_time.tm_sec = 0;
-    schedule_time.tm_min = trigger->minutes;
-    schedule_time.tm_hour = trigger->hours;
-    mktime(&schedule_time);
-
-    /* Adjust schedule day */
-    if (trigger->type == ESP_SCHEDULE_TYPE_DAYS_OF_WEEK) {
-        int no_of_days = 0;
-        no_of_days = esp_schedule_get_no_of_days(trigger, &current_time, &schedule_time);
-        schedule_time.tm_sec += no_of_days * SECONDS_IN_DAY;
-    }
-    if (trigger->type == ESP_SCHEDULE_TYPE_DATE) {
-        schedule_time.tm_mday = trigger->date.day;
-        schedule_time.tm_mon = esp_schedule_get_next_month(trigger, &current_time, &schedule_time) - 1;
-        schedule_time.tm_year = esp_schedule_get_next_year(trigger, &current_time, &schedule_time) - 1900;
-        if (schedule_time.tm_mon < 0) {
-            ESP_LOGE(TAG, "Invalid month found: %d. Setting it to next month.", schedule_time.tm_mon);
-            schedule_time.tm_mon = current_time.tm_mon + 1;
+    } else {
+        esp_schedule_get_local_time(now, &current_time);
+
+        /* The schedule date is worked out on the broken down local time, and it gets converted
+         * to a timestamp just once at the end.
+         */
+        schedule_time = current_time;
+        schedule_time.tm_sec = 0;
+        schedule_time.tm_min = trigger->minutes;
+        schedule_time.tm_hour = trigger->hours;
+
+        /* Adjust schedule day */
+        if (trigger->type == ESP_SCHEDULE_TYPE_DAYS_OF_WEEK) {
+            schedule_time.tm_mday += esp_schedule_get_no_of_days(trigger, &current_time, &schedule_time);
         }
-        if (schedule_time.tm_mon >= 12) {
-            schedule_time.tm_year += schedule_time.tm_mon / 12;
-            schedule_time.tm_mon = schedule_time.tm_mon % 12;
+        if (trigger->type == ESP_SCHEDULE_TYPE_DATE) {
+            schedule_time.tm_mday = trigger->date.day;
+            schedule_time.tm_mon = esp_schedule_get_next_month(trigger, &current_time, &schedule_time) - 1;
+            schedule_time.tm_year = esp_schedule_get_next_year(trigger, &current_time, &schedule_time) - 1900;
+            if (schedule_time.tm_mon < 0) {
+                ESP_LOGE(TAG, "Invalid month found: %d. Setting it to next month.", schedule_time.tm_mon);
+                schedule_time.tm_mon = current_time.tm_mon + 1;
+            }
+            if (schedule_time.tm_mon >= 12) {
+                schedule_time.tm_year += schedule_time.tm_mon / 12;
+                schedule_time.tm_mon = schedule_time.tm_mon % 12;
+            }
         }
-    }
-    mktime(&schedule_time);
+        /* Let mktime() find if DST is in effect on the schedule date, rather than assuming the current
+         * state and correcting for it later. This also normalises the day and month overflows.
+         */
+        schedule_time.tm_isdst = -1;
+        target = mktime(&schedule_time);
+
+        /* Calculate difference */
+        time_diff = difftime(target, now);
 
-    /* Adjust time according to DST */
-    time_t dst_adjust = 0;
-    if (!current_time.tm_isdst && schedule_time.tm_isdst) {
-        dst_adjust = -3600;
-    } else if (current_time.tm_isdst && !schedule_time.tm_isdst ) {
-        dst_adjust = 3600;
+        /* For one time schedules to check for expiry after a reboot. If NVS is enabled, this should be stored in NVS. */
+        trigger->next_scheduled_time_utc = target;
     }
-    ESP_LOGD(TAG, "DST adjust seconds: %lld", (long long) dst_adjust);
-    schedule_time.tm_sec += dst_adjust;
-    mktime(&schedule_time);
 
     /* Print schedule time */
     memset(time_str, 0, sizeof(time_str));
     strftime(time_str, sizeof(time_str), "%c %z[%Z]", &schedule_time);
     ESP_LOGI(TAG, "Schedule %s will be active on: %s. DST: %s", schedule_name, time_str, schedule_time.tm_isdst ? "Yes" : "No");
 
-    /* Calculate difference */
-    time_diff = difftime((mktime(&schedule_time)), mktime(&current_time));
-
-    /* For one time schedules to check for expiry after a reboot. If NVS is enabled, this should be stored in NVS. */
-    trigger->next_scheduled_time_utc = mktime(&schedule_time);
-
     return time_diff;
 }
 
@@ -303,9 +357,150 @@ static bool esp_schedule_is_expired(esp_schedule_trigger_t *trigger)
     return false;
 }
 
+/* Should be called with the lock held */
+static void esp_schedule_heap_swap(size_t a, size_t b)
+{
+    esp_schedule_heap_entry_t entry = schedule_heap[a];
+    schedule_heap[a] = schedule_heap[b];
+    schedule_heap[b] = entry;
+    schedule_heap[a].schedule->heap_index = a;
+    schedule_heap[b].schedule->heap_index = b;
+}
+
+static void esp_schedule_heap_sift_up(size_t index)
+{
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (schedule_heap[parent].deadline_us <= schedule_heap[index].deadline_us) {
+            break;
+        }
+        esp_schedule_heap_swap(index, parent);
+        index = parent;
+    }
+}
+
+static void esp_schedule_heap_sift_down(size_t index)
+{
+    while (true) {
+        size_t smallest = index;
+        size_t left = (2 * index) + 1;
+        size_t right = left + 1;
+        if ((left < schedule_heap_count) && (schedule_heap[left].deadline_us < schedule_heap[smallest].deadline_us)) {
+            smallest = left;
+        }
+        if ((right < schedule_heap_count) && (schedule_heap[right].deadline_us < schedule_heap[smallest].deadline_us)) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        esp_schedule_heap_swap(index, smallest);
+        index = smallest;
+    }
+}
+
+static void esp_schedule_heap_remove(esp_schedule_t *schedule)
+{
+    if (schedule->heap_index < 0) {
+        return;
+    }
+    size_t index = schedule->heap_index;
+    size_t last = --schedule_heap_count;
+    schedule->heap_index = -1;
+    if (index == last) {
+        return;
+    }
+    /* Move the last entry into the hole and restore the heap order around it */
+    esp_schedule_t *moved = schedule_heap[last].schedule;
+    schedule_heap[index] = schedule_heap[last];
+    moved->heap_index = index;
+    esp_schedule_heap_sift_up(index);
+    esp_schedule_heap_sift_down(moved->heap_index);
+}
+
+static esp_err_t esp_schedule_heap_add(esp_schedule_t *schedule, int64_t deadline_us)
+{
+    if (schedule_heap_count == schedule_heap_size) {
+        size_t new_size = schedule_heap_size ? (schedule_heap_size * 2) : ESP_SCHEDULE_HEAP_INITIAL_SIZE;
+        esp_schedule_heap_entry_t *new_heap = MEM_REALLOC_EXTRAM(schedule_heap, new_size * sizeof(esp_schedule_heap_entry_t));
+        if (!new_heap) {
+            return ESP_ERR_NO_MEM;
+        }
+        schedule_heap = new_heap;
+        schedule_heap_size = new_size;
+    }
+    size_t index = schedule_heap_count++;
+    schedule_heap[index].deadline_us = deadline_us;
+    schedule_heap[index].schedule = schedule;
+    schedule->heap_index = index;
+    esp_schedule_heap_sift_up(index);
+    return ESP_OK;
+}
+
+/* Arms the timer for the earliest schedule. The timer command is sent only if the earliest
+ * deadline has changed, so adding or removing any other schedule does not involve the timer task.
+ * Should be called with the lock held. The command is sent without blocking, since the timer task
+ * may itself be waiting for the lock in esp_schedule_common_timer_cb(). Returns false if the timer
+ * command queue was full, in which case the caller should retry.
+ */
+static bool esp_schedule_timer_rearm(void)
+{
+    if (schedule_dispatching) {
+        /* The timer will be rearmed once all the due schedules are processed */
+        return true;
+    }
+    if (schedule_heap_count == 0) {
+        if (schedule_armed_deadline_us != INT64_MAX) {
+            if (xTimerStop(schedule_timer, 0) != pdPASS) {
+                return false;
+            }
+            schedule_armed_deadline_us = INT64_MAX;
+        }
+        return true;
+    }
+    int64_t deadline_us = schedule_heap[0].deadline_us;
+    if (deadline_us == schedule_armed_deadline_us) {
+        return true;
+    }
+    int64_t diff_us = deadline_us - esp_timer_get_time();
+    if (diff_us > ESP_SCHEDULE_MAX_TIMER_PERIOD_US) {
+        /* Longer waits are done in steps, so that the period fits in the tick count */
+        diff_us = ESP_SCHEDULE_MAX_TIMER_PERIOD_US;
+    }
+    const int64_t tick_us = portTICK_PERIOD_MS * 1000;
+    TickType_t ticks = (diff_us > 0) ? (TickType_t)((diff_us + tick_us - 1) / tick_us) : 1;
+    /* This starts the timer as well, if it was not running */
+    if (xTimerChangePeriod(schedule_timer, ticks, 0) != pdPASS) {
+        return false;
+    }
+    schedule_armed_deadline_us = deadline_us;
+    return true;
+}
+
+/* Rearms the timer and releases the lock. Should be called with the lock held, from outside the timer task. */
+static void esp_schedule_timer_rearm_and_unlock(void)
+{
+    while (!esp_schedule_timer_rearm()) {
+        /* The timer command queue is full. Let the timer task drain it, without holding the lock
+         * which it may be waiting for, and then try again.
+         */
+        xSemaphoreGive(schedule_lock);
+        vTaskDelay(1);
+        xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    }
+    xSemaphoreGive(schedule_lock);
+}
+
 static void esp_schedule_stop_timer(esp_schedule_t *schedule)
 {
-    xTimerStop(schedule->timer, portMAX_DELAY);
+    if (!schedule_lock) {
+        return;
+    }
+    xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    if (schedule->heap_index >= 0) {
+        esp_schedule_heap_remove(schedule);
+    }
+    esp_schedule_timer_rearm_and_unlock();
 }
 
 static void esp_schedule_start_timer(esp_schedule_t *schedule)
@@ -324,17 +519,17 @@ static void esp_schedule_start_timer(esp_schedule_t *schedule)
         schedule->timestamp_cb((esp_schedule_handle_t)schedule, schedule->trigger.next_scheduled_time_utc, schedule->priv_data);
     }
 
-    xTimerStop(schedule->timer, portMAX_DELAY);
-    xTimerChangePeriod(schedule->timer, (schedule->next_scheduled_time_diff * 1000) / portTICK_PERIOD_MS, portMAX_DELAY);
+    int64_t deadline_us = esp_timer_get_time() + ((int64_t)schedule->next_scheduled_time_diff * 1000000);
+    xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    esp_schedule_heap_remove(schedule);
+    if (esp_schedule_heap_add(schedule, deadline_us) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the timer for schedule %s", schedule->name);
+    }
+    esp_schedule_timer_rearm_and_unlock();
 }
 
-static void esp_schedule_common_timer_cb(TimerHandle_t timer)
+static void esp_schedule_process(esp_schedule_t *schedule)
 {
-    void *priv_data = pvTimerGetTimerID(timer);
-    if (priv_data == NULL) {
-        return;
-    }
-    esp_schedule_t *schedule = (esp_schedule_t *)priv_data;
     time_t now;
     time(&now);
     struct tm validity_time;
@@ -374,9 +569,61 @@ restart_schedule:
     esp_schedule_start_timer(schedule);
 }
 
-static void esp_schedule_delete_timer(esp_schedule_t *schedule)
+/* Rearms the timer from the work queue task, if that could not be done from the timer task */
+static void esp_schedule_timer_rearm_work(void *priv_data)
 {
-    xTimerDelete(schedule->timer, portMAX_DELAY);
+    xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    esp_schedule_timer_rearm_and_unlock();
+}
+
+static void esp_schedule_common_timer_cb(TimerHandle_t timer)
+{
+    xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    /* The timer has expired, so nothing is armed now */
+    schedule_armed_deadline_us = INT64_MAX;
+    schedule_dispatching = true;
+    while ((schedule_heap_count > 0) && (schedule_heap[0].deadline_us <= esp_timer_get_time())) {
+        esp_schedule_t *schedule = schedule_heap[0].schedule;
+        esp_schedule_heap_remove(schedule);
+        /* The lock is released while processing, since the callbacks may add, edit or remove schedules */
+        xSemaphoreGive(schedule_lock);
+        esp_schedule_process(schedule);
+        xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    }
+    schedule_dispatching = false;
+    /* Timer callbacks must not block. The queue can only be full here due to commands from other
+     * tasks which are not yet processed, so retrying from within the timer task would not help.
+     * The timer is one-shot, so the retry is done from the work queue, which can wait for the
+     * timer task to drain the queue.
+     */
+    if (!esp_schedule_timer_rearm()) {
+        ESP_LOGW(TAG, "Timer command queue is full. Rearming the timer from the work queue.");
+        if (esp_rmaker_work_queue_add_task(esp_schedule_timer_rearm_work, NULL) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to rearm the timer. Schedules will not trigger till one is added or edited.");
+        }
+    }
+    xSemaphoreGive(schedule_lock);
+}
+
+static esp_err_t esp_schedule_timer_init(void)
+{
+    if (schedule_lock) {
+        return ESP_OK;
+    }
+    schedule_lock = xSemaphoreCreateMutex();
+    if (!schedule_lock) {
+        ESP_LOGE(TAG, "Could not create lock");
+        return ESP_ERR_NO_MEM;
+    }
+    /* Temporarily setting the timer for 1 (anything greater than 0) tick. This will get changed when xTimerChangePeriod() is called. */
+    schedule_timer = xTimerCreate("schedule", 1, pdFALSE, NULL, esp_schedule_common_timer_cb);
+    if (!schedule_timer) {
+        ESP_LOGE(TAG, "Could not create timer");
+        vSemaphoreDelete(schedule_lock);
+        schedule_lock = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
 }
 
 static void esp_schedule_create_timer(esp_schedule_t *schedule)
@@ -385,9 +632,8 @@ static void esp_schedule_create_timer(esp_schedule_t *schedule)
         /* This is just used for calculating next_scheduled_time_utc for ESP_SCHEDULE_DAY_ONCE (in case of ESP_SCHEDULE_TYPE_DAYS_OF_WEEK) or for ESP_SCHEDULE_MONTH_ONCE (in case of ESP_SCHEDULE_TYPE_DATE), and only used when NVS is enabled. And if NVS is enabled, time will already be synced and the time will be correctly calculated. */
         schedule->next_scheduled_time_diff = esp_schedule_get_next_schedule_time_diff(schedule->name, &schedule->trigger);
     }
-
-    /* Temporarily setting the timer for 1 (anything greater than 0) tick. This will get changed when xTimerChangePeriod() is called. */
-    schedule->timer = xTimerCreate("schedule", 1, pdFALSE, (void *)schedule, esp_schedule_common_timer_cb);
+    /* All the schedules share a single timer. This just marks the schedule as not armed. */
+    schedule->heap_index = -1;
 }
 
 esp_err_t esp_schedule_get(esp_schedule_handle_t handle, esp_schedule_config_t *schedule_config)
@@ -500,10 +746,7 @@ esp_err_t esp_schedule_delete(esp_schedule_handle_t handle)
     }
     esp_schedule_t *schedule = (esp_schedule_t *)handle;
     ESP_LOGI(TAG, "Deleting schedule %s", schedule->name);
-    if (schedule->timer) {
-        esp_schedule_stop_timer(schedule);
-        esp_schedule_delete_timer(schedule);
-    }
+    esp_schedule_stop_timer(schedule);
     esp_schedule_nvs_remove(schedule);
     free(schedule);
     return ESP_OK;
@@ -524,12 +767,17 @@ esp_schedule_handle_t esp_schedule_create(esp_schedule_config_t *schedule_config
         return NULL;
     }
 
+    if (esp_schedule_timer_init() != ESP_OK) {
+        return NULL;
+    }
+
     esp_schedule_t *schedule = (esp_schedule_t *)MEM_CALLOC_EXTRAM(1, sizeof(esp_schedule_t));
     if (schedule == NULL) {
         ESP_LOGE(TAG, "Could not allocate handle");
         return NULL;
     }
     strlcpy(schedule->name, schedule_config->name, sizeof(schedule->name));
+    schedule->heap_index = -1;
 
     esp_schedule_set(schedule, schedule_config);
 
@@ -563,6 +811,10 @@ esp_schedule_handle_t *esp_schedule_init(bool enable_nvs, char *nvs_partition, u
     /* Wait for time to be updated here */
 
 
+    if (esp_schedule_timer_init() != ESP_OK) {
+        return NULL;
+    }
+
     /* Below this is initialising schedules from NVS */
     esp_schedule_nvs_init(nvs_partition);
 
@@ -580,7 +832,7 @@ esp_schedule_handle_t *esp_schedule_init(bool enable_nvs, char *nvs_partition, u
     for (size_t handle_count = 0; handle_count < *schedule_count; handle_count++) {
         schedule = (esp_schedule_t *)handle_list[handle_count];
         schedule->trigger_cb = NULL;
-        schedule->timer = NULL;
+        schedule->heap_index = -1;
         /* Check for ONCE and expired schedules and delete them. */
         if (esp_schedule_is_expired(&schedule->trigger)) {
             /* This schedule has already expired. */
@@ -14,7 +14,11 @@ typedef struct esp_schedule {
     char name[MAX_SCHEDULE_NAME_LEN + 1];
     esp_schedule_trigger_t trigger;
     uint32_t next_scheduled_time_diff;
-    TimerHandle_t timer;
+    /* Index in the heap of armed schedules, or -1 if not armed. This takes the place of the per schedule
+     * timer handle used earlier, with the same size, so that schedules stored in NVS in the older format,
+     * as the complete structure, can still be migrated.
+     */
+    intptr_t heap_index;
     esp_schedule_trigger_cb_t trigger_cb;
     esp_schedule_timestamp_cb_t timestamp_cb;
     void *priv_data;
@@ -16,16 +16,189 @@
 #include <time.h>
 #include <esp_log.h>
 #include <nvs.h>
+#include <esp_rmaker_utils.h>
 #include "esp_schedule_internal.h"
 
 static const char *TAG = "esp_schedule_nvs";
 
 #define ESP_SCHEDULE_NVS_NAMESPACE "schd"
+/* Used by the older format, which had a blob per schedule, holding the complete esp_schedule_t */
 #define ESP_SCHEDULE_COUNT_KEY "schd_count"
+/* All the schedules are stored in a single blob with this key, as a header followed by the records */
+#define ESP_SCHEDULE_TABLE_KEY "schd_table"
+#define ESP_SCHEDULE_TABLE_VERSION 1
+#define ESP_SCHEDULE_TABLE_MAX_COUNT UINT8_MAX
+
+typedef struct __attribute__((packed)) {
+    uint8_t version;
+    uint8_t count;
+    /* Size of each record. Records written by a later version may be longer, with new fields at the end. */
+    uint16_t record_size;
+} esp_schedule_nvs_table_header_t;
+
+/* Only the fields that need to persist across reboots, with fixed size types */
+typedef struct __attribute__((packed)) {
+    char name[MAX_SCHEDULE_NAME_LEN + 1];
+    uint8_t type;
+    uint8_t hours;
+    uint8_t minutes;
+    uint8_t repeat_days;
+    uint8_t day;
+    uint16_t repeat_months;
+    uint16_t year;
+    uint8_t repeat_every_year;
+    int32_t relative_seconds;
+    int64_t next_scheduled_time_utc;
+    int64_t validity_start_time;
+    int64_t validity_end_time;
+} esp_schedule_nvs_record_t;
 
 static char *esp_schedule_nvs_partition = NULL;
 static bool nvs_enabled = false;
 
+static void esp_schedule_nvs_record_from_schedule(esp_schedule_nvs_record_t *record, esp_schedule_t *schedule)
+{
+    memset(record, 0, sizeof(esp_schedule_nvs_record_t));
+    strlcpy(record->name, schedule->name, sizeof(record->name));
+    record->type = schedule->trigger.type;
+    record->hours = schedule->trigger.hours;
+    record->minutes = schedule->trigger.minutes;
+    record->repeat_days = schedule->trigger.day.repeat_days;
+    record->day = schedule->trigger.date.day;
+    record->repeat_months = schedule->trigger.date.repeat_months;
+    record->year = schedule->trigger.date.year;
+    record->repeat_every_year = schedule->trigger.date.repeat_every_year;
+    record->relative_seconds = schedule->trigger.relative_seconds;
+    record->next_scheduled_time_utc = schedule->trigger.next_scheduled_time_utc;
+    record->validity_start_time = schedule->validity.start_time;
+    record->validity_end_time = schedule->validity.end_time;
+}
+
+static esp_schedule_t *esp_schedule_nvs_schedule_from_record(esp_schedule_nvs_record_t *record)
+{
+    esp_schedule_t *schedule = (esp_schedule_t *)MEM_CALLOC_EXTRAM(1, sizeof(esp_schedule_t));
+    if (schedule == NULL) {
+        ESP_LOGE(TAG, "Could not allocate handle");
+        return NULL;
+    }
+    strlcpy(schedule->name, record->name, sizeof(schedule->name));
+    schedule->trigger.type = record->type;
+    schedule->trigger.hours = record->hours;
+    schedule->trigger.minutes = record->minutes;
+    schedule->trigger.day.repeat_days = record->repeat_days;
+    schedule->trigger.date.day = record->day;
+    schedule->trigger.date.repeat_months = record->repeat_months;
+    schedule->trigger.date.year = record->year;
+    schedule->trigger.date.repeat_every_year = record->repeat_every_year;
+    schedule->trigger.relative_seconds = record->relative_seconds;
+    schedule->trigger.next_scheduled_time_utc = (time_t)record->next_scheduled_time_utc;
+    schedule->validity.start_time = (time_t)record->validity_start_time;
+    schedule->validity.end_time = (time_t)record->validity_end_time;
+    schedule->heap_index = -1;
+    return schedule;
+}
+
+/* Reads the table into an array of records, with room for one more, for adding a schedule.
+ * A missing or unreadable table is treated as an empty one.
+ */
+static esp_err_t esp_schedule_nvs_table_read(nvs_handle_t nvs_handle, esp_schedule_nvs_record_t **records, uint8_t *count)
+{
+    *records = NULL;
+    *count = 0;
+    size_t buf_size = 0;
+    uint8_t *buf = NULL;
+    esp_schedule_nvs_table_header_t header = {0};
+    esp_err_t err = nvs_get_blob(nvs_handle, ESP_SCHEDULE_TABLE_KEY, NULL, &buf_size);
+    if (err == ESP_OK) {
+        buf = (uint8_t *)MEM_ALLOC_EXTRAM(buf_size);
+        if (buf == NULL) {
+            ESP_LOGE(TAG, "Could not allocate %d bytes for schedules", buf_size);
+            return ESP_ERR_NO_MEM;
+        }
+        err = nvs_get_blob(nvs_handle, ESP_SCHEDULE_TABLE_KEY, buf, &buf_size);
+    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = ESP_OK;
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS get failed with error %d", err);
+        free(buf);
+        return err;
+    }
+    if (buf) {
+        if (buf_size >= sizeof(header)) {
+            memcpy(&header, buf, sizeof(header));
+        }
+        /* Later versions only add fields at the end of the records, which record_size accounts for */
+        if ((buf_size < sizeof(header)) || (header.version < ESP_SCHEDULE_TABLE_VERSION) ||
+                (header.record_size < sizeof(esp_schedule_nvs_record_t)) ||
+                (buf_size < sizeof(header) + ((size_t)header.count * header.record_size))) {
+            /* Failing here would block all the later writes as well. Start afresh instead, so that the
+             * schedules can be set again, and the next write replaces the unreadable table.
+             */
+            ESP_LOGE(TAG, "Invalid schedules table in NVS. Version: %d, Size: %d. Discarding it.",
+                    header.version, buf_size);
+            memset(&header, 0, sizeof(header));
+        }
+    }
+    *records = (esp_schedule_nvs_record_t *)MEM_CALLOC_EXTRAM(header.count + 1, sizeof(esp_schedule_nvs_record_t));
+    if (*records == NULL) {
+        ESP_LOGE(TAG, "Could not allocate schedule records");
+        free(buf);
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < header.count; i++) {
+        /* Any fields added after this version are skipped */
+        memcpy(&(*records)[i], buf + sizeof(header) + (i * header.record_size), sizeof(esp_schedule_nvs_record_t));
+        (*records)[i].name[MAX_SCHEDULE_NAME_LEN] = '\0';
+    }
+    *count = header.count;
+    free(buf);
+    return ESP_OK;
+}
+
+/* Writes the complete table, or erases it if there are no schedules */
+static esp_err_t esp_schedule_nvs_table_write(nvs_handle_t nvs_handle, esp_schedule_nvs_record_t *records, uint8_t count)
+{
+    esp_err_t err;
+    if (count == 0) {
+        err = nvs_erase_key(nvs_handle, ESP_SCHEDULE_TABLE_KEY);
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            err = ESP_OK;
+        }
+    } else {
+        esp_schedule_nvs_table_header_t header = {
+            .version = ESP_SCHEDULE_TABLE_VERSION,
+            .count = count,
+            .record_size = sizeof(esp_schedule_nvs_record_t),
+        };
+        size_t buf_size = sizeof(header) + (count * sizeof(esp_schedule_nvs_record_t));
+        uint8_t *buf = (uint8_t *)MEM_ALLOC_EXTRAM(buf_size);
+        if (buf == NULL) {
+            ESP_LOGE(TAG, "Could not allocate %d bytes for schedules", buf_size);
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(buf, &header, sizeof(header));
+        memcpy(buf + sizeof(header), records, count * sizeof(esp_schedule_nvs_record_t));
+        err = nvs_set_blob(nvs_handle, ESP_SCHEDULE_TABLE_KEY, buf, buf_size);
+        free(buf);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS set failed for schedules with error %d", err);
+        return err;
+    }
+    return nvs_commit(nvs_handle);
+}
+
+static int esp_schedule_nvs_table_find(esp_schedule_nvs_record_t *records, uint8_t count, const char *name)
+{
+    for (int i = 0; i < count; i++) {
+        if (strncmp(records[i].name, name, sizeof(records[i].name)) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 esp_err_t esp_schedule_nvs_add(esp_schedule_t *schedule)
 {
     if (!nvs_enabled) {
@@ -38,51 +211,34 @@ esp_err_t esp_schedule_nvs_add(esp_schedule_t *schedule)
         ESP_LOGE(TAG, "NVS open failed with error %d", err);
         return err;
     }
+    esp_schedule_nvs_record_t *records = NULL;
+    uint8_t count = 0;
+    err = esp_schedule_nvs_table_read(nvs_handle, &records, &count);
+    if (err != ESP_OK) {
+        nvs_close(nvs_handle);
+        return err;
+    }
 
     /* Check if this is new schedule or editing an existing schedule */
-    size_t buf_size;
-    bool editing_schedule = true;
-    err = nvs_get_blob(nvs_handle, schedule->name, NULL, &buf_size);
-    if (err != ESP_OK) {
-        if (err == ESP_ERR_NVS_NOT_FOUND) {
-            editing_schedule = false;
-        } else {
-            ESP_LOGE(TAG, "NVS get failed with error %d", err);
-            nvs_close(nvs_handle);
-            return err;
-        }
-    } else {
+    int index = esp_schedule_nvs_table_find(records, count, schedule->name);
+    if (index >= 0) {
         ESP_LOGI(TAG, "Updating the existing schedule %s", schedule->name);
+    } else if (count < ESP_SCHEDULE_TABLE_MAX_COUNT) {
+        /* The table read leaves room for one more record */
+        index = count++;
+    } else {
+        ESP_LOGE(TAG, "Max %d schedules can be stored in NVS", ESP_SCHEDULE_TABLE_MAX_COUNT);
+        free(records);
+        nvs_close(nvs_handle);
+        return ESP_ERR_NO_MEM;
     }
-
-    err = nvs_set_blob(nvs_handle, schedule->name, schedule, sizeof(esp_schedule_t));
+    esp_schedule_nvs_record_from_schedule(&records[index], schedule);
+    err = esp_schedule_nvs_table_write(nvs_handle, records, count);
+    free(records);
+    nvs_close(nvs_handle);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "NVS set failed with error %d", err);
-        nvs_close(nvs_handle);
         return err;
     }
-    if (editing_schedule == false) {
-        uint8_t schedule_count;
-        err = nvs_get_u8(nvs_handle, ESP_SCHEDULE_COUNT_KEY, &schedule_count);
-        if (err != ESP_OK) {
-            if (err == ESP_ERR_NVS_NOT_FOUND) {
-                schedule_count = 0;
-            } else {
-                ESP_LOGE(TAG, "NVS get failed with error %d", err);
-                nvs_close(nvs_handle);
-                return err;
-            }
-        }
-        schedule_count++;
-        err = nvs_set_u8(nvs_handle, ESP_SCHEDULE_COUNT_KEY, schedule_count);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "NVS set failed for schedule count with error %d", err);
-            nvs_close(nvs_handle);
-            return err;
-        }
-    }
-    nvs_commit(nvs_handle);
-    nvs_close(nvs_handle);
     ESP_LOGI(TAG, "Schedule %s added in NVS", schedule->name);
     return ESP_OK;
 }
@@ -123,33 +279,35 @@ esp_err_t esp_schedule_nvs_remove(esp_schedule_t *schedule)
         ESP_LOGE(TAG, "NVS open failed with error %d", err);
         return err;
     }
-    err = nvs_erase_key(nvs_handle, schedule->name);
+    esp_schedule_nvs_record_t *records = NULL;
+    uint8_t count = 0;
+    err = esp_schedule_nvs_table_read(nvs_handle, &records, &count);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "NVS erase key failed with error %d", err);
         nvs_close(nvs_handle);
         return err;
     }
-    uint8_t schedule_count;
-    err = nvs_get_u8(nvs_handle, ESP_SCHEDULE_COUNT_KEY, &schedule_count);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "NVS get failed for schedule count with error %d", err);
+    int index = esp_schedule_nvs_table_find(records, count, schedule->name);
+    if (index < 0) {
+        ESP_LOGE(TAG, "Schedule %s not found in NVS", schedule->name);
+        free(records);
         nvs_close(nvs_handle);
-        return err;
+        return ESP_ERR_NOT_FOUND;
     }
-    schedule_count--;
-    err = nvs_set_u8(nvs_handle, ESP_SCHEDULE_COUNT_KEY, schedule_count);
+    /* The order of the schedules does not matter, so just move the last one into the freed slot */
+    records[index] = records[--count];
+    err = esp_schedule_nvs_table_write(nvs_handle, records, count);
+    free(records);
+    nvs_close(nvs_handle);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "NVS set failed for schedule count with error %d", err);
-        nvs_close(nvs_handle);
         return err;
     }
-    nvs_commit(nvs_handle);
-    nvs_close(nvs_handle);
     ESP_LOGI(TAG, "Schedule %s removed from NVS", schedule->name);
     return ESP_OK;
 }
 
-static uint8_t esp_schedule_nvs_get_count(void)
+/********* Older format, with a blob per schedule. Only read, for migrating to the table. *********/
+
+static uint8_t esp_schedule_nvs_legacy_get_count(void)
 {
     if (!nvs_enabled) {
         ESP_LOGD(TAG, "NVS not enabled. Not getting count from NVS.");
@@ -173,7 +331,7 @@ static uint8_t esp_schedule_nvs_get_count(void)
     return schedule_count;
 }
 
-static esp_schedule_handle_t esp_schedule_nvs_get(char *nvs_key)
+static esp_schedule_handle_t esp_schedule_nvs_legacy_get(char *nvs_key)
 {
     if (!nvs_enabled) {
         ESP_LOGD(TAG, "NVS not enabled. Not getting from NVS.");
@@ -192,7 +350,12 @@ static esp_schedule_handle_t esp_schedule_nvs_get(char *nvs_key)
         nvs_close(nvs_handle);
         return NULL;
     }
-    esp_schedule_t *schedule = (esp_schedule_t *)malloc(buf_size);
+    if (buf_size > sizeof(esp_schedule_t)) {
+        ESP_LOGE(TAG, "Invalid size %d for schedule %s", buf_size, nvs_key);
+        nvs_close(nvs_handle);
+        return NULL;
+    }
+    esp_schedule_t *schedule = (esp_schedule_t *)MEM_CALLOC_EXTRAM(1, sizeof(esp_schedule_t));
     if (schedule == NULL) {
         ESP_LOGE(TAG, "Could not allocate handle");
         nvs_close(nvs_handle);
@@ -206,18 +369,23 @@ static esp_schedule_handle_t esp_schedule_nvs_get(char *nvs_key)
         return NULL;
     }
     nvs_close(nvs_handle);
+    /* The runtime fields were stored as well in this format, and are stale */
+    schedule->trigger_cb = NULL;
+    schedule->timestamp_cb = NULL;
+    schedule->priv_data = NULL;
+    schedule->heap_index = -1;
     ESP_LOGI(TAG, "Schedule %s found in NVS", schedule->name);
     return (esp_schedule_handle_t) schedule;
 }
 
-esp_schedule_handle_t *esp_schedule_nvs_get_all(uint8_t *schedule_count)
+static esp_schedule_handle_t *esp_schedule_nvs_legacy_get_all(uint8_t *schedule_count)
 {
     if (!nvs_enabled) {
         ESP_LOGD(TAG, "NVS not enabled. Not Initialising NVS.");
         return NULL;
     }
 
-    *schedule_count = esp_schedule_nvs_get_count();
+    *schedule_count = esp_schedule_nvs_legacy_get_count();
     if (*schedule_count == 0) {
         ESP_LOGI(TAG, "No Entries found in NVS");
         return NULL;
@@ -236,12 +404,14 @@ esp_schedule_handle_t *esp_schedule_nvs_get_all(uint8_t *schedule_count)
     esp_err_t err = nvs_entry_find(esp_schedule_nvs_partition, ESP_SCHEDULE_NVS_NAMESPACE, NVS_TYPE_BLOB, &nvs_iterator);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "No entry found in NVS");
-        return NULL;;
+        free(handle_list);
+        *schedule_count = 0;
+        return NULL;
     }
     while (err == ESP_OK) {
         nvs_entry_info(nvs_iterator, &nvs_entry);
         ESP_LOGI(TAG, "Found schedule in NVS with key: %s", nvs_entry.key);
-        handle_list[handle_count] = esp_schedule_nvs_get(nvs_entry.key);
+        handle_list[handle_count] = esp_schedule_nvs_legacy_get(nvs_entry.key);
         if (handle_list[handle_count] != NULL) {
             /* Increase count only if nvs_get was successful */
             handle_count++;
@@ -253,12 +423,14 @@ esp_schedule_handle_t *esp_schedule_nvs_get_all(uint8_t *schedule_count)
     nvs_iterator_t nvs_iterator = nvs_entry_find(esp_schedule_nvs_partition, ESP_SCHEDULE_NVS_NAMESPACE, NVS_TYPE_BLOB);
     if (nvs_iterator == NULL) {
         ESP_LOGE(TAG, "No entry found in NVS");
-        return NULL;;
+        free(handle_list);
+        *schedule_count = 0;
+        return NULL;
     }
     while (nvs_iterator != NULL) {
         nvs_entry_info(nvs_iterator, &nvs_entry);
         ESP_LOGI(TAG, "Found schedule in NVS with key: %s", nvs_entry.key);
-        handle_list[handle_count] = esp_schedule_nvs_get(nvs_entry.key);
+        handle_list[handle_count] = esp_schedule_nvs_legacy_get(nvs_entry.key);
         if (handle_list[handle_count] != NULL) {
             /* Increase count only if nvs_get was successful */
             handle_count++;
@@ -266,6 +438,90 @@ esp_schedule_handle_t *esp_schedule_nvs_get_all(uint8_t *schedule_count)
         nvs_iterator = nvs_entry_next(nvs_iterator);
     }
 #endif
+    *schedule_count = handle_count;
+    ESP_LOGI(TAG, "Found %d schedules in NVS in the older format", *schedule_count);
+    return handle_list;
+}
+
+/* Moves the schedules stored in the older format to the table, and erases the older entries */
+static esp_schedule_handle_t *esp_schedule_nvs_migrate(nvs_handle_t nvs_handle, uint8_t *schedule_count)
+{
+    esp_schedule_handle_t *handle_list = esp_schedule_nvs_legacy_get_all(schedule_count);
+    if (handle_list == NULL) {
+        return NULL;
+    }
+    esp_schedule_nvs_record_t *records = (esp_schedule_nvs_record_t *)MEM_CALLOC_EXTRAM(*schedule_count, sizeof(esp_schedule_nvs_record_t));
+    if (records == NULL) {
+        /* The schedules are still usable. Migration will be attempted again on the next boot. */
+        ESP_LOGE(TAG, "Could not allocate schedule records for migration");
+        return handle_list;
+    }
+    for (int i = 0; i < *schedule_count; i++) {
+        esp_schedule_nvs_record_from_schedule(&records[i], (esp_schedule_t *)handle_list[i]);
+    }
+    /* The table is written first, so that the schedules are not lost if this gets interrupted */
+    esp_err_t err = esp_schedule_nvs_table_write(nvs_handle, records, *schedule_count);
+    free(records);
+    if (err != ESP_OK) {
+        return handle_list;
+    }
+    for (int i = 0; i < *schedule_count; i++) {
+        nvs_erase_key(nvs_handle, ((esp_schedule_t *)handle_list[i])->name);
+    }
+    nvs_erase_key(nvs_handle, ESP_SCHEDULE_COUNT_KEY);
+    nvs_commit(nvs_handle);
+    ESP_LOGI(TAG, "Migrated %d schedules to the new NVS format", *schedule_count);
+    return handle_list;
+}
+
+esp_schedule_handle_t *esp_schedule_nvs_get_all(uint8_t *schedule_count)
+{
+    *schedule_count = 0;
+    if (!nvs_enabled) {
+        ESP_LOGD(TAG, "NVS not enabled. Not Initialising NVS.");
+        return NULL;
+    }
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open_from_partition(esp_schedule_nvs_partition, ESP_SCHEDULE_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "NVS open failed with error %d", err);
+        return NULL;
+    }
+    esp_schedule_nvs_record_t *records = NULL;
+    uint8_t count = 0;
+    err = esp_schedule_nvs_table_read(nvs_handle, &records, &count);
+    if (err != ESP_OK) {
+        nvs_close(nvs_handle);
+        return NULL;
+    }
+    esp_schedule_handle_t *handle_list = NULL;
+    if (count == 0) {
+        uint8_t legacy_count = 0;
+        if (nvs_get_u8(nvs_handle, ESP_SCHEDULE_COUNT_KEY, &legacy_count) == ESP_OK && legacy_count > 0) {
+            handle_list = esp_schedule_nvs_migrate(nvs_handle, schedule_count);
+        } else {
+            ESP_LOGI(TAG, "No Entries found in NVS");
+        }
+        free(records);
+        nvs_close(nvs_handle);
+        return handle_list;
+    }
+    nvs_close(nvs_handle);
+    handle_list = (esp_schedule_handle_t *)malloc(sizeof(esp_schedule_handle_t) * count);
+    if (handle_list == NULL) {
+        ESP_LOGE(TAG, "Could not allocate schedule list");
+        free(records);
+        return NULL;
+    }
+    int handle_count = 0;
+    for (int i = 0; i < count; i++) {
+        handle_list[handle_count] = esp_schedule_nvs_schedule_from_record(&records[i]);
+        if (handle_list[handle_count] != NULL) {
+            ESP_LOGI(TAG, "Schedule %s found in NVS", records[i].name);
+            handle_count++;
+        }
+    }
+    free(records);
     *schedule_count = handle_count;
     ESP_LOGI(TAG, "Found %d schedules in NVS", *schedule_count);
     return handle_list;
@@ -0,0 +1,235 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Reference implementation of the next trigger time computation, as it was before it moved to a single
+ * mktime() on the broken down schedule time. The new computation is checked against this one.
+ * The functions are renamed with a ref_ prefix, so that this can be built along with esp_schedule.c.
+ */
+
+static int ref_get_no_of_days(esp_schedule_trigger_t *trigger, struct tm *current_time, struct tm *schedule_time)
+{
+    /* for day, monday = 0, sunday = 6. */
+    int next_day = 0;
+    /* struct tm has tm_wday with sunday as 0. Whereas we have monday as 0. Converting struct tm to our format */
+    int today = ((current_time->tm_wday + 7 - 1) % 7);
+
+    esp_schedule_days_t today_bit = 1 << today;
+    uint8_t repeat_days = trigger->day.repeat_days;
+    int current_seconds = (current_time->tm_hour * 60 + current_time->tm_min) * 60 + current_time->tm_sec;
+    int schedule_seconds = (schedule_time->tm_hour * 60 + schedule_time->tm_min) * 60;
+
+    /* Handling for one time schedule */
+    if (repeat_days == ESP_SCHEDULE_DAY_ONCE) {
+        if (schedule_seconds > current_seconds) {
+            /* The schedule is today and is yet to go off */
+            return 0;
+        } else {
+            /* The schedule is tomorrow */
+            return 1;
+        }
+    }
+
+    /* Handling for repeating schedules */
+    /* Check if it is today */
+    if ((repeat_days & today_bit)) {
+        if (schedule_seconds > current_seconds) {
+            /* The schedule is today and is yet to go off. */
+            return 0;
+        }
+    }
+    /* Check if it is this week or next week */
+    if ((repeat_days & (today_bit ^ 0xFF)) > today_bit) {
+        /* Next schedule is yet to come in this week */
+        next_day = ffs(repeat_days & (0xFF << (today + 1))) - 1;
+        return (next_day - today);
+    } else {
+        /* First scheduled day of the next week */
+        next_day = ffs(repeat_days) - 1;
+        if (next_day == today) {
+            /* Same day, next week */
+            return 7;
+        }
+        return (7 - today + next_day);
+    }
+
+    ESP_LOGE(TAG, "No of days could not be found. This should not happen.");
+    return 0;
+}
+
+static uint8_t ref_get_next_month(esp_schedule_trigger_t *trigger, struct tm *current_time, struct tm *schedule_time)
+{
+    int current_seconds = (current_time->tm_hour * 60 + current_time->tm_min) * 60 + current_time->tm_sec;
+    int schedule_seconds = (schedule_time->tm_hour * 60 + schedule_time->tm_min) * 60;
+    /* +1 is because struct tm has months starting from 0, whereas we have them starting from 1 */
+    uint8_t current_month = current_time->tm_mon + 1;
+    /* -1 because month_bit starts from 0b1. So for January, it should be 1 << 0. And current_month starts from 1. */
+    uint16_t current_month_bit = 1 << (current_month - 1);
+    uint8_t next_schedule_month = 0;
+    uint16_t repeat_months = trigger->date.repeat_months;
+
+    /* Check if month is not specified */
+    if (repeat_months == ESP_SCHEDULE_MONTH_ONCE) {
+        if (trigger->date.day == current_time->tm_mday) {
+            /* The schedule day is same. Check if time has already passed */
+            if (schedule_seconds > current_seconds) {
+                /* The schedule is today and is yet to go off */
+                return current_month;
+            } else {
+                /* Today's time has passed */
+                return (current_month + 1);
+            }
+        } else if (trigger->date.day > current_time->tm_mday) {
+            /* The day is yet to come in this month */
+            return current_month;
+        } else {
+            /* The day has passed in the current month */
+            return (current_month + 1);
+        }
+    }
+
+    /* Check if schedule is not this year itself, it is in future. */
+    if (trigger->date.year > (current_time->tm_year + 1900)) {
+        /* Find first schedule month of next year */
+        next_schedule_month = ffs(repeat_months);
+        /* Year will be handled by the caller. So no need to add any additional months */
+        return next_schedule_month;
+    }
+
+    /* Check if schedule is this month and is yet to come */
+    if (current_month_bit & repeat_months) {
+        if (trigger->date.day == current_time->tm_mday) {
+            /* The schedule day is same. Check if time has already passed */
+            if (schedule_seconds > current_seconds) {
+                /* The schedule is today and is yet to go off */
+                return current_month;
+            }
+        }
+        if (trigger->date.day > current_time->tm_mday) {
+            /* The day is yet to come in this month */
+            return current_month;
+        }
+    }
+
+    /* Check if schedule is this year */
+    if ((repeat_months & (current_month_bit ^ 0xFFFF)) > current_month_bit) {
+        /* Next schedule month is yet to come in this year */
+        next_schedule_month = ffs(repeat_months & (0xFFFF << (current_month)));
+        return next_schedule_month;
+    }
+
+    /* Check if schedule is for this year and does not repeat */
+    if (!trigger->date.repeat_every_year) {
+        if (trigger->date.year <= (current_time->tm_year + 1900)) {
+            ESP_LOGE(TAG, "Schedule does not repeat next year, but get_next_month has been called.");
+            return 0;
+        }
+    }
+
+    /* Schedule is not this year */
+    /* Find first schedule month of next year */
+    next_schedule_month = ffs(repeat_months);
+    /* +12 because the schedule is next year */
+    return (next_schedule_month + 12);
+}
+
+static uint16_t ref_get_next_year(esp_schedule_trigger_t *trigger, struct tm *current_time, struct tm *schedule_time)
+{
+    uint16_t current_year = current_time->tm_year + 1900;
+    uint16_t schedule_year = trigger->date.year;
+    if (schedule_year > current_year) {
+        return schedule_year;
+    }
+    /* If the schedule is set to repeat_every_year, we return the current year */
+    /* If the schedule has already passed in this year, we still return current year, as the additional months will be handled in get_next_month */
+    return current_year;
+}
+
+static uint32_t ref_get_next_schedule_time_diff(const char *schedule_name, esp_schedule_trigger_t *trigger)
+{
+    struct tm current_time, schedule_time;
+    time_t now;
+    char time_str[64];
+    int32_t time_diff;
+
+    /* Get current time */
+    time(&now);
+    /* Handling ESP_SCHEDULE_TYPE_RELATIVE first since it doesn't require any
+     * computation based on days, hours, minutes, etc.
+     */
+    if (trigger->type == ESP_SCHEDULE_TYPE_RELATIVE) {
+        /* If next scheduled time is already set, just compute the difference
+         * between current time and next scheduled time and return that diff.
+         */
+        time_t target;
+        if (trigger->next_scheduled_time_utc > 0) {
+            target = (time_t)trigger->next_scheduled_time_utc;
+            time_diff = difftime(target, now);
+        } else {
+            target = now + (time_t)trigger->relative_seconds;
+            time_diff = trigger->relative_seconds;
+        }
+        localtime_r(&target, &schedule_time);
+        trigger->next_scheduled_time_utc = mktime(&schedule_time);
+        /* Print schedule time */
+        memset(time_str, 0, sizeof(time_str));
+        strftime(time_str, sizeof(time_str), "%c %z[%Z]", &schedule_time);
+        ESP_LOGI(TAG, "Schedule %s will be active on: %s. DST: %s", schedule_name, time_str, schedule_time.tm_isdst ? "Yes" : "No");
+        return time_diff;
+    }
+    localtime_r(&now, &current_time);
+
+    /* Get schedule time */
+    localtime_r(&now, &schedule_time);
+    schedule_time.tm_sec = 0;
+    schedule_time.tm_min = trigger->minutes;
+    schedule_time.tm_hour = trigger->hours;
+    mktime(&schedule_time);
+
+    /* Adjust schedule day */
+    if (trigger->type == ESP_SCHEDULE_TYPE_DAYS_OF_WEEK) {
+        int no_of_days = 0;
+        no_of_days = ref_get_no_of_days(trigger, &current_time, &schedule_time);
+        schedule_time.tm_sec += no_of_days * SECONDS_IN_DAY;
+    }
+    if (trigger->type == ESP_SCHEDULE_TYPE_DATE) {
+        schedule_time.tm_mday = trigger->date.day;
+        schedule_time.tm_mon = ref_get_next_month(trigger, &current_time, &schedule_time) - 1;
+        schedule_time.tm_year = ref_get_next_year(trigger, &current_time, &schedule_time) - 1900;
+        if (schedule_time.tm_mon < 0) {
+            ESP_LOGE(TAG, "Invalid month found: %d. Setting it to next month.", schedule_time.tm_mon);
+            schedule_time.tm_mon = current_time.tm_mon + 1;
+        }
+        if (schedule_time.tm_mon >= 12) {
+            schedule_time.tm_year += schedule_time.tm_mon / 12;
+            schedule_time.tm_mon = schedule_time.tm_mon % 12;
+        }
+    }
+    mktime(&schedule_time);
+
+    /* Adjust time according to DST */
+    time_t dst_adjust = 0;
+    if (!current_time.tm_isdst && schedule_time.tm_isdst) {
+        dst_adjust = -3600;
+    } else if (current_time.tm_isdst && !schedule_time.tm_isdst ) {
+        dst_adjust = 3600;
+    }
+    ESP_LOGD(TAG, "DST adjust seconds: %lld", (long long) dst_adjust);
+    schedule_time.tm_sec += dst_adjust;
+    mktime(&schedule_time);
+
+    /* Print schedule time */
+    memset(time_str, 0, sizeof(time_str));
+    strftime(time_str, sizeof(time_str), "%c %z[%Z]", &schedule_time);
+    ESP_LOGI(TAG, "Schedule %s will be active on: %s. DST: %s", schedule_name, time_str, schedule_time.tm_isdst ? "Yes" : "No");
+
+    /* Calculate difference */
+    time_diff = difftime((mktime(&schedule_time)), mktime(&current_time));
+
+    /* For one time schedules to check for expiry after a reboot. If NVS is enabled, this should be stored in NVS. */
+    trigger->next_scheduled_time_utc = mktime(&schedule_time);
+
+    return time_diff;
+}
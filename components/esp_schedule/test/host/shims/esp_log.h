@@ -0,0 +1,28 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host build shim of esp_log.h. Logs are printed only if ESP_SCHEDULE_HOST_LOG is set to 1,
+ * but the arguments are always checked against the format.
+ */
+#pragma once
+
+#include <stdio.h>
+
+#ifndef ESP_SCHEDULE_HOST_LOG
+#define ESP_SCHEDULE_HOST_LOG 0
+#endif
+
+#define ESP_HOST_LOG(level, tag, format, ...) do { \
+        if (ESP_SCHEDULE_HOST_LOG) { \
+            printf(level " (%s) " format "\n", tag, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) ESP_HOST_LOG("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_HOST_LOG("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_HOST_LOG("I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_HOST_LOG("D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_HOST_LOG("V", tag, format, ##__VA_ARGS__)
@@ -0,0 +1,23 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host build shim of esp_rmaker_mqtt_glue.h, with just the types needed by esp_rmaker_mqtt.h. The MQTT
+ * connection itself is not part of any host build.
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+typedef struct esp_rmaker_mqtt_conn_params esp_rmaker_mqtt_conn_params_t;
+
+typedef void (*esp_rmaker_mqtt_subscribe_cb_t)(const char *topic, void *payload, size_t payload_len, void *priv_data);
+
+typedef struct {
+    bool setup_done;
+} esp_rmaker_mqtt_config_t;
@@ -0,0 +1,16 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host build shim of esp_rmaker_utils.h, with just the allocators used by esp_schedule */
+#pragma once
+
+#include <stdlib.h>
+#include <esp_err.h>
+#include <esp_idf_version.h>
+
+#define MEM_ALLOC_EXTRAM(size)          malloc(size)
+#define MEM_CALLOC_EXTRAM(num, size)    calloc(num, size)
+#define MEM_REALLOC_EXTRAM(ptr, size)   realloc(ptr, size)
@@ -0,0 +1,16 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host build shim of esp_rmaker_work_queue.h. Tasks are queued in a FIFO, which the test runs with
+ * host_work_queue_run().
+ */
+#pragma once
+
+#include <esp_err.h>
+
+typedef void (*esp_rmaker_work_fn_t)(void *priv_data);
+
+esp_err_t esp_rmaker_work_queue_add_task(esp_rmaker_work_fn_t work_fn, void *priv_data);
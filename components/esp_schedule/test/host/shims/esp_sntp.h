@@ -0,0 +1,17 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host build shim of esp_sntp.h. SNTP is never started on the host. */
+#pragma once
+
+#include <stdbool.h>
+
+#define SNTP_OPMODE_POLL 0
+
+bool esp_sntp_enabled(void);
+void esp_sntp_setoperatingmode(int operating_mode);
+void esp_sntp_setservername(int idx, const char *server);
+void esp_sntp_init(void);
@@ -0,0 +1,12 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host build shim of esp_timer.h. The time is controlled by the test. */
+#pragma once
+
+#include <stdint.h>
+
+int64_t esp_timer_get_time(void);
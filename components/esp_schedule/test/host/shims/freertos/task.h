@@ -0,0 +1,12 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host build shim of FreeRTOS task.h */
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+void vTaskDelay(const TickType_t ticks);
@@ -0,0 +1,13 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Functions available in newlib on the ESP targets, but not in glibc. Included before every source file. */
+#pragma once
+
+#include <stddef.h>
+
+int fls(int mask);
+size_t strlcpy(char *dst, const char *src, size_t size);
@@ -0,0 +1,24 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Controls for the host shims, for the tests which exercise the timer */
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+
+/* Makes the timer commands fail, as if the timer command queue was full */
+extern bool host_timer_queue_full;
+
+/* Moves esp_timer_get_time() ahead of the monotonic clock */
+void host_time_advance_us(int64_t us);
+bool host_timer_is_active(void);
+TickType_t host_timer_get_period(void);
+/* Invokes the timer callback, if the timer is active. The timer is one-shot, so it stops first. */
+void host_timer_fire(void);
+/* Runs the queued work queue tasks, including any which they queue. Returns the number run. */
+int host_work_queue_run(void);
@@ -0,0 +1,273 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host implementations of the IDF, FreeRTOS and NVS functions used by esp_schedule, and by the other host
+ * builds which share these shims. The tests are single threaded, so the lock does nothing and the queues
+ * never block. The timer and the work queue only run when the test asks for it, using the controls in
+ * host_shims.h.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <esp_sntp.h>
+#include <freertos/task.h>
+#include <freertos/timers.h>
+#include <freertos/semphr.h>
+#include <freertos/queue.h>
+#include <esp_rmaker_work_queue.h>
+#include "esp_schedule_internal.h"
+#include "host_shims.h"
+
+#define HOST_WORK_QUEUE_SIZE    16
+
+static int s_dummy_handle;
+static int64_t s_time_offset_us;
+
+bool host_timer_queue_full;
+static TimerCallbackFunction_t s_timer_cb;
+static bool s_timer_active;
+static TickType_t s_timer_period;
+
+static struct {
+    esp_rmaker_work_fn_t work_fn;
+    void *priv_data;
+} s_work_queue[HOST_WORK_QUEUE_SIZE];
+static int s_work_queue_head;
+static int s_work_queue_count;
+
+int64_t esp_timer_get_time(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((int64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000) + s_time_offset_us;
+}
+
+void host_time_advance_us(int64_t us)
+{
+    s_time_offset_us += us;
+}
+
+bool host_timer_is_active(void)
+{
+    return s_timer_active;
+}
+
+TickType_t host_timer_get_period(void)
+{
+    return s_timer_period;
+}
+
+void host_timer_fire(void)
+{
+    if (s_timer_active) {
+        s_timer_active = false;
+        s_timer_cb(&s_dummy_handle);
+    }
+}
+
+esp_err_t esp_rmaker_work_queue_add_task(esp_rmaker_work_fn_t work_fn, void *priv_data)
+{
+    if (s_work_queue_count == HOST_WORK_QUEUE_SIZE) {
+        return ESP_FAIL;
+    }
+    int index = (s_work_queue_head + s_work_queue_count) % HOST_WORK_QUEUE_SIZE;
+    s_work_queue[index].work_fn = work_fn;
+    s_work_queue[index].priv_data = priv_data;
+    s_work_queue_count++;
+    return ESP_OK;
+}
+
+int host_work_queue_run(void)
+{
+    int count = 0;
+    while (s_work_queue_count) {
+        esp_rmaker_work_fn_t work_fn = s_work_queue[s_work_queue_head].work_fn;
+        void *priv_data = s_work_queue[s_work_queue_head].priv_data;
+        s_work_queue_head = (s_work_queue_head + 1) % HOST_WORK_QUEUE_SIZE;
+        s_work_queue_count--;
+        work_fn(priv_data);
+        count++;
+    }
+    return count;
+}
+
+void vTaskDelay(const TickType_t ticks)
+{
+    (void)ticks;
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *id,
+        TimerCallbackFunction_t callback)
+{
+    s_timer_cb = callback;
+    s_timer_period = period;
+    return &s_dummy_handle;
+}
+
+BaseType_t xTimerStop(TimerHandle_t timer, TickType_t ticks_to_wait)
+{
+    if (host_timer_queue_full) {
+        return pdFAIL;
+    }
+    s_timer_active = false;
+    return pdPASS;
+}
+
+BaseType_t xTimerChangePeriod(TimerHandle_t timer, TickType_t new_period, TickType_t ticks_to_wait)
+{
+    if (host_timer_queue_full) {
+        return pdFAIL;
+    }
+    s_timer_period = new_period;
+    s_timer_active = true;
+    return pdPASS;
+}
+
+typedef struct {
+    uint8_t *items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+} host_queue_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    host_queue_t *queue = calloc(1, sizeof(host_queue_t));
+    if (!queue) {
+        return NULL;
+    }
+    queue->items = calloc(length, item_size);
+    if (!queue->items) {
+        free(queue);
+        return NULL;
+    }
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t handle, const void *item, TickType_t ticks_to_wait)
+{
+    host_queue_t *queue = handle;
+    if (queue->count == queue->length) {
+        return pdFAIL;
+    }
+    UBaseType_t index = (queue->head + queue->count) % queue->length;
+    memcpy(queue->items + (index * queue->item_size), item, queue->item_size);
+    queue->count++;
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t handle, void *item, TickType_t ticks_to_wait)
+{
+    host_queue_t *queue = handle;
+    if (queue->count == 0) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items + (queue->head * queue->item_size), queue->item_size);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle)
+{
+    return ((host_queue_t *)handle)->count;
+}
+
+void vQueueDelete(QueueHandle_t handle)
+{
+    host_queue_t *queue = handle;
+    free(queue->items);
+    free(queue);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return &s_dummy_handle;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait)
+{
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+}
+
+bool esp_sntp_enabled(void)
+{
+    return true;
+}
+
+void esp_sntp_setoperatingmode(int operating_mode)
+{
+}
+
+void esp_sntp_setservername(int idx, const char *server)
+{
+}
+
+void esp_sntp_init(void)
+{
+}
+
+esp_err_t esp_schedule_nvs_add(esp_schedule_t *schedule)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_schedule_nvs_remove(esp_schedule_t *schedule)
+{
+    return ESP_OK;
+}
+
+esp_schedule_handle_t *esp_schedule_nvs_get_all(uint8_t *schedule_count)
+{
+    *schedule_count = 0;
+    return NULL;
+}
+
+bool esp_schedule_nvs_is_enabled(void)
+{
+    return false;
+}
+
+esp_err_t esp_schedule_nvs_init(char *nvs_partition)
+{
+    return ESP_OK;
+}
+
+int fls(int mask)
+{
+    int bit = 0;
+    unsigned int value = (unsigned int)mask;
+    while (value) {
+        bit++;
+        value >>= 1;
+    }
+    return bit;
+}
+
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size) {
+        size_t copy_len = (len < size - 1) ? len : size - 1;
+        memcpy(dst, src, copy_len);
+        dst[copy_len] = '\0';
+    }
+    return len;
+}
@@ -0,0 +1,266 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host property test for the next trigger time of the days of week and date based schedules.
+ * Random triggers are checked against the reference implementation, across timezones with and without DST.
+ * The two can only differ close to DST transitions, where the reference applied the DST correction from the
+ * wrong side, and there the new time is checked to be a valid trigger time. Days of week triggers are also checked against a brute
+ * force search for the next matching day.
+ *
+ * Usage: test_next_trigger [iterations per timezone]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* time() is redirected to a clock controlled by the test, for both the implementations */
+static time_t s_now;
+
+static time_t esp_schedule_host_time(time_t *t)
+{
+    if (t) {
+        *t = s_now;
+    }
+    return s_now;
+}
+#define time(t) esp_schedule_host_time(t)
+
+#include "../../src/esp_schedule.c"
+#include "reference_next_trigger.c"
+
+#undef time
+
+#define DEFAULT_ITERATIONS  200000
+/* 2021-01-01 00:00:00 UTC, and the range of the random current times after that */
+#define START_TIME          1609459200
+#define TIME_RANGE_SECS     (10LL * 365 * SECONDS_IN_DAY)
+
+static const char *zones[] = {
+    "UTC0",
+    "CET-1CEST,M3.5.0,M10.5.0/3",
+    "EST5EDT,M3.2.0,M11.1.0",
+    "IST-5:30",
+    "AEST-10AEDT,M10.1.0,M4.1.0/3",
+};
+
+static void set_tz(const char *tz)
+{
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+static uint32_t random_u32(void)
+{
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static void random_trigger(esp_schedule_trigger_t *trigger)
+{
+    memset(trigger, 0, sizeof(*trigger));
+    trigger->hours = rand() % 24;
+    trigger->minutes = rand() % 60;
+    if (rand() % 2) {
+        trigger->type = ESP_SCHEDULE_TYPE_DAYS_OF_WEEK;
+        trigger->day.repeat_days = rand() % 128;
+    } else {
+        struct tm current_time;
+        localtime_r(&s_now, &current_time);
+        trigger->type = ESP_SCHEDULE_TYPE_DATE;
+        trigger->date.day = 1 + rand() % 28;
+        trigger->date.repeat_months = rand() % 4096;
+        trigger->date.year = 1900 + current_time.tm_year + rand() % 2;
+        trigger->date.repeat_every_year = rand() % 2;
+    }
+}
+
+/* Next time after now at which a days of week trigger should fire. A wall clock time skipped when DST starts
+ * is either moved ahead by mktime(), or the day is skipped, and both are accepted. A wall clock time repeated
+ * when DST ends fires only once, so that day is over once its first occurrence has passed.
+ */
+static time_t brute_force_days_of_week(const esp_schedule_trigger_t *trigger, bool skip_nonexistent)
+{
+    struct tm current_time;
+    localtime_r(&s_now, &current_time);
+    for (int days = 0; days <= 8; days++) {
+        struct tm schedule_time = current_time;
+        schedule_time.tm_mday += days;
+        schedule_time.tm_hour = trigger->hours;
+        schedule_time.tm_min = trigger->minutes;
+        schedule_time.tm_sec = 0;
+        schedule_time.tm_isdst = -1;
+        time_t target = mktime(&schedule_time);
+        /* Monday is 0 in repeat_days, but Sunday is 0 in tm_wday */
+        int day = (schedule_time.tm_wday + 6) % 7;
+        bool nonexistent = (schedule_time.tm_hour != trigger->hours || schedule_time.tm_min != trigger->minutes);
+        if (skip_nonexistent && nonexistent) {
+            continue;
+        }
+        time_t first = target;
+        time_t earlier = target - 3600;
+        struct tm earlier_tm;
+        localtime_r(&earlier, &earlier_tm);
+        if (earlier_tm.tm_mday == schedule_time.tm_mday && earlier_tm.tm_hour == schedule_time.tm_hour &&
+                earlier_tm.tm_min == schedule_time.tm_min) {
+            first = earlier;
+        }
+        if (first > s_now && (trigger->day.repeat_days == 0 || (trigger->day.repeat_days & (1 << day)))) {
+            return target;
+        }
+    }
+    return 0;
+}
+
+/* Whether the DST state changes within the given number of seconds of the time */
+static bool near_dst_transition(time_t t, time_t window)
+{
+    time_t before = t - window, after = t + window;
+    struct tm before_tm, after_tm;
+    localtime_r(&before, &before_tm);
+    localtime_r(&after, &after_tm);
+    return before_tm.tm_isdst != after_tm.tm_isdst;
+}
+
+/* A wall clock time that is skipped or repeated at a DST transition can map to either of two instants an hour
+ * apart, and both are correct.
+ */
+static bool is_dst_ambiguous(time_t target, time_t expected)
+{
+    return near_dst_transition(expected, 3600) && llabs((long long)(target - expected)) == 3600;
+}
+
+/* Whether the trigger is due at the given time, as per its fields. The wall clock time is not checked around
+ * DST transitions, where it may not exist, or may occur twice. A date trigger whose months are over for its
+ * year falls back to a later month, so the month is accepted if it matches the one in also_month.
+ */
+static bool is_trigger_time(const esp_schedule_trigger_t *trigger, time_t target, time_t also_month)
+{
+    struct tm target_tm;
+    localtime_r(&target, &target_tm);
+    if (!near_dst_transition(target, 3600) &&
+            (target_tm.tm_hour != trigger->hours || target_tm.tm_min != trigger->minutes)) {
+        return false;
+    }
+    if (trigger->type == ESP_SCHEDULE_TYPE_DAYS_OF_WEEK) {
+        int day = (target_tm.tm_wday + 6) % 7;
+        return trigger->day.repeat_days == 0 || (trigger->day.repeat_days & (1 << day));
+    }
+    struct tm also_month_tm;
+    localtime_r(&also_month, &also_month_tm);
+    return target_tm.tm_mday == trigger->date.day &&
+            (trigger->date.repeat_months == 0 || (trigger->date.repeat_months & (1 << target_tm.tm_mon)) ||
+            (target_tm.tm_year == also_month_tm.tm_year && target_tm.tm_mon == also_month_tm.tm_mon));
+}
+
+/* The reference applied the DST correction as per the current time, so it can be off when the current time
+ * or the trigger time is close to a DST transition. A difference is accepted only in that case, and only if
+ * the new time is a valid trigger time, and the reference did not find an earlier one in the future.
+ * Differences at skipped or repeated wall clock times are accepted as well.
+ */
+static bool is_reference_error(const esp_schedule_trigger_t *trigger, time_t target, time_t ref_target)
+{
+    if (is_dst_ambiguous(target, ref_target)) {
+        return true;
+    }
+    if (!near_dst_transition(s_now, SECONDS_IN_DAY) && !near_dst_transition(target, 3600)) {
+        return false;
+    }
+    if (!is_trigger_time(trigger, target, ref_target)) {
+        return false;
+    }
+    return !is_trigger_time(trigger, ref_target, target) || ref_target <= s_now || ref_target > target;
+}
+
+static void print_failure(const char *what, const char *tz, const esp_schedule_trigger_t *trigger,
+        long long expected, long long actual)
+{
+    printf("FAIL %s: TZ %s, now %lld, type %d, %02d:%02d, repeat_days 0x%02x, day %d, repeat_months 0x%03x,"
+            " year %d, every year %d: expected %lld, got %lld\n", what, tz, (long long)s_now, trigger->type,
+            trigger->hours, trigger->minutes, trigger->day.repeat_days, trigger->date.day,
+            trigger->date.repeat_months, trigger->date.year, trigger->date.repeat_every_year, expected, actual);
+}
+
+static int test_random_triggers(long iterations)
+{
+    int failures = 0;
+    long total = 0, dst_differences = 0;
+    srand(1234);
+    for (size_t z = 0; z < sizeof(zones) / sizeof(zones[0]); z++) {
+        set_tz(zones[z]);
+        for (long i = 0; i < iterations; i++) {
+            s_now = START_TIME + (time_t)(random_u32() % TIME_RANGE_SECS);
+            esp_schedule_trigger_t trigger, ref_trigger;
+            random_trigger(&trigger);
+            ref_trigger = trigger;
+            uint32_t time_diff = esp_schedule_get_next_schedule_time_diff("test", &trigger);
+            uint32_t ref_time_diff = ref_get_next_schedule_time_diff("test", &ref_trigger);
+            total++;
+            if (trigger.type == ESP_SCHEDULE_TYPE_DAYS_OF_WEEK) {
+                time_t expected = brute_force_days_of_week(&trigger, false);
+                time_t target = (time_t)trigger.next_scheduled_time_utc;
+                if (expected != target && !is_dst_ambiguous(target, expected) &&
+                        brute_force_days_of_week(&trigger, true) != target) {
+                    print_failure("brute force", zones[z], &trigger, expected, trigger.next_scheduled_time_utc);
+                    failures++;
+                }
+            }
+            if (time_diff != ref_time_diff || trigger.next_scheduled_time_utc != ref_trigger.next_scheduled_time_utc) {
+                if (is_reference_error(&trigger, (time_t)trigger.next_scheduled_time_utc,
+                            (time_t)ref_trigger.next_scheduled_time_utc)) {
+                    dst_differences++;
+                } else {
+                    print_failure("reference", zones[z], &trigger, ref_trigger.next_scheduled_time_utc,
+                            trigger.next_scheduled_time_utc);
+                    failures++;
+                }
+            }
+        }
+    }
+    printf("Random triggers: %ld checked, %ld reference errors near DST transitions, %d failures\n",
+            total, dst_differences, failures);
+    return failures;
+}
+
+/* The local time for the current second is cached. Changing the timezone within that second must
+ * still give the trigger time as per the new timezone.
+ */
+static int test_tz_change(void)
+{
+    int failures = 0;
+    esp_schedule_trigger_t trigger = {
+        .type = ESP_SCHEDULE_TYPE_DAYS_OF_WEEK,
+        .hours = 7,
+        .minutes = 30,
+        .day.repeat_days = 0x15,
+    };
+    s_now = 1700000000;
+    for (size_t z = 0; z < sizeof(zones) / sizeof(zones[0]); z++) {
+        esp_schedule_trigger_t first = trigger, second = trigger, ref_trigger = trigger;
+        set_tz(zones[z]);
+        esp_schedule_get_next_schedule_time_diff("test", &first);
+        set_tz(zones[(z + 1) % (sizeof(zones) / sizeof(zones[0]))]);
+        esp_schedule_get_next_schedule_time_diff("test", &second);
+        ref_get_next_schedule_time_diff("test", &ref_trigger);
+        if (second.next_scheduled_time_utc != ref_trigger.next_scheduled_time_utc) {
+            print_failure("timezone change", getenv("TZ"), &trigger, ref_trigger.next_scheduled_time_utc,
+                    second.next_scheduled_time_utc);
+            failures++;
+        }
+    }
+    printf("Timezone change: %d failures\n", failures);
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = DEFAULT_ITERATIONS;
+    if (argc > 1) {
+        iterations = strtol(argv[1], NULL, 0);
+    }
+    int failures = test_random_triggers(iterations);
+    failures += test_tz_change();
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+/*
+ * SPDX-FileCopyrightText: 2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Host test for rearming the common schedule timer. If the timer command queue is full when the timer
+ * task tries to rearm the timer after dispatching the due schedules, the next schedule must still fire.
+ *
+ * Usage: test_timer_rearm
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../src/esp_schedule.c"
+#include "host_shims.h"
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __func__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static int s_trigger_count[2];
+
+static void trigger_cb(esp_schedule_handle_t handle, void *priv_data)
+{
+    s_trigger_count[(intptr_t)priv_data]++;
+}
+
+static esp_schedule_t *create_schedule(const char *name, intptr_t index)
+{
+    esp_schedule_t *schedule = calloc(1, sizeof(esp_schedule_t));
+    if (!schedule) {
+        return NULL;
+    }
+    strlcpy(schedule->name, name, sizeof(schedule->name));
+    schedule->trigger.type = ESP_SCHEDULE_TYPE_DAYS_OF_WEEK;
+    schedule->trigger.day.repeat_days = 0x7f;
+    schedule->trigger_cb = trigger_cb;
+    schedule->priv_data = (void *)index;
+    schedule->heap_index = -1;
+    return schedule;
+}
+
+static int test_rearm_with_queue_full(void)
+{
+    int failures = 0;
+    esp_schedule_t *first = create_schedule("first", 0);
+    esp_schedule_t *second = create_schedule("second", 1);
+    if (!first || !second || (esp_schedule_timer_init() != ESP_OK)) {
+        printf("FAIL: Could not set up the schedules\n");
+        return 1;
+    }
+    int64_t now = esp_timer_get_time();
+    int64_t second_deadline_us = now + (60 * 1000000LL);
+    xSemaphoreTake(schedule_lock, portMAX_DELAY);
+    esp_schedule_heap_add(first, now + 1000000);
+    esp_schedule_heap_add(second, second_deadline_us);
+    esp_schedule_timer_rearm_and_unlock();
+    CHECK(host_timer_is_active());
+
+    /* The first schedule fires, but the timer cannot be rearmed for the second one */
+    host_time_advance_us(2 * 1000000);
+    host_timer_queue_full = true;
+    host_timer_fire();
+    CHECK(s_trigger_count[0] == 1);
+    CHECK(!host_timer_is_active());
+
+    /* Once the queue has space, the retry from the work queue rearms it */
+    host_timer_queue_full = false;
+    CHECK(host_work_queue_run() == 1);
+    CHECK(host_timer_is_active());
+    CHECK(schedule_armed_deadline_us == second_deadline_us);
+
+    host_time_advance_us(60 * 1000000LL);
+    host_timer_fire();
+    CHECK(s_trigger_count[1] == 1);
+    /* Both the schedules repeat daily, so the timer stays armed */
+    CHECK(host_timer_is_active());
+    printf("Rearm with timer command queue full: %d failures\n", failures);
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    setenv("TZ", "UTC0", 1);
+    tzset();
+    int failures = test_rearm_with_queue_full();
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,511 @@
+/* Benchmark Example: Linux host build
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+/* Runs the parts of the benchmark which do not need the rest of the RainMaker core, on a Linux host: JSON
+ * parsing and generation of params payloads, the esp_schedule operations, the time series aggregation and
+ * the MQTT payload compression. The results are printed in the same BENCH_RESULT format as the firmware.
+ *
+ * Usage: bench_host [replay trace file]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <esp_err.h>
+#include <esp_timer.h>
+#include <json_parser.h>
+#include <json_generator.h>
+#include <esp_schedule.h>
+#include <esp_rmaker_ts_aggregate.h>
+#include <esp_rmaker_mqtt.h>
+#include <esp_rmaker_mqtt_compress.h>
+
+/* Same defaults as the Kconfig options of the firmware. These can be changed with BENCH_DEFS in the Makefile. */
+#ifndef CONFIG_BENCH_NUM_DEVICES
+#define CONFIG_BENCH_NUM_DEVICES        4
+#endif
+#ifndef CONFIG_BENCH_PARAMS_PER_DEVICE
+#define CONFIG_BENCH_PARAMS_PER_DEVICE  4
+#endif
+#ifndef CONFIG_BENCH_ITERATIONS
+#define CONFIG_BENCH_ITERATIONS         200
+#endif
+#ifndef CONFIG_BENCH_SCHEDULE_COUNT
+#define CONFIG_BENCH_SCHEDULE_COUNT     200
+#endif
+/* Time series aggregation: sampling rate, aggregation window and the duration of the sampled data */
+#ifndef CONFIG_BENCH_TS_SAMPLE_RATE_HZ
+#define CONFIG_BENCH_TS_SAMPLE_RATE_HZ  1000
+#endif
+#ifndef CONFIG_BENCH_TS_WINDOW_SECS
+#define CONFIG_BENCH_TS_WINDOW_SECS     60
+#endif
+#ifndef CONFIG_BENCH_TS_DURATION_SECS
+#define CONFIG_BENCH_TS_DURATION_SECS   3600
+#endif
+
+#define BENCH_DEVICE_NAME_FMT   "Dev%d"
+#define BENCH_PARAM_NAME_FMT    "P%d"
+#define BENCH_PAYLOAD_SIZE      16384
+#define BENCH_RESULT_SIZE       512
+#define BENCH_LINE_SIZE         1024
+#define BENCH_DEFAULT_TRACE     "../main/replay_trace.txt"
+#define BENCH_TOPIC_SIZE        128
+
+static uint32_t samples[CONFIG_BENCH_ITERATIONS];
+
+static int bench_cmp_samples(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_report(const char *scenario, int count, int failed, int64_t elapsed_us, size_t bytes)
+{
+    if (count == 0) {
+        printf("No messages processed for %s.\n", scenario);
+        return;
+    }
+    qsort(samples, count, sizeof(uint32_t), bench_cmp_samples);
+    uint64_t total_us = 0;
+    for (int i = 0; i < count; i++) {
+        total_us += samples[i];
+    }
+    char buf[BENCH_RESULT_SIZE];
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, buf, sizeof(buf), NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_string(&jstr, "scenario", (char *)scenario);
+    json_gen_obj_set_int(&jstr, "msgs", count);
+    json_gen_obj_set_int(&jstr, "failed", failed);
+    json_gen_obj_set_float(&jstr, "msgs_per_sec", elapsed_us ? (float)count * 1000000 / elapsed_us : 0);
+    json_gen_obj_set_int(&jstr, "avg_us", (int)(total_us / count));
+    json_gen_obj_set_int(&jstr, "p50_us", samples[count / 2]);
+    json_gen_obj_set_int(&jstr, "p99_us", samples[(count * 99) / 100]);
+    json_gen_obj_set_int(&jstr, "max_us", samples[count - 1]);
+    json_gen_obj_set_int(&jstr, "bytes_per_msg", (int)(bytes / count));
+    json_gen_end_object(&jstr);
+    json_gen_str_end(&jstr);
+    printf("BENCH_RESULT %s\n", buf);
+}
+
+/* Generates a params report, with all the params of all the devices, as the node does for the full report */
+static int bench_gen_report(int i, char *buf, size_t buf_size)
+{
+    json_gen_str_t jstr;
+    char name[16];
+    json_gen_str_start(&jstr, buf, buf_size, NULL, NULL);
+    json_gen_start_object(&jstr);
+    for (int d = 0; d < CONFIG_BENCH_NUM_DEVICES; d++) {
+        snprintf(name, sizeof(name), BENCH_DEVICE_NAME_FMT, d);
+        json_gen_push_object(&jstr, name);
+        for (int p = 0; p < CONFIG_BENCH_PARAMS_PER_DEVICE; p++) {
+            snprintf(name, sizeof(name), BENCH_PARAM_NAME_FMT, p);
+            json_gen_obj_set_int(&jstr, name, (i + p) % 1000);
+        }
+        json_gen_pop_object(&jstr);
+    }
+    json_gen_end_object(&jstr);
+    /* The length includes the NULL termination, and is more than the buffer size if it did not fit */
+    int len = json_gen_str_end(&jstr);
+    return (len <= buf_size) ? len - 1 : -1;
+}
+
+/* Looks up every param of every device in the payload, as the node does when handling set params */
+static int bench_parse_params(const char *payload, int len)
+{
+    jparse_ctx_t jctx;
+    char name[16];
+    int found = 0;
+    if (json_parse_start(&jctx, payload, len) != OS_SUCCESS) {
+        return -1;
+    }
+    for (int d = 0; d < CONFIG_BENCH_NUM_DEVICES; d++) {
+        snprintf(name, sizeof(name), BENCH_DEVICE_NAME_FMT, d);
+        if (json_obj_get_object(&jctx, name) != OS_SUCCESS) {
+            continue;
+        }
+        for (int p = 0; p < CONFIG_BENCH_PARAMS_PER_DEVICE; p++) {
+            int val;
+            snprintf(name, sizeof(name), BENCH_PARAM_NAME_FMT, p);
+            if (json_obj_get_int(&jctx, name, &val) == OS_SUCCESS) {
+                found++;
+            }
+        }
+        json_obj_leave_object(&jctx);
+    }
+    json_parse_end(&jctx);
+    return found;
+}
+
+static void bench_json_report(void)
+{
+    char *payload = calloc(1, BENCH_PAYLOAD_SIZE);
+    if (!payload) {
+        printf("Failed to allocate payload buffer for json_report.\n");
+        return;
+    }
+    int failed = 0;
+    size_t bytes = 0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < CONFIG_BENCH_ITERATIONS; i++) {
+        int64_t t = esp_timer_get_time();
+        int len = bench_gen_report(i, payload, BENCH_PAYLOAD_SIZE);
+        samples[i] = (uint32_t)(esp_timer_get_time() - t);
+        if (len < 0) {
+            failed++;
+        } else {
+            bytes += len;
+        }
+    }
+    bench_report("json_report", CONFIG_BENCH_ITERATIONS, failed, esp_timer_get_time() - start, bytes);
+    free(payload);
+}
+
+static void bench_json_parse(void)
+{
+    char *payload = calloc(1, BENCH_PAYLOAD_SIZE);
+    if (!payload) {
+        printf("Failed to allocate payload buffer for json_parse.\n");
+        return;
+    }
+    int failed = 0;
+    size_t bytes = 0;
+    int64_t elapsed = 0;
+    for (int i = 0; i < CONFIG_BENCH_ITERATIONS; i++) {
+        /* A full set params request, with all the params of all the devices */
+        int len = bench_gen_report(i, payload, BENCH_PAYLOAD_SIZE);
+        if (len < 0) {
+            failed++;
+            samples[i] = 0;
+            continue;
+        }
+        int64_t t = esp_timer_get_time();
+        int found = bench_parse_params(payload, len);
+        samples[i] = (uint32_t)(esp_timer_get_time() - t);
+        elapsed += samples[i];
+        bytes += len;
+        if (found != CONFIG_BENCH_NUM_DEVICES * CONFIG_BENCH_PARAMS_PER_DEVICE) {
+            failed++;
+        }
+    }
+    bench_report("json_parse", CONFIG_BENCH_ITERATIONS, failed, elapsed, bytes);
+    free(payload);
+}
+
+/* Parses the payloads of the trace, which has "<topic suffix> <payload>" on each line */
+static void bench_replay_trace(const char *path)
+{
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        printf("Failed to open %s. Skipping replay.\n", path);
+        return;
+    }
+    char line[BENCH_LINE_SIZE];
+    int done = 0, failed = 0;
+    size_t bytes = 0;
+    int64_t elapsed = 0;
+    while (done < CONFIG_BENCH_ITERATIONS && fgets(line, sizeof(line), fp)) {
+        char *sep = strchr(line, ' ');
+        if (line[0] == '#' || !sep) {
+            continue;
+        }
+        char *payload = sep + 1;
+        int len = strcspn(payload, "\r\n");
+        int64_t t = esp_timer_get_time();
+        int found = bench_parse_params(payload, len);
+        samples[done] = (uint32_t)(esp_timer_get_time() - t);
+        elapsed += samples[done++];
+        bytes += len;
+        if (found < 0) {
+            failed++;
+        }
+    }
+    fclose(fp);
+    bench_report("replay_parse", done, failed, elapsed, bytes);
+}
+
+typedef enum {
+    BENCH_SCHEDULE_OP_CREATE = 0,
+    BENCH_SCHEDULE_OP_ENABLE,
+    /* Enabling already enabled schedules again, as happens when the time gets synchronised */
+    BENCH_SCHEDULE_OP_REARM,
+    BENCH_SCHEDULE_OP_DISABLE,
+    BENCH_SCHEDULE_OP_DELETE,
+    BENCH_SCHEDULE_OP_MAX,
+} bench_schedule_op_t;
+
+static const char *bench_schedule_op_names[BENCH_SCHEDULE_OP_MAX] = {
+    "create", "enable", "rearm", "disable", "delete"
+};
+
+static void bench_schedule_trigger_cb(esp_schedule_handle_t handle, void *priv_data)
+{
+}
+
+/* Same as the schedule_timers scenario of the firmware, except for the heap usage, which is not tracked here */
+static void bench_schedule_timers(void)
+{
+    esp_schedule_handle_t *handles = calloc(CONFIG_BENCH_SCHEDULE_COUNT, sizeof(esp_schedule_handle_t));
+    if (!handles) {
+        printf("Failed to allocate memory for %d schedules.\n", CONFIG_BENCH_SCHEDULE_COUNT);
+        return;
+    }
+    uint64_t total_us[BENCH_SCHEDULE_OP_MAX] = {0};
+    uint32_t max_us[BENCH_SCHEDULE_OP_MAX] = {0};
+    int created = 0;
+    for (int op = 0; op < BENCH_SCHEDULE_OP_MAX; op++) {
+        for (int i = 0; i < CONFIG_BENCH_SCHEDULE_COUNT; i++) {
+            int64_t t = esp_timer_get_time();
+            switch (op) {
+                case BENCH_SCHEDULE_OP_CREATE: {
+                    esp_schedule_config_t config = {
+                        .trigger.type = ESP_SCHEDULE_TYPE_DAYS_OF_WEEK,
+                        /* Spread across the day, so that the schedules do not all land on the same deadline */
+                        .trigger.hours = (i / 60) % 24,
+                        .trigger.minutes = i % 60,
+                        .trigger.day.repeat_days = ESP_SCHEDULE_DAY_EVERYDAY,
+                        .trigger_cb = bench_schedule_trigger_cb,
+                    };
+                    snprintf(config.name, sizeof(config.name), "bst%04d", i);
+                    handles[i] = esp_schedule_create(&config);
+                    if (handles[i]) {
+                        created++;
+                    }
+                    break;
+                }
+                case BENCH_SCHEDULE_OP_ENABLE:
+                case BENCH_SCHEDULE_OP_REARM:
+                    if (handles[i]) {
+                        esp_schedule_enable(handles[i]);
+                    }
+                    break;
+                case BENCH_SCHEDULE_OP_DISABLE:
+                    if (handles[i]) {
+                        esp_schedule_disable(handles[i]);
+                    }
+                    break;
+                case BENCH_SCHEDULE_OP_DELETE:
+                    if (handles[i]) {
+                        esp_schedule_delete(handles[i]);
+                        handles[i] = NULL;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            uint32_t elapsed = (uint32_t)(esp_timer_get_time() - t);
+            total_us[op] += elapsed;
+            if (elapsed > max_us[op]) {
+                max_us[op] = elapsed;
+            }
+        }
+    }
+    free(handles);
+    if (created == 0) {
+        printf("Failed to create any schedule for schedule_timers.\n");
+        return;
+    }
+    char buf[BENCH_RESULT_SIZE];
+    char key[24];
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, buf, sizeof(buf), NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_string(&jstr, "scenario", "schedule_timers");
+    json_gen_obj_set_int(&jstr, "schedules", created);
+    for (int op = 0; op < BENCH_SCHEDULE_OP_MAX; op++) {
+        snprintf(key, sizeof(key), "%s_avg_us", bench_schedule_op_names[op]);
+        json_gen_obj_set_int(&jstr, key, (int)(total_us[op] / CONFIG_BENCH_SCHEDULE_COUNT));
+        snprintf(key, sizeof(key), "%s_max_us", bench_schedule_op_names[op]);
+        json_gen_obj_set_int(&jstr, key, max_us[op]);
+    }
+    json_gen_end_object(&jstr);
+    json_gen_str_end(&jstr);
+    printf("BENCH_RESULT %s\n", buf);
+}
+
+/* Generates a node config, with the same structure as the one the node reports for the benchmark devices */
+static int bench_gen_config(char *buf, size_t buf_size)
+{
+    json_gen_str_t jstr;
+    char name[16];
+    json_gen_str_start(&jstr, buf, buf_size, NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_string(&jstr, "node_id", "0123456789ABCDEF0123");
+    json_gen_obj_set_string(&jstr, "config_version", "2020-03-20");
+    json_gen_push_object(&jstr, "info");
+    json_gen_obj_set_string(&jstr, "name", "ESP RainMaker Benchmark");
+    json_gen_obj_set_string(&jstr, "fw_version", "1.0");
+    json_gen_obj_set_string(&jstr, "type", "Benchmark");
+    json_gen_pop_object(&jstr);
+    json_gen_push_array(&jstr, "devices");
+    for (int d = 0; d < CONFIG_BENCH_NUM_DEVICES; d++) {
+        json_gen_start_object(&jstr);
+        snprintf(name, sizeof(name), BENCH_DEVICE_NAME_FMT, d);
+        json_gen_obj_set_string(&jstr, "name", name);
+        json_gen_obj_set_string(&jstr, "type", "esp.device.other");
+        json_gen_push_array(&jstr, "params");
+        for (int p = 0; p < CONFIG_BENCH_PARAMS_PER_DEVICE; p++) {
+            json_gen_start_object(&jstr);
+            snprintf(name, sizeof(name), BENCH_PARAM_NAME_FMT, p);
+            json_gen_obj_set_string(&jstr, "name", name);
+            json_gen_obj_set_string(&jstr, "data_type", "int");
+            json_gen_push_array(&jstr, "properties");
+            json_gen_arr_set_string(&jstr, "read");
+            json_gen_arr_set_string(&jstr, "write");
+            json_gen_pop_array(&jstr);
+            json_gen_obj_set_string(&jstr, "ui_type", "esp.ui.slider");
+            json_gen_push_object(&jstr, "bounds");
+            json_gen_obj_set_int(&jstr, "min", 0);
+            json_gen_obj_set_int(&jstr, "max", 1000);
+            json_gen_pop_object(&jstr);
+            json_gen_end_object(&jstr);
+        }
+        json_gen_pop_array(&jstr);
+        json_gen_end_object(&jstr);
+    }
+    json_gen_pop_array(&jstr);
+    json_gen_end_object(&jstr);
+    int len = json_gen_str_end(&jstr);
+    return (len <= buf_size) ? len - 1 : -1;
+}
+
+/* Same as the compression scenario of the firmware, with the node config and the full params report
+ * generated as above, and compressed the way the node does before publishing them.
+ */
+static void bench_compression(void)
+{
+    char *payload = calloc(1, BENCH_PAYLOAD_SIZE);
+    if (!payload) {
+        printf("Failed to allocate payload buffer for compression.\n");
+        return;
+    }
+    char topic[BENCH_TOPIC_SIZE];
+    esp_rmaker_mqtt_compress_stats_t before, after;
+    esp_rmaker_mqtt_compress_get_stats(&before);
+    for (int i = 0; i < CONFIG_BENCH_ITERATIONS; i++) {
+        /* Alternately, like the node reports them on a (re)connection */
+        int len = bench_gen_config(payload, BENCH_PAYLOAD_SIZE);
+        esp_rmaker_mqtt_msg_class_t msg_class = ESP_RMAKER_MQTT_MSG_CLASS_CONFIG;
+        const char *orig_topic = "node/0123456789ABCDEF0123/config";
+        if (i % 2) {
+            len = bench_gen_report(i, payload, BENCH_PAYLOAD_SIZE);
+            msg_class = ESP_RMAKER_MQTT_MSG_CLASS_PARAM_REPORT;
+            orig_topic = "node/0123456789ABCDEF0123/params/local/init";
+        }
+        void *out = NULL;
+        size_t out_len = 0;
+        if ((len > 0) && (esp_rmaker_mqtt_compress_payload(msg_class, orig_topic, payload, len, topic,
+                sizeof(topic), &out, &out_len) == ESP_OK)) {
+            free(out);
+        }
+    }
+    free(payload);
+    esp_rmaker_mqtt_compress_get_stats(&after);
+    uint32_t compressed = after.compressed - before.compressed;
+    uint32_t msgs = compressed + (after.incompressible - before.incompressible);
+    if (msgs == 0) {
+        printf("No messages large enough for compression. Check CONFIG_ESP_RMAKER_MQTT_COMPRESSION_MIN_SIZE.\n");
+        return;
+    }
+    uint64_t bytes_in = after.bytes_in - before.bytes_in;
+    uint64_t bytes_out = after.bytes_out - before.bytes_out;
+    char buf[BENCH_RESULT_SIZE];
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, buf, sizeof(buf), NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_string(&jstr, "scenario", "compression");
+    json_gen_obj_set_int(&jstr, "msgs", msgs);
+    json_gen_obj_set_int(&jstr, "compressed", compressed);
+    json_gen_obj_set_int(&jstr, "window_bits", CONFIG_ESP_RMAKER_MQTT_COMPRESSION_WINDOW_BITS);
+    json_gen_obj_set_int(&jstr, "lookahead_bits", CONFIG_ESP_RMAKER_MQTT_COMPRESSION_LOOKAHEAD_BITS);
+    json_gen_obj_set_int(&jstr, "bytes_in_per_msg", (int)(bytes_in / msgs));
+    json_gen_obj_set_int(&jstr, "bytes_out_per_msg", (int)(bytes_out / msgs));
+    json_gen_obj_set_float(&jstr, "ratio", bytes_in ? (float)bytes_out / bytes_in : 1);
+    json_gen_obj_set_int(&jstr, "avg_us", (int)((after.time_us - before.time_us) / msgs));
+    json_gen_end_object(&jstr);
+    json_gen_str_end(&jstr);
+    printf("BENCH_RESULT %s\n", buf);
+}
+
+/* Samples at CONFIG_BENCH_TS_SAMPLE_RATE_HZ, as per a simulated clock, and aggregates them the way
+ * esp_rmaker_param_set_simple_ts_aggregation() does. The last window is flushed once it elapses with no
+ * more samples, like the flush timer does on the node. "failed" counts the windows whose sample count or
+ * summary is not as expected.
+ */
+static void bench_ts_aggregate(void)
+{
+    const uint32_t window_secs = CONFIG_BENCH_TS_WINDOW_SECS;
+    const int64_t sample_count = (int64_t)CONFIG_BENCH_TS_SAMPLE_RATE_HZ * CONFIG_BENCH_TS_DURATION_SECS;
+    const uint32_t samples_per_window = CONFIG_BENCH_TS_SAMPLE_RATE_HZ * window_secs;
+    esp_rmaker_ts_window_t window = {0}, done;
+    const time_t start = 1700000000;
+    int64_t aggregated = 0;
+    int windows = 0, failed = 0;
+    /* A sawtooth between 0 and 99, so that the min, max and mean of each full window are known */
+    int64_t t = esp_timer_get_time();
+    for (int64_t i = 0; i < sample_count; i++) {
+        time_t now = start + (time_t)(i / CONFIG_BENCH_TS_SAMPLE_RATE_HZ);
+        if (esp_rmaker_ts_window_add(&window, window_secs, (float)(i % 100), now, &done)) {
+            windows++;
+            aggregated += done.count;
+            if ((done.count != samples_per_window) || (done.min != 0) || (done.max != 99)) {
+                failed++;
+            }
+        }
+    }
+    int64_t elapsed_us = esp_timer_get_time() - t;
+    time_t end = start + CONFIG_BENCH_TS_DURATION_SECS;
+    if (esp_rmaker_ts_window_take(&window, window_secs, end - 1, false, &done)) {
+        /* Not yet elapsed at the time of the last sample */
+        failed++;
+    }
+    if (esp_rmaker_ts_window_take(&window, window_secs, end + window_secs, false, &done)) {
+        windows++;
+        aggregated += done.count;
+    }
+    if (aggregated != sample_count) {
+        failed++;
+    }
+    char buf[BENCH_RESULT_SIZE];
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, buf, sizeof(buf), NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_string(&jstr, "scenario", "ts_aggregate");
+    json_gen_obj_set_int(&jstr, "sample_rate_hz", CONFIG_BENCH_TS_SAMPLE_RATE_HZ);
+    json_gen_obj_set_int(&jstr, "window_secs", window_secs);
+    json_gen_obj_set_int(&jstr, "samples", (int)sample_count);
+    json_gen_obj_set_int(&jstr, "windows", windows);
+    json_gen_obj_set_int(&jstr, "failed", failed);
+    json_gen_obj_set_float(&jstr, "avg_ns_per_sample", sample_count ? (float)elapsed_us * 1000 / sample_count : 0);
+    json_gen_obj_set_float(&jstr, "max_sample_rate_khz", elapsed_us ? (float)sample_count / elapsed_us * 1000 : 0);
+    json_gen_end_object(&jstr);
+    json_gen_str_end(&jstr);
+    printf("BENCH_RESULT %s\n", buf);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace = (argc > 1) ? argv[1] : BENCH_DEFAULT_TRACE;
+    /* The schedules need a valid time and timezone, as on the node */
+    if (!getenv("TZ")) {
+        setenv("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+    }
+    tzset();
+
+    bench_json_parse();
+    bench_json_report();
+    bench_replay_trace(trace);
+    bench_schedule_timers();
+    bench_ts_aggregate();
+    bench_compression();
+    printf("BENCH_DONE\n");
+    return 0;
+}
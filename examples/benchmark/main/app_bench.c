@@ -0,0 +1,482 @@
+/* Benchmark Example: Traffic generator
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+#include <json_generator.h>
+#include <esp_schedule.h>
+
+#include <esp_rmaker_core.h>
+#include <esp_rmaker_mqtt.h>
+#include <esp_rmaker_utils.h>
+
+#include "app_priv.h"
+
+static const char *TAG = "app_bench";
+
+#define BENCH_TASK_STACK        (6 * 1024)
+#define BENCH_TASK_PRIORITY     (tskIDLE_PRIORITY + 1)
+#define BENCH_PAYLOAD_SIZE      1024
+#define BENCH_TOPIC_SIZE        100
+#define BENCH_RESULT_SIZE       512
+/* Time given to the asynchronous work triggered by the messages, before taking the readings */
+#define BENCH_SETTLE_TIME_MS    500
+/* Number of times the node config and params are reported for the compression scenario */
+#define BENCH_COMPRESS_ROUNDS   10
+
+/* Generates the payload for iteration i of a scenario. Returns the payload length, or -1 on failure. */
+typedef int (*bench_payload_gen_t)(int i, char *buf, size_t buf_size);
+
+typedef struct {
+    uint32_t published_msgs;
+    uint32_t published_bytes;
+} bench_publish_stats_t;
+
+typedef struct {
+    uint64_t alloc_bytes;
+    uint32_t alloc_count;
+    uint32_t free_heap;
+    bench_publish_stats_t published;
+} bench_snapshot_t;
+
+static bench_publish_stats_t publish_stats;
+static uint32_t *samples;
+
+extern const char replay_trace_start[] asm("_binary_replay_trace_txt_start");
+extern const char replay_trace_end[] asm("_binary_replay_trace_txt_end");
+
+static void bench_publish_cb(const char *topic, const void *data, size_t data_len, void *priv_data)
+{
+    publish_stats.published_msgs++;
+    publish_stats.published_bytes += data_len;
+}
+
+static void bench_take_snapshot(bench_snapshot_t *snapshot)
+{
+    memset(snapshot, 0, sizeof(bench_snapshot_t));
+    for (int tag = 0; tag < ESP_RMAKER_MEM_TAG_MAX; tag++) {
+        esp_rmaker_mem_tag_stats_t stats;
+        if (esp_rmaker_mem_tag_get_stats(tag, &stats) == ESP_OK) {
+            snapshot->alloc_bytes += stats.total_bytes;
+            snapshot->alloc_count += stats.alloc_count;
+        }
+    }
+    snapshot->free_heap = esp_get_free_heap_size();
+    snapshot->published = publish_stats;
+}
+
+static int bench_cmp_samples(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void bench_report(const char *scenario, int count, int failed, int64_t elapsed_us,
+        bench_snapshot_t *before, bench_snapshot_t *after)
+{
+    if (count == 0) {
+        ESP_LOGW(TAG, "No messages processed for %s.", scenario);
+        return;
+    }
+    qsort(samples, count, sizeof(uint32_t), bench_cmp_samples);
+    uint64_t total_us = 0;
+    for (int i = 0; i < count; i++) {
+        total_us += samples[i];
+    }
+    char buf[BENCH_RESULT_SIZE];
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, buf, sizeof(buf), NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_string(&jstr, "scenario", (char *)scenario);
+    json_gen_obj_set_int(&jstr, "msgs", count);
+    json_gen_obj_set_int(&jstr, "failed", failed);
+    json_gen_obj_set_float(&jstr, "msgs_per_sec", elapsed_us ? (float)count * 1000000 / elapsed_us : 0);
+    json_gen_obj_set_int(&jstr, "avg_us", (int)(total_us / count));
+    json_gen_obj_set_int(&jstr, "p50_us", samples[count / 2]);
+    json_gen_obj_set_int(&jstr, "p99_us", samples[(count * 99) / 100]);
+    json_gen_obj_set_int(&jstr, "max_us", samples[count - 1]);
+    json_gen_obj_set_float(&jstr, "alloc_bytes_per_msg",
+            (float)(after->alloc_bytes - before->alloc_bytes) / count);
+    json_gen_obj_set_float(&jstr, "allocs_per_msg",
+            (float)(after->alloc_count - before->alloc_count) / count);
+    /* Positive if the heap is still held after the scenario, like for newly added schedules */
+    json_gen_obj_set_int(&jstr, "heap_delta", (int)before->free_heap - (int)after->free_heap);
+    json_gen_obj_set_float(&jstr, "publishes_per_msg",
+            (float)(after->published.published_msgs - before->published.published_msgs) / count);
+    json_gen_obj_set_float(&jstr, "published_bytes_per_msg",
+            (float)(after->published.published_bytes - before->published.published_bytes) / count);
+    esp_rmaker_latency_stats_t latency;
+    if (esp_rmaker_latency_get_stats(ESP_RMAKER_LATENCY_STAGE_TOTAL, &latency) == ESP_OK && latency.count) {
+        /* Time spent in the set params handling itself, as traced by the RainMaker core */
+        json_gen_obj_set_int(&jstr, "core_avg_us", (int)(latency.total_us / latency.count));
+        json_gen_obj_set_int(&jstr, "core_max_us", latency.max_us);
+    }
+    json_gen_end_object(&jstr);
+    json_gen_str_end(&jstr);
+    /* Printed directly, so that it can be picked up by scripts, irrespective of the log level */
+    printf("BENCH_RESULT %s\n", buf);
+}
+
+/* Runs a scenario by injecting count messages on the given topic suffix, as generated by gen */
+static void bench_run_scenario(const char *scenario, const char *topic_suffix, bench_payload_gen_t gen, int count)
+{
+    char topic[BENCH_TOPIC_SIZE];
+    snprintf(topic, sizeof(topic), "node/%s/%s", esp_rmaker_get_node_id(), topic_suffix);
+    char *payload = calloc(1, BENCH_PAYLOAD_SIZE);
+    if (!payload) {
+        ESP_LOGE(TAG, "Failed to allocate payload buffer for %s.", scenario);
+        return;
+    }
+    ESP_LOGI(TAG, "Running %s with %d messages.", scenario, count);
+    bench_snapshot_t before, after;
+    esp_rmaker_latency_reset();
+    bench_take_snapshot(&before);
+    int done = 0, failed = 0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < count; i++) {
+        int len = gen(i, payload, BENCH_PAYLOAD_SIZE);
+        if (len < 0) {
+            failed++;
+            continue;
+        }
+        int64_t t = esp_timer_get_time();
+        esp_err_t err = esp_rmaker_mqtt_loopback_inject(topic, payload, len);
+        samples[done++] = (uint32_t)(esp_timer_get_time() - t);
+        if (err != ESP_OK) {
+            failed++;
+        }
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    vTaskDelay(BENCH_SETTLE_TIME_MS / portTICK_PERIOD_MS);
+    bench_take_snapshot(&after);
+    bench_report(scenario, done, failed, elapsed, &before, &after);
+    free(payload);
+}
+
+static int bench_gen_set_params(int i, char *buf, size_t buf_size)
+{
+    json_gen_str_t jstr;
+    char name[16];
+    json_gen_str_start(&jstr, buf, buf_size, NULL, NULL);
+    json_gen_start_object(&jstr);
+    for (int d = 0; d < CONFIG_BENCH_SET_PARAMS_DEVICES_PER_MSG; d++) {
+        snprintf(name, sizeof(name), BENCH_DEVICE_NAME_FMT, (i + d) % CONFIG_BENCH_NUM_DEVICES);
+        json_gen_push_object(&jstr, name);
+        snprintf(name, sizeof(name), BENCH_PARAM_NAME_FMT, i % CONFIG_BENCH_PARAMS_PER_DEVICE);
+        /* Keep changing the value, so that every message results in an actual update */
+        json_gen_obj_set_int(&jstr, name, i % 1000);
+        json_gen_pop_object(&jstr);
+    }
+    json_gen_end_object(&jstr);
+    /* The length includes the NULL termination, and is more than the buffer size if it did not fit */
+    int len = json_gen_str_end(&jstr);
+    return (len <= buf_size) ? len - 1 : -1;
+}
+
+/* Alternately adds and removes a schedule, so that the count stays within the schedule limits */
+static int bench_gen_schedule(int i, char *buf, size_t buf_size)
+{
+    int len;
+    if (i % 2 == 0) {
+        len = snprintf(buf, buf_size, "{\"Schedule\":{\"Schedules\":[{\"id\":\"bs%04d\",\"name\":\"Bench\","
+                "\"operation\":\"add\",\"triggers\":[{\"m\":%d,\"d\":127}],"
+                "\"action\":{\"" BENCH_DEVICE_NAME_FMT "\":{\"P0\":%d}}}]}}",
+                (i / 2) % 10000, (i * 7) % 1440, (i / 2) % CONFIG_BENCH_NUM_DEVICES, i % 1000);
+    } else {
+        len = snprintf(buf, buf_size, "{\"Schedule\":{\"Schedules\":[{\"id\":\"bs%04d\",\"operation\":\"remove\"}]}}",
+                (i / 2) % 10000);
+    }
+    return (len > 0 && len < buf_size) ? len : -1;
+}
+
+static int bench_gen_scene_activate(int i, char *buf, size_t buf_size)
+{
+    int len = snprintf(buf, buf_size, "{\"Scenes\":{\"Scenes\":[{\"id\":\"bsc0\",\"operation\":\"activate\"}]}}");
+    return (len > 0 && len < buf_size) ? len : -1;
+}
+
+/* Adds the scene used by the scene activation scenario. It changes the first param of all the devices. */
+static esp_err_t bench_add_scene(void)
+{
+    char *payload = calloc(1, BENCH_PAYLOAD_SIZE);
+    if (!payload) {
+        return ESP_ERR_NO_MEM;
+    }
+    json_gen_str_t jstr;
+    char name[16];
+    json_gen_str_start(&jstr, payload, BENCH_PAYLOAD_SIZE, NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_push_object(&jstr, "Scenes");
+    json_gen_push_array(&jstr, "Scenes");
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_string(&jstr, "id", "bsc0");
+    json_gen_obj_set_string(&jstr, "name", "Bench");
+    json_gen_obj_set_string(&jstr, "operation", "add");
+    json_gen_push_object(&jstr, "action");
+    for (int d = 0; d < CONFIG_BENCH_NUM_DEVICES; d++) {
+        snprintf(name, sizeof(name), BENCH_DEVICE_NAME_FMT, d);
+        json_gen_push_object(&jstr, name);
+        json_gen_obj_set_int(&jstr, "P0", d + 1);
+        json_gen_pop_object(&jstr);
+    }
+    json_gen_pop_object(&jstr);
+    json_gen_end_object(&jstr);
+    json_gen_pop_array(&jstr);
+    json_gen_pop_object(&jstr);
+    json_gen_end_object(&jstr);
+    esp_err_t err = ESP_ERR_INVALID_SIZE;
+    if (json_gen_str_end(&jstr) <= BENCH_PAYLOAD_SIZE) {
+        char topic[BENCH_TOPIC_SIZE];
+        snprintf(topic, sizeof(topic), "node/%s/params/remote", esp_rmaker_get_node_id());
+        err = esp_rmaker_mqtt_loopback_inject(topic, payload, strlen(payload));
+    }
+    free(payload);
+    return err;
+}
+
+/* Replays the embedded trace. Each line is "<topic suffix> <payload>". */
+static void bench_replay_trace(void)
+{
+    char topic[BENCH_TOPIC_SIZE];
+    bench_snapshot_t before, after;
+    int done = 0, failed = 0;
+    esp_rmaker_latency_reset();
+    bench_take_snapshot(&before);
+    int64_t start = esp_timer_get_time();
+    const char *line = replay_trace_start;
+    while (line < replay_trace_end && done < CONFIG_BENCH_ITERATIONS) {
+        const char *eol = memchr(line, '\n', replay_trace_end - line);
+        if (!eol) {
+            eol = replay_trace_end;
+        }
+        const char *sep = memchr(line, ' ', eol - line);
+        if ((line[0] != '#') && sep) {
+            int len = snprintf(topic, sizeof(topic), "node/%s/%.*s", esp_rmaker_get_node_id(),
+                    (int)(sep - line), line);
+            const char *payload = sep + 1;
+            size_t payload_len = eol - payload;
+            if (payload_len && payload[payload_len - 1] == '\r') {
+                payload_len--;
+            }
+            if (len >= sizeof(topic)) {
+                failed++;
+            } else {
+                int64_t t = esp_timer_get_time();
+                esp_err_t err = esp_rmaker_mqtt_loopback_inject(topic, payload, payload_len);
+                samples[done++] = (uint32_t)(esp_timer_get_time() - t);
+                if (err != ESP_OK) {
+                    failed++;
+                }
+            }
+        }
+        line = eol + 1;
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    vTaskDelay(BENCH_SETTLE_TIME_MS / portTICK_PERIOD_MS);
+    bench_take_snapshot(&after);
+    bench_report("replay", done, failed, elapsed, &before, &after);
+}
+
+#ifdef CONFIG_ESP_RMAKER_MQTT_COMPRESSION
+/* Measures the compression of the real node config and full params report, by having the node report them again */
+static void bench_compression(void)
+{
+    esp_rmaker_mqtt_compress_stats_t before, after;
+    esp_rmaker_mqtt_compress_get_stats(&before);
+    for (int i = 0; i < BENCH_COMPRESS_ROUNDS; i++) {
+        esp_rmaker_report_node_details();
+        vTaskDelay(BENCH_SETTLE_TIME_MS / portTICK_PERIOD_MS);
+    }
+    esp_rmaker_mqtt_compress_get_stats(&after);
+    uint32_t compressed = after.compressed - before.compressed;
+    uint32_t msgs = compressed + (after.incompressible - before.incompressible);
+    if (msgs == 0) {
+        ESP_LOGW(TAG, "No messages large enough for compression. Check CONFIG_ESP_RMAKER_MQTT_COMPRESSION_MIN_SIZE.");
+        return;
+    }
+    uint64_t bytes_in = after.bytes_in - before.bytes_in;
+    uint64_t bytes_out = after.bytes_out - before.bytes_out;
+    char buf[BENCH_RESULT_SIZE];
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, buf, sizeof(buf), NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_string(&jstr, "scenario", "compression");
+    json_gen_obj_set_int(&jstr, "msgs", msgs);
+    json_gen_obj_set_int(&jstr, "compressed", compressed);
+    json_gen_obj_set_int(&jstr, "window_bits", CONFIG_ESP_RMAKER_MQTT_COMPRESSION_WINDOW_BITS);
+    json_gen_obj_set_int(&jstr, "lookahead_bits", CONFIG_ESP_RMAKER_MQTT_COMPRESSION_LOOKAHEAD_BITS);
+    json_gen_obj_set_int(&jstr, "bytes_in_per_msg", (int)(bytes_in / msgs));
+    json_gen_obj_set_int(&jstr, "bytes_out_per_msg", (int)(bytes_out / msgs));
+    json_gen_obj_set_float(&jstr, "ratio", bytes_in ? (float)bytes_out / bytes_in : 1);
+    json_gen_obj_set_int(&jstr, "avg_us", (int)((after.time_us - before.time_us) / msgs));
+    json_gen_end_object(&jstr);
+    json_gen_str_end(&jstr);
+    printf("BENCH_RESULT %s\n", buf);
+}
+#endif /* CONFIG_ESP_RMAKER_MQTT_COMPRESSION */
+
+typedef enum {
+    BENCH_SCHEDULE_OP_CREATE = 0,
+    BENCH_SCHEDULE_OP_ENABLE,
+    /* Enabling already enabled schedules again, as happens when the time gets synchronised */
+    BENCH_SCHEDULE_OP_REARM,
+    BENCH_SCHEDULE_OP_DISABLE,
+    BENCH_SCHEDULE_OP_DELETE,
+    BENCH_SCHEDULE_OP_MAX,
+} bench_schedule_op_t;
+
+static const char *bench_schedule_op_names[BENCH_SCHEDULE_OP_MAX] = {
+    "create", "enable", "rearm", "disable", "delete"
+};
+
+static void bench_schedule_trigger_cb(esp_schedule_handle_t handle, void *priv_data)
+{
+}
+
+/* Measures the esp_schedule operations directly, with a large number of schedules armed at the same time */
+static void bench_schedule_timers(void)
+{
+    if (esp_rmaker_time_check() != true) {
+        ESP_LOGW(TAG, "Time not synchronised. Skipping schedule_timers.");
+        return;
+    }
+    esp_schedule_handle_t *handles = calloc(CONFIG_BENCH_SCHEDULE_COUNT, sizeof(esp_schedule_handle_t));
+    if (!handles) {
+        ESP_LOGE(TAG, "Failed to allocate memory for %d schedules.", CONFIG_BENCH_SCHEDULE_COUNT);
+        return;
+    }
+    ESP_LOGI(TAG, "Running schedule_timers with %d schedules.", CONFIG_BENCH_SCHEDULE_COUNT);
+    uint64_t total_us[BENCH_SCHEDULE_OP_MAX] = {0};
+    uint32_t max_us[BENCH_SCHEDULE_OP_MAX] = {0};
+    uint32_t free_heap_before = esp_get_free_heap_size();
+    uint32_t free_heap_armed = 0;
+    int created = 0;
+    for (int op = 0; op < BENCH_SCHEDULE_OP_MAX; op++) {
+        for (int i = 0; i < CONFIG_BENCH_SCHEDULE_COUNT; i++) {
+            int64_t t = esp_timer_get_time();
+            switch (op) {
+                case BENCH_SCHEDULE_OP_CREATE: {
+                    esp_schedule_config_t config = {
+                        .trigger.type = ESP_SCHEDULE_TYPE_DAYS_OF_WEEK,
+                        /* Spread across the day, so that the schedules do not all land on the same deadline */
+                        .trigger.hours = (i / 60) % 24,
+                        .trigger.minutes = i % 60,
+                        .trigger.day.repeat_days = ESP_SCHEDULE_DAY_EVERYDAY,
+                        .trigger_cb = bench_schedule_trigger_cb,
+                    };
+                    snprintf(config.name, sizeof(config.name), "bst%04d", i);
+                    handles[i] = esp_schedule_create(&config);
+                    if (handles[i]) {
+                        created++;
+                    }
+                    break;
+                }
+                case BENCH_SCHEDULE_OP_ENABLE:
+                case BENCH_SCHEDULE_OP_REARM:
+                    if (handles[i]) {
+                        esp_schedule_enable(handles[i]);
+                    }
+                    break;
+                case BENCH_SCHEDULE_OP_DISABLE:
+                    if (handles[i]) {
+                        esp_schedule_disable(handles[i]);
+                    }
+                    break;
+                case BENCH_SCHEDULE_OP_DELETE:
+                    if (handles[i]) {
+                        esp_schedule_delete(handles[i]);
+                        handles[i] = NULL;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            uint32_t elapsed = (uint32_t)(esp_timer_get_time() - t);
+            total_us[op] += elapsed;
+            if (elapsed > max_us[op]) {
+                max_us[op] = elapsed;
+            }
+        }
+        if (op == BENCH_SCHEDULE_OP_REARM) {
+            free_heap_armed = esp_get_free_heap_size();
+        }
+    }
+    free(handles);
+    if (created == 0) {
+        ESP_LOGE(TAG, "Failed to create any schedule for schedule_timers.");
+        return;
+    }
+    char buf[BENCH_RESULT_SIZE];
+    char key[24];
+    json_gen_str_t jstr;
+    json_gen_str_start(&jstr, buf, sizeof(buf), NULL, NULL);
+    json_gen_start_object(&jstr);
+    json_gen_obj_set_string(&jstr, "scenario", "schedule_timers");
+    json_gen_obj_set_int(&jstr, "schedules", created);
+    for (int op = 0; op < BENCH_SCHEDULE_OP_MAX; op++) {
+        snprintf(key, sizeof(key), "%s_avg_us", bench_schedule_op_names[op]);
+        json_gen_obj_set_int(&jstr, key, (int)(total_us[op] / CONFIG_BENCH_SCHEDULE_COUNT));
+        snprintf(key, sizeof(key), "%s_max_us", bench_schedule_op_names[op]);
+        json_gen_obj_set_int(&jstr, key, max_us[op]);
+    }
+    /* Heap held per schedule while all of them are armed */
+    json_gen_obj_set_int(&jstr, "heap_per_schedule", ((int)free_heap_before - (int)free_heap_armed) / created);
+    json_gen_end_object(&jstr);
+    json_gen_str_end(&jstr);
+    printf("BENCH_RESULT %s\n", buf);
+}
+
+static void bench_task(void *arg)
+{
+    vTaskDelay((CONFIG_BENCH_START_DELAY_SEC * 1000) / portTICK_PERIOD_MS);
+    esp_rmaker_mqtt_loopback_set_publish_cb(bench_publish_cb, NULL);
+
+    bench_run_scenario("set_params", "params/remote", bench_gen_set_params, CONFIG_BENCH_ITERATIONS);
+    bench_run_scenario("schedule_add_remove", "params/remote", bench_gen_schedule, CONFIG_BENCH_ITERATIONS);
+    if (bench_add_scene() == ESP_OK) {
+        bench_run_scenario("scene_activate", "params/remote", bench_gen_scene_activate, CONFIG_BENCH_ITERATIONS);
+    } else {
+        ESP_LOGE(TAG, "Failed to add scene. Skipping scene_activate.");
+    }
+    bench_schedule_timers();
+#ifdef CONFIG_BENCH_REPLAY_TRACE
+    bench_replay_trace();
+#endif
+#ifdef CONFIG_ESP_RMAKER_MQTT_COMPRESSION
+    bench_compression();
+#endif
+
+    esp_rmaker_mqtt_loopback_set_publish_cb(NULL, NULL);
+    free(samples);
+    samples = NULL;
+    ESP_LOGI(TAG, "Benchmark complete.");
+    printf("BENCH_DONE\n");
+    vTaskDelete(NULL);
+}
+
+void app_bench_start(void)
+{
+    samples = calloc(CONFIG_BENCH_ITERATIONS, sizeof(uint32_t));
+    if (!samples) {
+        ESP_LOGE(TAG, "Failed to allocate memory for %d samples.", CONFIG_BENCH_ITERATIONS);
+        return;
+    }
+    if (xTaskCreate(bench_task, "bench_task", BENCH_TASK_STACK, NULL, BENCH_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create benchmark task.");
+        free(samples);
+        samples = NULL;
+    }
+}
@@ -0,0 +1,125 @@
+/* Benchmark Example
+
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_log.h>
+#include <esp_event.h>
+#include <nvs_flash.h>
+
+#include <esp_rmaker_core.h>
+#include <esp_rmaker_mqtt.h>
+#include <esp_rmaker_common_events.h>
+#include <esp_rmaker_schedule.h>
+#include <esp_rmaker_scenes.h>
+
+#include <app_wifi.h>
+
+#include "app_priv.h"
+
+static const char *TAG = "app_main";
+
+/* Callback to handle the set params requests. The values are just reported back,
+ * so that the reporting path is also covered by the measurements.
+ */
+static esp_err_t write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
+            const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx)
+{
+    esp_rmaker_param_update_and_report(param, val);
+    return ESP_OK;
+}
+
+static void event_handler(void* arg, esp_event_base_t event_base,
+                          int32_t event_id, void* event_data)
+{
+    if (event_base == RMAKER_COMMON_EVENT && event_id == RMAKER_MQTT_EVENT_CONNECTED) {
+        static bool started;
+        if (!started) {
+            started = true;
+            app_bench_start();
+        }
+    }
+}
+
+void app_main()
+{
+    /* Initialize NVS. */
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK( err );
+
+    /* Initialize Wi-Fi. Note that, this should be called before esp_rmaker_node_init()
+     */
+    app_wifi_init();
+
+    /* Use the in-process MQTT loopback, so that the measurements are not affected by the network.
+     * Note that this should be called before esp_rmaker_node_init()
+     */
+    err = esp_rmaker_mqtt_loopback_setup();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not set up MQTT loopback. Check CONFIG_ESP_RMAKER_MQTT_LOOPBACK. Aborting!!!");
+        vTaskDelay(5000/portTICK_PERIOD_MS);
+        abort();
+    }
+    esp_event_handler_register(RMAKER_COMMON_EVENT, RMAKER_MQTT_EVENT_CONNECTED, &event_handler, NULL);
+
+    /* Initialize the ESP RainMaker Agent.
+     * Note that this should be called after app_wifi_init() but before app_wifi_start()
+     * */
+    esp_rmaker_config_t rainmaker_cfg = {
+        .enable_time_sync = false,
+    };
+    esp_rmaker_node_t *node = esp_rmaker_node_init(&rainmaker_cfg, "ESP RainMaker Benchmark", "Benchmark");
+    if (!node) {
+        ESP_LOGE(TAG, "Could not initialise node. Aborting!!!");
+        vTaskDelay(5000/portTICK_PERIOD_MS);
+        abort();
+    }
+
+    /* Create the devices, each with a set of integer params */
+    for (int i = 0; i < CONFIG_BENCH_NUM_DEVICES; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), BENCH_DEVICE_NAME_FMT, i);
+        esp_rmaker_device_t *device = esp_rmaker_device_create(name, NULL, NULL);
+        esp_rmaker_device_add_cb(device, write_cb, NULL);
+        for (int j = 0; j < CONFIG_BENCH_PARAMS_PER_DEVICE; j++) {
+            snprintf(name, sizeof(name), BENCH_PARAM_NAME_FMT, j);
+            esp_rmaker_param_t *param = esp_rmaker_param_create(name, NULL, esp_rmaker_int(0),
+                    PROP_FLAG_READ | PROP_FLAG_WRITE);
+            esp_rmaker_param_add_bounds(param, esp_rmaker_int(0), esp_rmaker_int(1000), esp_rmaker_int(1));
+            esp_rmaker_device_add_param(device, param);
+        }
+        esp_rmaker_node_add_device(node, device);
+    }
+
+    /* Enable scheduling. */
+    esp_rmaker_schedule_enable();
+
+    /* Enable Scenes */
+    esp_rmaker_scenes_enable();
+
+    /* Start the ESP RainMaker Agent */
+    esp_rmaker_start();
+
+    /* Start the Wi-Fi.
+     * The MQTT (loopback) connection is initiated by the RainMaker Agent once the
+     * Wi-Fi is connected. None of the benchmark traffic goes over the network.
+     */
+    err = app_wifi_start(POP_TYPE_RANDOM);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Could not start Wifi. Aborting!!!");
+        vTaskDelay(5000/portTICK_PERIOD_MS);
+        abort();
+    }
+}
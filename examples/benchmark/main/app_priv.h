@@ -0,0 +1,14 @@
+/*
+   This example code is in the Public Domain (or CC0 licensed, at your option.)
+
+   Unless required by applicable law or agreed to in writing, this
+   software is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+   CONDITIONS OF ANY KIND, either express or implied.
+*/
+#pragma once
+
+#define BENCH_DEVICE_NAME_FMT   "Dev%d"
+#define BENCH_PARAM_NAME_FMT    "P%d"
+
+/* Start the benchmark task. Should be called once the (loopback) MQTT connection is up. */
+void app_bench_start(void);
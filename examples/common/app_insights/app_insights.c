@@ -38,7 +38,7 @@ static int app_insights_data_send(void *data, size_t len)
     if (!node_id) {
         return -1;
     }
-    if (esp_rmaker_mqtt_is_budget_available() == false) {
+    if (esp_rmaker_mqtt_is_class_budget_available(ESP_RMAKER_MQTT_MSG_CLASS_TIME_SERIES) == false) {
         /* the API `esp_rmaker_mqtt_publish` already checks if the budget is available.
             This also raises an error message, which we do not want for esp-insights.
             silently return with error */
@@ -73,6 +73,137 @@ static void rmaker_common_event_handler(void* arg, esp_event_base_t event_base,
             break;
     }
 }
+
+#if defined(CONFIG_DIAG_ENABLE_METRICS) && \
+    (defined(CONFIG_ESP_RMAKER_LATENCY_TRACE) || defined(CONFIG_ESP_RMAKER_MEM_TAG_ACCOUNTING))
+#define APP_INSIGHTS_RMAKER_METRICS
+#include <esp_diagnostics_metrics.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/timers.h>
+
+#define RMAKER_METRICS_TAG          "rmaker"
+#define RMAKER_METRICS_INTERVAL     (5 * 60)    /* 5 minutes */
+
+#ifdef CONFIG_ESP_RMAKER_LATENCY_TRACE
+#define LATENCY_METRICS_PATH        "rmaker.latency"
+
+/* Keys are kept short because of the key length limit in esp_diagnostics */
+static const char *latency_keys[ESP_RMAKER_LATENCY_STAGE_MAX] = {
+    [ESP_RMAKER_LATENCY_STAGE_PARSE] = "lat_parse",
+    [ESP_RMAKER_LATENCY_STAGE_WRITE_CB] = "lat_write_cb",
+    [ESP_RMAKER_LATENCY_STAGE_PARAM_UPDATE] = "lat_update",
+    [ESP_RMAKER_LATENCY_STAGE_NVS_STORE] = "lat_nvs",
+    [ESP_RMAKER_LATENCY_STAGE_JSON_POPULATE] = "lat_json",
+    [ESP_RMAKER_LATENCY_STAGE_PUBLISH] = "lat_publish",
+    [ESP_RMAKER_LATENCY_STAGE_TOTAL] = "lat_total",
+};
+/* esp_diagnostics keeps references to the labels, so these need to be static */
+static const char *latency_labels[ESP_RMAKER_LATENCY_STAGE_MAX] = {
+    [ESP_RMAKER_LATENCY_STAGE_PARSE] = "Set params parse latency (us)",
+    [ESP_RMAKER_LATENCY_STAGE_WRITE_CB] = "Set params write callback latency (us)",
+    [ESP_RMAKER_LATENCY_STAGE_PARAM_UPDATE] = "Param update latency (us)",
+    [ESP_RMAKER_LATENCY_STAGE_NVS_STORE] = "Param NVS store latency (us)",
+    [ESP_RMAKER_LATENCY_STAGE_JSON_POPULATE] = "Params JSON populate latency (us)",
+    [ESP_RMAKER_LATENCY_STAGE_PUBLISH] = "Params publish latency (us)",
+    [ESP_RMAKER_LATENCY_STAGE_TOTAL] = "Set params total latency (us)",
+};
+static esp_rmaker_latency_stats_t prev_latency_stats[ESP_RMAKER_LATENCY_STAGE_MAX];
+
+/* Reports the average latency (in usec) of each stage over the last interval */
+static void app_insights_latency_metrics_report(void)
+{
+    esp_rmaker_latency_stats_t stats;
+    for (int stage = 0; stage < ESP_RMAKER_LATENCY_STAGE_MAX; stage++) {
+        if (esp_rmaker_latency_get_stats(stage, &stats) != ESP_OK) {
+            continue;
+        }
+        /* Stats may have been reset in between */
+        if (stats.count < prev_latency_stats[stage].count) {
+            memset(&prev_latency_stats[stage], 0, sizeof(esp_rmaker_latency_stats_t));
+        }
+        uint32_t count = stats.count - prev_latency_stats[stage].count;
+        if (count) {
+            uint64_t total_us = stats.total_us - prev_latency_stats[stage].total_us;
+            esp_diag_metrics_add_uint(latency_keys[stage], (uint32_t)(total_us / count));
+        }
+        prev_latency_stats[stage] = stats;
+    }
+}
+
+static void app_insights_latency_metrics_register(void)
+{
+    for (int stage = 0; stage < ESP_RMAKER_LATENCY_STAGE_MAX; stage++) {
+        esp_diag_metrics_register(RMAKER_METRICS_TAG, latency_keys[stage], latency_labels[stage], LATENCY_METRICS_PATH,
+                ESP_DIAG_DATA_TYPE_UINT);
+    }
+}
+#endif /* CONFIG_ESP_RMAKER_LATENCY_TRACE */
+
+#ifdef CONFIG_ESP_RMAKER_MEM_TAG_ACCOUNTING
+#define MEM_TAG_METRICS_PATH        "rmaker.heap"
+
+static const char *mem_tag_keys[ESP_RMAKER_MEM_TAG_MAX] = {
+    [ESP_RMAKER_MEM_TAG_PARAMS] = "mem_params",
+    [ESP_RMAKER_MEM_TAG_NODE_CONFIG] = "mem_node_config",
+    [ESP_RMAKER_MEM_TAG_SCHEDULE] = "mem_schedule",
+    [ESP_RMAKER_MEM_TAG_SCENES] = "mem_scenes",
+    [ESP_RMAKER_MEM_TAG_OTA] = "mem_ota",
+    [ESP_RMAKER_MEM_TAG_LOCAL_CTRL] = "mem_local_ctrl",
+};
+static const char *mem_tag_labels[ESP_RMAKER_MEM_TAG_MAX] = {
+    [ESP_RMAKER_MEM_TAG_PARAMS] = "Params heap usage (bytes)",
+    [ESP_RMAKER_MEM_TAG_NODE_CONFIG] = "Node config heap usage (bytes)",
+    [ESP_RMAKER_MEM_TAG_SCHEDULE] = "Schedules heap usage (bytes)",
+    [ESP_RMAKER_MEM_TAG_SCENES] = "Scenes heap usage (bytes)",
+    [ESP_RMAKER_MEM_TAG_OTA] = "OTA heap usage (bytes)",
+    [ESP_RMAKER_MEM_TAG_LOCAL_CTRL] = "Local control heap usage (bytes)",
+};
+
+/* Reports the live heap usage of each subsystem */
+static void app_insights_mem_tag_metrics_report(void)
+{
+    esp_rmaker_mem_tag_stats_t stats;
+    for (int tag = 0; tag < ESP_RMAKER_MEM_TAG_MAX; tag++) {
+        if (esp_rmaker_mem_tag_get_stats(tag, &stats) == ESP_OK) {
+            esp_diag_metrics_add_uint(mem_tag_keys[tag], stats.live_bytes);
+        }
+    }
+}
+
+static void app_insights_mem_tag_metrics_register(void)
+{
+    for (int tag = 0; tag < ESP_RMAKER_MEM_TAG_MAX; tag++) {
+        esp_diag_metrics_register(RMAKER_METRICS_TAG, mem_tag_keys[tag], mem_tag_labels[tag], MEM_TAG_METRICS_PATH,
+                ESP_DIAG_DATA_TYPE_UINT);
+    }
+}
+#endif /* CONFIG_ESP_RMAKER_MEM_TAG_ACCOUNTING */
+
+static void app_insights_rmaker_metrics_timer_cb(TimerHandle_t timer)
+{
+#ifdef CONFIG_ESP_RMAKER_LATENCY_TRACE
+    app_insights_latency_metrics_report();
+#endif
+#ifdef CONFIG_ESP_RMAKER_MEM_TAG_ACCOUNTING
+    app_insights_mem_tag_metrics_report();
+#endif
+}
+
+static void app_insights_rmaker_metrics_enable(void)
+{
+#ifdef CONFIG_ESP_RMAKER_LATENCY_TRACE
+    app_insights_latency_metrics_register();
+#endif
+#ifdef CONFIG_ESP_RMAKER_MEM_TAG_ACCOUNTING
+    app_insights_mem_tag_metrics_register();
+#endif
+    TimerHandle_t timer = xTimerCreate("app_insights_rmaker", (RMAKER_METRICS_INTERVAL * 1000) / portTICK_PERIOD_MS,
+            pdTRUE, NULL, app_insights_rmaker_metrics_timer_cb);
+    if (!timer || (xTimerStart(timer, 0) != pdPASS)) {
+        ESP_LOGE("app_insights", "Failed to start RainMaker metrics timer.");
+    }
+}
+#endif /* CONFIG_DIAG_ENABLE_METRICS && (CONFIG_ESP_RMAKER_LATENCY_TRACE || CONFIG_ESP_RMAKER_MEM_TAG_ACCOUNTING) */
 #endif /* CONFIG_ESP_INSIGHTS_ENABLED */
 
 #define TAG "app_insights"
@@ -109,6 +240,9 @@ esp_err_t app_insights_enable(void)
         .alloc_ext_ram = true,
     };
     esp_insights_enable(&config);
+#ifdef APP_INSIGHTS_RMAKER_METRICS
+    app_insights_rmaker_metrics_enable();
+#endif /* APP_INSIGHTS_RMAKER_METRICS */
 #else
     ESP_LOGI(TAG, "Enable CONFIG_ESP_INSIGHTS_ENABLED to get Insights.");
 #endif /* ! CONFIG_ESP_INSIGHTS_ENABLED */